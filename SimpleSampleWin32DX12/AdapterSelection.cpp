@@ -0,0 +1,208 @@
+//
+// AdapterSelection.cpp - Adapter selection policy and a persistent cache of device probe results
+//
+
+#include "pch.h"
+#include "AdapterSelection.h"
+
+#include <fstream>
+
+using namespace DX;
+
+namespace
+{
+    constexpr uint32_t c_CacheMagic = 0x43504441; // 'ADPC'
+    constexpr uint32_t c_CacheVersion = 1;
+    constexpr uint32_t c_MaxCacheEntries = 64;
+
+    struct CacheHeader
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint32_t    entryCount;
+        uint32_t    reserved;
+    };
+
+    inline bool IsSameLuid(const LUID& a, const LUID& b) noexcept
+    {
+        return a.LowPart == b.LowPart && a.HighPart == b.HighPart;
+    }
+}
+
+bool AdapterCache::Load(const wchar_t* fileName)
+{
+    m_entries.clear();
+    m_dirty = false;
+
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file)
+        return false;
+
+    CacheHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != c_CacheMagic
+        || header.version != c_CacheVersion
+        || header.entryCount > c_MaxCacheEntries)
+    {
+        return false;
+    }
+
+    std::vector<Entry> entries(header.entryCount);
+    if (header.entryCount
+        && !file.read(reinterpret_cast<char*>(entries.data()), std::streamsize(sizeof(Entry) * entries.size())))
+    {
+        return false;
+    }
+
+    m_entries = std::move(entries);
+    return true;
+}
+
+bool AdapterCache::Save(const wchar_t* fileName) const
+{
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    CacheHeader header = {};
+    header.magic = c_CacheMagic;
+    header.version = c_CacheVersion;
+    header.entryCount = static_cast<uint32_t>(std::min<size_t>(m_entries.size(), c_MaxCacheEntries));
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_entries.data()), std::streamsize(sizeof(Entry) * header.entryCount));
+
+    return file.good();
+}
+
+ADAPTER_SUPPORT AdapterCache::Find(const AdapterInfo& adapter, D3D_FEATURE_LEVEL featureLevel) const noexcept
+{
+    const Entry* entry = FindEntry(adapter);
+    if (!entry)
+        return AdapterSupport_Unknown;
+
+    if (entry->supportedLevel && featureLevel <= entry->supportedLevel)
+        return AdapterSupport_Yes;
+
+    if (entry->unsupportedLevel && featureLevel >= entry->unsupportedLevel)
+        return AdapterSupport_No;
+
+    return AdapterSupport_Unknown;
+}
+
+void AdapterCache::Record(const AdapterInfo& adapter, D3D_FEATURE_LEVEL featureLevel, bool supported)
+{
+    // Without a driver version there's nothing to tell a stale entry apart from a current one.
+    if (!adapter.driverVersion)
+        return;
+
+    Entry* entry = FindEntry(adapter);
+    if (!entry)
+    {
+        // The LUID is reused across driver updates; the old entry is no longer useful.
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+            [&](const Entry& e) { return IsSameLuid(e.luid, adapter.luid); }), m_entries.end());
+
+        if (m_entries.size() >= c_MaxCacheEntries)
+        {
+            m_entries.erase(m_entries.begin());
+        }
+
+        Entry e = {};
+        e.luid = adapter.luid;
+        e.driverVersion = adapter.driverVersion;
+        m_entries.push_back(e);
+        entry = &m_entries.back();
+    }
+
+    if (supported)
+    {
+        if (featureLevel <= entry->supportedLevel)
+            return;
+
+        entry->supportedLevel = featureLevel;
+        if (entry->unsupportedLevel && entry->unsupportedLevel <= featureLevel)
+        {
+            entry->unsupportedLevel = static_cast<D3D_FEATURE_LEVEL>(0);
+        }
+    }
+    else
+    {
+        if (entry->unsupportedLevel && featureLevel >= entry->unsupportedLevel)
+            return;
+
+        entry->unsupportedLevel = featureLevel;
+    }
+
+    m_dirty = true;
+}
+
+AdapterCache::Entry* AdapterCache::FindEntry(const AdapterInfo& adapter) noexcept
+{
+    for (auto& e : m_entries)
+    {
+        if (IsSameLuid(e.luid, adapter.luid) && e.driverVersion == adapter.driverVersion)
+            return &e;
+    }
+    return nullptr;
+}
+
+const AdapterCache::Entry* AdapterCache::FindEntry(const AdapterInfo& adapter) const noexcept
+{
+    return const_cast<AdapterCache*>(this)->FindEntry(adapter);
+}
+
+int DX::SelectAdapter(
+    const AdapterInfo* adapters,
+    size_t count,
+    const AdapterPolicy& policy,
+    const std::function<bool(size_t)>& isSupported)
+{
+    if (count && (!adapters || !isSupported))
+    {
+        throw std::invalid_argument("SelectAdapter");
+    }
+
+    std::vector<size_t> order;
+    order.reserve(count);
+
+    for (size_t j = 0; j < count; ++j)
+    {
+        const auto& adapter = adapters[j];
+
+        if (adapter.isSoftware && !policy.allowSoftware)
+            continue;
+
+        if (adapter.dedicatedVideoMemory < policy.minDedicatedVideoMemory)
+            continue;
+
+        order.push_back(j);
+    }
+
+    if (policy.preferMostVideoMemory)
+    {
+        std::stable_sort(order.begin(), order.end(),
+            [adapters](size_t a, size_t b)
+            {
+                return adapters[a].dedicatedVideoMemory > adapters[b].dedicatedVideoMemory;
+            });
+    }
+
+    if (policy.preferredLuid.LowPart || policy.preferredLuid.HighPart)
+    {
+        auto preferred = std::find_if(order.begin(), order.end(),
+            [&](size_t j) { return IsSameLuid(adapters[j].luid, policy.preferredLuid); });
+        if (preferred != order.end())
+        {
+            std::rotate(order.begin(), preferred, preferred + 1);
+        }
+    }
+
+    for (const size_t j : order)
+    {
+        if (isSupported(j))
+            return static_cast<int>(j);
+    }
+
+    return -1;
+}
@@ -0,0 +1,102 @@
+//
+// AdapterSelection.h - Adapter selection policy and a persistent cache of device probe results
+//
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace DX
+{
+    // What DeviceResources knows about an adapter before creating a device on it.
+    struct AdapterInfo
+    {
+        LUID                luid;
+        uint64_t            driverVersion;          // User-mode driver version, 0 if unknown
+        uint32_t            vendorId;
+        uint32_t            deviceId;
+        uint64_t            dedicatedVideoMemory;
+        bool                isSoftware;
+    };
+
+    // How to choose between adapters. The default takes the first hardware adapter in
+    // DXGI's high-performance order which supports the minimum feature level.
+    struct AdapterPolicy
+    {
+        LUID                preferredLuid;          // Tried first when non-zero
+        uint64_t            minDedicatedVideoMemory;
+        D3D_FEATURE_LEVEL   minFeatureLevel;
+        bool                preferMostVideoMemory;  // Otherwise keep enumeration order
+        bool                allowSoftware;
+
+        AdapterPolicy() noexcept :
+            preferredLuid{},
+            minDedicatedVideoMemory(0),
+            minFeatureLevel(D3D_FEATURE_LEVEL_11_0),
+            preferMostVideoMemory(false),
+            allowSoftware(false)
+        {
+        }
+    };
+
+    enum ADAPTER_SUPPORT : uint32_t
+    {
+        AdapterSupport_Unknown = 0,
+        AdapterSupport_Yes,
+        AdapterSupport_No,
+    };
+
+    // Remembers which feature levels each adapter was found to support, keyed by LUID and driver
+    // version, so a later start can skip creating throwaway devices to probe it. A driver update
+    // changes the key, which invalidates the entry.
+    class AdapterCache
+    {
+    public:
+        AdapterCache() = default;
+
+        AdapterCache(AdapterCache&&) = default;
+        AdapterCache& operator= (AdapterCache&&) = default;
+
+        AdapterCache(AdapterCache const&) = delete;
+        AdapterCache& operator= (AdapterCache const&) = delete;
+
+        // Loading a missing or malformed file leaves the cache empty.
+        bool Load(const wchar_t* fileName);
+        bool Save(const wchar_t* fileName) const;
+
+        ADAPTER_SUPPORT Find(const AdapterInfo& adapter, D3D_FEATURE_LEVEL featureLevel) const noexcept;
+
+        // Records the result of probing or creating a device at featureLevel.
+        void Record(const AdapterInfo& adapter, D3D_FEATURE_LEVEL featureLevel, bool supported);
+
+        size_t GetEntryCount() const noexcept { return m_entries.size(); }
+        bool IsDirty() const noexcept { return m_dirty; }
+
+    private:
+        struct Entry
+        {
+            LUID                luid;
+            uint64_t            driverVersion;
+            D3D_FEATURE_LEVEL   supportedLevel;     // Highest level known to work, 0 if none
+            D3D_FEATURE_LEVEL   unsupportedLevel;   // Lowest level known to fail, 0 if none
+        };
+
+        Entry* FindEntry(const AdapterInfo& adapter) noexcept;
+        const Entry* FindEntry(const AdapterInfo& adapter) const noexcept;
+
+        std::vector<Entry>  m_entries;
+        bool                m_dirty = false;
+    };
+
+    // Returns the index of the adapter the policy selects, or -1 if none qualifies. Candidates are
+    // filtered on the cheap properties first, and isSupported (which may have to create a device)
+    // is only called for them in order of preference until one succeeds.
+    int SelectAdapter(
+        _In_reads_(count) const AdapterInfo* adapters,
+        size_t count,
+        const AdapterPolicy& policy,
+        const std::function<bool(size_t)>& isSupported);
+}
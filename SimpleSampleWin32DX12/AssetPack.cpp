@@ -0,0 +1,120 @@
+//
+// AssetPack.cpp - Loads assets out of a memory-mapped asset pack, or from loose files
+//
+
+#include "pch.h"
+#include "AssetPack.h"
+
+#include "MappedFile.h"
+
+using namespace DX;
+
+namespace
+{
+    // Pack names are UTF-8.
+    std::string ToUTF8(const wchar_t* name)
+    {
+        const int length = WideCharToMultiByte(CP_UTF8, 0, name, -1, nullptr, 0, nullptr, nullptr);
+        if (length <= 0)
+        {
+            throw std::invalid_argument("Asset name is not valid Unicode");
+        }
+
+        std::string result(size_t(length), '\0');
+        WideCharToMultiByte(CP_UTF8, 0, name, -1, &result[0], length, nullptr, nullptr);
+        result.resize(size_t(length - 1));
+        return result;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// AssetData
+
+AssetData::AssetData() noexcept :
+    m_data(nullptr),
+    m_size(0)
+{
+}
+
+AssetData::AssetData(AssetData&&) noexcept = default;
+AssetData& AssetData::operator= (AssetData&&) noexcept = default;
+AssetData::~AssetData() = default;
+
+AssetData AssetData::FromFile(const wchar_t* fileName)
+{
+    AssetData result;
+    result.m_file = std::make_unique<MappedFile>(fileName);
+    result.m_data = result.m_file->GetData();
+    result.m_size = result.m_file->GetSize();
+    return result;
+}
+
+//--------------------------------------------------------------------------------------
+// AssetPack
+
+AssetPack::AssetPack(const wchar_t* fileName) noexcept(false) :
+    m_file(std::make_unique<MappedFile>(fileName)),
+    m_view(m_file->GetData(), m_file->GetSize())
+{
+}
+
+AssetPack::AssetPack(AssetPack&&) noexcept = default;
+AssetPack& AssetPack::operator= (AssetPack&&) noexcept = default;
+AssetPack::~AssetPack() = default;
+
+bool AssetPack::Contains(const wchar_t* name) const
+{
+    return Find(name) >= 0;
+}
+
+AssetData AssetPack::Load(const wchar_t* name) const
+{
+    const int index = Find(name);
+    if (index < 0)
+    {
+        throw std::out_of_range("AssetPack::Load: asset not found");
+    }
+
+    const auto j = static_cast<uint32_t>(index);
+    const auto& entry = m_view.GetEntry(j);
+
+    AssetData result;
+    if (m_view.IsCompressed(j))
+    {
+        if (entry.size > SIZE_MAX)
+        {
+            throw std::runtime_error("AssetPack::Load: asset too large");
+        }
+
+        result.m_buffer.resize(static_cast<size_t>(entry.size));
+        m_view.Extract(j, result.m_buffer.data(), result.m_buffer.size());
+        result.m_data = result.m_buffer.data();
+    }
+    else
+    {
+        result.m_data = m_view.GetStoredData(j);
+    }
+
+    result.m_size = static_cast<size_t>(entry.size);
+    return result;
+}
+
+AssetData AssetPack::LoadOrOpen(const wchar_t* name) const
+{
+    if (Contains(name))
+    {
+        return Load(name);
+    }
+
+    return AssetData::FromFile(name);
+}
+
+int AssetPack::Find(const wchar_t* name) const
+{
+    if (!name)
+    {
+        throw std::invalid_argument("AssetPack");
+    }
+
+    return m_view.Find(ToUTF8(name).c_str());
+}
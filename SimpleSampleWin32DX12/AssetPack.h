@@ -0,0 +1,83 @@
+//
+// AssetPack.h - Loads assets out of a memory-mapped asset pack, or from loose files
+//
+
+#pragma once
+
+#include "AssetPackFormat.h"
+
+#include <memory>
+#include <vector>
+
+
+namespace DX
+{
+    class MappedFile;
+
+    // The bytes of one asset, ready to hand to a loader which reads from memory. They either point
+    // straight into a mapping (of the pack, or of a loose file), or into a buffer the asset was
+    // decompressed into. Moving an AssetData doesn't move the bytes.
+    class AssetData
+    {
+    public:
+        AssetData() noexcept;
+
+        AssetData(AssetData&&) noexcept;
+        AssetData& operator= (AssetData&&) noexcept;
+
+        AssetData(AssetData const&) = delete;
+        AssetData& operator= (AssetData const&) = delete;
+
+        ~AssetData();
+
+        // Maps a loose file.
+        static AssetData FromFile(_In_z_ const wchar_t* fileName);
+
+        const uint8_t* GetData() const noexcept { return m_data; }
+        size_t GetSize() const noexcept { return m_size; }
+
+        // True if the bytes are read in place rather than having been copied or decompressed.
+        bool IsMapped() const noexcept { return m_buffer.empty(); }
+
+    private:
+        friend class AssetPack;
+
+        const uint8_t*              m_data;
+        size_t                      m_size;
+        std::vector<uint8_t>        m_buffer;
+        std::unique_ptr<MappedFile> m_file;
+    };
+
+    // An asset pack opened with a single read-only mapping. Stored entries are returned in place,
+    // and compressed ones are decompressed as they're loaded; either way nothing else is opened.
+    // AssetData returned in place refers to the mapping, so it must not outlive the pack.
+    class AssetPack
+    {
+    public:
+        explicit AssetPack(_In_z_ const wchar_t* fileName) noexcept(false);
+
+        AssetPack(AssetPack&&) noexcept;
+        AssetPack& operator= (AssetPack&&) noexcept;
+
+        AssetPack(AssetPack const&) = delete;
+        AssetPack& operator= (AssetPack const&) = delete;
+
+        ~AssetPack();
+
+        bool Contains(_In_z_ const wchar_t* name) const;
+
+        // Throws std::out_of_range if the pack has no such asset.
+        AssetData Load(_In_z_ const wchar_t* name) const;
+
+        // Loads from the pack if it has the asset, otherwise from the named loose file.
+        AssetData LoadOrOpen(_In_z_ const wchar_t* name) const;
+
+        const AssetPackView& GetView() const noexcept { return m_view; }
+
+    private:
+        int Find(_In_z_ const wchar_t* name) const;
+
+        std::unique_ptr<MappedFile> m_file;
+        AssetPackView               m_view;
+    };
+}
@@ -0,0 +1,267 @@
+//
+// AssetPackBuilder.cpp - Command-line tool which builds a single-file asset pack
+//
+// Usage: AssetPackBuilder [-nocompress] [-minsavings <percent>] <output.pak> <asset>...
+//
+// Assets are stored under the names they are given on the command line, and laid out in that
+// order, so list them in the order the game loads them. Each is LZ4 compressed if that saves at
+// least the given percentage (10% by default); otherwise it is stored as-is and loads in place.
+//
+
+#include "AssetPackFormat.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace DX;
+using namespace DX::AssetPackFormat;
+
+namespace
+{
+    struct Asset
+    {
+        std::string             fileName;       // As given on the command line
+        std::string             name;           // Normalized
+        std::vector<uint8_t>    data;           // As written to the pack
+        uint64_t                size;           // Decompressed
+        uint32_t                compression;
+        AssetPackFormat::Entry  entry;
+    };
+
+    std::vector<uint8_t> ReadFile(const char* fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            throw std::runtime_error(std::string("Can't open ") + fileName);
+        }
+
+        const std::streamoff size = file.tellg();
+        if (size < 0)
+        {
+            throw std::runtime_error(std::string("Can't read ") + fileName);
+        }
+
+        std::vector<uint8_t> data(static_cast<size_t>(size));
+        file.seekg(0);
+        if (size && !file.read(reinterpret_cast<char*>(data.data()), size))
+        {
+            throw std::runtime_error(std::string("Can't read ") + fileName);
+        }
+
+        return data;
+    }
+
+    void WritePadding(std::ofstream& file, uint64_t& position, uint64_t alignment)
+    {
+        static const char zeros[4096] = {};
+        uint64_t padding = AlignUp(position, alignment) - position;
+        position += padding;
+        while (padding)
+        {
+            const auto chunk = static_cast<std::streamsize>(std::min<uint64_t>(padding, sizeof(zeros)));
+            file.write(zeros, chunk);
+            padding -= uint64_t(chunk);
+        }
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr, "Usage: AssetPackBuilder [-nocompress] [-minsavings <percent>] <output.pak> <asset>...\n");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool compress = true;
+    double minSavings = 0.10;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg)
+    {
+        if (!strcmp(argv[arg], "-nocompress"))
+        {
+            compress = false;
+        }
+        else if (!strcmp(argv[arg], "-minsavings") && arg + 1 < argc)
+        {
+            minSavings = atof(argv[++arg]) / 100.0;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (argc - arg < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const char* outputName = argv[arg++];
+
+    try
+    {
+        std::vector<Asset> assets;
+        for (; arg < argc; ++arg)
+        {
+            Asset asset = {};
+            asset.fileName = argv[arg];
+            asset.name = NormalizeName(argv[arg]);
+
+            if (asset.name.empty() || asset.name.size() > c_MaxNameLength)
+            {
+                throw std::runtime_error(std::string("Bad asset name ") + argv[arg]);
+            }
+
+            for (const auto& other : assets)
+            {
+                if (other.name == asset.name)
+                {
+                    throw std::runtime_error(std::string("Duplicate asset ") + argv[arg]);
+                }
+            }
+
+            asset.data = ReadFile(argv[arg]);
+            asset.size = asset.data.size();
+            asset.compression = Compression_None;
+
+            if (compress && !asset.data.empty())
+            {
+                auto compressed = LZ4::Compress(asset.data.data(), asset.data.size());
+                if (double(compressed.size()) <= double(asset.data.size()) * (1.0 - minSavings))
+                {
+                    asset.data = std::move(compressed);
+                    asset.compression = Compression_LZ4;
+                }
+            }
+
+            assets.emplace_back(std::move(asset));
+        }
+
+        if (assets.size() > c_MaxEntries)
+        {
+            throw std::runtime_error("Too many assets");
+        }
+
+        // Lay out the names, then the payloads in command-line order.
+        Header header = {};
+        header.magic = c_Magic;
+        header.version = c_Version;
+        header.entryCount = static_cast<uint32_t>(assets.size());
+        header.namesOffset = c_TableOffset + uint64_t(sizeof(Entry)) * assets.size();
+
+        std::string names;
+        for (auto& asset : assets)
+        {
+            asset.entry.nameHash = HashName(asset.name);
+            asset.entry.nameOffset = static_cast<uint32_t>(names.size());
+            asset.entry.nameLength = static_cast<uint32_t>(asset.name.size());
+            names += asset.name;
+            names += '\0';
+        }
+        header.namesSize = names.size();
+
+        uint64_t offset = AlignUp(header.namesOffset + header.namesSize, c_DataAlignment);
+        header.dataOffset = offset;
+        for (auto& asset : assets)
+        {
+            asset.entry.offset = offset;
+            asset.entry.storedSize = asset.data.size();
+            asset.entry.size = asset.size;
+            asset.entry.compression = asset.compression;
+            offset = AlignUp(offset + asset.data.size(), c_DataAlignment);
+        }
+
+        // The last payload isn't padded.
+        header.fileSize = assets.empty() ? header.dataOffset : assets.back().entry.offset + assets.back().data.size();
+
+        // The table is sorted by hash for lookup.
+        std::vector<Entry> table;
+        table.reserve(assets.size());
+        for (const auto& asset : assets)
+        {
+            table.push_back(asset.entry);
+        }
+        std::stable_sort(table.begin(), table.end(),
+            [](const Entry& a, const Entry& b) { return a.nameHash < b.nameHash; });
+
+        {
+            std::ofstream file(outputName, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                throw std::runtime_error(std::string("Can't create ") + outputName);
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(table.data()), std::streamsize(sizeof(Entry) * table.size()));
+            file.write(names.data(), std::streamsize(names.size()));
+
+            uint64_t position = header.namesOffset + header.namesSize;
+            for (const auto& asset : assets)
+            {
+                WritePadding(file, position, c_DataAlignment);
+                file.write(reinterpret_cast<const char*>(asset.data.data()), std::streamsize(asset.data.size()));
+                position += asset.data.size();
+            }
+
+            if (!file.good())
+            {
+                throw std::runtime_error(std::string("Can't write ") + outputName);
+            }
+        }
+
+        // Read the pack back through the same view the game uses, and compare every asset with its
+        // source file, so a bad pack never ships.
+        const auto written = ReadFile(outputName);
+        const AssetPackView view(written.data(), written.size());
+
+        uint64_t totalSize = 0;
+        for (const auto& asset : assets)
+        {
+            const int index = view.Find(asset.name.c_str());
+            if (index < 0)
+            {
+                std::remove(outputName);
+                throw std::runtime_error("Verification failed: " + asset.name + " not found");
+            }
+
+            std::vector<uint8_t> check(static_cast<size_t>(asset.size));
+            view.Extract(static_cast<uint32_t>(index), check.data(), check.size());
+
+            const auto original = ReadFile(asset.fileName.c_str());
+            if (original.size() != check.size()
+                || (!check.empty() && memcmp(original.data(), check.data(), check.size()) != 0))
+            {
+                std::remove(outputName);
+                throw std::runtime_error("Verification failed: " + asset.name + " doesn't match " + asset.fileName);
+            }
+
+            printf("%10llu -> %10llu %s  %s\n",
+                static_cast<unsigned long long>(asset.size),
+                static_cast<unsigned long long>(asset.data.size()),
+                asset.compression == Compression_LZ4 ? "lz4 " : "none",
+                asset.name.c_str());
+
+            totalSize += asset.size;
+        }
+
+        printf("%10llu -> %10llu bytes in %s, %zu assets\n",
+            static_cast<unsigned long long>(totalSize),
+            static_cast<unsigned long long>(header.fileSize),
+            outputName, assets.size());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,274 @@
+//
+// AssetPackFormat.h - On-disk layout of the single-file asset pack, and a validated view of one
+//
+
+#pragma once
+
+#include "LZ4.h"
+#include "SalFallbacks.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+
+namespace DX
+{
+    // An asset pack is one file holding every asset the sample loads:
+    //
+    //   Header          64 bytes at offset 0
+    //   Entry[]         the table of contents, sorted by name hash, starting at offset 64
+    //   names           the normalized names, each NUL-terminated
+    //   payloads        one per entry, each starting on a c_DataAlignment boundary, in the order the
+    //                   builder was given them so that a startup which loads in that order reads
+    //                   the file front to back
+    //
+    // Everything is little-endian. Payloads are either stored as-is, so a loader can read them in
+    // place from a mapping of the pack, or LZ4 block compressed when that saves enough to be worth
+    // decompressing.
+    namespace AssetPackFormat
+    {
+        constexpr uint32_t c_Magic = 0x4B415041;          // 'APAK'
+        constexpr uint32_t c_Version = 1;
+        constexpr uint64_t c_DataAlignment = 4096;        // Page aligned, so stored payloads can be mapped and read in place
+        constexpr uint32_t c_MaxEntries = 65536;
+        constexpr uint32_t c_MaxNameLength = 260;
+
+        enum COMPRESSION : uint32_t
+        {
+            Compression_None = 0,
+            Compression_LZ4,
+        };
+
+        struct Header
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            uint32_t    entryCount;
+            uint32_t    reserved0;
+            uint64_t    namesOffset;
+            uint64_t    namesSize;
+            uint64_t    dataOffset;         // Start of the first payload
+            uint64_t    fileSize;
+            uint64_t    reserved1[2];
+        };
+
+        struct Entry
+        {
+            uint64_t    nameHash;           // HashName of the normalized name
+            uint64_t    offset;             // Of the payload, from the start of the file
+            uint64_t    storedSize;         // Bytes in the file
+            uint64_t    size;               // Bytes once decompressed
+            uint32_t    nameOffset;         // Into the names block
+            uint32_t    nameLength;         // Excluding the terminator
+            uint32_t    compression;
+            uint32_t    reserved;
+        };
+
+        static_assert(sizeof(Header) == 64, "Asset pack header size mismatch");
+        static_assert(sizeof(Entry) == 48, "Asset pack entry size mismatch");
+
+        constexpr uint64_t c_TableOffset = sizeof(Header);
+
+        inline uint64_t AlignUp(uint64_t value, uint64_t alignment) noexcept
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        // Names are looked up case-insensitively and with either kind of slash, since they are
+        // usually the file names the assets were built from.
+        inline std::string NormalizeName(const char* name)
+        {
+            std::string result;
+            for (; name && *name; ++name)
+            {
+                char c = *name;
+                if (c >= 'A' && c <= 'Z')
+                {
+                    c = static_cast<char>(c - 'A' + 'a');
+                }
+                else if (c == '\\')
+                {
+                    c = '/';
+                }
+                result += c;
+            }
+            return result;
+        }
+
+        // 64-bit FNV-1a of an already normalized name.
+        inline uint64_t HashName(const std::string& normalizedName) noexcept
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for (const char c : normalizedName)
+            {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    }
+
+    // Validates an asset pack image where it lies (typically a mapping of the file) and looks up
+    // entries in it. The image must outlive the view. Header, table and name ranges are checked up
+    // front and a malformed pack throws std::runtime_error from the constructor; compressed payloads
+    // are only checked as they are decompressed.
+    class AssetPackView
+    {
+    public:
+        AssetPackView(_In_reads_bytes_(dataSize) const uint8_t* data, size_t dataSize) noexcept(false) :
+            m_data(data),
+            m_dataSize(dataSize),
+            m_entries(nullptr),
+            m_entryCount(0),
+            m_names(nullptr)
+        {
+            using namespace AssetPackFormat;
+
+            if (!data)
+            {
+                throw std::invalid_argument("AssetPackView");
+            }
+
+            if (dataSize < sizeof(Header))
+            {
+                throw std::runtime_error("Invalid asset pack: too small for the header");
+            }
+
+            const auto& header = *reinterpret_cast<const Header*>(data);
+
+            if (header.magic != c_Magic || header.version != c_Version)
+            {
+                throw std::runtime_error("Invalid asset pack: not a version 1 pack");
+            }
+
+            if (header.fileSize != dataSize)
+            {
+                throw std::runtime_error("Invalid asset pack: truncated");
+            }
+
+            const uint64_t tableEnd = c_TableOffset + uint64_t(header.entryCount) * sizeof(Entry);
+            if (header.entryCount > c_MaxEntries
+                || header.namesOffset < tableEnd
+                || header.namesOffset > dataSize
+                || header.namesSize > dataSize - header.namesOffset
+                || header.dataOffset < header.namesOffset + header.namesSize
+                || header.dataOffset > dataSize)
+            {
+                throw std::runtime_error("Invalid asset pack: bad table of contents");
+            }
+
+            m_entries = reinterpret_cast<const Entry*>(data + c_TableOffset);
+            m_entryCount = header.entryCount;
+            m_names = reinterpret_cast<const char*>(data + header.namesOffset);
+
+            for (uint32_t j = 0; j < m_entryCount; ++j)
+            {
+                const auto& entry = m_entries[j];
+
+                if ((j > 0 && entry.nameHash < m_entries[j - 1].nameHash)
+                    || entry.nameLength > c_MaxNameLength
+                    || uint64_t(entry.nameOffset) + entry.nameLength >= header.namesSize
+                    || m_names[entry.nameOffset + entry.nameLength] != '\0')
+                {
+                    throw std::runtime_error("Invalid asset pack: bad entry name");
+                }
+
+                if (entry.offset < header.dataOffset
+                    || entry.offset > dataSize
+                    || entry.storedSize > dataSize - entry.offset)
+                {
+                    throw std::runtime_error("Invalid asset pack: entry out of range");
+                }
+
+                if (entry.compression == Compression_None ? entry.storedSize != entry.size
+                    : entry.compression != Compression_LZ4)
+                {
+                    throw std::runtime_error("Invalid asset pack: bad compression");
+                }
+            }
+        }
+
+        AssetPackView(AssetPackView&&) = default;
+        AssetPackView& operator= (AssetPackView&&) = default;
+
+        AssetPackView(AssetPackView const&) = default;
+        AssetPackView& operator= (AssetPackView const&) = default;
+
+        uint32_t GetEntryCount() const noexcept { return m_entryCount; }
+
+        const AssetPackFormat::Entry& GetEntry(uint32_t index) const
+        {
+            if (index >= m_entryCount)
+            {
+                throw std::out_of_range("AssetPackView::GetEntry");
+            }
+            return m_entries[index];
+        }
+
+        const char* GetName(uint32_t index) const
+        {
+            return m_names + GetEntry(index).nameOffset;
+        }
+
+        // Returns the index of the named entry, or -1 if the pack doesn't have it.
+        int Find(_In_z_ const char* name) const
+        {
+            const std::string normalized = AssetPackFormat::NormalizeName(name);
+            const uint64_t hash = AssetPackFormat::HashName(normalized);
+
+            auto it = std::lower_bound(m_entries, m_entries + m_entryCount, hash,
+                [](const AssetPackFormat::Entry& entry, uint64_t value) { return entry.nameHash < value; });
+
+            for (; it != m_entries + m_entryCount && it->nameHash == hash; ++it)
+            {
+                if (normalized.compare(0, std::string::npos, m_names + it->nameOffset, it->nameLength) == 0)
+                    return static_cast<int>(it - m_entries);
+            }
+
+            return -1;
+        }
+
+        bool IsCompressed(uint32_t index) const
+        {
+            return GetEntry(index).compression != AssetPackFormat::Compression_None;
+        }
+
+        // The payload as stored, which is the asset itself unless it is compressed.
+        const uint8_t* GetStoredData(uint32_t index) const
+        {
+            return m_data + GetEntry(index).offset;
+        }
+
+        // Writes the asset into dest, which must hold exactly the entry's size.
+        void Extract(uint32_t index, _Out_writes_bytes_(destSize) uint8_t* dest, size_t destSize) const
+        {
+            const auto& entry = GetEntry(index);
+            if (destSize != entry.size)
+            {
+                throw std::invalid_argument("AssetPackView::Extract");
+            }
+
+            if (entry.compression == AssetPackFormat::Compression_LZ4)
+            {
+                LZ4::Decompress(m_data + entry.offset, static_cast<size_t>(entry.storedSize), dest, destSize);
+            }
+            else if (destSize)
+            {
+                memcpy(dest, m_data + entry.offset, destSize);
+            }
+        }
+
+        const uint8_t* GetData() const noexcept { return m_data; }
+        size_t GetDataSize() const noexcept { return m_dataSize; }
+
+    private:
+        const uint8_t*                  m_data;
+        size_t                          m_dataSize;
+        const AssetPackFormat::Entry*   m_entries;
+        uint32_t                        m_entryCount;
+        const char*                     m_names;
+    };
+}
@@ -0,0 +1,430 @@
+//
+// AssetStreamer.h - Loads assets in the background through prioritized read and decode stages
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+namespace DX
+{
+    enum ASSET_STATUS : uint32_t
+    {
+        AssetStatus_Queued = 0,
+        AssetStatus_Reading,
+        AssetStatus_Decoding,
+        AssetStatus_Ready,
+        AssetStatus_Failed,
+    };
+
+    // The result of an AssetStreamer request. The render loop polls it each frame and carries on
+    // with a placeholder until it is ready; it never blocks.
+    template<typename T>
+    class AssetHandle
+    {
+    public:
+        AssetHandle() = default;
+
+        AssetHandle(AssetHandle&&) = default;
+        AssetHandle& operator= (AssetHandle&&) = default;
+
+        AssetHandle(AssetHandle const&) = default;
+        AssetHandle& operator= (AssetHandle const&) = default;
+
+        bool IsValid() const noexcept { return m_state != nullptr; }
+
+        ASSET_STATUS GetStatus() const noexcept
+        {
+            return m_state ? m_state->status.load(std::memory_order_acquire) : AssetStatus_Failed;
+        }
+
+        bool IsReady() const noexcept { return GetStatus() == AssetStatus_Ready; }
+        bool IsFailed() const noexcept { return GetStatus() == AssetStatus_Failed; }
+        bool IsPending() const noexcept { return GetStatus() < AssetStatus_Ready; }
+
+        // Returns the decoded asset once ready, or rethrows the error the request failed with.
+        T& Get()
+        {
+            switch (GetStatus())
+            {
+            case AssetStatus_Ready:
+                return m_state->value;
+
+            case AssetStatus_Failed:
+                if (m_state && m_state->error)
+                {
+                    std::rethrow_exception(m_state->error);
+                }
+                throw std::logic_error("AssetHandle has no request");
+
+            default:
+                throw std::logic_error("AssetHandle::Get called before the asset was ready");
+            }
+        }
+
+        void Reset() noexcept { m_state.reset(); }
+
+    private:
+        friend class AssetStreamer;
+
+        struct State
+        {
+            std::atomic<ASSET_STATUS>   status;
+            T                           value;
+            std::exception_ptr          error;
+
+            State() : status(AssetStatus_Queued), value{} {}
+        };
+
+        std::shared_ptr<State> m_state;
+    };
+
+    // Streams assets in two stages. Reads (file or pack I/O, which mostly wait) run on dedicated I/O
+    // threads, so they never tie up a CPU worker; decodes (parsing, decompression, recording GPU
+    // uploads) run on the shared ThreadPool. Each stage takes the highest priority request waiting
+    // for it, first come first served within a priority, and at most maxDecodes decodes run at once
+    // so streaming can't crowd out frame work on the pool.
+    //
+    // Request takes a read function returning the raw asset and a decode function taking it and
+    // returning the result; an exception from either fails the request, and Get rethrows it.
+    class AssetStreamer
+    {
+    public:
+        struct Statistics
+        {
+            uint32_t    requests;
+            uint32_t    completed;
+            uint32_t    failed;
+            double      totalLatencyMs;     // From request to ready, summed over completed requests
+            double      longestLatencyMs;
+        };
+
+        // A maxDecodes of zero allows one per pool thread.
+        AssetStreamer(ThreadPool& decodePool, unsigned int ioThreadCount = 2, unsigned int maxDecodes = 0) noexcept(false) :
+            m_pool(&decodePool),
+            m_maxDecodes(maxDecodes ? maxDecodes : static_cast<unsigned int>(std::max<size_t>(decodePool.GetThreadCount(), 1))),
+            m_nextSequence(0),
+            m_reading(0),
+            m_decoders(0),
+            m_stop(false),
+            m_stats{}
+        {
+            if (!ioThreadCount)
+            {
+                throw std::invalid_argument("AssetStreamer needs at least one I/O thread");
+            }
+
+            m_ioThreads.reserve(ioThreadCount);
+            for (unsigned int j = 0; j < ioThreadCount; ++j)
+            {
+                m_ioThreads.emplace_back([this]() { ReadLoop(); });
+            }
+        }
+
+        AssetStreamer(AssetStreamer&&) = delete;
+        AssetStreamer& operator= (AssetStreamer&&) = delete;
+
+        AssetStreamer(AssetStreamer const&) = delete;
+        AssetStreamer& operator= (AssetStreamer const&) = delete;
+
+        // Requests not yet started are failed; those already reading or decoding finish first.
+        ~AssetStreamer()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+
+                const auto cancelled = std::make_exception_ptr(std::runtime_error("AssetStreamer shut down"));
+                for (auto& job : m_readQueue)
+                {
+                    job->Fail(cancelled);
+                }
+                for (auto& job : m_decodeQueue)
+                {
+                    job->Fail(cancelled);
+                }
+                m_readQueue.clear();
+                m_decodeQueue.clear();
+            }
+            m_condition.notify_all();
+
+            for (auto& thread : m_ioThreads)
+            {
+                thread.join();
+            }
+
+            // Decoders on the pool refer to this object.
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]() { return !m_decoders; });
+        }
+
+        template<typename Read, typename Decode>
+        auto Request(int priority, Read&& read, Decode&& decode)
+            -> AssetHandle<decltype(decode(read()))>
+        {
+            using Raw = decltype(read());
+            using Result = decltype(decode(read()));
+
+            auto job = std::make_unique<TypedJob<typename std::decay<Read>::type, typename std::decay<Decode>::type, Raw, Result>>(
+                std::forward<Read>(read), std::forward<Decode>(decode));
+
+            AssetHandle<Result> handle;
+            handle.m_state = job->state;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stop)
+                {
+                    throw std::logic_error("AssetStreamer is shutting down");
+                }
+
+                job->priority = priority;
+                job->sequence = m_nextSequence++;
+                job->requested = Clock::now();
+                Push(m_readQueue, std::move(job));
+                ++m_stats.requests;
+            }
+            m_condition.notify_one();
+
+            return handle;
+        }
+
+        // Blocks until every request made so far has completed or failed.
+        void WaitIdle()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]()
+                {
+                    return m_readQueue.empty() && m_decodeQueue.empty() && !m_reading && !m_decoders;
+                });
+        }
+
+        // Requests which have neither completed nor failed.
+        uint32_t GetPendingCount() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_stats.requests - m_stats.completed - m_stats.failed;
+        }
+
+        Statistics GetStatistics() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_stats;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Job
+        {
+            int                 priority = 0;
+            uint64_t            sequence = 0;
+            Clock::time_point   requested;
+
+            virtual ~Job() = default;
+            virtual void Read() = 0;
+            virtual void Decode() = 0;
+            virtual void SetStatus(ASSET_STATUS status) noexcept = 0;
+            virtual void Fail(std::exception_ptr error) noexcept = 0;
+        };
+
+        template<typename ReadFunction, typename DecodeFunction, typename Raw, typename Result>
+        struct TypedJob : public Job
+        {
+            using State = typename AssetHandle<Result>::State;
+
+            ReadFunction            read;
+            DecodeFunction          decode;
+            std::unique_ptr<Raw>    raw;
+            std::shared_ptr<State>  state;
+
+            template<typename R, typename D>
+            TypedJob(R&& r, D&& d) :
+                read(std::forward<R>(r)),
+                decode(std::forward<D>(d)),
+                state(std::make_shared<State>())
+            {
+            }
+
+            void Read() override
+            {
+                raw = std::make_unique<Raw>(read());
+            }
+
+            void Decode() override
+            {
+                state->value = decode(std::move(*raw));
+                raw.reset();
+                state->status.store(AssetStatus_Ready, std::memory_order_release);
+            }
+
+            void SetStatus(ASSET_STATUS status) noexcept override
+            {
+                state->status.store(status, std::memory_order_release);
+            }
+
+            void Fail(std::exception_ptr error) noexcept override
+            {
+                raw.reset();
+                state->error = error;
+                state->status.store(AssetStatus_Failed, std::memory_order_release);
+            }
+        };
+
+        using Queue = std::vector<std::unique_ptr<Job>>;
+
+        // Heap order: highest priority first, then oldest first.
+        static bool IsLowerPriority(const std::unique_ptr<Job>& a, const std::unique_ptr<Job>& b) noexcept
+        {
+            if (a->priority != b->priority)
+                return a->priority < b->priority;
+            return a->sequence > b->sequence;
+        }
+
+        static void Push(Queue& queue, std::unique_ptr<Job>&& job)
+        {
+            queue.emplace_back(std::move(job));
+            std::push_heap(queue.begin(), queue.end(), IsLowerPriority);
+        }
+
+        static std::unique_ptr<Job> Pop(Queue& queue)
+        {
+            std::pop_heap(queue.begin(), queue.end(), IsLowerPriority);
+            auto job = std::move(queue.back());
+            queue.pop_back();
+            return job;
+        }
+
+        void ReadLoop()
+        {
+            for (;;)
+            {
+                std::unique_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_condition.wait(lock, [this]() { return m_stop || !m_readQueue.empty(); });
+
+                    if (m_stop)
+                        return;
+
+                    job = Pop(m_readQueue);
+                    ++m_reading;
+                }
+
+                job->SetStatus(AssetStatus_Reading);
+
+                std::exception_ptr error;
+                try
+                {
+                    job->Read();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                bool startDecoder = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    --m_reading;
+
+                    if (!error && m_stop)
+                    {
+                        error = std::make_exception_ptr(std::runtime_error("AssetStreamer shut down"));
+                    }
+
+                    if (error)
+                    {
+                        job->Fail(error);
+                        ++m_stats.failed;
+                    }
+                    else
+                    {
+                        Push(m_decodeQueue, std::move(job));
+                        if (m_decoders < m_maxDecodes)
+                        {
+                            ++m_decoders;
+                            startDecoder = true;
+                        }
+                    }
+
+                    m_idle.notify_all();
+                }
+
+                if (startDecoder)
+                {
+                    std::ignore = m_pool->Submit([this]() { DecodeLoop(); });
+                }
+            }
+        }
+
+        // Runs on the pool, decoding whatever has the highest priority until nothing is waiting.
+        void DecodeLoop()
+        {
+            for (;;)
+            {
+                std::unique_ptr<Job> job;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_decodeQueue.empty())
+                    {
+                        --m_decoders;
+
+                        // Notify while holding the lock, so a waiting destructor can't return first.
+                        m_idle.notify_all();
+                        return;
+                    }
+
+                    job = Pop(m_decodeQueue);
+                }
+
+                job->SetStatus(AssetStatus_Decoding);
+
+                std::exception_ptr error;
+                try
+                {
+                    job->Decode();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                    job->Fail(error);
+                }
+
+                const double ms = std::chrono::duration<double, std::milli>(Clock::now() - job->requested).count();
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (error)
+                {
+                    ++m_stats.failed;
+                }
+                else
+                {
+                    ++m_stats.completed;
+                    m_stats.totalLatencyMs += ms;
+                    m_stats.longestLatencyMs = std::max(m_stats.longestLatencyMs, ms);
+                }
+            }
+        }
+
+        ThreadPool*                 m_pool;
+        const unsigned int          m_maxDecodes;
+        std::vector<std::thread>    m_ioThreads;
+
+        mutable std::mutex          m_mutex;
+        std::condition_variable     m_condition;    // Wakes I/O threads
+        std::condition_variable     m_idle;         // Signals progress to WaitIdle and the destructor
+        Queue                       m_readQueue;
+        Queue                       m_decodeQueue;
+        uint64_t                    m_nextSequence;
+        unsigned int                m_reading;
+        unsigned int                m_decoders;
+        bool                        m_stop;
+        Statistics                  m_stats;
+    };
+}
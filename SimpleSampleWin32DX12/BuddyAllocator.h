@@ -0,0 +1,216 @@
+//
+// BuddyAllocator.h - A CPU-only buddy allocator for sub-allocating offsets within a memory range
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+
+namespace DX
+{
+    // Manages offsets within a single power-of-two sized range. Blocks are always naturally
+    // aligned to their own size, so any alignment up to the block size is honored for free.
+    // This class does not touch GPU memory and can be used (and tested) on its own.
+    class BuddyAllocator
+    {
+    public:
+        static constexpr uint64_t c_InvalidOffset = UINT64_MAX;
+
+        struct Statistics
+        {
+            uint64_t totalSize;
+            uint64_t usedBytes;
+            uint64_t requestedBytes;
+            uint64_t largestFreeBlock;
+            uint32_t allocationCount;
+            uint32_t freeBlockCount;
+
+            uint64_t FreeBytes() const noexcept { return totalSize - usedBytes; }
+
+            // 0 means all free space is in one contiguous block; approaching 1 means free space is badly scattered.
+            float Fragmentation() const noexcept
+            {
+                const uint64_t freeBytes = FreeBytes();
+                return (freeBytes > 0) ? 1.f - float(double(largestFreeBlock) / double(freeBytes)) : 0.f;
+            }
+
+            // Ratio of space lost to power-of-two rounding versus what callers asked for.
+            float InternalWaste() const noexcept
+            {
+                return (usedBytes > 0) ? 1.f - float(double(requestedBytes) / double(usedBytes)) : 0.f;
+            }
+        };
+
+        BuddyAllocator(uint64_t size, uint64_t minBlockSize) noexcept(false) :
+            m_totalSize(size),
+            m_minBlockSize(minBlockSize),
+            m_maxOrder(0),
+            m_usedBytes(0),
+            m_requestedBytes(0)
+        {
+            if (!IsPow2(size) || !IsPow2(minBlockSize) || minBlockSize > size)
+            {
+                throw std::invalid_argument("BuddyAllocator requires power-of-two sizes");
+            }
+
+            while ((m_minBlockSize << m_maxOrder) < m_totalSize)
+            {
+                ++m_maxOrder;
+            }
+
+            m_freeLists.resize(m_maxOrder + 1);
+            m_freeLists[m_maxOrder].insert(0);
+        }
+
+        BuddyAllocator(BuddyAllocator&&) = default;
+        BuddyAllocator& operator= (BuddyAllocator&&) = default;
+
+        BuddyAllocator(BuddyAllocator const&) = delete;
+        BuddyAllocator& operator= (BuddyAllocator const&) = delete;
+
+        // Returns c_InvalidOffset if the request cannot be satisfied.
+        uint64_t Allocate(uint64_t size, uint64_t alignment = 0)
+        {
+            if (!size || size > m_totalSize || alignment > m_totalSize)
+                return c_InvalidOffset;
+
+            const uint32_t order = OrderForSize(std::max(size, alignment));
+
+            // Find the smallest free block which is large enough.
+            uint32_t current = order;
+            while (current <= m_maxOrder && m_freeLists[current].empty())
+            {
+                ++current;
+            }
+
+            if (current > m_maxOrder)
+                return c_InvalidOffset;
+
+            // Prefer the lowest offset so allocations pack towards the start of the range.
+            auto it = m_freeLists[current].begin();
+            const uint64_t offset = *it;
+            m_freeLists[current].erase(it);
+
+            // Split down to the requested order, returning the upper halves to the free lists.
+            while (current > order)
+            {
+                --current;
+                m_freeLists[current].insert(offset + BlockSize(current));
+            }
+
+            m_allocations[offset] = Allocation{ order, size };
+            m_usedBytes += BlockSize(order);
+            m_requestedBytes += size;
+
+            return offset;
+        }
+
+        void Free(uint64_t offset)
+        {
+            auto it = m_allocations.find(offset);
+            if (it == m_allocations.end())
+            {
+                throw std::invalid_argument("BuddyAllocator::Free called with unknown offset");
+            }
+
+            uint32_t order = it->second.order;
+            m_usedBytes -= BlockSize(order);
+            m_requestedBytes -= it->second.requestedSize;
+            m_allocations.erase(it);
+
+            // Coalesce with free buddies as far up as possible.
+            while (order < m_maxOrder)
+            {
+                const uint64_t buddy = offset ^ BlockSize(order);
+                auto& freeList = m_freeLists[order];
+                auto buddyIt = freeList.find(buddy);
+                if (buddyIt == freeList.end())
+                    break;
+
+                freeList.erase(buddyIt);
+                offset = std::min(offset, buddy);
+                ++order;
+            }
+
+            m_freeLists[order].insert(offset);
+        }
+
+        // Size actually reserved for an allocation (after power-of-two rounding).
+        uint64_t GetAllocationSize(uint64_t offset) const
+        {
+            auto it = m_allocations.find(offset);
+            return (it != m_allocations.end()) ? BlockSize(it->second.order) : 0;
+        }
+
+        bool IsEmpty() const noexcept { return m_allocations.empty(); }
+        uint64_t GetSize() const noexcept { return m_totalSize; }
+        uint64_t GetMinBlockSize() const noexcept { return m_minBlockSize; }
+
+        Statistics GetStatistics() const noexcept
+        {
+            Statistics stats = {};
+            stats.totalSize = m_totalSize;
+            stats.usedBytes = m_usedBytes;
+            stats.requestedBytes = m_requestedBytes;
+            stats.allocationCount = static_cast<uint32_t>(m_allocations.size());
+
+            for (uint32_t order = 0; order <= m_maxOrder; ++order)
+            {
+                const size_t count = m_freeLists[order].size();
+                stats.freeBlockCount += static_cast<uint32_t>(count);
+                if (count > 0)
+                {
+                    stats.largestFreeBlock = BlockSize(order);
+                }
+            }
+
+            return stats;
+        }
+
+        static constexpr bool IsPow2(uint64_t value) noexcept { return value && !(value & (value - 1)); }
+
+        static uint64_t NextPow2(uint64_t value) noexcept
+        {
+            uint64_t result = 1;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+    private:
+        struct Allocation
+        {
+            uint32_t order;
+            uint64_t requestedSize;
+        };
+
+        uint64_t BlockSize(uint32_t order) const noexcept { return m_minBlockSize << order; }
+
+        uint32_t OrderForSize(uint64_t size) const noexcept
+        {
+            uint32_t order = 0;
+            while (BlockSize(order) < size)
+            {
+                ++order;
+            }
+            return order;
+        }
+
+        uint64_t                                    m_totalSize;
+        uint64_t                                    m_minBlockSize;
+        uint32_t                                    m_maxOrder;
+        uint64_t                                    m_usedBytes;
+        uint64_t                                    m_requestedBytes;
+
+        std::vector<std::set<uint64_t>>             m_freeLists;
+        std::unordered_map<uint64_t, Allocation>    m_allocations;
+    };
+}
@@ -0,0 +1,148 @@
+//
+// CommandAllocatorPool.cpp - Fence-recycled command allocators grouped by command list type
+//
+
+#include "pch.h"
+#include "CommandAllocatorPool.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    const wchar_t* GetTypeName(D3D12_COMMAND_LIST_TYPE type) noexcept
+    {
+        switch (type)
+        {
+        case D3D12_COMMAND_LIST_TYPE_COMPUTE:   return L"Compute";
+        case D3D12_COMMAND_LIST_TYPE_COPY:      return L"Copy";
+        default:                                return L"Direct";
+        }
+    }
+}
+
+CommandAllocatorPool::CommandAllocatorPool(ID3D12Device* device) noexcept(false) :
+    m_device(device),
+    m_pools{}
+{
+    if (!device)
+    {
+        throw std::invalid_argument("CommandAllocatorPool requires a device");
+    }
+}
+
+ID3D12CommandAllocator* CommandAllocatorPool::Acquire(D3D12_COMMAND_LIST_TYPE type, uint64_t completedFenceValue)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& pool = GetPool(type);
+
+    while (!pool.pending.empty() && pool.pending.front().fenceValue <= completedFenceValue)
+    {
+        pool.available.push_back(pool.pending.front().allocator);
+        pool.pending.pop_front();
+    }
+
+    ID3D12CommandAllocator* allocator = nullptr;
+    if (!pool.available.empty())
+    {
+        allocator = pool.available.back();
+        pool.available.pop_back();
+
+        ThrowIfFailed(allocator->Reset());
+    }
+    else
+    {
+        allocator = Create(type, pool);
+    }
+
+    ++pool.inUse;
+    pool.highWater = std::max(pool.highWater, pool.inUse + static_cast<uint32_t>(pool.pending.size()));
+
+    return allocator;
+}
+
+void CommandAllocatorPool::Release(D3D12_COMMAND_LIST_TYPE type, ID3D12CommandAllocator* allocator, uint64_t fenceValue)
+{
+    if (!allocator)
+    {
+        throw std::invalid_argument("CommandAllocatorPool::Release");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& pool = GetPool(type);
+    if (!pool.inUse)
+    {
+        throw std::logic_error("CommandAllocatorPool::Release called without a matching Acquire");
+    }
+
+    --pool.inUse;
+
+    // Each type is normally tied to one queue, whose fence values only increase.
+    assert(pool.pending.empty() || pool.pending.back().fenceValue <= fenceValue);
+    pool.pending.push_back(Pending{ fenceValue, allocator });
+}
+
+void CommandAllocatorPool::Reserve(D3D12_COMMAND_LIST_TYPE type, uint32_t count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& pool = GetPool(type);
+    while (pool.allocators.size() < count)
+    {
+        pool.available.push_back(Create(type, pool));
+    }
+}
+
+CommandAllocatorPool::Statistics CommandAllocatorPool::GetStatistics(D3D12_COMMAND_LIST_TYPE type) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto& pool = GetPool(type);
+
+    Statistics stats = {};
+    stats.allocatorCount = static_cast<uint32_t>(pool.allocators.size());
+    stats.inUse = pool.inUse;
+    stats.pending = static_cast<uint32_t>(pool.pending.size());
+    stats.highWater = pool.highWater;
+    return stats;
+}
+
+CommandAllocatorPool::Pool& CommandAllocatorPool::GetPool(D3D12_COMMAND_LIST_TYPE type)
+{
+    return const_cast<Pool&>(static_cast<const CommandAllocatorPool*>(this)->GetPool(type));
+}
+
+const CommandAllocatorPool::Pool& CommandAllocatorPool::GetPool(D3D12_COMMAND_LIST_TYPE type) const
+{
+    switch (type)
+    {
+    case D3D12_COMMAND_LIST_TYPE_DIRECT:    return m_pools[0];
+    case D3D12_COMMAND_LIST_TYPE_COMPUTE:   return m_pools[1];
+    case D3D12_COMMAND_LIST_TYPE_COPY:      return m_pools[2];
+    default:
+        throw std::invalid_argument("Unsupported command list type");
+    }
+}
+
+ID3D12CommandAllocator* CommandAllocatorPool::Create(D3D12_COMMAND_LIST_TYPE type, Pool& pool)
+{
+    ComPtr<ID3D12CommandAllocator> allocator;
+    ThrowIfFailed(m_device->CreateCommandAllocator(type, IID_PPV_ARGS(allocator.GetAddressOf())));
+
+    wchar_t name[48] = {};
+    swprintf_s(name, L"CommandAllocatorPool %ls %zu", GetTypeName(type), pool.allocators.size());
+    allocator->SetName(name);
+
+    pool.allocators.emplace_back(allocator);
+
+#ifdef _DEBUG
+    char buff[96] = {};
+    sprintf_s(buff, "INFO: CommandAllocatorPool grew to %zu %ls allocators\n", pool.allocators.size(), GetTypeName(type));
+    OutputDebugStringA(buff);
+#endif
+
+    return allocator.Get();
+}
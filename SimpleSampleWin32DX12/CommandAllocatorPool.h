@@ -0,0 +1,77 @@
+//
+// CommandAllocatorPool.h - Fence-recycled command allocators grouped by command list type
+//
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+
+namespace DX
+{
+    // Hands out command allocators by list type. A released allocator is tagged with the fence value
+    // which marks the end of the GPU work recorded through it, and is only reset and handed out
+    // again once that value has completed.
+    //
+    // Allocator memory can't be queried, so the number of live allocators per type is tracked
+    // instead: every count in Statistics, high-water mark included, is a number of allocators.
+    // The high-water mark is the figure to size Reserve calls from.
+    class CommandAllocatorPool
+    {
+    public:
+        struct Statistics
+        {
+            uint32_t    allocatorCount;     // Allocators created for this type
+            uint32_t    inUse;              // Acquired and not yet released
+            uint32_t    pending;            // Released, waiting on the GPU
+            uint32_t    highWater;          // Peak of inUse + pending, in allocators rather than bytes
+        };
+
+        explicit CommandAllocatorPool(ID3D12Device* device) noexcept(false);
+
+        CommandAllocatorPool(CommandAllocatorPool&&) = delete;
+        CommandAllocatorPool& operator= (CommandAllocatorPool&&) = delete;
+
+        CommandAllocatorPool(CommandAllocatorPool const&) = delete;
+        CommandAllocatorPool& operator= (CommandAllocatorPool const&) = delete;
+
+        // Returns a reset allocator, reusing one whose fence value is at or below completedFenceValue.
+        ID3D12CommandAllocator* Acquire(D3D12_COMMAND_LIST_TYPE type, uint64_t completedFenceValue);
+
+        // Returns an allocator to the pool once the queue has signaled fenceValue.
+        void Release(D3D12_COMMAND_LIST_TYPE type, ID3D12CommandAllocator* allocator, uint64_t fenceValue);
+
+        // Creates allocators up front so steady-state frames never create them.
+        void Reserve(D3D12_COMMAND_LIST_TYPE type, uint32_t count);
+
+        Statistics GetStatistics(D3D12_COMMAND_LIST_TYPE type) const;
+
+    private:
+        struct Pending
+        {
+            uint64_t                                        fenceValue;
+            ID3D12CommandAllocator*                         allocator;
+        };
+
+        struct Pool
+        {
+            std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> allocators;
+            std::vector<ID3D12CommandAllocator*>            available;
+            std::deque<Pending>                             pending;
+            uint32_t                                        inUse;
+            uint32_t                                        highWater;
+        };
+
+        Pool& GetPool(D3D12_COMMAND_LIST_TYPE type);
+        const Pool& GetPool(D3D12_COMMAND_LIST_TYPE type) const;
+        ID3D12CommandAllocator* Create(D3D12_COMMAND_LIST_TYPE type, Pool& pool);
+
+        static constexpr size_t c_PoolCount = 3;
+
+        Microsoft::WRL::ComPtr<ID3D12Device>                m_device;
+        Pool                                                m_pools[c_PoolCount];
+        mutable std::mutex                                  m_mutex;
+    };
+}
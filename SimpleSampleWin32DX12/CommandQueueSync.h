@@ -0,0 +1,183 @@
+//
+// CommandQueueSync.h - Fence value and cross-queue dependency bookkeeping
+//
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+
+namespace DX
+{
+    enum COMMAND_QUEUE_TYPE : uint32_t
+    {
+        CommandQueue_Graphics = 0,
+        CommandQueue_Compute,
+        CommandQueue_Copy,
+        CommandQueue_Count
+    };
+
+    // The device operations CommandQueueSync relies on. Each queue signals its own fence.
+    class ICommandQueueBackend
+    {
+    public:
+        virtual ~ICommandQueueBackend() = default;
+
+        virtual void Signal(uint32_t queue, uint64_t value) = 0;
+        virtual void Wait(uint32_t queue, uint32_t sourceQueue, uint64_t value) = 0;
+        virtual uint64_t GetCompletedValue(uint32_t queue) const = 0;
+
+    protected:
+        ICommandQueueBackend() = default;
+        ICommandQueueBackend(ICommandQueueBackend const&) = default;
+        ICommandQueueBackend& operator= (ICommandQueueBackend const&) = default;
+    };
+
+    // Issues monotonically increasing fence values per queue and tracks GPU-side waits between
+    // queues. Redundant waits (already waited for, or already complete) are dropped, and waits on
+    // values which have not been signaled yet are rejected, since they could never be satisfied
+    // by work already submitted and are the usual cause of cross-queue deadlocks.
+    //
+    // Knows nothing about Direct3D, so it can be driven by a mock backend.
+    class CommandQueueSync
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t    signals;
+            uint64_t    waits;
+            uint64_t    skippedWaits;
+        };
+
+        CommandQueueSync(ICommandQueueBackend* backend, uint32_t queueCount) noexcept(false) :
+            m_backend(backend),
+            m_lastSignaled(queueCount, 0),
+            m_lastCompleted(queueCount, 0),
+            m_waited(size_t(queueCount) * queueCount, 0),
+            m_queueCount(queueCount),
+            m_stats{}
+        {
+            if (!backend || !queueCount)
+            {
+                throw std::invalid_argument("CommandQueueSync requires a backend and at least one queue");
+            }
+        }
+
+        CommandQueueSync(CommandQueueSync&&) = default;
+        CommandQueueSync& operator= (CommandQueueSync&&) = default;
+
+        CommandQueueSync(CommandQueueSync const&) = delete;
+        CommandQueueSync& operator= (CommandQueueSync const&) = delete;
+
+        // Signals the next value on a queue and returns it.
+        uint64_t Signal(uint32_t queue)
+        {
+            CheckQueue(queue);
+
+            const uint64_t value = m_lastSignaled[queue] + 1;
+            m_backend->Signal(queue, value);
+            m_lastSignaled[queue] = value;
+            ++m_stats.signals;
+            return value;
+        }
+
+        // Records a signal issued outside of this class, such as a per-frame present fence.
+        void RecordSignal(uint32_t queue, uint64_t value)
+        {
+            CheckQueue(queue);
+
+            if (value <= m_lastSignaled[queue])
+            {
+                throw std::invalid_argument("Fence values must increase monotonically");
+            }
+
+            m_lastSignaled[queue] = value;
+            ++m_stats.signals;
+        }
+
+        // Makes queue wait on the GPU until sourceQueue has reached value.
+        void Wait(uint32_t queue, uint32_t sourceQueue, uint64_t value)
+        {
+            CheckQueue(queue);
+            CheckQueue(sourceQueue);
+
+            if (queue == sourceQueue)
+            {
+                throw std::invalid_argument("A queue can't wait on itself");
+            }
+
+            if (value > m_lastSignaled[sourceQueue])
+            {
+                throw std::logic_error("Waiting on a fence value which has not been signaled");
+            }
+
+            uint64_t& waited = m_waited[size_t(queue) * m_queueCount + sourceQueue];
+            if (value <= waited || IsComplete(sourceQueue, value))
+            {
+                ++m_stats.skippedWaits;
+                return;
+            }
+
+            m_backend->Wait(queue, sourceQueue, value);
+            waited = value;
+            ++m_stats.waits;
+        }
+
+        // Makes queue wait for everything submitted to sourceQueue so far.
+        void WaitForLatest(uint32_t queue, uint32_t sourceQueue)
+        {
+            CheckQueue(sourceQueue);
+            Wait(queue, sourceQueue, m_lastSignaled[sourceQueue]);
+        }
+
+        // Non-blocking completion query. Only asks the backend when the cached value is too old.
+        bool IsComplete(uint32_t queue, uint64_t value)
+        {
+            CheckQueue(queue);
+
+            if (value <= m_lastCompleted[queue])
+                return true;
+
+            return GetCompletedValue(queue) >= value;
+        }
+
+        uint64_t GetCompletedValue(uint32_t queue)
+        {
+            CheckQueue(queue);
+
+            const uint64_t completed = m_backend->GetCompletedValue(queue);
+            if (completed > m_lastCompleted[queue])
+            {
+                m_lastCompleted[queue] = completed;
+            }
+            return m_lastCompleted[queue];
+        }
+
+        uint64_t GetLastSignaledValue(uint32_t queue) const
+        {
+            CheckQueue(queue);
+            return m_lastSignaled[queue];
+        }
+
+        uint32_t GetQueueCount() const noexcept { return m_queueCount; }
+        const Statistics& GetStatistics() const noexcept { return m_stats; }
+
+    private:
+        void CheckQueue(uint32_t queue) const
+        {
+            if (queue >= m_queueCount)
+            {
+                throw std::out_of_range("Invalid queue index");
+            }
+        }
+
+        ICommandQueueBackend*   m_backend;
+        std::vector<uint64_t>   m_lastSignaled;
+        std::vector<uint64_t>   m_lastCompleted;
+        std::vector<uint64_t>   m_waited;           // [queue * count + source]
+        uint32_t                m_queueCount;
+        Statistics              m_stats;
+    };
+}
@@ -0,0 +1,212 @@
+//
+// DescriptorAllocator.cpp - Shader-visible descriptor allocation with persistent and per-frame regions
+//
+
+#include "pch.h"
+#include "DescriptorAllocator.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+DescriptorAllocator::DescriptorAllocator(
+    ID3D12Device* device,
+    uint32_t persistentCount,
+    uint32_t transientCount) noexcept(false) :
+    m_device(device),
+    m_cpuStart{},
+    m_gpuStart{},
+    m_stagingStart{},
+    m_descriptorSize(0),
+    m_persistentCount(persistentCount),
+    m_persistentInUse(0),
+    m_ring(transientCount)
+{
+    if (!device)
+    {
+        throw std::invalid_argument("DescriptorAllocator requires a device");
+    }
+
+    if (!persistentCount || !transientCount)
+    {
+        throw std::invalid_argument("DescriptorAllocator requires non-empty regions");
+    }
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    desc.NumDescriptors = persistentCount + transientCount;
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+
+    ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(m_heap.ReleaseAndGetAddressOf())));
+
+    m_heap->SetName(L"DescriptorAllocator");
+
+    desc.NumDescriptors = persistentCount;
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+
+    ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(m_stagingHeap.ReleaseAndGetAddressOf())));
+
+    m_stagingHeap->SetName(L"DescriptorAllocator Staging");
+
+    m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+    m_gpuStart = m_heap->GetGPUDescriptorHandleForHeapStart();
+    m_stagingStart = m_stagingHeap->GetCPUDescriptorHandleForHeapStart();
+    m_descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    // Hand out the lowest indices first.
+    m_freeList.reserve(persistentCount);
+    for (uint32_t j = persistentCount; j > 0; --j)
+    {
+        m_freeList.push_back(j - 1);
+    }
+}
+
+uint32_t DescriptorAllocator::AllocatePersistent()
+{
+    if (m_freeList.empty())
+    {
+        throw std::runtime_error("DescriptorAllocator persistent region exhausted");
+    }
+
+    const uint32_t index = m_freeList.back();
+    m_freeList.pop_back();
+    ++m_persistentInUse;
+
+    m_dirty.push_back(index);
+    return index;
+}
+
+void DescriptorAllocator::FreePersistent(uint32_t index)
+{
+    if (index >= m_persistentCount)
+    {
+        throw std::out_of_range("DescriptorAllocator::FreePersistent");
+    }
+
+    // The slot may still be referenced by frames in flight, so it is held until EndFrame tags it with a fence.
+    m_frameFrees.push_back(index);
+}
+
+void DescriptorAllocator::MarkDirty(uint32_t index)
+{
+    if (index >= m_persistentCount)
+    {
+        throw std::out_of_range("DescriptorAllocator::MarkDirty");
+    }
+
+    m_dirty.push_back(index);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetCpuHandle(uint32_t index) const noexcept
+{
+    assert(index < m_persistentCount);
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_stagingStart, static_cast<INT>(index), m_descriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetGpuHandle(uint32_t index) const noexcept
+{
+    assert(index < m_persistentCount);
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_gpuStart, static_cast<INT>(index), m_descriptorSize);
+}
+
+DescriptorAllocator::Table DescriptorAllocator::AllocateTransient(uint32_t count)
+{
+    const uint32_t offset = m_persistentCount + m_ring.Allocate(count);
+
+    Table table;
+    table.cpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cpuStart, static_cast<INT>(offset), m_descriptorSize);
+    table.gpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_gpuStart, static_cast<INT>(offset), m_descriptorSize);
+    table.count = count;
+    return table;
+}
+
+DescriptorAllocator::Table DescriptorAllocator::CopyTransient(const D3D12_CPU_DESCRIPTOR_HANDLE* sources, uint32_t count)
+{
+    if (!sources)
+    {
+        throw std::invalid_argument("DescriptorAllocator::CopyTransient");
+    }
+
+    const Table table = AllocateTransient(count);
+
+    // Queued rather than copied immediately, so an entire frame's tables cost a single CopyDescriptors call.
+    m_copyDestStarts.push_back(table.cpuHandle);
+    m_copyDestSizes.push_back(count);
+    for (uint32_t j = 0; j < count; ++j)
+    {
+        m_copySrcStarts.push_back(sources[j]);
+        m_copySrcSizes.push_back(1);
+    }
+
+    return table;
+}
+
+void DescriptorAllocator::BeginFrame(uint64_t completedFenceValue)
+{
+    m_ring.Retire(completedFenceValue);
+
+    while (!m_pendingFrees.empty() && m_pendingFrees.front().fenceValue <= completedFenceValue)
+    {
+        m_freeList.push_back(m_pendingFrees.front().index);
+        m_pendingFrees.pop_front();
+        --m_persistentInUse;
+    }
+
+    Commit();
+}
+
+void DescriptorAllocator::EndFrame(uint64_t fenceValue)
+{
+    Commit();
+
+    m_ring.EndFrame(fenceValue);
+
+    for (const uint32_t index : m_frameFrees)
+    {
+        m_pendingFrees.push_back(PendingFree{ fenceValue, index });
+    }
+    m_frameFrees.clear();
+}
+
+void DescriptorAllocator::Commit()
+{
+    if (!m_dirty.empty())
+    {
+        std::sort(m_dirty.begin(), m_dirty.end());
+        m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end()), m_dirty.end());
+
+        // Coalesce runs of adjacent persistent slots into single ranges.
+        size_t j = 0;
+        while (j < m_dirty.size())
+        {
+            const uint32_t start = m_dirty[j];
+            uint32_t count = 1;
+            while (j + count < m_dirty.size() && m_dirty[j + count] == start + count)
+            {
+                ++count;
+            }
+
+            m_copyDestStarts.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cpuStart, static_cast<INT>(start), m_descriptorSize));
+            m_copyDestSizes.push_back(count);
+            m_copySrcStarts.push_back(GetCpuHandle(start));
+            m_copySrcSizes.push_back(count);
+
+            j += count;
+        }
+
+        m_dirty.clear();
+    }
+
+    if (!m_copyDestStarts.empty())
+    {
+        m_device->CopyDescriptors(
+            static_cast<UINT>(m_copyDestStarts.size()), m_copyDestStarts.data(), m_copyDestSizes.data(),
+            static_cast<UINT>(m_copySrcStarts.size()), m_copySrcStarts.data(), m_copySrcSizes.data(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        m_copyDestStarts.clear();
+        m_copyDestSizes.clear();
+        m_copySrcStarts.clear();
+        m_copySrcSizes.clear();
+    }
+}
@@ -0,0 +1,104 @@
+//
+// DescriptorAllocator.h - Shader-visible descriptor allocation with persistent and per-frame regions
+//
+
+#pragma once
+
+#include "DescriptorRing.h"
+
+#include <deque>
+#include <vector>
+
+
+namespace DX
+{
+    // Manages a single shader-visible CBV/SRV/UAV heap split into two regions:
+    //
+    //  - A persistent region for long-lived descriptors, handed out from a free list. Views are
+    //    written into a CPU-only staging heap and copied into the shader-visible heap in batches.
+    //  - A ring region for transient descriptor tables, which are valid for the current frame only
+    //    and are reclaimed once the GPU fence value for that frame has completed.
+    //
+    // Freed persistent slots are likewise only reused once the frame that freed them has retired.
+    class DescriptorAllocator
+    {
+    public:
+        static constexpr uint32_t c_InvalidIndex = UINT32_MAX;
+
+        struct Table
+        {
+            D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle;  // Shader-visible heap; write-only
+            D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+            uint32_t                    count;
+        };
+
+        DescriptorAllocator(ID3D12Device* device, uint32_t persistentCount, uint32_t transientCount) noexcept(false);
+
+        DescriptorAllocator(DescriptorAllocator&&) = default;
+        DescriptorAllocator& operator= (DescriptorAllocator&&) = default;
+
+        DescriptorAllocator(DescriptorAllocator const&) = delete;
+        DescriptorAllocator& operator= (DescriptorAllocator const&) = delete;
+
+        // Persistent descriptors. Write the view to GetCpuHandle(); it is copied to the
+        // shader-visible heap by the next Commit, BeginFrame, or EndFrame.
+        uint32_t AllocatePersistent();
+        void FreePersistent(uint32_t index);
+        void MarkDirty(uint32_t index);
+
+        D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(uint32_t index) const noexcept;
+        D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(uint32_t index) const noexcept;
+
+        // Transient descriptor tables for the current frame.
+        Table AllocateTransient(uint32_t count);
+        Table CopyTransient(_In_reads_(count) const D3D12_CPU_DESCRIPTOR_HANDLE* sources, uint32_t count);
+
+        // Frame boundaries. completedFenceValue retires earlier frames; fenceValue is the value
+        // which will be signaled once the GPU has finished with the current frame.
+        void BeginFrame(uint64_t completedFenceValue);
+        void EndFrame(uint64_t fenceValue);
+
+        // Issues all pending staging-to-shader-visible copies as one CopyDescriptors call.
+        void Commit();
+
+        ID3D12DescriptorHeap* Heap() const noexcept { return m_heap.Get(); }
+
+        uint32_t GetPersistentCount() const noexcept { return m_persistentCount; }
+        uint32_t GetPersistentInUse() const noexcept { return m_persistentInUse; }
+        uint32_t GetTransientCount() const noexcept { return m_ring.GetCount(); }
+        uint32_t GetTransientInUse() const noexcept { return m_ring.GetInUse(); }
+        uint32_t GetTransientHighWater() const noexcept { return m_ring.GetHighWater(); }
+
+    private:
+        struct PendingFree
+        {
+            uint64_t    fenceValue;
+            uint32_t    index;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D12Device>            m_device;
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>    m_heap;
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>    m_stagingHeap;
+        D3D12_CPU_DESCRIPTOR_HANDLE                     m_cpuStart;
+        D3D12_GPU_DESCRIPTOR_HANDLE                     m_gpuStart;
+        D3D12_CPU_DESCRIPTOR_HANDLE                     m_stagingStart;
+        UINT                                            m_descriptorSize;
+
+        // Persistent region
+        uint32_t                                        m_persistentCount;
+        uint32_t                                        m_persistentInUse;
+        std::vector<uint32_t>                           m_freeList;
+        std::vector<uint32_t>                           m_frameFrees;
+        std::deque<PendingFree>                         m_pendingFrees;
+        std::vector<uint32_t>                           m_dirty;
+
+        // Ring region
+        DescriptorRing                                  m_ring;
+
+        // Pending copies into the ring.
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>        m_copyDestStarts;
+        std::vector<UINT>                               m_copyDestSizes;
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>        m_copySrcStarts;
+        std::vector<UINT>                               m_copySrcSizes;
+    };
+}
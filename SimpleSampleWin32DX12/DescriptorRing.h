@@ -0,0 +1,138 @@
+//
+// DescriptorRing.h - Per-frame ring allocation of descriptor ranges, retired by fence value
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+
+
+namespace DX
+{
+    // Hands out contiguous ranges of indices from a fixed-size ring. Everything allocated during a
+    // frame is tagged with that frame's fence value by EndFrame, and is reclaimed in one step once
+    // Retire sees that value complete. A range never wraps: if it doesn't fit at the end of the ring
+    // it starts again at zero, and the skipped space is reclaimed along with the frame.
+    // This class only tracks indices and can be used (and tested) without Direct3D.
+    class DescriptorRing
+    {
+    public:
+        explicit DescriptorRing(uint32_t count) noexcept(false) :
+            m_count(count),
+            m_head(0),
+            m_tail(0),
+            m_allocated(0),
+            m_retired(0),
+            m_highWater(0)
+        {
+            if (!count)
+            {
+                throw std::invalid_argument("DescriptorRing requires a non-empty ring");
+            }
+        }
+
+        DescriptorRing(DescriptorRing&&) = default;
+        DescriptorRing& operator= (DescriptorRing&&) = default;
+
+        DescriptorRing(DescriptorRing const&) = delete;
+        DescriptorRing& operator= (DescriptorRing const&) = delete;
+
+        // Returns the first index of the range; throws if the ring is too full.
+        uint32_t Allocate(uint32_t count)
+        {
+            uint64_t used = m_allocated - m_retired;
+            if (!count || used + count > m_count)
+            {
+                throw std::runtime_error("DescriptorRing exhausted");
+            }
+
+            if (!used)
+            {
+                m_head = m_tail = 0;
+            }
+
+            uint32_t offset = 0;
+            if (m_head >= m_tail)
+            {
+                if (m_head + count <= m_count)
+                {
+                    offset = m_head;
+                }
+                else if (count <= m_tail)
+                {
+                    // The unused space at the end of the ring is consumed along with the allocation.
+                    m_allocated += m_count - m_head;
+                    offset = 0;
+                }
+                else
+                {
+                    throw std::runtime_error("DescriptorRing exhausted");
+                }
+            }
+            else if (m_head + count <= m_tail)
+            {
+                offset = m_head;
+            }
+            else
+            {
+                throw std::runtime_error("DescriptorRing exhausted");
+            }
+
+            m_head = offset + count;
+            m_allocated += count;
+
+            used = m_allocated - m_retired;
+            m_highWater = std::max(m_highWater, static_cast<uint32_t>(used));
+
+            return offset;
+        }
+
+        // Tags everything allocated since the last EndFrame with the frame's fence value.
+        void EndFrame(uint64_t fenceValue)
+        {
+            if (m_markers.empty() || m_markers.back().allocated != m_allocated)
+            {
+                m_markers.push_back(Marker{ fenceValue, m_head, m_allocated });
+            }
+            else
+            {
+                // Nothing new was allocated this frame; just extend the last marker's lifetime.
+                m_markers.back().fenceValue = fenceValue;
+            }
+        }
+
+        // Reclaims every frame whose fence value has completed.
+        void Retire(uint64_t completedFenceValue)
+        {
+            while (!m_markers.empty() && m_markers.front().fenceValue <= completedFenceValue)
+            {
+                m_tail = m_markers.front().head;
+                m_retired = m_markers.front().allocated;
+                m_markers.pop_front();
+            }
+        }
+
+        uint32_t GetCount() const noexcept { return m_count; }
+        uint32_t GetInUse() const noexcept { return static_cast<uint32_t>(m_allocated - m_retired); }
+        uint32_t GetHighWater() const noexcept { return m_highWater; }
+
+    private:
+        struct Marker
+        {
+            uint64_t    fenceValue;
+            uint32_t    head;
+            uint64_t    allocated;
+        };
+
+        uint32_t            m_count;
+        uint32_t            m_head;
+        uint32_t            m_tail;
+        uint64_t            m_allocated;    // Running totals, including space skipped at the end
+        uint64_t            m_retired;
+        uint32_t            m_highWater;
+        std::deque<Marker>  m_markers;
+    };
+}
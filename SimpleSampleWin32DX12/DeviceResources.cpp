@@ -19,6 +19,21 @@ using Microsoft::WRL::ComPtr;
 
 namespace
 {
+    // Milliseconds on the performance counter, for timing startup phases.
+    inline double GetTimeMs() noexcept
+    {
+        static const double s_msPerTick = []()
+            {
+                LARGE_INTEGER frequency;
+                QueryPerformanceFrequency(&frequency);
+                return 1000.0 / double(frequency.QuadPart);
+            }();
+
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return double(counter.QuadPart) * s_msPerTick;
+    }
+
     inline DXGI_FORMAT NoSRGB(DXGI_FORMAT fmt) noexcept
     {
         switch (fmt)
@@ -36,6 +51,50 @@ namespace
     {
         return std::max(0l, std::min(ax2, bx2) - std::max(ax1, bx1)) * std::max(0l, std::min(ay2, by2) - std::max(ay1, by1));
     }
+
+    // Drives CommandQueueSync with real queues and fences, indexed by COMMAND_QUEUE_TYPE.
+    class D3D12QueueBackend final : public ICommandQueueBackend
+    {
+    public:
+        D3D12QueueBackend(ID3D12CommandQueue* const* queues, ID3D12Fence* const* fences) noexcept :
+            m_queues{},
+            m_fences{}
+        {
+            for (uint32_t j = 0; j < CommandQueue_Count; ++j)
+            {
+                m_queues[j] = queues[j];
+                m_fences[j] = fences[j];
+            }
+        }
+
+        void Signal(uint32_t queue, uint64_t value) override
+        {
+            ThrowIfFailed(GetQueue(queue)->Signal(m_fences[queue], value));
+        }
+
+        void Wait(uint32_t queue, uint32_t sourceQueue, uint64_t value) override
+        {
+            ThrowIfFailed(GetQueue(queue)->Wait(m_fences[sourceQueue], value));
+        }
+
+        uint64_t GetCompletedValue(uint32_t queue) const override
+        {
+            return m_fences[queue] ? m_fences[queue]->GetCompletedValue() : 0;
+        }
+
+    private:
+        ID3D12CommandQueue* GetQueue(uint32_t queue) const
+        {
+            if (!m_queues[queue])
+            {
+                throw std::logic_error("Command queue was not created");
+            }
+            return m_queues[queue];
+        }
+
+        ID3D12CommandQueue*     m_queues[CommandQueue_Count];
+        ID3D12Fence*            m_fences[CommandQueue_Count];
+    };
 }
 
 // Constructor for DeviceResources.
@@ -44,21 +103,37 @@ DeviceResources::DeviceResources(
     DXGI_FORMAT depthBufferFormat,
     UINT backBufferCount,
     D3D_FEATURE_LEVEL minFeatureLevel,
-    unsigned int flags) noexcept(false) :
+    unsigned int flags,
+    UINT framesInFlight) noexcept(false) :
     m_backBufferIndex(0),
+    m_frameIndex(0),
+    m_commandAllocator(nullptr),
+    m_workerCommandAllocators{},
+    m_workerCommandListMask(0),
     m_fenceValues{},
+    m_computeCommandAllocator(nullptr),
     m_rtvDescriptorSize(0),
     m_screenViewport{},
     m_scissorRect{},
     m_backBufferFormat(backBufferFormat),
     m_depthBufferFormat(depthBufferFormat),
     m_backBufferCount(backBufferCount),
+    m_framesInFlight(framesInFlight ? framesInFlight : backBufferCount),
+    m_maxFrameLatency(1),
     m_d3dMinFeatureLevel(minFeatureLevel),
     m_window(nullptr),
     m_d3dFeatureLevel(D3D_FEATURE_LEVEL_11_0),
     m_dxgiFactoryFlags(0),
     m_outputSize{ 0, 0, 1, 1 },
+    m_pendingWidth(0),
+    m_pendingHeight(0),
+    m_resizeRequests(0),
+    m_liveResize(false),
     m_colorSpace(DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709),
+    m_colorSpaceApplied(false),
+    m_outputTopologyValid(false),
+    m_adapterInfo{},
+    m_deviceTimings{},
     m_options(flags),
     m_deviceNotify(nullptr)
 {
@@ -67,6 +142,13 @@ DeviceResources::DeviceResources(
         throw std::out_of_range("invalid backBufferCount");
     }
 
+    // Frames in flight limits how far the CPU runs ahead of the GPU; it can be lower than the
+    // buffer count (more buffers for smoother flips, less latency) but never higher.
+    if (m_framesInFlight > backBufferCount || m_framesInFlight > MAX_FRAMES_IN_FLIGHT)
+    {
+        throw std::out_of_range("invalid framesInFlight");
+    }
+
     if (minFeatureLevel < D3D_FEATURE_LEVEL_11_0)
     {
         throw std::out_of_range("minFeatureLevel too low");
@@ -83,6 +165,9 @@ DeviceResources::~DeviceResources()
 // Configures the Direct3D device, and stores handles to it and the device context.
 void DeviceResources::CreateDeviceResources()
 {
+m_deviceTimings = {};
+const double startTime = GetTimeMs();
+
 #if defined(_DEBUG)
     // Enable the debug layer (requires the Graphics Tools "optional feature").
     //
@@ -141,9 +226,15 @@ if (m_options & c_AllowTearing)
     }
 }
 
+double phaseTime = GetTimeMs();
+m_deviceTimings.factory = phaseTime - startTime;
+
 ComPtr<IDXGIAdapter1> adapter;
 GetAdapter(adapter.GetAddressOf());
 
+m_deviceTimings.adapterSelection = GetTimeMs() - phaseTime;
+phaseTime = GetTimeMs();
+
 // Create the DX12 API device object.
 HRESULT hr = D3D12CreateDevice(
     adapter.Get(),
@@ -152,6 +243,9 @@ HRESULT hr = D3D12CreateDevice(
 );
 ThrowIfFailed(hr);
 
+m_deviceTimings.deviceCreation = GetTimeMs() - phaseTime;
+phaseTime = GetTimeMs();
+
 m_d3dDevice->SetName(L"DeviceResources");
 
 #ifndef NDEBUG
@@ -205,6 +299,13 @@ else
     m_d3dFeatureLevel = m_d3dMinFeatureLevel;
 }
 
+// The next start can select this adapter without probing it.
+m_adapterCache.Record(m_adapterInfo, m_d3dFeatureLevel, true);
+if (m_adapterCache.IsDirty() && !m_adapterCacheFile.empty())
+{
+    std::ignore = m_adapterCache.Save(m_adapterCacheFile.c_str());
+}
+
 // Create the command queue.
 D3D12_COMMAND_QUEUE_DESC queueDesc = {};
 queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -214,6 +315,23 @@ ThrowIfFailed(m_d3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(m_command
 
 m_commandQueue->SetName(L"DeviceResources");
 
+// Create the copy queue used for uploads, which run alongside rendering.
+queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+
+ThrowIfFailed(m_d3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(m_copyQueue.ReleaseAndGetAddressOf())));
+
+m_copyQueue->SetName(L"DeviceResources Copy");
+
+// Create the optional compute queue, which runs alongside the graphics queue.
+if (m_options & c_EnableAsyncCompute)
+{
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+
+    ThrowIfFailed(m_d3dDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(m_computeQueue.ReleaseAndGetAddressOf())));
+
+    m_computeQueue->SetName(L"DeviceResources Compute");
+}
+
 // Create descriptor heaps for render target views and depth stencil views.
 D3D12_DESCRIPTOR_HEAP_DESC rtvDescriptorHeapDesc = {};
 rtvDescriptorHeapDesc.NumDescriptors = m_backBufferCount;
@@ -236,33 +354,80 @@ if (m_depthBufferFormat != DXGI_FORMAT_UNKNOWN)
     m_dsvDescriptorHeap->SetName(L"DeviceResources");
 }
 
-// Create a command allocator for each back buffer that will be rendered to.
-for (UINT n = 0; n < m_backBufferCount; n++)
-{
-    ThrowIfFailed(m_d3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(m_commandAllocators[n].ReleaseAndGetAddressOf())));
+// Create the allocator used to place the depth buffer and other render targets in shared heaps.
+m_heapAllocator = std::make_unique<ResourceHeapAllocator>(m_d3dDevice.Get());
 
-    wchar_t name[25] = {};
-    swprintf_s(name, L"Render target %u", n);
-    m_commandAllocators[n]->SetName(name);
-}
+// Create the command allocator pool, with enough allocators for each frame in flight.
+m_commandAllocatorPool = std::make_unique<CommandAllocatorPool>(m_d3dDevice.Get());
+m_commandAllocatorPool->Reserve(D3D12_COMMAND_LIST_TYPE_DIRECT, m_framesInFlight);
 
 // Create a command list for recording graphics commands.
-ThrowIfFailed(m_d3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocators[0].Get(), nullptr, IID_PPV_ARGS(m_commandList.ReleaseAndGetAddressOf())));
-ThrowIfFailed(m_commandList->Close());
+{
+    auto allocator = m_commandAllocatorPool->Acquire(D3D12_COMMAND_LIST_TYPE_DIRECT, 0);
+
+    ThrowIfFailed(m_d3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, IID_PPV_ARGS(m_commandList.ReleaseAndGetAddressOf())));
+    ThrowIfFailed(m_commandList->Close());
+
+    // Nothing was recorded, so the allocator can be reused right away.
+    m_commandAllocatorPool->Release(D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, 0);
+}
 
 m_commandList->SetName(L"DeviceResources");
 
 // Create a fence for tracking GPU execution progress.
-ThrowIfFailed(m_d3dDevice->CreateFence(m_fenceValues[m_backBufferIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_fence.ReleaseAndGetAddressOf())));
-m_fenceValues[m_backBufferIndex]++;
+ThrowIfFailed(m_d3dDevice->CreateFence(m_fenceValues[m_frameIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_fence.ReleaseAndGetAddressOf())));
+m_fenceValues[m_frameIndex]++;
 
 m_fence->SetName(L"DeviceResources");
 
-m_fenceEvent.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
-if (!m_fenceEvent.IsValid())
+ThrowIfFailed(m_d3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_copyFence.ReleaseAndGetAddressOf())));
+
+m_copyFence->SetName(L"DeviceResources Copy");
+
+if (m_computeQueue)
 {
-    throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
+    ThrowIfFailed(m_d3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_computeFence.ReleaseAndGetAddressOf())));
+
+    m_computeFence->SetName(L"DeviceResources Compute");
 }
+
+// Track fence values and waits across the queues.
+{
+    ID3D12CommandQueue* queues[CommandQueue_Count] = { m_commandQueue.Get(), m_computeQueue.Get(), m_copyQueue.Get() };
+    ID3D12Fence* fences[CommandQueue_Count] = { m_fence.Get(), m_computeFence.Get(), m_copyFence.Get() };
+
+    m_queueBackend = std::make_unique<D3D12QueueBackend>(queues, fences);
+    m_queueSync = std::make_unique<CommandQueueSync>(m_queueBackend.get(), CommandQueue_Count);
+
+    // The graphics fence was created one value behind the next frame's fence value.
+    if (m_fenceValues[m_frameIndex] > 1)
+    {
+        m_queueSync->RecordSignal(CommandQueue_Graphics, m_fenceValues[m_frameIndex] - 1);
+    }
+}
+
+// Each fence gets its own timeline, with its own event to wait on.
+m_fenceTimelines[CommandQueue_Graphics] = std::make_unique<FenceTimeline>(m_fence.Get());
+m_fenceTimelines[CommandQueue_Copy] = std::make_unique<FenceTimeline>(m_copyFence.Get());
+if (m_computeFence)
+{
+    m_fenceTimelines[CommandQueue_Compute] = std::make_unique<FenceTimeline>(m_computeFence.Get());
+}
+
+const double endTime = GetTimeMs();
+m_deviceTimings.deviceSetup = endTime - phaseTime;
+m_deviceTimings.total = endTime - startTime;
+
+#ifdef _DEBUG
+{
+    char buff[256] = {};
+    sprintf_s(buff, "Device creation: %.2f ms (factory %.2f, adapter %.2f [%u probed, %u cached], device %.2f, setup %.2f)\n",
+        m_deviceTimings.total, m_deviceTimings.factory, m_deviceTimings.adapterSelection,
+        m_deviceTimings.adaptersProbed, m_deviceTimings.probesSkipped,
+        m_deviceTimings.deviceCreation, m_deviceTimings.deviceSetup);
+    OutputDebugStringA(buff);
+}
+#endif
 }
 
 // These resources need to be recreated every time the window size is changed.
@@ -280,7 +445,11 @@ void DeviceResources::CreateWindowSizeDependentResources()
     for (UINT n = 0; n < m_backBufferCount; n++)
     {
         m_renderTargets[n].Reset();
-        m_fenceValues[n] = m_fenceValues[m_backBufferIndex];
+    }
+
+    for (UINT n = 0; n < m_framesInFlight; n++)
+    {
+        m_fenceValues[n] = m_fenceValues[m_frameIndex];
     }
 
     // Determine the render target size in pixels.
@@ -297,7 +466,7 @@ void DeviceResources::CreateWindowSizeDependentResources()
             backBufferWidth,
             backBufferHeight,
             backBufferFormat,
-            (m_options & c_AllowTearing) ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0u
+            GetSwapChainFlags()
         );
 
         if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
@@ -334,7 +503,7 @@ void DeviceResources::CreateWindowSizeDependentResources()
         swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
         swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
         swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
-        swapChainDesc.Flags = (m_options & c_AllowTearing) ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0u;
+        swapChainDesc.Flags = GetSwapChainFlags();
 
         DXGI_SWAP_CHAIN_FULLSCREEN_DESC fsSwapChainDesc = {};
         fsSwapChainDesc.Windowed = TRUE;
@@ -352,11 +521,24 @@ void DeviceResources::CreateWindowSizeDependentResources()
 
         ThrowIfFailed(swapChain.As(&m_swapChain));
 
+        // The waitable object and latency limit survive ResizeBuffers, so they are only set up here.
+        if (m_options & c_EnableFrameLatencyWaitable)
+        {
+            ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(m_maxFrameLatency));
+
+            m_frameLatencyWaitableObject.Attach(m_swapChain->GetFrameLatencyWaitableObject());
+            if (!m_frameLatencyWaitableObject.IsValid())
+            {
+                throw std::runtime_error("GetFrameLatencyWaitableObject");
+            }
+        }
+
         // This class does not support exclusive full-screen mode and prevents DXGI from responding to the ALT+ENTER shortcut
         ThrowIfFailed(m_dxgiFactory->MakeWindowAssociation(m_window, DXGI_MWA_NO_ALT_ENTER));
     }
 
-    // Handle color space settings for HDR
+    // Handle color space settings for HDR. A new or resized swap chain needs its color space set again.
+    m_colorSpaceApplied = false;
     UpdateColorSpace();
 
     // Obtain the back buffers for this window which will be the final render targets
@@ -386,8 +568,6 @@ void DeviceResources::CreateWindowSizeDependentResources()
     {
         // Allocate a 2-D surface as the depth/stencil buffer and create a depth/stencil view
         // on this surface.
-        const CD3DX12_HEAP_PROPERTIES depthHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
-
         D3D12_RESOURCE_DESC depthStencilDesc = CD3DX12_RESOURCE_DESC::Tex2D(
             m_depthBufferFormat,
             backBufferWidth,
@@ -402,17 +582,30 @@ void DeviceResources::CreateWindowSizeDependentResources()
         depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
         depthOptimizedClearValue.DepthStencil.Stencil = 0;
 
-        ThrowIfFailed(m_d3dDevice->CreateCommittedResource(
-            &depthHeapProperties,
-            D3D12_HEAP_FLAG_NONE,
-            &depthStencilDesc,
+        // The GPU is idle at this point, so the previous depth buffer's memory can be reused directly
+        // from the placed heap rather than going back to the OS for a new committed allocation.
+        m_depthStencil.Reset();
+        m_heapAllocator->Free(m_depthStencilAllocation);
+
+        m_heapAllocator->CreatePlacedResource(
+            depthStencilDesc,
             D3D12_RESOURCE_STATE_DEPTH_WRITE,
             &depthOptimizedClearValue,
-            IID_PPV_ARGS(m_depthStencil.ReleaseAndGetAddressOf())
-        ));
+            m_depthStencil.GetAddressOf(),
+            m_depthStencilAllocation
+        );
 
         m_depthStencil->SetName(L"Depth stencil");
 
+    #ifdef _DEBUG
+        const auto heapStats = m_heapAllocator->GetStatistics();
+        char buff[192] = {};
+        sprintf_s(buff, "Placed heaps: %u heaps, %llu KB reserved, %llu KB used by %u resources (%.1f%% rounding waste, %.1f%% fragmentation)\n",
+            heapStats.heapCount, heapStats.reservedBytes / 1024, heapStats.usedBytes / 1024, heapStats.allocationCount,
+            heapStats.internalWaste * 100.f, heapStats.fragmentation * 100.f);
+        OutputDebugStringA(buff);
+    #endif
+
         D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
         dsvDesc.Format = m_depthBufferFormat;
         dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
@@ -465,6 +658,33 @@ bool DeviceResources::WindowSizeChanged(int width, int height)
     return true;
 }
 
+// Records a new window size without touching the swap chain. Only the latest size is kept.
+void DeviceResources::RequestWindowSize(int width, int height) noexcept
+{
+    m_pendingWidth = width;
+    m_pendingHeight = height;
+    ++m_resizeRequests;
+}
+
+// Called at a frame boundary. Returns true if the swap chain was resized.
+bool DeviceResources::ApplyPendingWindowSize()
+{
+    if (!m_resizeRequests || m_liveResize)
+        return false;
+
+#ifdef _DEBUG
+    if (m_resizeRequests > 1)
+    {
+        char buff[64] = {};
+        sprintf_s(buff, "Coalesced %u window size changes\n", m_resizeRequests);
+        OutputDebugStringA(buff);
+    }
+#endif
+
+    m_resizeRequests = 0;
+    return WindowSizeChanged(m_pendingWidth, m_pendingHeight);
+}
+
 // Recreate all device resources and set them back to the current state.
 void DeviceResources::HandleDeviceLost()
 {
@@ -475,19 +695,45 @@ void DeviceResources::HandleDeviceLost()
 
     for (UINT n = 0; n < m_backBufferCount; n++)
     {
-        m_commandAllocators[n].Reset();
         m_renderTargets[n].Reset();
     }
 
+    for (UINT n = 0; n < MAX_WORKER_COMMAND_LISTS; n++)
+    {
+        m_workerCommandLists[n].Reset();
+        m_workerCommandAllocators[n] = nullptr;
+    }
+    m_workerCommandListMask = 0;
+
+    m_commandAllocator = nullptr;
+    m_commandAllocatorPool.reset();
+
     m_depthStencil.Reset();
+    m_depthStencilAllocation = PlacedAllocation();
+    m_heapAllocator.reset();
     m_commandQueue.Reset();
+    m_copyQueue.Reset();
+    m_copyFence.Reset();
+    m_computeQueue.Reset();
+    m_computeFence.Reset();
+    m_computeCommandList.Reset();
+    m_computeCommandAllocator = nullptr;
+    m_queueSync.reset();
+    m_queueBackend.reset();
+
+    for (auto& timeline : m_fenceTimelines)
+    {
+        timeline.reset();
+    }
     m_commandList.Reset();
     m_fence.Reset();
     m_rtvDescriptorHeap.Reset();
     m_dsvDescriptorHeap.Reset();
+    m_frameLatencyWaitableObject.Close();
     m_swapChain.Reset();
     m_d3dDevice.Reset();
     m_dxgiFactory.Reset();
+    m_outputTopologyValid = false;
 
 #ifdef _DEBUG
     {
@@ -511,9 +757,19 @@ void DeviceResources::HandleDeviceLost()
 // Prepare the command list and render target for rendering.
 void DeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState)
 {
-    // Reset command list and allocator.
-    ThrowIfFailed(m_commandAllocators[m_backBufferIndex]->Reset());
-    ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].Get(), nullptr));
+    // Release deferred objects and run completion callbacks for work the GPU has finished.
+    for (auto& timeline : m_fenceTimelines)
+    {
+        if (timeline)
+        {
+            std::ignore = timeline->Update();
+        }
+    }
+
+    // Reset command list with an allocator the GPU has finished with.
+    m_commandAllocator = m_commandAllocatorPool->Acquire(D3D12_COMMAND_LIST_TYPE_DIRECT,
+        m_fenceTimelines[CommandQueue_Graphics]->GetCompletedValue());
+    ThrowIfFailed(m_commandList->Reset(m_commandAllocator, nullptr));
 
     if (beforeState != afterState)
     {
@@ -525,21 +781,93 @@ void DeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_
     }
 }
 
+// Returns an open command list for this frame which may be recorded on any thread. Call from the
+// rendering thread between Prepare and Present; lists are submitted by Present after the main list.
+ID3D12GraphicsCommandList* DeviceResources::GetWorkerCommandList(unsigned int index)
+{
+    if (index >= MAX_WORKER_COMMAND_LISTS)
+    {
+        throw std::out_of_range("invalid worker command list index");
+    }
+
+    auto& commandList = m_workerCommandLists[index];
+    if (m_workerCommandListMask & (1u << index))
+    {
+        return commandList.Get();
+    }
+
+    auto allocator = m_commandAllocatorPool->Acquire(D3D12_COMMAND_LIST_TYPE_DIRECT, m_fence->GetCompletedValue());
+    m_workerCommandAllocators[index] = allocator;
+
+    if (!commandList)
+    {
+        ThrowIfFailed(m_d3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, IID_PPV_ARGS(commandList.ReleaseAndGetAddressOf())));
+
+        wchar_t name[32] = {};
+        swprintf_s(name, L"Worker %u", index);
+        commandList->SetName(name);
+    }
+    else
+    {
+        ThrowIfFailed(commandList->Reset(allocator, nullptr));
+    }
+
+    m_workerCommandListMask |= (1u << index);
+    return commandList.Get();
+}
+
 // Present the contents of the swap chain to the screen.
 void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState)
 {
+    // Worker command lists run after the main command list, in index order.
+    ID3D12CommandList* commandLists[1 + MAX_WORKER_COMMAND_LISTS] = { m_commandList.Get() };
+    UINT commandListCount = 1;
+
+    ID3D12GraphicsCommandList* lastCommandList = m_commandList.Get();
+    for (UINT n = 0; n < MAX_WORKER_COMMAND_LISTS; n++)
+    {
+        if (m_workerCommandListMask & (1u << n))
+        {
+            lastCommandList = m_workerCommandLists[n].Get();
+            commandLists[commandListCount++] = lastCommandList;
+        }
+    }
+
     if (beforeState != D3D12_RESOURCE_STATE_PRESENT)
     {
         // Transition the render target to the state that allows it to be presented to the display.
         const D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
             m_renderTargets[m_backBufferIndex].Get(),
             beforeState, D3D12_RESOURCE_STATE_PRESENT);
-        m_commandList->ResourceBarrier(1, &barrier);
+        lastCommandList->ResourceBarrier(1, &barrier);
     }
 
-    // Send the command list off to the GPU for processing.
+    // Send the command lists off to the GPU for processing in a single submission.
     ThrowIfFailed(m_commandList->Close());
-    m_commandQueue->ExecuteCommandLists(1, CommandListCast(m_commandList.GetAddressOf()));
+    for (UINT n = 0; n < MAX_WORKER_COMMAND_LISTS; n++)
+    {
+        if (m_workerCommandListMask & (1u << n))
+        {
+            ThrowIfFailed(m_workerCommandLists[n]->Close());
+        }
+    }
+
+    m_commandQueue->ExecuteCommandLists(commandListCount, commandLists);
+
+    // The allocators return to the pool once the fence value MoveToNextFrame signals for this frame completes.
+    const UINT64 fenceValue = m_fenceValues[m_frameIndex];
+    m_commandAllocatorPool->Release(D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator, fenceValue);
+    m_commandAllocator = nullptr;
+
+    for (UINT n = 0; n < MAX_WORKER_COMMAND_LISTS; n++)
+    {
+        if (m_workerCommandListMask & (1u << n))
+        {
+            m_commandAllocatorPool->Release(D3D12_COMMAND_LIST_TYPE_DIRECT, m_workerCommandAllocators[n], fenceValue);
+            m_workerCommandAllocators[n] = nullptr;
+        }
+    }
+    m_workerCommandListMask = 0;
 
     HRESULT hr;
     if (m_options & c_AllowTearing)
@@ -583,114 +911,297 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState)
 // Wait for pending GPU work to complete.
 void DeviceResources::WaitForGpu() noexcept
 {
-    if (m_commandQueue && m_fence && m_fenceEvent.IsValid())
+    auto timeline = m_fenceTimelines[CommandQueue_Graphics].get();
+    if (m_commandQueue && m_fence && timeline)
     {
         // Schedule a Signal command in the GPU queue.
-        const UINT64 fenceValue = m_fenceValues[m_backBufferIndex];
+        const UINT64 fenceValue = m_fenceValues[m_frameIndex];
         if (SUCCEEDED(m_commandQueue->Signal(m_fence.Get(), fenceValue)))
         {
-            // Wait until the Signal has been processed.
-            if (SUCCEEDED(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent.Get())))
+            if (m_queueSync)
+            {
+                m_queueSync->RecordSignal(CommandQueue_Graphics, fenceValue);
+            }
+
+            // Increment the fence value for the current frame.
+            m_fenceValues[m_frameIndex]++;
+
+            // Wait until the Signal has been processed, and any outstanding compute and copy queue
+            // work has finished too, reporting rather than hanging if it never does.
+            FenceTimeline* timelines[CommandQueue_Count] = {};
+            uint64_t values[CommandQueue_Count] = {};
+            timelines[CommandQueue_Graphics] = timeline;
+            values[CommandQueue_Graphics] = fenceValue;
+            if (m_queueSync)
             {
-                std::ignore = WaitForSingleObjectEx(m_fenceEvent.Get(), INFINITE, FALSE);
+                for (const auto queue : { CommandQueue_Compute, CommandQueue_Copy })
+                {
+                    timelines[queue] = m_fenceTimelines[queue].get();
+                    values[queue] = m_queueSync->GetLastSignaledValue(queue);
+                }
+            }
 
-                // Increment the fence value for the current frame.
-                m_fenceValues[m_backBufferIndex]++;
+            if (!FenceTimeline::WaitForAll(timelines, values, CommandQueue_Count))
+            {
+                for (uint32_t queue = 0; queue < CommandQueue_Count; ++queue)
+                {
+                    if (timelines[queue] && !timelines[queue]->IsComplete(values[queue]))
+                    {
+                        ReportGpuTimeout(static_cast<COMMAND_QUEUE_TYPE>(queue), values[queue]);
+                    }
+                }
             }
         }
     }
 }
 
+// Limits how many frames the swap chain will queue before the waitable object blocks.
+void DeviceResources::SetMaximumFrameLatency(UINT maxLatency)
+{
+    if (!maxLatency || maxLatency > DXGI_MAX_SWAP_CHAIN_BUFFERS)
+    {
+        throw std::out_of_range("invalid maxLatency");
+    }
+
+    m_maxFrameLatency = maxLatency;
+
+    if (m_swapChain && (m_options & c_EnableFrameLatencyWaitable))
+    {
+        ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(maxLatency));
+    }
+}
+
+// Blocks until the swap chain is ready for a new frame. Returns false if the timeout elapsed first.
+bool DeviceResources::WaitForFrameLatency(DWORD timeoutMs) noexcept
+{
+    if (!m_frameLatencyWaitableObject.IsValid())
+        return true;
+
+    return WaitForSingleObjectEx(m_frameLatencyWaitableObject.Get(), timeoutMs, TRUE) == WAIT_OBJECT_0;
+}
+
+// Signal a queue after submitting work to it, returning the value which marks that work's completion.
+UINT64 DeviceResources::SignalQueue(COMMAND_QUEUE_TYPE queue)
+{
+    if (queue == CommandQueue_Graphics)
+    {
+        // Graphics values come from the per-frame sequence, so the frame's own signal stays ahead of this one.
+        const UINT64 fenceValue = m_fenceValues[m_frameIndex];
+        ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fenceValue));
+        m_queueSync->RecordSignal(CommandQueue_Graphics, fenceValue);
+        m_fenceValues[m_frameIndex]++;
+        return fenceValue;
+    }
+
+    return m_queueSync->Signal(queue);
+}
+
+// Non-blocking check for whether a queue has reached fenceValue.
+bool DeviceResources::IsFenceComplete(COMMAND_QUEUE_TYPE queue, UINT64 fenceValue)
+{
+    return m_queueSync->IsComplete(queue, fenceValue);
+}
+
+// Make a queue wait on the GPU, not the CPU, until sourceQueue reaches fenceValue.
+void DeviceResources::QueueWait(COMMAND_QUEUE_TYPE queue, COMMAND_QUEUE_TYPE sourceQueue, UINT64 fenceValue)
+{
+    m_queueSync->Wait(queue, sourceQueue, fenceValue);
+}
+
+// Returns an open compute command list, using an allocator from the pool's compute set.
+ID3D12GraphicsCommandList* DeviceResources::BeginComputeCommandList()
+{
+    if (!m_computeQueue)
+    {
+        throw std::logic_error("Async compute requires c_EnableAsyncCompute");
+    }
+
+    if (m_computeCommandAllocator)
+    {
+        throw std::logic_error("Compute command list is already open");
+    }
+
+    m_computeCommandAllocator = m_commandAllocatorPool->Acquire(D3D12_COMMAND_LIST_TYPE_COMPUTE,
+        m_queueSync->GetCompletedValue(CommandQueue_Compute));
+
+    if (!m_computeCommandList)
+    {
+        ThrowIfFailed(m_d3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, m_computeCommandAllocator, nullptr, IID_PPV_ARGS(m_computeCommandList.ReleaseAndGetAddressOf())));
+
+        m_computeCommandList->SetName(L"DeviceResources Compute");
+    }
+    else
+    {
+        ThrowIfFailed(m_computeCommandList->Reset(m_computeCommandAllocator, nullptr));
+    }
+
+    return m_computeCommandList.Get();
+}
+
+// Submits the compute command list and signals the compute fence.
+UINT64 DeviceResources::ExecuteComputeCommandList()
+{
+    if (!m_computeCommandAllocator)
+    {
+        throw std::logic_error("Compute command list is not open");
+    }
+
+    ThrowIfFailed(m_computeCommandList->Close());
+    m_computeQueue->ExecuteCommandLists(1, CommandListCast(m_computeCommandList.GetAddressOf()));
+
+    const UINT64 fenceValue = m_queueSync->Signal(CommandQueue_Compute);
+
+    m_commandAllocatorPool->Release(D3D12_COMMAND_LIST_TYPE_COMPUTE, m_computeCommandAllocator, fenceValue);
+    m_computeCommandAllocator = nullptr;
+
+    return fenceValue;
+}
+
 // Prepare to render the next frame.
 void DeviceResources::MoveToNextFrame()
 {
     // Schedule a Signal command in the queue.
-    const UINT64 currentFenceValue = m_fenceValues[m_backBufferIndex];
+    const UINT64 currentFenceValue = m_fenceValues[m_frameIndex];
     ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), currentFenceValue));
+    m_queueSync->RecordSignal(CommandQueue_Graphics, currentFenceValue);
 
-    // Update the back buffer index.
+    // Update the back buffer index, and advance to the next frame slot. The two only move in
+    // step when the number of frames in flight matches the buffer count.
     m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
 
-    // If the next frame is not ready to be rendered yet, wait until it is ready.
-    if (m_fence->GetCompletedValue() < m_fenceValues[m_backBufferIndex])
+    // If the next frame slot is still in use by the GPU, wait until it is ready.
+    if (!m_fenceTimelines[CommandQueue_Graphics]->Wait(m_fenceValues[m_frameIndex]))
     {
-        ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValues[m_backBufferIndex], m_fenceEvent.Get()));
-        std::ignore = WaitForSingleObjectEx(m_fenceEvent.Get(), INFINITE, FALSE);
+        ReportGpuTimeout(CommandQueue_Graphics, m_fenceValues[m_frameIndex]);
+        throw std::runtime_error("Timed out waiting for the GPU to finish a frame");
     }
 
     // Set the fence value for the next frame.
-    m_fenceValues[m_backBufferIndex] = currentFenceValue + 1;
+    m_fenceValues[m_frameIndex] = currentFenceValue + 1;
+}
+
+// Called when a bounded fence wait times out, which means the GPU is hung or badly overloaded.
+void DeviceResources::ReportGpuTimeout(COMMAND_QUEUE_TYPE queue, UINT64 fenceValue) noexcept
+{
+#ifdef _DEBUG
+    static const char* s_queueNames[CommandQueue_Count] = { "graphics", "compute", "copy" };
+
+    const auto timeline = m_fenceTimelines[queue].get();
+    char buff[256] = {};
+    sprintf_s(buff, "ERROR: GPU timeout on %s queue waiting for fence %llu (completed %llu, device removed reason 0x%08X)\n",
+        s_queueNames[queue],
+        fenceValue,
+        timeline ? timeline->GetCompletedValue() : 0ull,
+        static_cast<unsigned int>(m_d3dDevice ? m_d3dDevice->GetDeviceRemovedReason() : S_OK));
+    OutputDebugStringA(buff);
+#else
+    UNREFERENCED_PARAMETER(queue);
+    UNREFERENCED_PARAMETER(fenceValue);
+#endif
+}
+
+// Applies an adapter selection policy. Its minimum feature level can only raise the one passed to the constructor.
+void DeviceResources::SetAdapterPolicy(const AdapterPolicy& policy) noexcept
+{
+    m_adapterPolicy = policy;
+    if (policy.minFeatureLevel > m_d3dMinFeatureLevel)
+    {
+        m_d3dMinFeatureLevel = policy.minFeatureLevel;
+    }
 }
 
-// This method acquires the first available hardware adapter that supports Direct3D 12.
+// Loads the adapter cache, and saves it there when device creation learns something new.
+void DeviceResources::SetAdapterCacheFile(const wchar_t* fileName)
+{
+    m_adapterCacheFile = fileName ? fileName : L"";
+
+    if (!m_adapterCacheFile.empty())
+    {
+        std::ignore = m_adapterCache.Load(m_adapterCacheFile.c_str());
+    }
+}
+
+// This method acquires the hardware adapter chosen by the adapter policy, in a single pass over the
+// adapters. Devices are only created to probe support when the adapter cache can't answer.
 // If no such adapter can be found, try WARP. Otherwise throw an exception.
 void DeviceResources::GetAdapter(IDXGIAdapter1** ppAdapter)
 {
     *ppAdapter = nullptr;
 
-    ComPtr<IDXGIAdapter1> adapter;
+    std::vector<ComPtr<IDXGIAdapter1>> adapters;
+    std::vector<AdapterInfo> adapterInfo;
 
     ComPtr<IDXGIFactory6> factory6;
-    HRESULT hr = m_dxgiFactory.As(&factory6);
-    if (SUCCEEDED(hr))
+    const bool byPreference = SUCCEEDED(m_dxgiFactory.As(&factory6));
+
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT adapterIndex = 0;; ++adapterIndex)
     {
-        for (UINT adapterIndex = 0;
-            SUCCEEDED(factory6->EnumAdapterByGpuPreference(
+        const HRESULT hr = byPreference
+            ? factory6->EnumAdapterByGpuPreference(
                 adapterIndex,
                 DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE,
-                IID_PPV_ARGS(adapter.ReleaseAndGetAddressOf())));
-                adapterIndex++)
-        {
-            DXGI_ADAPTER_DESC1 desc;
-            ThrowIfFailed(adapter->GetDesc1(&desc));
+                IID_PPV_ARGS(adapter.ReleaseAndGetAddressOf()))
+            : m_dxgiFactory->EnumAdapters1(adapterIndex, adapter.ReleaseAndGetAddressOf());
+        if (FAILED(hr))
+            break;
 
-            if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-            {
-                // Don't select the Basic Render Driver adapter.
-                continue;
-            }
+        DXGI_ADAPTER_DESC1 desc;
+        ThrowIfFailed(adapter->GetDesc1(&desc));
 
-            // Check to see if the adapter supports Direct3D 12, but don't create the actual device yet.
-            if (SUCCEEDED(D3D12CreateDevice(adapter.Get(), m_d3dMinFeatureLevel, _uuidof(ID3D12Device), nullptr)))
-            {
-            #ifdef _DEBUG
-                wchar_t buff[256] = {};
-                swprintf_s(buff, L"Direct3D Adapter (%u): VID:%04X, PID:%04X - %ls\n", adapterIndex, desc.VendorId, desc.DeviceId, desc.Description);
-                OutputDebugStringW(buff);
-            #endif
-                break;
-            }
+        AdapterInfo info = {};
+        info.luid = desc.AdapterLuid;
+        info.vendorId = desc.VendorId;
+        info.deviceId = desc.DeviceId;
+        info.dedicatedVideoMemory = desc.DedicatedVideoMemory;
+        info.isSoftware = (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) != 0;
+
+        // Reports the user-mode driver version, which changes whenever the driver is updated.
+        LARGE_INTEGER umdVersion;
+        if (SUCCEEDED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umdVersion)))
+        {
+            info.driverVersion = static_cast<uint64_t>(umdVersion.QuadPart);
         }
+
+        adapters.emplace_back(adapter);
+        adapterInfo.push_back(info);
     }
 
-    if (!adapter)
-    {
-        for (UINT adapterIndex = 0;
-            SUCCEEDED(m_dxgiFactory->EnumAdapters1(
-                adapterIndex,
-                adapter.ReleaseAndGetAddressOf()));
-                ++adapterIndex)
-        {
-            DXGI_ADAPTER_DESC1 desc;
-            ThrowIfFailed(adapter->GetDesc1(&desc));
+    AdapterPolicy policy = m_adapterPolicy;
+    policy.minFeatureLevel = m_d3dMinFeatureLevel;
 
-            if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+    const int index = SelectAdapter(adapterInfo.data(), adapterInfo.size(), policy,
+        [&](size_t j) -> bool
+        {
+            const ADAPTER_SUPPORT cached = m_adapterCache.Find(adapterInfo[j], m_d3dMinFeatureLevel);
+            if (cached != AdapterSupport_Unknown)
             {
-                // Don't select the Basic Render Driver adapter.
-                continue;
+                ++m_deviceTimings.probesSkipped;
+                return cached == AdapterSupport_Yes;
             }
 
             // Check to see if the adapter supports Direct3D 12, but don't create the actual device yet.
-            if (SUCCEEDED(D3D12CreateDevice(adapter.Get(), m_d3dMinFeatureLevel, _uuidof(ID3D12Device), nullptr)))
-            {
-            #ifdef _DEBUG
-                wchar_t buff[256] = {};
-                swprintf_s(buff, L"Direct3D Adapter (%u): VID:%04X, PID:%04X - %ls\n", adapterIndex, desc.VendorId, desc.DeviceId, desc.Description);
-                OutputDebugStringW(buff);
-            #endif
-                break;
-            }
-        }
+            ++m_deviceTimings.adaptersProbed;
+            const bool supported = SUCCEEDED(D3D12CreateDevice(adapters[j].Get(), m_d3dMinFeatureLevel, _uuidof(ID3D12Device), nullptr));
+            m_adapterCache.Record(adapterInfo[j], m_d3dMinFeatureLevel, supported);
+            return supported;
+        });
+
+    adapter.Reset();
+    if (index >= 0)
+    {
+        adapter = adapters[size_t(index)];
+        m_adapterInfo = adapterInfo[size_t(index)];
+
+    #ifdef _DEBUG
+        DXGI_ADAPTER_DESC1 desc;
+        ThrowIfFailed(adapter->GetDesc1(&desc));
+
+        wchar_t buff[256] = {};
+        swprintf_s(buff, L"Direct3D Adapter (%d): VID:%04X, PID:%04X - %ls\n", index, desc.VendorId, desc.DeviceId, desc.Description);
+        OutputDebugStringW(buff);
+    #endif
     }
 
 #if !defined(NDEBUG)
@@ -702,6 +1213,13 @@ void DeviceResources::GetAdapter(IDXGIAdapter1** ppAdapter)
             throw std::runtime_error("WARP12 not available. Enable the 'Graphics Tools' optional feature");
         }
 
+        DXGI_ADAPTER_DESC1 desc;
+        ThrowIfFailed(adapter->GetDesc1(&desc));
+
+        m_adapterInfo = {};
+        m_adapterInfo.luid = desc.AdapterLuid;
+        m_adapterInfo.isSoftware = true;
+
         OutputDebugStringA("Direct3D Adapter - WARP12\n");
     }
 #endif
@@ -714,6 +1232,24 @@ void DeviceResources::GetAdapter(IDXGIAdapter1** ppAdapter)
     *ppAdapter = adapter.Detach();
 }
 
+// The flags must match between creating the swap chain and every ResizeBuffers call.
+UINT DeviceResources::GetSwapChainFlags() const noexcept
+{
+    UINT flags = 0;
+
+    if (m_options & c_AllowTearing)
+    {
+        flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    }
+
+    if (m_options & c_EnableFrameLatencyWaitable)
+    {
+        flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    }
+
+    return flags;
+}
+
 // Sets the color space for the swap chain in order to handle HDR output.
 void DeviceResources::UpdateColorSpace()
 {
@@ -724,6 +1260,8 @@ void DeviceResources::UpdateColorSpace()
     {
         // Output information is cached on the DXGI Factory. If it is stale we need to create a new factory.
         ThrowIfFailed(CreateDXGIFactory2(m_dxgiFactoryFlags, IID_PPV_ARGS(m_dxgiFactory.ReleaseAndGetAddressOf())));
+
+        m_outputTopologyValid = false;
     }
 
     DXGI_COLOR_SPACE_TYPE colorSpace = DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709;
@@ -741,52 +1279,24 @@ void DeviceResources::UpdateColorSpace()
         if (!GetWindowRect(m_window, &windowBounds))
             throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "GetWindowRect");
 
-        const long ax1 = windowBounds.left;
-        const long ay1 = windowBounds.top;
-        const long ax2 = windowBounds.right;
-        const long ay2 = windowBounds.bottom;
-
-        ComPtr<IDXGIOutput> bestOutput;
-        long bestIntersectArea = -1;
-
-        ComPtr<IDXGIAdapter> adapter;
-        for (UINT adapterIndex = 0;
-            SUCCEEDED(m_dxgiFactory->EnumAdapters(adapterIndex, adapter.ReleaseAndGetAddressOf()));
-            ++adapterIndex)
+        if (!m_outputTopologyValid)
         {
-            ComPtr<IDXGIOutput> output;
-            for (UINT outputIndex = 0;
-                SUCCEEDED(adapter->EnumOutputs(outputIndex, output.ReleaseAndGetAddressOf()));
-                ++outputIndex)
-            {
-                // Get the rectangle bounds of current output.
-                DXGI_OUTPUT_DESC desc;
-                ThrowIfFailed(output->GetDesc(&desc));
-                const auto& r = desc.DesktopCoordinates;
-
-                // Compute the intersection
-                const long intersectArea = ComputeIntersectionArea(ax1, ay1, ax2, ay2, r.left, r.top, r.right, r.bottom);
-                if (intersectArea > bestIntersectArea)
-                {
-                    bestOutput.Swap(output);
-                    bestIntersectArea = intersectArea;
-                }
-            }
+            UpdateOutputTopology();
         }
 
-        if (bestOutput)
+        // Moving the window only needs a lookup over the cached desktop rects.
+        long bestIntersectArea = -1;
+        for (const auto& output : m_outputs)
         {
-            ComPtr<IDXGIOutput6> output6;
-            if (SUCCEEDED(bestOutput.As(&output6)))
-            {
-                DXGI_OUTPUT_DESC1 desc;
-                ThrowIfFailed(output6->GetDesc1(&desc));
+            const auto& r = output.desktopCoordinates;
 
-                if (desc.ColorSpace == DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020)
-                {
-                    // Display output is HDR10.
-                    isDisplayHDR10 = true;
-                }
+            const long intersectArea = ComputeIntersectionArea(
+                windowBounds.left, windowBounds.top, windowBounds.right, windowBounds.bottom,
+                r.left, r.top, r.right, r.bottom);
+            if (intersectArea > bestIntersectArea)
+            {
+                isDisplayHDR10 = output.isHDR10;
+                bestIntersectArea = intersectArea;
             }
         }
     }
@@ -810,6 +1320,9 @@ void DeviceResources::UpdateColorSpace()
         }
     }
 
+    if (colorSpace == m_colorSpace && m_colorSpaceApplied)
+        return;
+
     m_colorSpace = colorSpace;
 
     UINT colorSpaceSupport = 0;
@@ -819,4 +1332,46 @@ void DeviceResources::UpdateColorSpace()
     {
         ThrowIfFailed(m_swapChain->SetColorSpace1(colorSpace));
     }
+
+    m_colorSpaceApplied = true;
+}
+
+// Caches the desktop rectangle and HDR capability of every output. Only needs to run again when
+// the factory goes stale or the display configuration changes.
+void DeviceResources::UpdateOutputTopology()
+{
+    m_outputs.clear();
+
+    ComPtr<IDXGIAdapter> adapter;
+    for (UINT adapterIndex = 0;
+        SUCCEEDED(m_dxgiFactory->EnumAdapters(adapterIndex, adapter.ReleaseAndGetAddressOf()));
+        ++adapterIndex)
+    {
+        ComPtr<IDXGIOutput> output;
+        for (UINT outputIndex = 0;
+            SUCCEEDED(adapter->EnumOutputs(outputIndex, output.ReleaseAndGetAddressOf()));
+            ++outputIndex)
+        {
+            // Get the rectangle bounds of current output.
+            DXGI_OUTPUT_DESC desc;
+            ThrowIfFailed(output->GetDesc(&desc));
+
+            OutputInfo info = {};
+            info.desktopCoordinates = desc.DesktopCoordinates;
+
+            ComPtr<IDXGIOutput6> output6;
+            if (SUCCEEDED(output.As(&output6)))
+            {
+                DXGI_OUTPUT_DESC1 desc1;
+                ThrowIfFailed(output6->GetDesc1(&desc1));
+
+                // Display output is HDR10.
+                info.isHDR10 = (desc1.ColorSpace == DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020);
+            }
+
+            m_outputs.push_back(info);
+        }
+    }
+
+    m_outputTopologyValid = true;
 }
@@ -4,6 +4,12 @@
 
 #pragma once
 
+#include "AdapterSelection.h"
+#include "CommandAllocatorPool.h"
+#include "CommandQueueSync.h"
+#include "FenceTimeline.h"
+#include "HeapAllocator.h"
+
 namespace DX
 {
     // Provides an interface for an application that owns DeviceResources to be notified of the device being lost or created.
@@ -20,14 +26,29 @@ namespace DX
     class DeviceResources
     {
     public:
+        // Milliseconds spent in each phase of the last CreateDeviceResources call.
+        struct DeviceCreationTimings
+        {
+            double      factory;            // Debug layer, DXGI factory, and tearing support
+            double      adapterSelection;   // Enumeration, and probes the cache couldn't answer
+            double      deviceCreation;     // D3D12CreateDevice on the selected adapter
+            double      deviceSetup;        // Queues, heaps, command lists, and fences
+            double      total;
+            uint32_t    adaptersProbed;
+            uint32_t    probesSkipped;      // Answered by the adapter cache
+        };
+
         static constexpr unsigned int c_AllowTearing = 0x1;
         static constexpr unsigned int c_EnableHDR = 0x2;
+        static constexpr unsigned int c_EnableAsyncCompute = 0x4;
+        static constexpr unsigned int c_EnableFrameLatencyWaitable = 0x8;
 
         DeviceResources(DXGI_FORMAT backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM,
             DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D32_FLOAT,
             UINT backBufferCount = 2,
             D3D_FEATURE_LEVEL minFeatureLevel = D3D_FEATURE_LEVEL_11_0,
-            unsigned int flags = 0) noexcept(false);
+            unsigned int flags = 0,
+            UINT framesInFlight = 0) noexcept(false);
         ~DeviceResources();
 
         DeviceResources(DeviceResources&&) = default;
@@ -40,6 +61,14 @@ namespace DX
         void CreateWindowSizeDependentResources();
         void SetWindow(HWND window, int width, int height) noexcept;
         bool WindowSizeChanged(int width, int height);
+
+        // Resize coalescing. Requested sizes are merged and applied at most once per frame by
+        // ApplyPendingWindowSize. During a live resize they are held back, and the old back
+        // buffers are stretched to fit the window, so the GPU is flushed once when it ends.
+        void RequestWindowSize(int width, int height) noexcept;
+        void SetLiveResize(bool liveResize) noexcept { m_liveResize = liveResize; }
+        bool ApplyPendingWindowSize();
+        bool IsResizePending() const noexcept { return m_resizeRequests != 0; }
         void HandleDeviceLost();
         void RegisterDeviceNotify(IDeviceNotify* deviceNotify) noexcept { m_deviceNotify = deviceNotify; }
         void Prepare(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_PRESENT,
@@ -48,6 +77,29 @@ namespace DX
         void WaitForGpu() noexcept;
         void UpdateColorSpace();
 
+        // Adapter selection; call before CreateDeviceResources. The cache file remembers probe
+        // results across runs, keyed by adapter LUID and driver version.
+        void SetAdapterPolicy(const AdapterPolicy& policy) noexcept;
+        void SetAdapterCacheFile(_In_opt_z_ const wchar_t* fileName);
+        const DeviceCreationTimings& GetDeviceCreationTimings() const noexcept { return m_deviceTimings; }
+        void InvalidateOutputTopology() noexcept { m_outputTopologyValid = false; }
+
+        // Frame latency, available when created with c_EnableFrameLatencyWaitable. Waiting blocks
+        // until the swap chain can queue another frame, so input can be read as late as possible.
+        void SetMaximumFrameLatency(UINT maxLatency);
+        bool WaitForFrameLatency(DWORD timeoutMs = 1000) noexcept;
+
+        // Cross-queue fencing. Signal after submitting work to a queue; the returned value can be
+        // polled on the CPU, or waited on by another queue on the GPU before it uses the results.
+        UINT64 SignalQueue(COMMAND_QUEUE_TYPE queue);
+        bool IsFenceComplete(COMMAND_QUEUE_TYPE queue, UINT64 fenceValue);
+        void QueueWait(COMMAND_QUEUE_TYPE queue, COMMAND_QUEUE_TYPE sourceQueue, UINT64 fenceValue);
+
+        // Async compute, available when created with c_EnableAsyncCompute. Execute submits the list
+        // and returns the compute fence value which marks its completion.
+        ID3D12GraphicsCommandList* BeginComputeCommandList();
+        UINT64 ExecuteComputeCommandList();
+
         // Device Accessors.
         RECT GetOutputSize() const noexcept { return m_outputSize; }
 
@@ -57,17 +109,30 @@ namespace DX
         auto                        GetDXGIFactory() const noexcept { return m_dxgiFactory.Get(); }
         HWND                        GetWindow() const noexcept { return m_window; }
         D3D_FEATURE_LEVEL           GetDeviceFeatureLevel() const noexcept { return m_d3dFeatureLevel; }
+        const AdapterInfo&          GetAdapterInfo() const noexcept { return m_adapterInfo; }
         ID3D12Resource*             GetRenderTarget() const noexcept { return m_renderTargets[m_backBufferIndex].Get(); }
         ID3D12Resource*             GetDepthStencil() const noexcept { return m_depthStencil.Get(); }
+        ResourceHeapAllocator*      GetResourceHeapAllocator() const noexcept { return m_heapAllocator.get(); }
         ID3D12CommandQueue*         GetCommandQueue() const noexcept { return m_commandQueue.Get(); }
-        ID3D12CommandAllocator*     GetCommandAllocator() const noexcept { return m_commandAllocators[m_backBufferIndex].Get(); }
+        ID3D12CommandQueue*         GetCopyQueue() const noexcept { return m_copyQueue.Get(); }
+        ID3D12CommandQueue*         GetComputeQueue() const noexcept { return m_computeQueue.Get(); }
+        CommandQueueSync*           GetQueueSync() const noexcept { return m_queueSync.get(); }
+        FenceTimeline*              GetFenceTimeline(COMMAND_QUEUE_TYPE queue) const noexcept { return m_fenceTimelines[queue].get(); }
+        ID3D12CommandAllocator*     GetCommandAllocator() const noexcept { return m_commandAllocator; }
+        CommandAllocatorPool*       GetCommandAllocatorPool() const noexcept { return m_commandAllocatorPool.get(); }
         auto                        GetCommandList() const noexcept { return m_commandList.Get(); }
+        ID3D12GraphicsCommandList*  GetWorkerCommandList(unsigned int index);
         DXGI_FORMAT                 GetBackBufferFormat() const noexcept { return m_backBufferFormat; }
         DXGI_FORMAT                 GetDepthBufferFormat() const noexcept { return m_depthBufferFormat; }
         D3D12_VIEWPORT              GetScreenViewport() const noexcept { return m_screenViewport; }
         D3D12_RECT                  GetScissorRect() const noexcept { return m_scissorRect; }
-        UINT                        GetCurrentFrameIndex() const noexcept { return m_backBufferIndex; }
+        UINT                        GetCurrentFrameIndex() const noexcept { return m_frameIndex; }
+        UINT                        GetCurrentBackBufferIndex() const noexcept { return m_backBufferIndex; }
         UINT                        GetBackBufferCount() const noexcept { return m_backBufferCount; }
+        UINT                        GetFramesInFlight() const noexcept { return m_framesInFlight; }
+        UINT                        GetMaximumFrameLatency() const noexcept { return m_maxFrameLatency; }
+        UINT64                      GetCompletedFenceValue() const noexcept { return m_fence->GetCompletedValue(); }
+        UINT64                      GetCurrentFenceValue() const noexcept { return m_fenceValues[m_frameIndex]; }
         DXGI_COLOR_SPACE_TYPE       GetColorSpace() const noexcept { return m_colorSpace; }
         unsigned int                GetDeviceOptions() const noexcept { return m_options; }
 
@@ -84,28 +149,61 @@ namespace DX
 
     private:
         void MoveToNextFrame();
+        void ReportGpuTimeout(COMMAND_QUEUE_TYPE queue, UINT64 fenceValue) noexcept;
         void GetAdapter(IDXGIAdapter1** ppAdapter);
+        UINT GetSwapChainFlags() const noexcept;
+        void UpdateOutputTopology();
 
         static constexpr size_t MAX_BACK_BUFFER_COUNT = 3;
+        static constexpr size_t MAX_FRAMES_IN_FLIGHT = 3;
+        static constexpr size_t MAX_WORKER_COMMAND_LISTS = 16;
 
         UINT                                                m_backBufferIndex;
+        UINT                                                m_frameIndex;
 
         // Direct3D objects.
         Microsoft::WRL::ComPtr<ID3D12Device>                m_d3dDevice;
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>   m_commandList;
         Microsoft::WRL::ComPtr<ID3D12CommandQueue>          m_commandQueue;
-        Microsoft::WRL::ComPtr<ID3D12CommandAllocator>      m_commandAllocators[MAX_BACK_BUFFER_COUNT];
+        std::unique_ptr<CommandAllocatorPool>               m_commandAllocatorPool;
+        ID3D12CommandAllocator*                             m_commandAllocator;
+
+        // Additional command lists which can be recorded on other threads, submitted after m_commandList.
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>   m_workerCommandLists[MAX_WORKER_COMMAND_LISTS];
+        ID3D12CommandAllocator*                             m_workerCommandAllocators[MAX_WORKER_COMMAND_LISTS];
+        uint32_t                                            m_workerCommandListMask;
 
         // Swap chain objects.
         Microsoft::WRL::ComPtr<IDXGIFactory4>               m_dxgiFactory;
         Microsoft::WRL::ComPtr<IDXGISwapChain3>             m_swapChain;
         Microsoft::WRL::ComPtr<ID3D12Resource>              m_renderTargets[MAX_BACK_BUFFER_COUNT];
         Microsoft::WRL::ComPtr<ID3D12Resource>              m_depthStencil;
+        Microsoft::WRL::Wrappers::Event                     m_frameLatencyWaitableObject;
+        PlacedAllocation                                    m_depthStencilAllocation;
+
+        // Placed-resource heaps for render targets and buffers.
+        std::unique_ptr<ResourceHeapAllocator>              m_heapAllocator;
 
-        // Presentation fence objects.
+        // Presentation fence objects, indexed by frame slot rather than back buffer.
         Microsoft::WRL::ComPtr<ID3D12Fence>                 m_fence;
-        UINT64                                              m_fenceValues[MAX_BACK_BUFFER_COUNT];
-        Microsoft::WRL::Wrappers::Event                     m_fenceEvent;
+        UINT64                                              m_fenceValues[MAX_FRAMES_IN_FLIGHT];
+
+        // Copy queue for asynchronous uploads.
+        Microsoft::WRL::ComPtr<ID3D12CommandQueue>          m_copyQueue;
+        Microsoft::WRL::ComPtr<ID3D12Fence>                 m_copyFence;
+
+        // Optional compute queue for work which can overlap with graphics.
+        Microsoft::WRL::ComPtr<ID3D12CommandQueue>          m_computeQueue;
+        Microsoft::WRL::ComPtr<ID3D12Fence>                 m_computeFence;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>   m_computeCommandList;
+        ID3D12CommandAllocator*                             m_computeCommandAllocator;
+
+        // Fence values and waits across all of the above queues.
+        std::unique_ptr<ICommandQueueBackend>               m_queueBackend;
+        std::unique_ptr<CommandQueueSync>                   m_queueSync;
+
+        // Completion tracking, deferred releases, and bounded waits for each queue's fence.
+        std::unique_ptr<FenceTimeline>                      m_fenceTimelines[CommandQueue_Count];
 
         // Direct3D rendering objects.
         Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>        m_rtvDescriptorHeap;
@@ -118,6 +216,8 @@ namespace DX
         DXGI_FORMAT                                         m_backBufferFormat;
         DXGI_FORMAT                                         m_depthBufferFormat;
         UINT                                                m_backBufferCount;
+        UINT                                                m_framesInFlight;
+        UINT                                                m_maxFrameLatency;
         D3D_FEATURE_LEVEL                                   m_d3dMinFeatureLevel;
 
         // Cached device properties.
@@ -126,8 +226,32 @@ namespace DX
         DWORD                                               m_dxgiFactoryFlags;
         RECT                                                m_outputSize;
 
+        // Pending window size, applied at the next frame boundary.
+        int                                                 m_pendingWidth;
+        int                                                 m_pendingHeight;
+        uint32_t                                            m_resizeRequests;
+        bool                                                m_liveResize;
+
         // HDR Support
         DXGI_COLOR_SPACE_TYPE                               m_colorSpace;
+        bool                                                m_colorSpaceApplied;
+
+        // Cached output topology, so finding the output under the window doesn't enumerate adapters.
+        struct OutputInfo
+        {
+            RECT    desktopCoordinates;
+            bool    isHDR10;
+        };
+
+        std::vector<OutputInfo>                             m_outputs;
+        bool                                                m_outputTopologyValid;
+
+        // Adapter selection and startup timing.
+        AdapterPolicy                                       m_adapterPolicy;
+        AdapterCache                                        m_adapterCache;
+        std::wstring                                        m_adapterCacheFile;
+        AdapterInfo                                         m_adapterInfo;
+        DeviceCreationTimings                               m_deviceTimings;
 
         // DeviceResources options (see flags above)
         unsigned int                                        m_options;
@@ -0,0 +1,785 @@
+//
+// DynamicBVH.h - Bounding volume hierarchy over moving boxes, for culling, picking and proximity
+//
+
+#pragma once
+
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+namespace DX
+{
+    // A binary tree of axis-aligned boxes with one leaf per object, kept free of Direct3D so it can
+    // be run on the CPU alone. Leaves are inserted where they add the least surface area, and the
+    // tree is rebalanced by rotations on the way back up, so its height stays logarithmic as
+    // objects come and go. Frustum, ray and nearest-object queries descend only into the boxes
+    // which can contribute.
+    //
+    // Objects which move keep their place in the tree: Move refits the boxes above one leaf, or
+    // SetBox followed by Refit updates many at once in a single pass. Refitting never changes the
+    // shape of the tree, so once objects have moved far from where they were inserted, Rebuild
+    // rebuilds it from scratch. Leaf handles stay valid across all of these.
+    class DynamicBVH
+    {
+    public:
+        using Handle = uint32_t;
+
+        static constexpr Handle c_InvalidHandle = UINT32_MAX;
+
+        struct Box
+        {
+            float   lower[3];
+            float   upper[3];
+        };
+
+        DynamicBVH() noexcept :
+            m_root(c_InvalidHandle),
+            m_free(c_InvalidHandle),
+            m_leafCount(0)
+        {
+        }
+
+        DynamicBVH(DynamicBVH&&) = default;
+        DynamicBVH& operator= (DynamicBVH&&) = default;
+
+        DynamicBVH(DynamicBVH const&) = default;
+        DynamicBVH& operator= (DynamicBVH const&) = default;
+
+        void Clear() noexcept
+        {
+            m_nodes.clear();
+            m_root = c_InvalidHandle;
+            m_free = c_InvalidHandle;
+            m_leafCount = 0;
+        }
+
+        // Adds an object; value is returned with it by GetValue.
+        Handle Insert(const Box& box, uint32_t value)
+        {
+            const Handle leaf = Allocate();
+            auto& node = m_nodes[leaf];
+            node.box = box;
+            node.height = 0;
+            node.value = value;
+
+            InsertLeaf(leaf);
+            ++m_leafCount;
+            return leaf;
+        }
+
+        void Remove(Handle leaf)
+        {
+            CheckLeaf(leaf);
+            RemoveLeaf(leaf);
+            Release(leaf);
+            --m_leafCount;
+        }
+
+        // Replaces an object's box and refits the boxes above it, stopping once they no longer change.
+        void Move(Handle leaf, const Box& box)
+        {
+            CheckLeaf(leaf);
+            m_nodes[leaf].box = box;
+
+            for (Handle index = m_nodes[leaf].parent; index != c_InvalidHandle; index = m_nodes[index].parent)
+            {
+                auto& node = m_nodes[index];
+                const Box refit = Union(m_nodes[node.child1].box, m_nodes[node.child2].box);
+                if (Equal(refit, node.box))
+                    break;
+
+                node.box = refit;
+            }
+        }
+
+        // Replaces an object's box without touching the rest of the tree: call Refit before the
+        // next query.
+        void SetBox(Handle leaf, const Box& box)
+        {
+            CheckLeaf(leaf);
+            m_nodes[leaf].box = box;
+        }
+
+        // Recomputes every internal box from its children, children first.
+        void Refit()
+        {
+            m_order.clear();
+            if (m_root != c_InvalidHandle && !IsLeaf(m_root))
+            {
+                m_order.push_back(m_root);
+            }
+
+            // Parents come before their children in m_order, so walking it backward refits bottom up.
+            for (size_t j = 0; j < m_order.size(); ++j)
+            {
+                const auto& node = m_nodes[m_order[j]];
+                if (!IsLeaf(node.child1))
+                {
+                    m_order.push_back(node.child1);
+                }
+                if (!IsLeaf(node.child2))
+                {
+                    m_order.push_back(node.child2);
+                }
+            }
+
+            for (auto it = m_order.crbegin(); it != m_order.crend(); ++it)
+            {
+                auto& node = m_nodes[*it];
+                node.box = Union(m_nodes[node.child1].box, m_nodes[node.child2].box);
+            }
+        }
+
+        // Rebuilds the tree over the current leaves, top down, splitting each set of leaves at the
+        // median of their centers along the longest axis. The result has the least height possible.
+        void Rebuild()
+        {
+            m_order.clear();
+            m_free = c_InvalidHandle;
+            for (size_t j = m_nodes.size(); j-- > 0; )
+            {
+                if (m_nodes[j].height == 0)
+                {
+                    m_order.push_back(static_cast<Handle>(j));
+                }
+                else
+                {
+                    Release(static_cast<Handle>(j));
+                }
+            }
+
+            m_root = m_order.empty() ? c_InvalidHandle : Build(0, m_order.size());
+            if (m_root != c_InvalidHandle)
+            {
+                m_nodes[m_root].parent = c_InvalidHandle;
+            }
+        }
+
+        // Calls visit(leaf) for every object whose box is at least partly inside the frustum.
+        template<typename F>
+        void QueryFrustum(const Frustum& frustum, F&& visit) const
+        {
+            if (m_root == c_InvalidHandle)
+                return;
+
+            // Along with each node, the planes its box still straddles: once inside all of them,
+            // everything below is visible without further tests.
+            Stack<std::pair<Handle, unsigned int>> stack;
+            stack.Push(std::make_pair(m_root, 0x3Fu));
+
+            while (!stack.Empty())
+            {
+                const auto entry = stack.Pop();
+                const auto& node = m_nodes[entry.first];
+
+                unsigned int planes = entry.second;
+                bool outside = false;
+                for (unsigned int p = 0; p < 6 && planes; ++p)
+                {
+                    if (!(planes & (1u << p)))
+                        continue;
+
+                    float center = frustum.planes[p][3];
+                    float radius = 0.f;
+                    for (size_t j = 0; j < 3; ++j)
+                    {
+                        center += frustum.planes[p][j] * (node.box.lower[j] + node.box.upper[j]) * 0.5f;
+                        radius += std::fabs(frustum.planes[p][j]) * (node.box.upper[j] - node.box.lower[j]) * 0.5f;
+                    }
+
+                    if (center + radius < 0.f)
+                    {
+                        outside = true;
+                        break;
+                    }
+
+                    if (center - radius >= 0.f)
+                    {
+                        planes &= ~(1u << p);
+                    }
+                }
+
+                if (outside)
+                    continue;
+
+                if (IsLeaf(entry.first))
+                {
+                    visit(entry.first);
+                }
+                else
+                {
+                    stack.Push(std::make_pair(node.child2, planes));
+                    stack.Push(std::make_pair(node.child1, planes));
+                }
+            }
+        }
+
+        void QueryFrustum(const Frustum& frustum, std::vector<Handle>& leaves) const
+        {
+            leaves.clear();
+            QueryFrustum(frustum, [&](Handle leaf) { leaves.push_back(leaf); });
+        }
+
+        // Finds the object the ray hits first within maxDistance, or returns c_InvalidHandle.
+        // hit(leaf, boxDistance) returns the distance along the ray of the object itself, or a
+        // negative value for a miss; returning boxDistance treats the box as the object. Boxes are
+        // visited nearest first, and those beyond the closest hit so far are skipped.
+        template<typename F>
+        Handle Raycast(const float (&origin)[3], const float (&direction)[3], float maxDistance, float& distance, F&& hit) const
+        {
+            distance = maxDistance;
+            if (m_root == c_InvalidHandle)
+                return c_InvalidHandle;
+
+            float inverse[3];
+            for (size_t j = 0; j < 3; ++j)
+            {
+                inverse[j] = 1.f / direction[j];
+            }
+
+            Handle result = c_InvalidHandle;
+
+            Stack<std::pair<Handle, float>> stack;
+            float enter;
+            if (IntersectRay(m_nodes[m_root].box, origin, inverse, distance, enter))
+            {
+                stack.Push(std::make_pair(m_root, enter));
+            }
+
+            while (!stack.Empty())
+            {
+                const auto entry = stack.Pop();
+                if (entry.second > distance)
+                    continue;
+
+                const auto& node = m_nodes[entry.first];
+                if (IsLeaf(entry.first))
+                {
+                    const float t = hit(entry.first, entry.second);
+                    if (t >= 0.f && t <= distance)
+                    {
+                        distance = t;
+                        result = entry.first;
+                    }
+                    continue;
+                }
+
+                float enter1 = 0.f;
+                float enter2 = 0.f;
+                const bool hit1 = IntersectRay(m_nodes[node.child1].box, origin, inverse, distance, enter1);
+                const bool hit2 = IntersectRay(m_nodes[node.child2].box, origin, inverse, distance, enter2);
+
+                // The nearer child goes on top.
+                if (hit1 && hit2)
+                {
+                    if (enter1 <= enter2)
+                    {
+                        stack.Push(std::make_pair(node.child2, enter2));
+                        stack.Push(std::make_pair(node.child1, enter1));
+                    }
+                    else
+                    {
+                        stack.Push(std::make_pair(node.child1, enter1));
+                        stack.Push(std::make_pair(node.child2, enter2));
+                    }
+                }
+                else if (hit1)
+                {
+                    stack.Push(std::make_pair(node.child1, enter1));
+                }
+                else if (hit2)
+                {
+                    stack.Push(std::make_pair(node.child2, enter2));
+                }
+            }
+
+            return result;
+        }
+
+        Handle Raycast(const float (&origin)[3], const float (&direction)[3], float maxDistance, float& distance) const
+        {
+            return Raycast(origin, direction, maxDistance, distance, [](Handle, float boxDistance) { return boxDistance; });
+        }
+
+        // Finds the object whose box is nearest point (zero if inside it), or returns
+        // c_InvalidHandle if there are none.
+        Handle Nearest(const float (&point)[3], float& distance) const
+        {
+            distance = std::numeric_limits<float>::infinity();
+            if (m_root == c_InvalidHandle)
+                return c_InvalidHandle;
+
+            Handle result = c_InvalidHandle;
+            float best = distance;
+
+            Stack<std::pair<Handle, float>> stack;
+            stack.Push(std::make_pair(m_root, DistanceSquared(m_nodes[m_root].box, point)));
+
+            while (!stack.Empty())
+            {
+                const auto entry = stack.Pop();
+                if (entry.second >= best)
+                    continue;
+
+                const auto& node = m_nodes[entry.first];
+                if (IsLeaf(entry.first))
+                {
+                    best = entry.second;
+                    result = entry.first;
+                    continue;
+                }
+
+                const float distance1 = DistanceSquared(m_nodes[node.child1].box, point);
+                const float distance2 = DistanceSquared(m_nodes[node.child2].box, point);
+
+                if (distance1 <= distance2)
+                {
+                    stack.Push(std::make_pair(node.child2, distance2));
+                    stack.Push(std::make_pair(node.child1, distance1));
+                }
+                else
+                {
+                    stack.Push(std::make_pair(node.child1, distance1));
+                    stack.Push(std::make_pair(node.child2, distance2));
+                }
+            }
+
+            distance = std::sqrt(best);
+            return result;
+        }
+
+        uint32_t GetValue(Handle leaf) const { CheckLeaf(leaf); return m_nodes[leaf].value; }
+        const Box& GetBox(Handle leaf) const { CheckLeaf(leaf); return m_nodes[leaf].box; }
+
+        uint32_t GetLeafCount() const noexcept { return m_leafCount; }
+        int32_t GetHeight() const noexcept { return m_root == c_InvalidHandle ? 0 : m_nodes[m_root].height; }
+
+        static Box Union(const Box& a, const Box& b) noexcept
+        {
+            Box box;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                box.lower[j] = std::min(a.lower[j], b.lower[j]);
+                box.upper[j] = std::max(a.upper[j], b.upper[j]);
+            }
+            return box;
+        }
+
+        static float SurfaceArea(const Box& box) noexcept
+        {
+            const float x = box.upper[0] - box.lower[0];
+            const float y = box.upper[1] - box.lower[1];
+            const float z = box.upper[2] - box.lower[2];
+            return 2.f * (x * y + y * z + z * x);
+        }
+
+    private:
+        struct Node
+        {
+            Box         box;
+            Handle      parent = c_InvalidHandle;       // Next free node, while on the free list
+            Handle      child1 = c_InvalidHandle;
+            Handle      child2 = c_InvalidHandle;
+            int32_t     height = -1;                    // Zero for leaves, -1 while free
+            uint32_t    value = 0;
+        };
+
+        // A traversal stack which only allocates for trees deeper than any balanced one gets.
+        template<typename T>
+        class Stack
+        {
+        public:
+            Stack() noexcept : m_count(0) {}
+
+            bool Empty() const noexcept { return !m_count; }
+
+            void Push(const T& value)
+            {
+                if (m_count < c_Inline)
+                {
+                    m_inline[m_count] = value;
+                }
+                else
+                {
+                    m_overflow.push_back(value);
+                }
+                ++m_count;
+            }
+
+            T Pop()
+            {
+                --m_count;
+                if (m_count < c_Inline)
+                    return m_inline[m_count];
+
+                const T value = m_overflow.back();
+                m_overflow.pop_back();
+                return value;
+            }
+
+        private:
+            static constexpr size_t c_Inline = 128;
+
+            T               m_inline[c_Inline];
+            std::vector<T>  m_overflow;
+            size_t          m_count;
+        };
+
+        bool IsLeaf(Handle index) const noexcept { return m_nodes[index].child1 == c_InvalidHandle; }
+
+        void CheckLeaf(Handle leaf) const
+        {
+            if (leaf >= m_nodes.size() || m_nodes[leaf].height != 0)
+            {
+                throw std::out_of_range("DynamicBVH: invalid handle");
+            }
+        }
+
+        static bool Equal(const Box& a, const Box& b) noexcept
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                if (a.lower[j] != b.lower[j] || a.upper[j] != b.upper[j])
+                    return false;
+            }
+            return true;
+        }
+
+        // Slab test, returning where the ray enters the box if it does so before maxDistance.
+        static bool IntersectRay(const Box& box, const float (&origin)[3], const float (&inverse)[3], float maxDistance, float& enter) noexcept
+        {
+            float first = 0.f;
+            float last = maxDistance;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                float t1 = (box.lower[j] - origin[j]) * inverse[j];
+                float t2 = (box.upper[j] - origin[j]) * inverse[j];
+                if (t1 > t2)
+                {
+                    std::swap(t1, t2);
+                }
+
+                // Written so that a NaN (a ray in the plane of a face) leaves the interval as is.
+                first = t1 > first ? t1 : first;
+                last = t2 < last ? t2 : last;
+                if (first > last)
+                    return false;
+            }
+
+            enter = first;
+            return true;
+        }
+
+        static float DistanceSquared(const Box& box, const float (&point)[3]) noexcept
+        {
+            float distance = 0.f;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const float d = std::max(std::max(box.lower[j] - point[j], point[j] - box.upper[j]), 0.f);
+                distance += d * d;
+            }
+            return distance;
+        }
+
+        Handle Allocate()
+        {
+            if (m_free != c_InvalidHandle)
+            {
+                const Handle index = m_free;
+                m_free = m_nodes[index].parent;
+                m_nodes[index] = Node();
+                return index;
+            }
+
+            if (m_nodes.size() >= c_InvalidHandle)
+            {
+                throw std::length_error("DynamicBVH");
+            }
+
+            m_nodes.emplace_back();
+            return static_cast<Handle>(m_nodes.size() - 1);
+        }
+
+        void Release(Handle index) noexcept
+        {
+            auto& node = m_nodes[index];
+            node.parent = m_free;
+            node.child1 = c_InvalidHandle;
+            node.child2 = c_InvalidHandle;
+            node.height = -1;
+            m_free = index;
+        }
+
+        void InsertLeaf(Handle leaf)
+        {
+            if (m_root == c_InvalidHandle)
+            {
+                m_root = leaf;
+                m_nodes[leaf].parent = c_InvalidHandle;
+                return;
+            }
+
+            // Descend toward the sibling for which the tree's total surface area grows least.
+            const Box box = m_nodes[leaf].box;
+            Handle index = m_root;
+            while (!IsLeaf(index))
+            {
+                const auto& node = m_nodes[index];
+
+                const float area = SurfaceArea(node.box);
+                const float combined = SurfaceArea(Union(node.box, box));
+
+                // Pairing with this node makes a new parent; going lower grows this node's box.
+                const float cost = 2.f * combined;
+                const float inheritance = 2.f * (combined - area);
+
+                auto descend = [&](Handle child)
+                    {
+                        const auto& childBox = m_nodes[child].box;
+                        const float grown = SurfaceArea(Union(childBox, box));
+                        return (IsLeaf(child) ? grown : grown - SurfaceArea(childBox)) + inheritance;
+                    };
+
+                const float cost1 = descend(node.child1);
+                const float cost2 = descend(node.child2);
+
+                if (cost < cost1 && cost < cost2)
+                    break;
+
+                index = cost1 < cost2 ? node.child1 : node.child2;
+            }
+
+            const Handle sibling = index;
+            const Handle oldParent = m_nodes[sibling].parent;
+            const Handle newParent = Allocate();
+
+            auto& parent = m_nodes[newParent];
+            parent.parent = oldParent;
+            parent.box = Union(box, m_nodes[sibling].box);
+            parent.height = m_nodes[sibling].height + 1;
+            parent.child1 = sibling;
+            parent.child2 = leaf;
+
+            if (oldParent != c_InvalidHandle)
+            {
+                auto& grandparent = m_nodes[oldParent];
+                if (grandparent.child1 == sibling)
+                {
+                    grandparent.child1 = newParent;
+                }
+                else
+                {
+                    grandparent.child2 = newParent;
+                }
+            }
+            else
+            {
+                m_root = newParent;
+            }
+
+            m_nodes[sibling].parent = newParent;
+            m_nodes[leaf].parent = newParent;
+
+            FixUpward(m_nodes[leaf].parent);
+        }
+
+        void RemoveLeaf(Handle leaf)
+        {
+            if (leaf == m_root)
+            {
+                m_root = c_InvalidHandle;
+                return;
+            }
+
+            const Handle parent = m_nodes[leaf].parent;
+            const Handle grandparent = m_nodes[parent].parent;
+            const Handle sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+            m_nodes[sibling].parent = grandparent;
+            Release(parent);
+
+            if (grandparent == c_InvalidHandle)
+            {
+                m_root = sibling;
+                return;
+            }
+
+            auto& node = m_nodes[grandparent];
+            if (node.child1 == parent)
+            {
+                node.child1 = sibling;
+            }
+            else
+            {
+                node.child2 = sibling;
+            }
+
+            FixUpward(grandparent);
+        }
+
+        // Rebalances, then recomputes the heights and boxes, from index to the root.
+        void FixUpward(Handle index)
+        {
+            while (index != c_InvalidHandle)
+            {
+                index = Balance(index);
+
+                auto& node = m_nodes[index];
+                const auto& child1 = m_nodes[node.child1];
+                const auto& child2 = m_nodes[node.child2];
+                node.height = 1 + std::max(child1.height, child2.height);
+                node.box = Union(child1.box, child2.box);
+
+                index = node.parent;
+            }
+        }
+
+        // If the heights of a's children differ by more than one, rotates the taller child up into
+        // a's place, returning the node now at the top.
+        Handle Balance(Handle a)
+        {
+            auto& nodeA = m_nodes[a];
+            if (IsLeaf(a) || nodeA.height < 2)
+                return a;
+
+            const Handle b = nodeA.child1;
+            const Handle c = nodeA.child2;
+            const int32_t balance = m_nodes[c].height - m_nodes[b].height;
+
+            if (balance > 1)
+                return Rotate(a, c, false);
+
+            if (balance < -1)
+                return Rotate(a, b, true);
+
+            return a;
+        }
+
+        // Swaps a with its child up, whose taller child stays with it while the shorter one
+        // replaces up among a's children.
+        Handle Rotate(Handle a, Handle up, bool upIsChild1)
+        {
+            auto& nodeA = m_nodes[a];
+            auto& nodeUp = m_nodes[up];
+
+            const Handle f = nodeUp.child1;
+            const Handle g = nodeUp.child2;
+
+            nodeUp.child1 = a;
+            nodeUp.parent = nodeA.parent;
+            nodeA.parent = up;
+
+            if (nodeUp.parent != c_InvalidHandle)
+            {
+                auto& parent = m_nodes[nodeUp.parent];
+                if (parent.child1 == a)
+                {
+                    parent.child1 = up;
+                }
+                else
+                {
+                    parent.child2 = up;
+                }
+            }
+            else
+            {
+                m_root = up;
+            }
+
+            const bool keepF = m_nodes[f].height > m_nodes[g].height;
+            const Handle kept = keepF ? f : g;
+            const Handle moved = keepF ? g : f;
+
+            nodeUp.child2 = kept;
+            if (upIsChild1)
+            {
+                nodeA.child1 = moved;
+            }
+            else
+            {
+                nodeA.child2 = moved;
+            }
+            m_nodes[moved].parent = a;
+
+            const auto& child1 = m_nodes[nodeA.child1];
+            const auto& child2 = m_nodes[nodeA.child2];
+            nodeA.box = Union(child1.box, child2.box);
+            nodeA.height = 1 + std::max(child1.height, child2.height);
+
+            nodeUp.box = Union(nodeA.box, m_nodes[kept].box);
+            nodeUp.height = 1 + std::max(nodeA.height, m_nodes[kept].height);
+            return up;
+        }
+
+        // Builds a subtree over m_order[begin, end), returning its root.
+        Handle Build(size_t begin, size_t end)
+        {
+            if (end - begin == 1)
+                return m_order[begin];
+
+            Box centers = {};
+            for (size_t j = 0; j < 3; ++j)
+            {
+                centers.lower[j] = std::numeric_limits<float>::infinity();
+                centers.upper[j] = -std::numeric_limits<float>::infinity();
+            }
+
+            for (size_t k = begin; k < end; ++k)
+            {
+                const auto& box = m_nodes[m_order[k]].box;
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    const float center = box.lower[j] + box.upper[j];
+                    centers.lower[j] = std::min(centers.lower[j], center);
+                    centers.upper[j] = std::max(centers.upper[j], center);
+                }
+            }
+
+            size_t axis = 0;
+            for (size_t j = 1; j < 3; ++j)
+            {
+                if (centers.upper[j] - centers.lower[j] > centers.upper[axis] - centers.lower[axis])
+                {
+                    axis = j;
+                }
+            }
+
+            const size_t middle = begin + (end - begin) / 2;
+            std::nth_element(m_order.begin() + ptrdiff_t(begin), m_order.begin() + ptrdiff_t(middle), m_order.begin() + ptrdiff_t(end),
+                [this, axis](Handle x, Handle y)
+                {
+                    const auto& a = m_nodes[x].box;
+                    const auto& b = m_nodes[y].box;
+                    return a.lower[axis] + a.upper[axis] < b.lower[axis] + b.upper[axis];
+                });
+
+            const Handle child1 = Build(begin, middle);
+            const Handle child2 = Build(middle, end);
+
+            const Handle index = Allocate();
+            auto& node = m_nodes[index];
+            node.child1 = child1;
+            node.child2 = child2;
+            node.box = Union(m_nodes[child1].box, m_nodes[child2].box);
+            node.height = 1 + std::max(m_nodes[child1].height, m_nodes[child2].height);
+
+            m_nodes[child1].parent = index;
+            m_nodes[child2].parent = index;
+            return index;
+        }
+
+        std::vector<Node>       m_nodes;
+        std::vector<Handle>     m_order;            // Scratch for Refit and Rebuild
+        Handle                  m_root;
+        Handle                  m_free;
+        uint32_t                m_leafCount;
+    };
+}
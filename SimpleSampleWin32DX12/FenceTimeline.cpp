@@ -0,0 +1,129 @@
+//
+// FenceTimeline.cpp - Completion tracking, deferred release, and bounded waits for a D3D12 fence
+//
+
+#include "pch.h"
+#include "FenceTimeline.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+FenceTimeline::FenceTimeline(ID3D12Fence* fence) noexcept(false) :
+    m_fence(fence),
+    m_completedValue(0)
+{
+    if (!fence)
+    {
+        throw std::invalid_argument("FenceTimeline requires a fence");
+    }
+
+    m_event.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+    if (!m_event.IsValid())
+    {
+        throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
+    }
+
+    m_completedValue = fence->GetCompletedValue();
+}
+
+uint64_t FenceTimeline::GetCompletedValue() noexcept
+{
+    // A removed device reports UINT64_MAX, which completes everything.
+    const uint64_t completed = m_fence->GetCompletedValue();
+    if (completed > m_completedValue)
+    {
+        m_completedValue = completed;
+    }
+    return m_completedValue;
+}
+
+bool FenceTimeline::Wait(uint64_t value, DWORD timeoutMs) noexcept
+{
+    if (IsComplete(value))
+        return true;
+
+    if (FAILED(m_fence->SetEventOnCompletion(value, m_event.Get())))
+        return false;
+
+    if (WaitForSingleObjectEx(m_event.Get(), timeoutMs, FALSE) != WAIT_OBJECT_0)
+        return false;
+
+    std::ignore = GetCompletedValue();
+    return true;
+}
+
+bool FenceTimeline::WaitForAll(FenceTimeline* const* timelines, const uint64_t* values, size_t count, DWORD timeoutMs) noexcept
+{
+    HANDLE events[MAXIMUM_WAIT_OBJECTS] = {};
+    DWORD eventCount = 0;
+
+    for (size_t j = 0; j < count; ++j)
+    {
+        FenceTimeline* timeline = timelines[j];
+        if (!timeline || timeline->IsComplete(values[j]))
+            continue;
+
+        if (eventCount >= MAXIMUM_WAIT_OBJECTS
+            || FAILED(timeline->m_fence->SetEventOnCompletion(values[j], timeline->m_event.Get())))
+            return false;
+
+        events[eventCount++] = timeline->m_event.Get();
+    }
+
+    if (!eventCount)
+        return true;
+
+    const DWORD result = WaitForMultipleObjectsEx(eventCount, events, TRUE, timeoutMs, FALSE);
+    return result < WAIT_OBJECT_0 + eventCount;
+}
+
+void FenceTimeline::DeferRelease(uint64_t value, ComPtr<IUnknown> object)
+{
+    if (!object)
+        return;
+
+    Pending pending;
+    pending.object = std::move(object);
+    m_pending.emplace(value, std::move(pending));
+}
+
+void FenceTimeline::OnCompletion(uint64_t value, std::function<void()> callback)
+{
+    if (!callback)
+    {
+        throw std::invalid_argument("FenceTimeline::OnCompletion");
+    }
+
+    Pending pending;
+    pending.callback = std::move(callback);
+    m_pending.emplace(value, std::move(pending));
+}
+
+size_t FenceTimeline::Update()
+{
+    if (m_pending.empty())
+        return 0;
+
+    const uint64_t completed = GetCompletedValue();
+
+    // Move retired entries out first, since callbacks may attach new work to this timeline.
+    std::vector<Pending> retiring;
+
+    const auto end = m_pending.upper_bound(completed);
+    for (auto it = m_pending.begin(); it != end; ++it)
+    {
+        retiring.emplace_back(std::move(it->second));
+    }
+    m_pending.erase(m_pending.begin(), end);
+
+    for (auto& it : retiring)
+    {
+        if (it.callback)
+        {
+            it.callback();
+        }
+    }
+
+    return retiring.size();
+}
@@ -0,0 +1,73 @@
+//
+// FenceTimeline.h - Completion tracking, deferred release, and bounded waits for a D3D12 fence
+//
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+
+
+namespace DX
+{
+    // Tracks the completed value of one fence. Objects and callbacks can be attached to a fence
+    // value; Update releases or runs them once the GPU has reached it. Waits take a timeout, so a
+    // hung GPU is reported to the caller instead of blocking forever.
+    //
+    // Each timeline owns its own event, so waits on different fences can't interfere, and
+    // WaitForAll can wait on several fences at once.
+    class FenceTimeline
+    {
+    public:
+        static constexpr DWORD c_DefaultTimeout = 10000;
+
+        explicit FenceTimeline(ID3D12Fence* fence) noexcept(false);
+
+        FenceTimeline(FenceTimeline&&) = default;
+        FenceTimeline& operator= (FenceTimeline&&) = default;
+
+        FenceTimeline(FenceTimeline const&) = delete;
+        FenceTimeline& operator= (FenceTimeline const&) = delete;
+
+        ~FenceTimeline() = default;
+
+        // Non-blocking queries.
+        uint64_t GetCompletedValue() noexcept;
+        bool IsComplete(uint64_t value) noexcept { return value <= m_completedValue || GetCompletedValue() >= value; }
+
+        // Blocks until the fence reaches value. Returns false if the timeout elapsed first.
+        bool Wait(uint64_t value, DWORD timeoutMs = c_DefaultTimeout) noexcept;
+
+        // Blocks until every timeline reaches its value. Returns false if the timeout elapsed first.
+        static bool WaitForAll(
+            _In_reads_(count) FenceTimeline* const* timelines,
+            _In_reads_(count) const uint64_t* values,
+            size_t count,
+            DWORD timeoutMs = c_DefaultTimeout) noexcept;
+
+        // Keeps an object alive until the fence reaches value.
+        void DeferRelease(uint64_t value, Microsoft::WRL::ComPtr<IUnknown> object);
+
+        // Runs a callback from Update once the fence reaches value.
+        void OnCompletion(uint64_t value, std::function<void()> callback);
+
+        // Releases objects and runs callbacks for every completed value. Returns the number retired.
+        size_t Update();
+
+        size_t GetPendingCount() const noexcept { return m_pending.size(); }
+        ID3D12Fence* GetFence() const noexcept { return m_fence.Get(); }
+
+    private:
+        struct Pending
+        {
+            Microsoft::WRL::ComPtr<IUnknown>    object;
+            std::function<void()>               callback;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D12Fence>     m_fence;
+        Microsoft::WRL::Wrappers::Event         m_event;
+        uint64_t                                m_completedValue;
+        std::multimap<uint64_t, Pending>        m_pending;
+    };
+}
@@ -0,0 +1,494 @@
+//
+// FrameGraph.h - Declarative render pass scheduling with automatic barriers and transient aliasing
+//
+// The graph itself is CPU-only: passes declare which resources they read and write, and Compile()
+// culls passes whose results are never consumed, derives the resource state transitions between
+// passes, and computes transient resource lifetimes so that textures which are never alive at the
+// same time can share heap memory. FrameGraphExecutor turns the compiled result into Direct3D 12.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ID3D12GraphicsCommandList;
+struct ID3D12Resource;
+
+
+namespace DX
+{
+    // How a pass uses a resource. Read-only usages may be combined; write usages may not.
+    enum FRAMEGRAPH_ACCESS : uint32_t
+    {
+        FrameGraphAccess_None = 0x0,
+        FrameGraphAccess_RenderTarget = 0x1,
+        FrameGraphAccess_DepthWrite = 0x2,
+        FrameGraphAccess_UnorderedAccess = 0x4,
+        FrameGraphAccess_CopyDest = 0x8,
+        FrameGraphAccess_DepthRead = 0x10,
+        FrameGraphAccess_ShaderResource = 0x20,
+        FrameGraphAccess_CopySource = 0x40,
+        FrameGraphAccess_Present = 0x80,
+
+        FrameGraphAccess_WriteMask = 0xF,
+    };
+
+    inline FRAMEGRAPH_ACCESS operator|(FRAMEGRAPH_ACCESS a, FRAMEGRAPH_ACCESS b) noexcept
+    {
+        return static_cast<FRAMEGRAPH_ACCESS>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+    }
+
+    struct FrameGraphTextureDesc
+    {
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    format;         // DXGI_FORMAT
+        uint32_t    usage;          // All FRAMEGRAPH_ACCESS bits the texture will be used with
+        float       clearValue[4];  // Color, or depth in [0]
+    };
+
+    class FrameGraph
+    {
+    public:
+        using ResourceHandle = uint32_t;
+        using PassFunction = std::function<void(ID3D12GraphicsCommandList*)>;
+
+        static constexpr ResourceHandle c_InvalidHandle = UINT32_MAX;
+
+        // Placement requirements for a transient resource, supplied by the executor at compile time.
+        // Resources are only aliased with others in the same heap group.
+        struct MemoryRequirements
+        {
+            uint64_t    size;
+            uint64_t    alignment;
+            uint32_t    heapGroup;
+        };
+
+        using MemoryQuery = std::function<MemoryRequirements(const FrameGraphTextureDesc&)>;
+
+        // A state transition (before != after) or a UAV barrier (before == after == UnorderedAccess).
+        struct Barrier
+        {
+            ResourceHandle      resource;
+            FRAMEGRAPH_ACCESS   before;
+            FRAMEGRAPH_ACCESS   after;
+        };
+
+        struct Resource
+        {
+            std::string             name;
+            bool                    imported;
+            ID3D12Resource*         external;
+            FRAMEGRAPH_ACCESS       initialAccess;
+            FRAMEGRAPH_ACCESS       finalAccess;
+            FrameGraphTextureDesc   desc;
+
+            // Compile results
+            uint32_t                firstPass;      // Index into the execution order
+            uint32_t                lastPass;
+            MemoryRequirements      memory;
+            uint64_t                heapOffset;
+
+            bool IsUsed() const noexcept { return firstPass != UINT32_MAX; }
+        };
+
+        struct Pass
+        {
+            std::string                                         name;
+            std::vector<std::pair<ResourceHandle, FRAMEGRAPH_ACCESS>> accesses;
+            PassFunction                                        execute;
+            bool                                                sideEffects;
+
+            // Compile results
+            bool                                                culled;
+            std::vector<ResourceHandle>                         activations;    // Transients whose memory becomes live here
+            std::vector<Barrier>                                barriers;       // Recorded before execute
+            std::vector<Barrier>                                releases;       // Recorded after execute
+        };
+
+        // Passed to a pass's setup function to declare its resource usage.
+        class PassBuilder
+        {
+        public:
+            PassBuilder(FrameGraph& graph, Pass& pass) noexcept : m_graph(graph), m_pass(pass) {}
+
+            ResourceHandle Read(ResourceHandle resource, FRAMEGRAPH_ACCESS access = FrameGraphAccess_ShaderResource)
+            {
+                if (access & FrameGraphAccess_WriteMask)
+                    throw std::invalid_argument("Read requires a read-only access");
+
+                return Use(resource, access);
+            }
+
+            ResourceHandle Write(ResourceHandle resource, FRAMEGRAPH_ACCESS access = FrameGraphAccess_RenderTarget)
+            {
+                if (!(access & FrameGraphAccess_WriteMask))
+                    throw std::invalid_argument("Write requires a writable access");
+
+                return Use(resource, access);
+            }
+
+            ResourceHandle CreateTexture(const char* name, const FrameGraphTextureDesc& desc)
+            {
+                return m_graph.CreateTexture(name, desc);
+            }
+
+            // Keeps the pass alive even if nothing consumes its outputs (e.g. readback or UI).
+            void SetSideEffects() noexcept { m_pass.sideEffects = true; }
+
+        private:
+            ResourceHandle Use(ResourceHandle resource, FRAMEGRAPH_ACCESS access)
+            {
+                if (resource >= m_graph.m_resources.size())
+                    throw std::out_of_range("Invalid frame graph resource handle");
+
+                for (auto& it : m_pass.accesses)
+                {
+                    if (it.first == resource)
+                    {
+                        it.second = it.second | access;
+                        return resource;
+                    }
+                }
+
+                m_pass.accesses.emplace_back(resource, access);
+                return resource;
+            }
+
+            FrameGraph& m_graph;
+            Pass&       m_pass;
+        };
+
+        FrameGraph() noexcept = default;
+
+        FrameGraph(FrameGraph&&) = default;
+        FrameGraph& operator= (FrameGraph&&) = default;
+
+        FrameGraph(FrameGraph const&) = delete;
+        FrameGraph& operator= (FrameGraph const&) = delete;
+
+        // Clears all passes and resources so the graph can be declared again for the next frame.
+        void Reset() noexcept
+        {
+            m_passes.clear();
+            m_resources.clear();
+            m_order.clear();
+            m_finalBarriers.clear();
+            m_heapSizes.clear();
+            m_compiled = false;
+        }
+
+        // Brings an externally owned resource (e.g. the swap chain back buffer) into the graph.
+        ResourceHandle ImportResource(const char* name, ID3D12Resource* resource,
+            FRAMEGRAPH_ACCESS initialAccess, FRAMEGRAPH_ACCESS finalAccess)
+        {
+            Resource res = {};
+            res.name = name ? name : "";
+            res.imported = true;
+            res.external = resource;
+            res.initialAccess = initialAccess;
+            res.finalAccess = finalAccess;
+            return AddResource(std::move(res));
+        }
+
+        // Declares a transient texture whose memory is owned (and possibly aliased) by the graph.
+        ResourceHandle CreateTexture(const char* name, const FrameGraphTextureDesc& desc)
+        {
+            Resource res = {};
+            res.name = name ? name : "";
+            res.desc = desc;
+            return AddResource(std::move(res));
+        }
+
+        template<typename Setup>
+        void AddPass(const char* name, Setup&& setup, PassFunction execute)
+        {
+            m_passes.emplace_back();
+            Pass& pass = m_passes.back();
+            pass.name = name ? name : "";
+            pass.execute = std::move(execute);
+            pass.sideEffects = false;
+            pass.culled = false;
+
+            PassBuilder builder(*this, pass);
+            setup(builder);
+
+            m_compiled = false;
+        }
+
+        void Compile(const MemoryQuery& queryMemory)
+        {
+            CullPasses();
+            ComputeLifetimes();
+            ComputeBarriers();
+            AssignMemory(queryMemory);
+            m_compiled = true;
+        }
+
+        bool IsCompiled() const noexcept { return m_compiled; }
+
+        // Compile results.
+        const std::vector<uint32_t>& GetExecutionOrder() const noexcept { return m_order; }
+        const std::vector<Barrier>& GetFinalBarriers() const noexcept { return m_finalBarriers; }
+        const std::vector<uint64_t>& GetHeapSizes() const noexcept { return m_heapSizes; }
+
+        const Pass& GetPass(uint32_t index) const { return m_passes.at(index); }
+        const Resource& GetResource(ResourceHandle handle) const { return m_resources.at(handle); }
+        size_t GetPassCount() const noexcept { return m_passes.size(); }
+        size_t GetResourceCount() const noexcept { return m_resources.size(); }
+
+        size_t GetCulledPassCount() const noexcept
+        {
+            return m_passes.size() - m_order.size();
+        }
+
+        // Memory that would be required without aliasing, for comparison with GetHeapSizes().
+        uint64_t GetUnaliasedMemory() const noexcept
+        {
+            uint64_t total = 0;
+            for (const auto& res : m_resources)
+            {
+                if (!res.imported && res.IsUsed())
+                {
+                    total += res.memory.size;
+                }
+            }
+            return total;
+        }
+
+    private:
+        ResourceHandle AddResource(Resource&& res)
+        {
+            res.firstPass = res.lastPass = UINT32_MAX;
+            res.heapOffset = 0;
+            res.memory = {};
+            m_resources.emplace_back(std::move(res));
+            m_compiled = false;
+            return static_cast<ResourceHandle>(m_resources.size() - 1);
+        }
+
+        // Walks the passes backwards from the graph outputs (imported resources and passes with
+        // side effects); a pass survives only if something downstream consumes what it writes.
+        void CullPasses()
+        {
+            std::vector<bool> needed(m_resources.size(), false);
+            for (size_t j = 0; j < m_resources.size(); ++j)
+            {
+                needed[j] = m_resources[j].imported;
+            }
+
+            for (size_t j = m_passes.size(); j > 0; --j)
+            {
+                Pass& pass = m_passes[j - 1];
+
+                bool alive = pass.sideEffects;
+                for (const auto& it : pass.accesses)
+                {
+                    if ((it.second & FrameGraphAccess_WriteMask) && needed[it.first])
+                    {
+                        alive = true;
+                        break;
+                    }
+                }
+
+                pass.culled = !alive;
+
+                if (alive)
+                {
+                    for (const auto& it : pass.accesses)
+                    {
+                        needed[it.first] = true;
+                    }
+                }
+            }
+
+            m_order.clear();
+            for (uint32_t j = 0; j < m_passes.size(); ++j)
+            {
+                if (!m_passes[j].culled)
+                {
+                    m_order.push_back(j);
+                }
+            }
+        }
+
+        void ComputeLifetimes()
+        {
+            for (auto& res : m_resources)
+            {
+                res.firstPass = res.lastPass = UINT32_MAX;
+            }
+
+            for (uint32_t step = 0; step < m_order.size(); ++step)
+            {
+                for (const auto& it : m_passes[m_order[step]].accesses)
+                {
+                    Resource& res = m_resources[it.first];
+                    if (res.firstPass == UINT32_MAX)
+                    {
+                        if (!res.imported && !(it.second & FrameGraphAccess_WriteMask))
+                        {
+                            throw std::logic_error("Transient frame graph resource is read before it is written: " + res.name);
+                        }
+                        res.firstPass = step;
+                    }
+                    res.lastPass = step;
+                }
+            }
+        }
+
+        static FRAMEGRAPH_ACCESS ResolveAccess(FRAMEGRAPH_ACCESS access) noexcept
+        {
+            // A write state can't be combined with read states, and it covers reads anyway.
+            const uint32_t writes = access & FrameGraphAccess_WriteMask;
+            return static_cast<FRAMEGRAPH_ACCESS>(writes ? writes : static_cast<uint32_t>(access));
+        }
+
+        void ComputeBarriers()
+        {
+            std::vector<FRAMEGRAPH_ACCESS> current(m_resources.size(), FrameGraphAccess_None);
+            for (size_t j = 0; j < m_resources.size(); ++j)
+            {
+                current[j] = m_resources[j].initialAccess;
+            }
+
+            for (auto& pass : m_passes)
+            {
+                pass.activations.clear();
+                pass.barriers.clear();
+                pass.releases.clear();
+            }
+
+            for (uint32_t step = 0; step < m_order.size(); ++step)
+            {
+                Pass& pass = m_passes[m_order[step]];
+
+                for (const auto& it : pass.accesses)
+                {
+                    Resource& res = m_resources[it.first];
+                    const FRAMEGRAPH_ACCESS access = ResolveAccess(it.second);
+
+                    if (!res.imported && res.firstPass == step)
+                    {
+                        // Transients are created in the state of their first use, so they only need to be activated.
+                        res.initialAccess = access;
+                        current[it.first] = access;
+                        pass.activations.push_back(it.first);
+                        continue;
+                    }
+
+                    if (current[it.first] != access)
+                    {
+                        pass.barriers.push_back(Barrier{ it.first, current[it.first], access });
+                        current[it.first] = access;
+                    }
+                    else if (access == FrameGraphAccess_UnorderedAccess)
+                    {
+                        pass.barriers.push_back(Barrier{ it.first, access, access });
+                    }
+                }
+
+                // Return transients to their creation state at the end of their lifetime, while they
+                // still own their memory, so the next frame sees them in the same state.
+                for (const auto& it : pass.accesses)
+                {
+                    Resource& res = m_resources[it.first];
+                    if (!res.imported && res.lastPass == step && current[it.first] != res.initialAccess)
+                    {
+                        pass.releases.push_back(Barrier{ it.first, current[it.first], res.initialAccess });
+                        current[it.first] = res.initialAccess;
+                    }
+                }
+            }
+
+            m_finalBarriers.clear();
+            for (ResourceHandle j = 0; j < m_resources.size(); ++j)
+            {
+                const Resource& res = m_resources[j];
+                if (res.imported && current[j] != res.finalAccess)
+                {
+                    m_finalBarriers.push_back(Barrier{ j, current[j], res.finalAccess });
+                }
+            }
+        }
+
+        static uint64_t AlignUp(uint64_t value, uint64_t alignment) noexcept
+        {
+            return (alignment > 1) ? ((value + alignment - 1) / alignment) * alignment : value;
+        }
+
+        // Greedy interval packing: the largest transients are placed first, each at the lowest
+        // offset which doesn't overlap the memory of any resource alive at the same time.
+        void AssignMemory(const MemoryQuery& queryMemory)
+        {
+            std::vector<ResourceHandle> transients;
+            for (ResourceHandle j = 0; j < m_resources.size(); ++j)
+            {
+                Resource& res = m_resources[j];
+                if (!res.imported && res.IsUsed())
+                {
+                    res.memory = queryMemory(res.desc);
+                    transients.push_back(j);
+                }
+            }
+
+            std::stable_sort(transients.begin(), transients.end(), [&](ResourceHandle a, ResourceHandle b)
+                {
+                    return m_resources[a].memory.size > m_resources[b].memory.size;
+                });
+
+            m_heapSizes.clear();
+
+            std::vector<ResourceHandle> placed;
+            for (const ResourceHandle handle : transients)
+            {
+                Resource& res = m_resources[handle];
+
+                std::vector<std::pair<uint64_t, uint64_t>> occupied;
+                for (const ResourceHandle other : placed)
+                {
+                    const Resource& o = m_resources[other];
+                    if (o.memory.heapGroup == res.memory.heapGroup
+                        && o.firstPass <= res.lastPass
+                        && res.firstPass <= o.lastPass)
+                    {
+                        occupied.emplace_back(o.heapOffset, o.heapOffset + o.memory.size);
+                    }
+                }
+
+                std::sort(occupied.begin(), occupied.end());
+
+                uint64_t offset = 0;
+                for (const auto& range : occupied)
+                {
+                    if (offset + res.memory.size <= range.first)
+                        break;
+
+                    offset = std::max(offset, AlignUp(range.second, res.memory.alignment));
+                }
+
+                res.heapOffset = offset;
+                placed.push_back(handle);
+
+                if (m_heapSizes.size() <= res.memory.heapGroup)
+                {
+                    m_heapSizes.resize(res.memory.heapGroup + 1, 0);
+                }
+                m_heapSizes[res.memory.heapGroup] = std::max(m_heapSizes[res.memory.heapGroup], offset + res.memory.size);
+            }
+        }
+
+        std::vector<Pass>       m_passes;
+        std::vector<Resource>   m_resources;
+        std::vector<uint32_t>   m_order;
+        std::vector<Barrier>    m_finalBarriers;
+        std::vector<uint64_t>   m_heapSizes;
+        bool                    m_compiled = false;
+    };
+}
@@ -0,0 +1,499 @@
+//
+// FrameGraphExecutor.cpp - Records a compiled FrameGraph into a Direct3D 12 command list
+//
+
+#include "pch.h"
+#include "FrameGraphExecutor.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    constexpr uint32_t c_DepthAccess = FrameGraphAccess_DepthWrite | FrameGraphAccess_DepthRead;
+
+    D3D12_RESOURCE_DESC GetResourceDesc(const FrameGraphTextureDesc& desc) noexcept
+    {
+        D3D12_RESOURCE_DESC resDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+            static_cast<DXGI_FORMAT>(desc.format),
+            desc.width,
+            desc.height,
+            1, 1);
+
+        if (desc.usage & FrameGraphAccess_RenderTarget)
+        {
+            resDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+        }
+
+        if (desc.usage & c_DepthAccess)
+        {
+            resDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+            if (!(desc.usage & FrameGraphAccess_ShaderResource))
+            {
+                resDesc.Flags |= D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+            }
+        }
+
+        if (desc.usage & FrameGraphAccess_UnorderedAccess)
+        {
+            resDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+        }
+
+        return resDesc;
+    }
+
+    inline bool operator==(const FrameGraphTextureDesc& a, const FrameGraphTextureDesc& b) noexcept
+    {
+        return a.width == b.width
+            && a.height == b.height
+            && a.format == b.format
+            && a.usage == b.usage
+            && memcmp(a.clearValue, b.clearValue, sizeof(a.clearValue)) == 0;
+    }
+}
+
+FrameGraphExecutor::FrameGraphExecutor(ID3D12Device* device, unsigned int framesInFlight) noexcept(false) :
+    m_device(device),
+    m_heapTier(D3D12_RESOURCE_HEAP_TIER_1),
+    m_framesInFlight(framesInFlight),
+    m_frame(0),
+    m_rtvCapacity(0),
+    m_dsvCapacity(0),
+    m_rtvDescriptorSize(0),
+    m_dsvDescriptorSize(0)
+{
+    if (!device)
+    {
+        throw std::invalid_argument("FrameGraphExecutor requires a device");
+    }
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+    {
+        m_heapTier = options.ResourceHeapTier;
+    }
+
+    m_rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+    m_dsvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+}
+
+void FrameGraphExecutor::Execute(FrameGraph& graph, ID3D12GraphicsCommandList* commandList)
+{
+    BeginExecute(graph);
+
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+    for (const uint32_t passIndex : graph.GetExecutionOrder())
+    {
+        RecordPass(graph, passIndex, commandList, barriers);
+    }
+
+    for (const auto& b : graph.GetFinalBarriers())
+    {
+        AddBarrier(barriers, b);
+    }
+
+    FlushBarriers(commandList, barriers);
+}
+
+void FrameGraphExecutor::Execute(FrameGraph& graph, ThreadPool& threadPool, const CommandListProvider& getCommandList)
+{
+    BeginExecute(graph);
+
+    const auto& order = graph.GetExecutionOrder();
+
+    // Command lists are acquired up front on this thread; only the recording is parallel.
+    std::vector<ID3D12GraphicsCommandList*> commandLists(std::max<size_t>(order.size(), 1));
+    for (size_t j = 0; j < commandLists.size(); ++j)
+    {
+        commandLists[j] = getCommandList(j);
+    }
+
+    // Each pass starts with its own barriers, so passes are independent once the graph is compiled.
+    // The final barriers go at the end of the last list, which is submitted last.
+    threadPool.ParallelFor(0, commandLists.size(), [&](size_t j)
+        {
+            std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+            if (j < order.size())
+            {
+                RecordPass(graph, order[j], commandLists[j], barriers);
+            }
+
+            if (j + 1 == commandLists.size())
+            {
+                for (const auto& b : graph.GetFinalBarriers())
+                {
+                    AddBarrier(barriers, b);
+                }
+            }
+
+            FlushBarriers(commandLists[j], barriers);
+        });
+}
+
+void FrameGraphExecutor::BeginExecute(FrameGraph& graph)
+{
+    ++m_frame;
+
+    // Release anything that the GPU could still have been using when it was replaced.
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+        [&](const std::pair<uint64_t, ComPtr<ID3D12Pageable>>& it)
+        {
+            return it.first + m_framesInFlight < m_frame;
+        }), m_retired.end());
+
+    if (!graph.IsCompiled())
+    {
+        graph.Compile([this](const FrameGraphTextureDesc& desc) { return GetMemoryRequirements(desc); });
+    }
+
+    PrepareHeaps(graph);
+    PrepareResources(graph);
+}
+
+// Records one pass. Barriers for the pass's releases are left in the list for the caller to flush.
+void FrameGraphExecutor::RecordPass(
+    const FrameGraph& graph,
+    uint32_t passIndex,
+    ID3D12GraphicsCommandList* commandList,
+    std::vector<D3D12_RESOURCE_BARRIER>& barriers) const
+{
+    const auto& pass = graph.GetPass(passIndex);
+
+    for (const auto handle : pass.activations)
+    {
+        barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, m_resources[handle]));
+    }
+
+    for (const auto& b : pass.barriers)
+    {
+        AddBarrier(barriers, b);
+    }
+
+    FlushBarriers(commandList, barriers);
+
+    // Aliased memory has undefined contents, so render targets must be cleared or discarded before use.
+    for (const auto handle : pass.activations)
+    {
+        const auto& res = graph.GetResource(handle);
+        if (res.initialAccess == FrameGraphAccess_RenderTarget || res.initialAccess == FrameGraphAccess_DepthWrite)
+        {
+            commandList->DiscardResource(m_resources[handle], nullptr);
+        }
+    }
+
+    wchar_t eventName[64] = {};
+    swprintf_s(eventName, L"%hs", pass.name.c_str());
+    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, eventName);
+
+    if (pass.execute)
+    {
+        pass.execute(commandList);
+    }
+
+    PIXEndEvent(commandList);
+
+    for (const auto& b : pass.releases)
+    {
+        AddBarrier(barriers, b);
+    }
+}
+
+void FrameGraphExecutor::AddBarrier(std::vector<D3D12_RESOURCE_BARRIER>& barriers, const FrameGraph::Barrier& b) const
+{
+    ID3D12Resource* resource = m_resources[b.resource];
+    if (b.before == b.after)
+    {
+        barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+    }
+    else
+    {
+        barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+            GetResourceState(b.before), GetResourceState(b.after)));
+    }
+}
+
+void FrameGraphExecutor::FlushBarriers(ID3D12GraphicsCommandList* commandList, std::vector<D3D12_RESOURCE_BARRIER>& barriers)
+{
+    if (!barriers.empty())
+    {
+        commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+        barriers.clear();
+    }
+}
+
+ID3D12Resource* FrameGraphExecutor::GetResource(FrameGraph::ResourceHandle handle) const noexcept
+{
+    return (handle < m_resources.size()) ? m_resources[handle] : nullptr;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE FrameGraphExecutor::GetRenderTargetView(FrameGraph::ResourceHandle handle) const noexcept
+{
+    if (handle >= m_rtvIndex.size() || m_rtvIndex[handle] < 0)
+        return D3D12_CPU_DESCRIPTOR_HANDLE{};
+
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_rtvIndex[handle], m_rtvDescriptorSize);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE FrameGraphExecutor::GetDepthStencilView(FrameGraph::ResourceHandle handle) const noexcept
+{
+    if (handle >= m_dsvIndex.size() || m_dsvIndex[handle] < 0)
+        return D3D12_CPU_DESCRIPTOR_HANDLE{};
+
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), m_dsvIndex[handle], m_dsvDescriptorSize);
+}
+
+uint64_t FrameGraphExecutor::GetHeapMemory() const noexcept
+{
+    uint64_t total = 0;
+    for (const auto& heap : m_heaps)
+    {
+        if (heap)
+        {
+            total += heap->GetDesc().SizeInBytes;
+        }
+    }
+    return total;
+}
+
+D3D12_RESOURCE_STATES FrameGraphExecutor::GetResourceState(FRAMEGRAPH_ACCESS access) noexcept
+{
+    D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+
+    if (access & FrameGraphAccess_RenderTarget)
+        state |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+    if (access & FrameGraphAccess_DepthWrite)
+        state |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    if (access & FrameGraphAccess_UnorderedAccess)
+        state |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    if (access & FrameGraphAccess_CopyDest)
+        state |= D3D12_RESOURCE_STATE_COPY_DEST;
+    if (access & FrameGraphAccess_DepthRead)
+        state |= D3D12_RESOURCE_STATE_DEPTH_READ;
+    if (access & FrameGraphAccess_ShaderResource)
+        state |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    if (access & FrameGraphAccess_CopySource)
+        state |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+
+    // FrameGraphAccess_Present is D3D12_RESOURCE_STATE_PRESENT, which is the same as COMMON.
+    return state;
+}
+
+FrameGraph::MemoryRequirements FrameGraphExecutor::GetMemoryRequirements(const FrameGraphTextureDesc& desc) const
+{
+    const D3D12_RESOURCE_DESC resDesc = GetResourceDesc(desc);
+    const CD3DX12_RESOURCE_ALLOCATION_INFO info(m_device->GetResourceAllocationInfo(0, 1, &resDesc));
+    if (info.SizeInBytes == UINT64_MAX)
+    {
+        throw std::invalid_argument("Invalid frame graph texture description");
+    }
+
+    // Tier 1 hardware can't mix render target/depth textures with other textures in one heap.
+    uint32_t heapGroup = 0;
+    if (m_heapTier == D3D12_RESOURCE_HEAP_TIER_1
+        && !(resDesc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)))
+    {
+        heapGroup = 1;
+    }
+
+    return FrameGraph::MemoryRequirements{ info.SizeInBytes, info.Alignment, heapGroup };
+}
+
+void FrameGraphExecutor::PrepareHeaps(const FrameGraph& graph)
+{
+    const auto& sizes = graph.GetHeapSizes();
+    if (m_heaps.size() < sizes.size())
+    {
+        m_heaps.resize(sizes.size());
+    }
+
+    for (uint32_t group = 0; group < sizes.size(); ++group)
+    {
+        if (!sizes[group])
+            continue;
+
+        auto& heap = m_heaps[group];
+        if (heap && heap->GetDesc().SizeInBytes >= sizes[group])
+            continue;
+
+        if (heap)
+        {
+            ComPtr<ID3D12Pageable> old;
+            ThrowIfFailed(heap.As(&old));
+            Retire(std::move(old));
+            heap.Reset();
+        }
+
+        D3D12_HEAP_FLAGS flags = D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES;
+        if (m_heapTier == D3D12_RESOURCE_HEAP_TIER_1)
+        {
+            flags = (group == 0) ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+        }
+
+        const CD3DX12_HEAP_DESC heapDesc(sizes[group], D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, flags);
+        ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())));
+
+        heap->SetName(L"FrameGraph");
+
+        // Every resource placed in the old heap has to be recreated.
+        for (auto& transient : m_transients)
+        {
+            if (transient.heapGroup == group && transient.resource)
+            {
+                ComPtr<ID3D12Pageable> old;
+                ThrowIfFailed(transient.resource.As(&old));
+                Retire(std::move(old));
+                transient.resource.Reset();
+            }
+        }
+    }
+}
+
+void FrameGraphExecutor::PrepareResources(const FrameGraph& graph)
+{
+    const size_t count = graph.GetResourceCount();
+    m_resources.assign(count, nullptr);
+    m_rtvIndex.assign(count, -1);
+    m_dsvIndex.assign(count, -1);
+
+    UINT rtvCount = 0;
+    UINT dsvCount = 0;
+
+    for (FrameGraph::ResourceHandle handle = 0; handle < count; ++handle)
+    {
+        const auto& res = graph.GetResource(handle);
+        if (res.imported)
+        {
+            m_resources[handle] = res.external;
+            continue;
+        }
+
+        if (!res.IsUsed())
+            continue;
+
+        const D3D12_RESOURCE_STATES initialState = GetResourceState(res.initialAccess);
+
+        // Reuse a cached placed resource with an identical description and placement.
+        Transient* match = nullptr;
+        for (auto& transient : m_transients)
+        {
+            if (transient.lastUsedFrame != m_frame
+                && transient.resource
+                && transient.heapGroup == res.memory.heapGroup
+                && transient.heapOffset == res.heapOffset
+                && transient.initialState == initialState
+                && transient.desc == res.desc)
+            {
+                match = &transient;
+                break;
+            }
+        }
+
+        if (!match)
+        {
+            Transient transient = {};
+            transient.desc = res.desc;
+            transient.heapGroup = res.memory.heapGroup;
+            transient.heapOffset = res.heapOffset;
+            transient.initialState = initialState;
+
+            const D3D12_RESOURCE_DESC resDesc = GetResourceDesc(res.desc);
+
+            D3D12_CLEAR_VALUE clearValue = {};
+            clearValue.Format = resDesc.Format;
+            const bool isDepth = (res.desc.usage & c_DepthAccess) != 0;
+            if (isDepth)
+            {
+                clearValue.DepthStencil.Depth = res.desc.clearValue[0];
+            }
+            else
+            {
+                memcpy(clearValue.Color, res.desc.clearValue, sizeof(clearValue.Color));
+            }
+
+            const bool needsClearValue = (resDesc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+
+            ThrowIfFailed(m_device->CreatePlacedResource(
+                m_heaps[transient.heapGroup].Get(),
+                transient.heapOffset,
+                &resDesc,
+                initialState,
+                needsClearValue ? &clearValue : nullptr,
+                IID_PPV_ARGS(transient.resource.GetAddressOf())));
+
+            wchar_t name[64] = {};
+            swprintf_s(name, L"FrameGraph %hs", res.name.c_str());
+            transient.resource->SetName(name);
+
+            m_transients.emplace_back(std::move(transient));
+            match = &m_transients.back();
+        }
+
+        match->lastUsedFrame = m_frame;
+        m_resources[handle] = match->resource.Get();
+
+        if (res.desc.usage & FrameGraphAccess_RenderTarget)
+        {
+            m_rtvIndex[handle] = static_cast<int>(rtvCount++);
+        }
+        if (res.desc.usage & c_DepthAccess)
+        {
+            m_dsvIndex[handle] = static_cast<int>(dsvCount++);
+        }
+    }
+
+    // Retire cached resources which this graph no longer declares.
+    for (auto& transient : m_transients)
+    {
+        if (transient.resource && transient.lastUsedFrame != m_frame)
+        {
+            ComPtr<ID3D12Pageable> old;
+            ThrowIfFailed(transient.resource.As(&old));
+            Retire(std::move(old));
+            transient.resource.Reset();
+        }
+    }
+
+    m_transients.erase(std::remove_if(m_transients.begin(), m_transients.end(),
+        [](const Transient& t) { return !t.resource; }), m_transients.end());
+
+    // Descriptor heaps for views are CPU-only, so they can be replaced immediately once recording is done.
+    if (rtvCount > m_rtvCapacity)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+        desc.NumDescriptors = rtvCount;
+        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        ThrowIfFailed(m_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(m_rtvHeap.ReleaseAndGetAddressOf())));
+        m_rtvHeap->SetName(L"FrameGraph");
+        m_rtvCapacity = rtvCount;
+    }
+
+    if (dsvCount > m_dsvCapacity)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+        desc.NumDescriptors = dsvCount;
+        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+        ThrowIfFailed(m_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(m_dsvHeap.ReleaseAndGetAddressOf())));
+        m_dsvHeap->SetName(L"FrameGraph");
+        m_dsvCapacity = dsvCount;
+    }
+
+    for (FrameGraph::ResourceHandle handle = 0; handle < count; ++handle)
+    {
+        if (m_rtvIndex[handle] >= 0)
+        {
+            m_device->CreateRenderTargetView(m_resources[handle], nullptr, GetRenderTargetView(handle));
+        }
+        if (m_dsvIndex[handle] >= 0)
+        {
+            m_device->CreateDepthStencilView(m_resources[handle], nullptr, GetDepthStencilView(handle));
+        }
+    }
+}
+
+void FrameGraphExecutor::Retire(ComPtr<ID3D12Pageable>&& object)
+{
+    m_retired.emplace_back(m_frame, std::move(object));
+}
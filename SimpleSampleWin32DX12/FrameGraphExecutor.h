@@ -0,0 +1,92 @@
+//
+// FrameGraphExecutor.h - Records a compiled FrameGraph into a Direct3D 12 command list
+//
+
+#pragma once
+
+#include "FrameGraph.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <vector>
+
+
+namespace DX
+{
+    // Owns the heaps and placed resources backing a FrameGraph's transient textures. Resources
+    // are cached between frames and only recreated when the graph's declarations change.
+    class FrameGraphExecutor
+    {
+    public:
+        FrameGraphExecutor(ID3D12Device* device, unsigned int framesInFlight) noexcept(false);
+
+        FrameGraphExecutor(FrameGraphExecutor&&) = default;
+        FrameGraphExecutor& operator= (FrameGraphExecutor&&) = default;
+
+        FrameGraphExecutor(FrameGraphExecutor const&) = delete;
+        FrameGraphExecutor& operator= (FrameGraphExecutor const&) = delete;
+
+        // Returns an open command list for the n-th executed pass. Lists are expected to be submitted in order.
+        using CommandListProvider = std::function<ID3D12GraphicsCommandList*(size_t)>;
+
+        // Compiles the graph if needed, then records each surviving pass with its barriers.
+        void Execute(FrameGraph& graph, ID3D12GraphicsCommandList* commandList);
+
+        // As above, but each pass is recorded into its own command list on the thread pool.
+        void Execute(FrameGraph& graph, ThreadPool& threadPool, const CommandListProvider& getCommandList);
+
+        // Valid while recording passes for the graph most recently passed to Execute.
+        ID3D12Resource* GetResource(FrameGraph::ResourceHandle handle) const noexcept;
+        D3D12_CPU_DESCRIPTOR_HANDLE GetRenderTargetView(FrameGraph::ResourceHandle handle) const noexcept;
+        D3D12_CPU_DESCRIPTOR_HANDLE GetDepthStencilView(FrameGraph::ResourceHandle handle) const noexcept;
+
+        uint64_t GetHeapMemory() const noexcept;
+
+        static D3D12_RESOURCE_STATES GetResourceState(FRAMEGRAPH_ACCESS access) noexcept;
+
+    private:
+        struct Transient
+        {
+            FrameGraphTextureDesc                   desc;
+            uint32_t                                heapGroup;
+            uint64_t                                heapOffset;
+            D3D12_RESOURCE_STATES                   initialState;
+            Microsoft::WRL::ComPtr<ID3D12Resource>  resource;
+            uint64_t                                lastUsedFrame;
+        };
+
+        void BeginExecute(FrameGraph& graph);
+        void RecordPass(const FrameGraph& graph, uint32_t passIndex, ID3D12GraphicsCommandList* commandList,
+            std::vector<D3D12_RESOURCE_BARRIER>& barriers) const;
+        void AddBarrier(std::vector<D3D12_RESOURCE_BARRIER>& barriers, const FrameGraph::Barrier& b) const;
+        static void FlushBarriers(ID3D12GraphicsCommandList* commandList, std::vector<D3D12_RESOURCE_BARRIER>& barriers);
+
+        FrameGraph::MemoryRequirements GetMemoryRequirements(const FrameGraphTextureDesc& desc) const;
+        void PrepareHeaps(const FrameGraph& graph);
+        void PrepareResources(const FrameGraph& graph);
+        void Retire(Microsoft::WRL::ComPtr<ID3D12Pageable>&& object);
+
+        Microsoft::WRL::ComPtr<ID3D12Device>                    m_device;
+        D3D12_RESOURCE_HEAP_TIER                                m_heapTier;
+        unsigned int                                            m_framesInFlight;
+        uint64_t                                                m_frame;
+
+        std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>>         m_heaps;
+        std::vector<Transient>                                  m_transients;
+
+        // Per-graph-resource lookups for the current frame.
+        std::vector<ID3D12Resource*>                            m_resources;
+        std::vector<int>                                        m_rtvIndex;
+        std::vector<int>                                        m_dsvIndex;
+
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>            m_rtvHeap;
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>            m_dsvHeap;
+        UINT                                                    m_rtvCapacity;
+        UINT                                                    m_dsvCapacity;
+        UINT                                                    m_rtvDescriptorSize;
+        UINT                                                    m_dsvDescriptorSize;
+
+        // Objects which may still be referenced by frames in flight.
+        std::vector<std::pair<uint64_t, Microsoft::WRL::ComPtr<ID3D12Pageable>>> m_retired;
+    };
+}
@@ -0,0 +1,401 @@
+//
+// FrustumCuller.h - Tests bounding spheres and boxes against a view frustum, four at a time
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+#include <arm_neon.h>
+#define DX_CULLING_NEON
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define DX_CULLING_SSE
+#endif
+
+
+namespace DX
+{
+    // The six planes of a view frustum, each normalized so that a x + b y + c z + d is the signed
+    // distance of a point from it, positive inside.
+    struct Frustum
+    {
+        float planes[6][4];
+
+        // Extracts the planes from a view-projection matrix in the DirectXMath convention (row
+        // vectors, clip space z from 0 to w), such as an XMFLOAT4X4's m.
+        static Frustum FromViewProjection(const float (&m)[4][4]) noexcept
+        {
+            Frustum frustum = {};
+            for (int j = 0; j < 4; ++j)
+            {
+                frustum.planes[0][j] = m[j][3] + m[j][0];     // Left
+                frustum.planes[1][j] = m[j][3] - m[j][0];     // Right
+                frustum.planes[2][j] = m[j][3] + m[j][1];     // Bottom
+                frustum.planes[3][j] = m[j][3] - m[j][1];     // Top
+                frustum.planes[4][j] = m[j][2];               // Near
+                frustum.planes[5][j] = m[j][3] - m[j][2];     // Far
+            }
+
+            for (auto& plane : frustum.planes)
+            {
+                const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+                if (length > 0.f)
+                {
+                    for (auto& value : plane)
+                    {
+                        value /= length;
+                    }
+                }
+            }
+
+            return frustum;
+        }
+    };
+
+    namespace CullingSimd
+    {
+        // Just enough of a four-wide float type for the culling loops.
+    #if defined(DX_CULLING_NEON)
+        using Float4 = float32x4_t;
+
+        inline Float4 Load(const float* p) noexcept { return vld1q_f32(p); }
+        inline Float4 Splat(float value) noexcept { return vdupq_n_f32(value); }
+        inline Float4 Add(Float4 a, Float4 b) noexcept { return vaddq_f32(a, b); }
+        inline Float4 MultiplyAdd(Float4 a, Float4 b, Float4 c) noexcept { return vmlaq_f32(c, a, b); }
+
+        // Bit j is set where lane j of a is at least b.
+        inline unsigned int GreaterEqualMask(Float4 a, Float4 b) noexcept
+        {
+            static const uint32_t bits[4] = { 1, 2, 4, 8 };
+            return vaddvq_u32(vandq_u32(vcgeq_f32(a, b), vld1q_u32(bits)));
+        }
+    #elif defined(DX_CULLING_SSE)
+        using Float4 = __m128;
+
+        inline Float4 Load(const float* p) noexcept { return _mm_loadu_ps(p); }
+        inline Float4 Splat(float value) noexcept { return _mm_set1_ps(value); }
+        inline Float4 Add(Float4 a, Float4 b) noexcept { return _mm_add_ps(a, b); }
+        inline Float4 MultiplyAdd(Float4 a, Float4 b, Float4 c) noexcept { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+        inline unsigned int GreaterEqualMask(Float4 a, Float4 b) noexcept
+        {
+            return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpge_ps(a, b)));
+        }
+    #else
+        struct Float4 { float v[4]; };
+
+        inline Float4 Load(const float* p) noexcept { return { { p[0], p[1], p[2], p[3] } }; }
+        inline Float4 Splat(float value) noexcept { return { { value, value, value, value } }; }
+
+        inline Float4 Add(Float4 a, Float4 b) noexcept
+        {
+            return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+        }
+
+        inline Float4 MultiplyAdd(Float4 a, Float4 b, Float4 c) noexcept
+        {
+            return { { a.v[0] * b.v[0] + c.v[0], a.v[1] * b.v[1] + c.v[1], a.v[2] * b.v[2] + c.v[2], a.v[3] * b.v[3] + c.v[3] } };
+        }
+
+        inline unsigned int GreaterEqualMask(Float4 a, Float4 b) noexcept
+        {
+            unsigned int mask = 0;
+            for (unsigned int j = 0; j < 4; ++j)
+            {
+                mask |= (a.v[j] >= b.v[j]) ? (1u << j) : 0u;
+            }
+            return mask;
+        }
+    #endif
+    }
+
+    // Keeps object bounds in structure-of-arrays form (one array per component), so they can be
+    // tested against a frustum four objects per SIMD iteration, and writes out the indices of the
+    // visible ones as a compact list in ascending order. Spheres and axis-aligned boxes (center and
+    // half extents) are kept separately, each with its own indices.
+    //
+    // The arrays are padded to a multiple of four with bounds which are never visible, so the
+    // loops have no remainder. Large sets can be split across a ThreadPool in chunks of
+    // c_ChunkSize; each chunk compacts into its own stretch of the output, and the stretches are
+    // closed up afterwards, so the result is the same as culling on one thread.
+    class FrustumCuller
+    {
+    public:
+        static constexpr size_t c_Width = 4;
+        static constexpr size_t c_ChunkSize = 4096;
+
+        FrustumCuller() = default;
+
+        FrustumCuller(FrustumCuller&&) = default;
+        FrustumCuller& operator= (FrustumCuller&&) = default;
+
+        FrustumCuller(FrustumCuller const&) = default;
+        FrustumCuller& operator= (FrustumCuller const&) = default;
+
+        void Clear() noexcept
+        {
+            m_spheres.Clear();
+            m_boxes.Clear();
+        }
+
+        uint32_t AddSphere(float x, float y, float z, float radius)
+        {
+            const uint32_t index = m_spheres.Add();
+            SetSphere(index, x, y, z, radius);
+            return index;
+        }
+
+        void SetSphere(uint32_t index, float x, float y, float z, float radius)
+        {
+            m_spheres.Check(index);
+            m_spheres.values[0][index] = x;
+            m_spheres.values[1][index] = y;
+            m_spheres.values[2][index] = z;
+            m_spheres.values[3][index] = radius;
+        }
+
+        uint32_t AddBox(float x, float y, float z, float extentX, float extentY, float extentZ)
+        {
+            const uint32_t index = m_boxes.Add();
+            SetBox(index, x, y, z, extentX, extentY, extentZ);
+            return index;
+        }
+
+        void SetBox(uint32_t index, float x, float y, float z, float extentX, float extentY, float extentZ)
+        {
+            m_boxes.Check(index);
+            m_boxes.values[0][index] = x;
+            m_boxes.values[1][index] = y;
+            m_boxes.values[2][index] = z;
+            m_boxes.values[3][index] = extentX;
+            m_boxes.values[4][index] = extentY;
+            m_boxes.values[5][index] = extentZ;
+        }
+
+        size_t GetSphereCount() const noexcept { return m_spheres.count; }
+        size_t GetBoxCount() const noexcept { return m_boxes.count; }
+
+        // Replaces visible with the indices of the spheres at least partly inside the frustum.
+        void CullSpheres(const Frustum& frustum, std::vector<uint32_t>& visible) const
+        {
+            Cull(m_spheres, frustum, visible, nullptr, &CullSphereRange);
+        }
+
+        void CullSpheres(const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool& threadPool) const
+        {
+            Cull(m_spheres, frustum, visible, &threadPool, &CullSphereRange);
+        }
+
+        // Replaces visible with the indices of the boxes at least partly inside the frustum.
+        void CullBoxes(const Frustum& frustum, std::vector<uint32_t>& visible) const
+        {
+            Cull(m_boxes, frustum, visible, nullptr, &CullBoxRange);
+        }
+
+        void CullBoxes(const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool& threadPool) const
+        {
+            Cull(m_boxes, frustum, visible, &threadPool, &CullBoxRange);
+        }
+
+    private:
+        // Component arrays, padded to a multiple of c_Width.
+        template<size_t Components>
+        struct Bounds
+        {
+            std::vector<float>  values[Components];
+            size_t              count = 0;
+
+            void Clear() noexcept
+            {
+                for (auto& component : values)
+                {
+                    component.clear();
+                }
+                count = 0;
+            }
+
+            uint32_t Add()
+            {
+                if (count >= UINT32_MAX)
+                {
+                    throw std::length_error("FrustumCuller");
+                }
+
+                // Padding fails every plane test: a negative infinite radius or extent.
+                if (count == values[0].size())
+                {
+                    const float padding = -std::numeric_limits<float>::infinity();
+                    for (size_t j = 0; j < Components; ++j)
+                    {
+                        values[j].resize(count + c_Width, j < 3 ? 0.f : padding);
+                    }
+                }
+
+                return static_cast<uint32_t>(count++);
+            }
+
+            void Check(uint32_t index) const
+            {
+                if (index >= count)
+                {
+                    throw std::out_of_range("FrustumCuller: invalid index");
+                }
+            }
+        };
+
+        using Spheres = Bounds<4>;
+        using Boxes = Bounds<6>;
+
+        // Tests the objects in [begin, end), both multiples of c_Width, writing the visible indices
+        // to out and returning how many there were.
+        using CullRange = size_t(*)(const void* bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* out);
+
+        // Appends index + j for each bit j of mask, without branching.
+        static size_t Compact(unsigned int mask, uint32_t index, uint32_t* out, size_t count) noexcept
+        {
+            out[count] = index;
+            count += mask & 1;
+            out[count] = index + 1;
+            count += (mask >> 1) & 1;
+            out[count] = index + 2;
+            count += (mask >> 2) & 1;
+            out[count] = index + 3;
+            count += (mask >> 3) & 1;
+            return count;
+        }
+
+        // A sphere is visible unless it lies wholly outside some plane: distance < -radius.
+        static size_t CullSphereRange(const void* bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* out)
+        {
+            using namespace CullingSimd;
+
+            const auto& spheres = *static_cast<const Spheres*>(bounds);
+
+            Float4 planes[6][4];
+            for (size_t p = 0; p < 6; ++p)
+            {
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    planes[p][j] = Splat(frustum.planes[p][j]);
+                }
+            }
+
+            const Float4 zero = Splat(0.f);
+
+            size_t count = 0;
+            for (size_t j = begin; j < end; j += c_Width)
+            {
+                const Float4 x = Load(&spheres.values[0][j]);
+                const Float4 y = Load(&spheres.values[1][j]);
+                const Float4 z = Load(&spheres.values[2][j]);
+                const Float4 r = Load(&spheres.values[3][j]);
+
+                unsigned int mask = 0xF;
+                for (size_t p = 0; p < 6 && mask; ++p)
+                {
+                    const Float4 distance = MultiplyAdd(planes[p][0], x, MultiplyAdd(planes[p][1], y, MultiplyAdd(planes[p][2], z, planes[p][3])));
+                    mask &= GreaterEqualMask(Add(distance, r), zero);
+                }
+
+                count = Compact(mask, static_cast<uint32_t>(j), out, count);
+            }
+            return count;
+        }
+
+        // A box is visible unless it lies wholly outside some plane: its center's distance plus
+        // its extents projected onto the plane normal is negative.
+        static size_t CullBoxRange(const void* bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* out)
+        {
+            using namespace CullingSimd;
+
+            const auto& boxes = *static_cast<const Boxes*>(bounds);
+
+            Float4 planes[6][4];
+            Float4 absolute[6][3];
+            for (size_t p = 0; p < 6; ++p)
+            {
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    planes[p][j] = Splat(frustum.planes[p][j]);
+                }
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    absolute[p][j] = Splat(std::fabs(frustum.planes[p][j]));
+                }
+            }
+
+            const Float4 zero = Splat(0.f);
+
+            size_t count = 0;
+            for (size_t j = begin; j < end; j += c_Width)
+            {
+                const Float4 x = Load(&boxes.values[0][j]);
+                const Float4 y = Load(&boxes.values[1][j]);
+                const Float4 z = Load(&boxes.values[2][j]);
+                const Float4 ex = Load(&boxes.values[3][j]);
+                const Float4 ey = Load(&boxes.values[4][j]);
+                const Float4 ez = Load(&boxes.values[5][j]);
+
+                unsigned int mask = 0xF;
+                for (size_t p = 0; p < 6 && mask; ++p)
+                {
+                    const Float4 distance = MultiplyAdd(planes[p][0], x, MultiplyAdd(planes[p][1], y, MultiplyAdd(planes[p][2], z, planes[p][3])));
+                    const Float4 radius = MultiplyAdd(absolute[p][0], ex, MultiplyAdd(absolute[p][1], ey, MultiplyAdd(absolute[p][2], ez, distance)));
+                    mask &= GreaterEqualMask(radius, zero);
+                }
+
+                count = Compact(mask, static_cast<uint32_t>(j), out, count);
+            }
+            return count;
+        }
+
+        template<typename T>
+        static void Cull(const T& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool* threadPool, CullRange cull)
+        {
+            const size_t padded = bounds.values[0].size();
+            visible.resize(padded);
+            if (!padded)
+                return;
+
+            const size_t chunks = (padded + c_ChunkSize - 1) / c_ChunkSize;
+            if (!threadPool || chunks == 1)
+            {
+                visible.resize(cull(&bounds, frustum, 0, padded, visible.data()));
+                return;
+            }
+
+            std::vector<size_t> counts(chunks);
+            threadPool->ParallelFor(0, chunks, [&](size_t chunk)
+                {
+                    const size_t begin = chunk * c_ChunkSize;
+                    const size_t end = std::min(begin + c_ChunkSize, padded);
+                    counts[chunk] = cull(&bounds, frustum, begin, end, visible.data() + begin);
+                });
+
+            // Close up the gaps; each chunk only ever moves toward the front.
+            size_t count = counts[0];
+            for (size_t chunk = 1; chunk < chunks; ++chunk)
+            {
+                if (counts[chunk])
+                {
+                    memmove(visible.data() + count, visible.data() + chunk * c_ChunkSize, counts[chunk] * sizeof(uint32_t));
+                }
+                count += counts[chunk];
+            }
+            visible.resize(count);
+        }
+
+        Spheres     m_spheres;
+        Boxes       m_boxes;
+    };
+}
@@ -5,6 +5,8 @@
 #include "pch.h"
 #include "Game.h"
 
+#include "SDKMesh.h"
+
 extern void ExitGame() noexcept;
 
 using namespace DirectX;
@@ -12,14 +14,117 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
-Game::Game() noexcept(false)
+namespace
+{
+    // Per-instance transforms for the instanced effects: a 3x4 matrix per instance in stream 1.
+    const D3D12_INPUT_ELEMENT_DESC s_instanceElements[] =
+    {
+        { "InstMatrix", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "InstMatrix", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "InstMatrix", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+    };
+
+    // Creates a SoundEffect from a .wav image. SoundEffect owns the buffer its format and samples
+    // point into, so the image is copied once, and the 'fmt ' and 'data' chunks are found in the copy.
+    std::unique_ptr<SoundEffect> CreateSoundEffect(AudioEngine* engine, const DX::AssetData& wav)
+    {
+        const size_t size = wav.GetSize();
+        if (size < 12 || memcmp(wav.GetData(), "RIFF", 4) != 0 || memcmp(wav.GetData() + 8, "WAVE", 4) != 0)
+        {
+            throw std::runtime_error("CreateSoundEffect: not a .wav file");
+        }
+
+        std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+        memcpy(data.get(), wav.GetData(), size);
+
+        const WAVEFORMATEX* wfx = nullptr;
+        const uint8_t* samples = nullptr;
+        size_t sampleBytes = 0;
+
+        const uint8_t* end = data.get() + size;
+        for (const uint8_t* chunk = data.get() + 12; end - chunk >= 8;)
+        {
+            uint32_t chunkSize = 0;
+            memcpy(&chunkSize, chunk + 4, sizeof(chunkSize));
+
+            const uint8_t* body = chunk + 8;
+            if (chunkSize > size_t(end - body))
+                break;
+
+            if (!memcmp(chunk, "fmt ", 4) && chunkSize >= sizeof(PCMWAVEFORMAT))
+            {
+                wfx = reinterpret_cast<const WAVEFORMATEX*>(body);
+            }
+            else if (!memcmp(chunk, "data", 4))
+            {
+                samples = body;
+                sampleBytes = chunkSize;
+            }
+
+            // Chunks are word aligned.
+            const size_t advance = size_t(chunkSize) + (chunkSize & 1);
+            if (advance >= size_t(end - body))
+                break;
+            chunk = body + advance;
+        }
+
+        if (!wfx || !samples)
+        {
+            throw std::runtime_error("CreateSoundEffect: missing 'fmt ' or 'data' chunk");
+        }
+
+        return std::make_unique<SoundEffect>(engine, data, wfx, samples, sampleBytes);
+    }
+}
+
+Game::Game() noexcept(false) :
+    m_visibleTeapots(0),
+    m_visibleModels(0),
+    m_stressMode(false),
+    m_teapotNode(DX::DynamicBVH::c_InvalidHandle),
+    m_modelNode(DX::DynamicBVH::c_InvalidHandle),
+    m_picked(nullptr),
+    m_modelMeshletStatistics{},
+    m_spriteUploadFence(0),
+    m_modelUploadFence(0),
+    m_spriteBatchUploadFence(0),
+    m_placeholderUploadFence(0),
+    m_placeholderDescriptor(DX::DescriptorAllocator::c_InvalidIndex),
+    m_flatNormalDescriptor(DX::DescriptorAllocator::c_InvalidIndex),
+    m_segoeFontDescriptor(DX::DescriptorAllocator::c_InvalidIndex),
+    m_qpcFrequency{},
+    m_inputTime{},
+    m_latencyTotalMs(0),
+    m_latencyMaxMs(0),
+    m_latencySamples(0),
+    m_inputLatencyMs(0.f),
+    m_inputLatencyMaxMs(0.f),
+    m_startupTime{},
+    m_timeToFirstFrameMs(0)
 {
-    m_deviceResources = std::make_unique<DX::DeviceResources>();
+    // Three back buffers with two frames in flight: smoother flips without adding latency.
+    m_deviceResources = std::make_unique<DX::DeviceResources>(
+        DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT, 3, D3D_FEATURE_LEVEL_11_0,
+        DX::DeviceResources::c_EnableFrameLatencyWaitable, 2);
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_threadPool = std::make_unique<DX::ThreadPool>();
+    m_pipelineQueue = std::make_unique<DX::PipelineCompileQueue>(*m_threadPool);
+
+    // At most two textures decode at once, leaving the rest of the pool to frame recording.
+    m_assetStreamer = std::make_unique<DX::AssetStreamer>(*m_threadPool, 2, 2);
+
+    if (!QueryPerformanceFrequency(&m_qpcFrequency))
+    {
+        throw std::exception();
+    }
 }
 
 Game::~Game()
 {
+    // Finish any decode still recording uploads before the GPU is drained.
+    m_assetStreamer.reset();
+
     if (m_deviceResources)
     {
         m_deviceResources->WaitForGpu();
@@ -34,6 +139,8 @@ Game::~Game()
 // Initialize the Direct3D resources required to run.
 void Game::Initialize(HWND window, int width, int height)
 {
+    QueryPerformanceCounter(&m_startupTime);
+
     m_gamePad = std::make_unique<GamePad>();
 
     m_keyboard = std::make_unique<Keyboard>();
@@ -43,38 +150,107 @@ void Game::Initialize(HWND window, int width, int height)
 
     m_deviceResources->SetWindow(window, width, height);
 
-    m_deviceResources->CreateDeviceResources();
-    CreateDeviceDependentResources();
+    // Remember which adapters were probed between runs, so startup can skip creating test devices.
+    wchar_t adapterCache[MAX_PATH] = {};
+    const DWORD tempPathLength = GetTempPathW(MAX_PATH, adapterCache);
+    if (tempPathLength && tempPathLength < MAX_PATH
+        && wcscat_s(adapterCache, L"DirectXTKSimpleSample.adapters") == 0)
+    {
+        m_deviceResources->SetAdapterCacheFile(adapterCache);
+    }
 
-    m_deviceResources->CreateWindowSizeDependentResources();
-    CreateWindowSizeDependentResources();
+    // Assets are read through one mapping of the pack when it has been built, and from loose files
+    // otherwise.
+    if (GetFileAttributesW(L"assets.pak") != INVALID_FILE_ATTRIBUTES)
+    {
+        m_assetPack = std::make_unique<DX::AssetPack>(L"assets.pak");
+    }
+
+    // Startup runs as a graph of tasks, so audio, file I/O, texture decoding and pipeline creation
+    // overlap. The device and swap chain are created on this thread, which owns the window.
+    DX::TaskGraph startup;
+
+    const auto device = startup.AddTask("Create device",
+        [this]()
+        {
+            m_deviceResources->CreateDeviceResources();
+        }, {}, true);
+
+    const auto assets = AddDeviceDependentTasks(startup, { device });
+
+    const auto swapChain = startup.AddTask("Create swap chain",
+        [this]()
+        {
+            m_deviceResources->CreateWindowSizeDependentResources();
+        }, { device }, true);
+
+    startup.AddTask("Window size dependent resources",
+        [this]()
+        {
+            CreateWindowSizeDependentResources();
+        }, { assets, swapChain }, true);
 
     // Create DirectXTK for Audio objects
-    AUDIO_ENGINE_FLAGS eflags = AudioEngine_Default;
-#ifdef _DEBUG
-    eflags |= AudioEngine_Debug;
-#endif
+    const auto audio = startup.AddTask("Audio engine",
+        [this]()
+        {
+            AUDIO_ENGINE_FLAGS eflags = AudioEngine_Default;
+        #ifdef _DEBUG
+            eflags |= AudioEngine_Debug;
+        #endif
+
+            m_audEngine = std::make_unique<AudioEngine>(eflags);
+
+            m_audioEvent = 0;
+            m_audioTimerAcc = 10.f;
+            m_retryDefault = false;
+        });
+
+    const auto waveBank = startup.AddTask("Wave bank",
+        [this]()
+        {
+            m_waveBank = std::make_unique<WaveBank>(m_audEngine.get(), L"adpcmdroid.xwb");
+        }, { audio });
 
-    m_audEngine = std::make_unique<AudioEngine>(eflags);
+    const auto soundEffect = startup.AddTask("Sound effect",
+        [this]()
+        {
+            m_soundEffect = CreateSoundEffect(m_audEngine.get(), LoadAsset(L"MusicMono_adpcm.wav"));
+        }, { audio });
 
-    m_audioEvent = 0;
-    m_audioTimerAcc = 10.f;
-    m_retryDefault = false;
+    startup.AddTask("Start audio",
+        [this]()
+        {
+            m_effect1 = m_soundEffect->CreateInstance();
+            m_effect2 = m_waveBank->CreateInstance(10);
 
-    m_waveBank = std::make_unique<WaveBank>(m_audEngine.get(), L"adpcmdroid.xwb");
+            m_effect1->Play(true);
+            m_effect2->Play();
+        }, { waveBank, soundEffect });
 
-    m_soundEffect = std::make_unique<SoundEffect>(m_audEngine.get(), L"MusicMono_adpcm.wav");
-    m_effect1 = m_soundEffect->CreateInstance();
-    m_effect2 = m_waveBank->CreateInstance(10);
+    startup.Run(*m_threadPool);
 
-    m_effect1->Play(true);
-    m_effect2->Play();
+#ifdef _DEBUG
+    OutputDebugStringA("Startup timeline:\n");
+    OutputDebugStringA(startup.FormatTimeline().c_str());
+#endif
 }
 
 #pragma region Frame Update
 // Executes the basic game loop.
 void Game::Tick()
 {
+    // Size changes are merged and applied here, between frames, rather than as each message arrives.
+    if (m_deviceResources->ApplyPendingWindowSize())
+    {
+        CreateWindowSizeDependentResources();
+    }
+
+    // Sleep until the swap chain can take another frame, so the frame starts as close to
+    // scan-out as possible, and input is read just before it is used.
+    std::ignore = m_deviceResources->WaitForFrameLatency();
+    QueryPerformanceCounter(&m_inputTime);
+
     m_timer.Tick([&]()
         {
             Update(m_timer);
@@ -154,6 +330,22 @@ void Game::Update(DX::StepTimer const& timer)
         ExitGame();
     }
 
+    // Stress mode swaps the single teapot and model for thousands of instances of each.
+    if (m_keyboardButtons.IsKeyPressed(Keyboard::Keys::I)
+        || m_gamePadButtons.y == GamePad::ButtonStateTracker::PRESSED)
+    {
+        m_stressMode = !m_stressMode;
+    }
+
+    // Clicking picks the object under the cursor, unless they are hidden by stress mode.
+    const auto mouse = m_mouse->GetState();
+    m_mouseButtons.Update(mouse);
+
+    if (m_mouseButtons.leftButton == Mouse::ButtonStateTracker::PRESSED && !m_stressMode)
+    {
+        Pick(mouse.x, mouse.y);
+    }
+
     PIXEndEvent();
 }
 #pragma endregion
@@ -170,87 +362,390 @@ void Game::Render()
 
     // Prepare the command list to render a new frame.
     m_deviceResources->Prepare();
-    Clear();
 
-    auto commandList = m_deviceResources->GetCommandList();
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Render");
+    PIXBeginEvent(PIX_COLOR_DEFAULT, L"Render");
+
+    // Reclaim descriptors from frames the GPU has finished with.
+    m_resourceDescriptors->BeginFrame(m_deviceResources->GetCompletedFenceValue());
+
+    // Streamed textures switch over from the placeholder once their copies complete.
+    const bool placeholderReady = IsUploaded(m_placeholderUploadFence);
+    UpdateStreamedTexture(m_windowsLogo);
+    UpdateStreamedTexture(m_seaFloor);
+    StreamMipLevels();
+
+    const bool spritesReady = placeholderReady && IsUploaded(m_spriteUploadFence) && IsUploaded(m_spriteBatchUploadFence);
+    const bool shapeReady = placeholderReady;
+    const bool modelReady = IsUploaded(m_modelUploadFence);
+
+    // Model textures are tracked for residency from the time they can be drawn.
+    if (modelReady && m_modelTextureResidency.size() != m_modelTextures.size())
+    {
+        for (const auto& texture : m_modelTextures)
+        {
+            m_modelTextureResidency.push_back(m_residency->Add(texture.Get(), m_deviceResources->GetCurrentFenceValue()));
+        }
+    }
+
+    const bool stressMode = m_stressMode && shapeReady && modelReady;
+
+    // Keep the scene index in step with the turning objects, and leave out those not in view.
+    UpdateScene(shapeReady, modelReady);
+
+    bool teapotVisible = false;
+    bool modelVisible = false;
+    {
+        XMFLOAT4X4 viewProjection;
+        XMStoreFloat4x4(&viewProjection, m_view * m_projection);
+        m_scene.QueryFrustum(DX::Frustum::FromViewProjection(viewProjection.m), [&](DX::DynamicBVH::Handle leaf)
+            {
+                if (m_scene.GetValue(leaf) == SceneObject_Teapot)
+                {
+                    teapotVisible = true;
+                }
+                else
+                {
+                    modelVisible = true;
+                }
+            });
+    }
+
+    // Then the model's meshlets, in its own space: those off screen, or facing wholly away. If none
+    // are left, the model isn't drawn.
+    m_modelMeshletStatistics = {};
+    if (modelVisible && !stressMode && !m_modelMeshlets.empty())
+    {
+        const XMMATRIX world = GetWorld(SceneObject_Model);
+
+        XMFLOAT4X4 worldViewProjection;
+        XMStoreFloat4x4(&worldViewProjection, world * m_view * m_projection);
+
+        XMFLOAT3 eye;
+        XMStoreFloat3(&eye, XMVector3Transform(XMMatrixInverse(nullptr, m_view).r[3], XMMatrixInverse(nullptr, world)));
+        const float eyePosition[3] = { eye.x, eye.y, eye.z };
+
+        m_modelMeshletStatistics = DX::Meshlets::CullMeshlets(m_modelMeshlets.data(), m_modelMeshlets.size(),
+            DX::Frustum::FromViewProjection(worldViewProjection.m), eyePosition);
+
+        modelVisible = m_modelMeshletStatistics.visible > 0;
+    }
+
+    // Describe the frame as a graph of passes. Barriers between passes are derived from the
+    // declared resource usage, and passes whose output is never consumed are culled.
+    m_frameGraph.Reset();
+
+    const auto backBuffer = m_frameGraph.ImportResource("Back buffer", m_deviceResources->GetRenderTarget(),
+        DX::FrameGraphAccess_RenderTarget, DX::FrameGraphAccess_RenderTarget);
+    const auto depthBuffer = m_frameGraph.ImportResource("Depth buffer", m_deviceResources->GetDepthStencil(),
+        DX::FrameGraphAccess_DepthWrite, DX::FrameGraphAccess_DepthWrite);
+
+    m_frameGraph.AddPass("Clear",
+        [&](DX::FrameGraph::PassBuilder& builder)
+        {
+            builder.Write(backBuffer, DX::FrameGraphAccess_RenderTarget);
+            builder.Write(depthBuffer, DX::FrameGraphAccess_DepthWrite);
+        },
+        [this](ID3D12GraphicsCommandList* commandList)
+        {
+            Clear(commandList);
+        });
 
     // Draw procedurally generated dynamic grid
-    const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
-    const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
-    DrawGrid(xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+    m_frameGraph.AddPass("Draw grid",
+        [&](DX::FrameGraph::PassBuilder& builder)
+        {
+            builder.Write(backBuffer, DX::FrameGraphAccess_RenderTarget);
+        },
+        [this](ID3D12GraphicsCommandList* commandList)
+        {
+            SetRenderTargets(commandList);
 
-    // Set the descriptor heaps
-    ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
-    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+            const XMVECTORF32 xaxis = { 20.f, 0.f, 0.f };
+            const XMVECTORF32 yaxis = { 0.f, 0.f, 20.f };
+            DrawGrid(commandList, xaxis, yaxis, g_XMZero, 20, 20, Colors::Gray);
+        });
 
     // Draw sprite
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw sprite");
-    m_sprites->Begin(commandList);
-    m_sprites->Draw(m_resourceDescriptors->GetGpuHandle(Descriptors::WindowsLogo), GetTextureSize(m_texture2.Get()),
-        XMFLOAT2(10, 75));
+    if (spritesReady)
+    {
+        UseTexture(m_windowsLogo);
 
-    m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
-    m_sprites->End();
-    PIXEndEvent(commandList);
+        m_frameGraph.AddPass("Draw sprite",
+            [&](DX::FrameGraph::PassBuilder& builder)
+            {
+                builder.Write(backBuffer, DX::FrameGraphAccess_RenderTarget);
+            },
+            [this](ID3D12GraphicsCommandList* commandList)
+            {
+                SetRenderTargets(commandList);
+
+                ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
+                commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+                m_sprites->Begin(commandList);
+                if (m_windowsLogo.resident)
+                {
+                    m_sprites->Draw(GetTextureHandle(m_windowsLogo), GetTextureSize(m_windowsLogo.texture->GetResource()),
+                        XMFLOAT2(10, 75));
+                }
+                else
+                {
+                    const RECT placeholder = { 10, 75, 10 + c_PlaceholderSpriteSize, 75 + c_PlaceholderSpriteSize };
+                    m_sprites->Draw(m_resourceDescriptors->GetGpuHandle(m_placeholderDescriptor), GetTextureSize(m_placeholderTexture.Get()),
+                        placeholder);
+                }
+
+                m_font->DrawString(m_sprites.get(), L"DirectXTK Simple Sample", XMFLOAT2(100, 10), Colors::Yellow);
+
+                wchar_t latency[64] = {};
+                swprintf_s(latency, L"Input to present: %.1f ms (max %.1f ms)", m_inputLatencyMs, m_inputLatencyMaxMs);
+                m_font->DrawString(m_sprites.get(), latency, XMFLOAT2(100, 10 + m_font->GetLineSpacing()), Colors::Yellow);
+
+                if (m_stressMode)
+                {
+                    wchar_t stress[96] = {};
+                    swprintf_s(stress, L"Stress: %u of %u instances visible, in %zu draws", m_visibleTeapots + m_visibleModels, c_StressInstances * 2,
+                        (m_visibleTeapots ? 1 : 0) + (m_visibleModels ? m_modelInstancedParts.size() : 0));
+                    m_font->DrawString(m_sprites.get(), stress, XMFLOAT2(100, 10 + 2 * m_font->GetLineSpacing()), Colors::Yellow);
+                }
+                else if (m_modelMeshletStatistics.visible)
+                {
+                    const auto& statistics = m_modelMeshletStatistics;
+                    wchar_t meshlets[96] = {};
+                    swprintf_s(meshlets, L"Meshlets: %u of %zu visible, %u back-facing, %u off screen", statistics.visible,
+                        m_modelMeshlets.size(), statistics.backFacing, statistics.outsideFrustum);
+                    m_font->DrawString(m_sprites.get(), meshlets, XMFLOAT2(100, 10 + 2 * m_font->GetLineSpacing()), Colors::Yellow);
+                }
+
+                if (m_picked)
+                {
+                    wchar_t picked[64] = {};
+                    swprintf_s(picked, L"Picked: %ls", m_picked);
+                    m_font->DrawString(m_sprites.get(), picked, XMFLOAT2(100, 10 + 3 * m_font->GetLineSpacing()), Colors::Yellow);
+                }
+                m_sprites->End();
+            });
+    }
 
     // Draw 3D object
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw teapot");
-    XMMATRIX local = m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
-    m_shapeEffect->SetWorld(local);
-    m_shapeEffect->Apply(commandList);
-    m_shape->Draw(commandList);
-    PIXEndEvent(commandList);
+    if (teapotVisible && !stressMode)
+    {
+        UseTexture(m_seaFloor);
+
+        m_frameGraph.AddPass("Draw teapot",
+            [&](DX::FrameGraph::PassBuilder& builder)
+            {
+                builder.Write(backBuffer, DX::FrameGraphAccess_RenderTarget);
+                builder.Write(depthBuffer, DX::FrameGraphAccess_DepthWrite);
+            },
+            [this](ID3D12GraphicsCommandList* commandList)
+            {
+                SetRenderTargets(commandList);
+
+                ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
+                commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+                m_shapeEffect->SetTexture(GetTextureHandle(m_seaFloor), m_states->LinearWrap());
+                m_shapeEffect->SetWorld(GetWorld(SceneObject_Teapot));
+                m_shapeEffect->Apply(commandList);
+                m_shape->Draw(commandList);
+            });
+    }
 
     // Draw model
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw model");
-    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
-    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
-    const XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
-    local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-    Model::UpdateEffectMatrices(m_modelEffects, local, m_view, m_projection);
-    heaps[0] = m_modelResources->Heap();
-    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
-    m_model->Draw(commandList, m_modelEffects.begin());
-    PIXEndEvent(commandList);
+    if (modelVisible && !stressMode)
+    {
+        UseModelTextures();
+
+        m_frameGraph.AddPass("Draw model",
+            [&](DX::FrameGraph::PassBuilder& builder)
+            {
+                builder.Write(backBuffer, DX::FrameGraphAccess_RenderTarget);
+                builder.Write(depthBuffer, DX::FrameGraphAccess_DepthWrite);
+            },
+            [this](ID3D12GraphicsCommandList* commandList)
+            {
+                SetRenderTargets(commandList);
+
+                Model::UpdateEffectMatrices(m_modelEffects, GetWorld(SceneObject_Model), m_view, m_projection);
+
+                ID3D12DescriptorHeap* heaps[] = { m_modelResources->Heap(), m_states->Heap() };
+                commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+                m_model->Draw(commandList, m_modelEffects.begin());
+            });
+    }
+
+    // Draw thousands of each, with the draw count set by the number of mesh parts alone.
+    if (stressMode)
+    {
+        UpdateInstanceTransforms();
+
+        if (m_visibleTeapots)
+        {
+            UseTexture(m_seaFloor);
+        }
+
+        if (m_visibleModels)
+        {
+            UseModelTextures();
+        }
+
+        m_frameGraph.AddPass("Draw instances",
+            [&](DX::FrameGraph::PassBuilder& builder)
+            {
+                builder.Write(backBuffer, DX::FrameGraphAccess_RenderTarget);
+                builder.Write(depthBuffer, DX::FrameGraphAccess_DepthWrite);
+            },
+            [this](ID3D12GraphicsCommandList* commandList)
+            {
+                SetRenderTargets(commandList);
+
+                // The visible teapots' transforms come first in the buffer, then the visible models'.
+                const UINT stride = sizeof(XMFLOAT3X4);
+                D3D12_VERTEX_BUFFER_VIEW instances = {};
+                instances.BufferLocation = m_instanceTransforms.GpuAddress();
+                instances.SizeInBytes = stride * m_visibleTeapots;
+                instances.StrideInBytes = stride;
+
+                ID3D12DescriptorHeap* heaps[] = { m_resourceDescriptors->Heap(), m_states->Heap() };
+                commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+                if (m_visibleTeapots)
+                {
+                    m_shapeInstancedEffect->SetTexture(GetTextureHandle(m_seaFloor), m_states->LinearWrap());
+                    m_shapeInstancedEffect->SetMatrices(Matrix::Identity, m_view, m_projection);
+                    m_shapeInstancedEffect->Apply(commandList);
+                    commandList->IASetVertexBuffers(1, 1, &instances);
+                    m_shape->DrawInstanced(commandList, m_visibleTeapots);
+                }
+
+                if (!m_visibleModels)
+                    return;
+
+                heaps[0] = m_modelResources->Heap();
+                commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+                instances.BufferLocation += instances.SizeInBytes;
+                instances.SizeInBytes = stride * m_visibleModels;
+                commandList->IASetVertexBuffers(1, 1, &instances);
+
+                // Parts are sorted by effect, so each material's pipeline is set once.
+                size_t effect = SIZE_MAX;
+                for (const auto& it : m_modelInstancedParts)
+                {
+                    if (it.effect != effect)
+                    {
+                        effect = it.effect;
+                        m_modelInstancedEffects[effect]->SetMatrices(Matrix::Identity, m_view, m_projection);
+                        m_modelInstancedEffects[effect]->Apply(commandList);
+                    }
+
+                    it.part->DrawInstanced(commandList, m_visibleModels);
+                }
+            });
+    }
+
+    // Each pass records into its own command list on the thread pool; Present submits them together.
+    m_frameGraphExecutor->Execute(m_frameGraph, *m_threadPool,
+        [this](size_t index)
+        {
+            return m_deviceResources->GetWorkerCommandList(static_cast<unsigned int>(index));
+        });
+
+    PIXEndEvent();
 
-    PIXEndEvent(commandList);
+    m_resourceDescriptors->EndFrame(m_deviceResources->GetCurrentFenceValue());
+
+    // Restore any evicted texture drawn this frame, and evict down to the budget, before submitting.
+    m_residency->Update(m_deviceResources->GetCompletedFenceValue());
 
     // Show the new frame.
     PIXBeginEvent(m_deviceResources->GetCommandQueue(), PIX_COLOR_DEFAULT, L"Present");
     m_deviceResources->Present();
     m_graphicsMemory->Commit(m_deviceResources->GetCommandQueue());
     PIXEndEvent(m_deviceResources->GetCommandQueue());
+
+    UpdateLatencyStatistics();
+
+    if (!m_timeToFirstFrameMs)
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        m_timeToFirstFrameMs = double(now.QuadPart - m_startupTime.QuadPart) * 1000.0 / double(m_qpcFrequency.QuadPart);
+
+    #ifdef _DEBUG
+        char buff[64] = {};
+        sprintf_s(buff, "Time to first frame: %.2f ms\n", m_timeToFirstFrameMs);
+        OutputDebugStringA(buff);
+    #endif
+    }
+}
+
+// Accumulates the input-to-present time of each frame, and publishes the average and worst case periodically.
+void Game::UpdateLatencyStatistics()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    const double ms = double(now.QuadPart - m_inputTime.QuadPart) * 1000.0 / double(m_qpcFrequency.QuadPart);
+    m_latencyTotalMs += ms;
+    m_latencyMaxMs = std::max(m_latencyMaxMs, ms);
+
+    if (++m_latencySamples < c_LatencyReportFrames)
+        return;
+
+    m_inputLatencyMs = static_cast<float>(m_latencyTotalMs / m_latencySamples);
+    m_inputLatencyMaxMs = static_cast<float>(m_latencyMaxMs);
+
+#ifdef _DEBUG
+    char buff[128] = {};
+    sprintf_s(buff, "Input to present latency: %.2f ms average, %.2f ms max (frame latency %u)\n",
+        m_inputLatencyMs, m_inputLatencyMaxMs, m_deviceResources->GetMaximumFrameLatency());
+    OutputDebugStringA(buff);
+
+    const auto pool = m_deviceResources->GetCommandAllocatorPool();
+    const auto direct = pool->GetStatistics(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    const auto compute = pool->GetStatistics(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+    sprintf_s(buff, "Command allocators: direct %u created, %u peak; compute %u created, %u peak\n",
+        direct.allocatorCount, direct.highWater, compute.allocatorCount, compute.highWater);
+    OutputDebugStringA(buff);
+#endif
+
+    m_latencyTotalMs = 0;
+    m_latencyMaxMs = 0;
+    m_latencySamples = 0;
 }
 
 // Helper method to clear the back buffers.
-void Game::Clear()
+void Game::Clear(ID3D12GraphicsCommandList* commandList)
 {
-    auto commandList = m_deviceResources->GetCommandList();
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Clear");
+    SetRenderTargets(commandList);
 
     // Clear the views.
     const auto rtvDescriptor = m_deviceResources->GetRenderTargetView();
     const auto dsvDescriptor = m_deviceResources->GetDepthStencilView();
 
-    commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, &dsvDescriptor);
     commandList->ClearRenderTargetView(rtvDescriptor, Colors::CornflowerBlue, 0, nullptr);
     commandList->ClearDepthStencilView(dsvDescriptor, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+}
+
+// Binds the back buffer, depth buffer, and viewport. Each pass records into its own command list,
+// so this state has to be set at the start of every pass.
+void Game::SetRenderTargets(ID3D12GraphicsCommandList* commandList)
+{
+    const auto rtvDescriptor = m_deviceResources->GetRenderTargetView();
+    const auto dsvDescriptor = m_deviceResources->GetDepthStencilView();
+    commandList->OMSetRenderTargets(1, &rtvDescriptor, FALSE, &dsvDescriptor);
 
     // Set the viewport and scissor rect.
     const auto viewport = m_deviceResources->GetScreenViewport();
     const auto scissorRect = m_deviceResources->GetScissorRect();
     commandList->RSSetViewports(1, &viewport);
     commandList->RSSetScissorRects(1, &scissorRect);
-
-    PIXEndEvent(commandList);
 }
 
-void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
+void XM_CALLCONV Game::DrawGrid(ID3D12GraphicsCommandList* commandList, FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
 {
-    auto commandList = m_deviceResources->GetCommandList();
-    PIXBeginEvent(commandList, PIX_COLOR_DEFAULT, L"Draw grid");
-
     m_lineEffect->Apply(commandList);
 
     m_batch->Begin(commandList);
@@ -283,8 +778,6 @@ void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR orig
     }
 
     m_batch->End();
-
-    PIXEndEvent(commandList);
 }
 #pragma endregion
 
@@ -306,6 +799,7 @@ void Game::OnResuming()
     m_timer.ResetElapsedTime();
     m_gamePadButtons.Reset();
     m_keyboardButtons.Reset();
+    m_mouseButtons.Reset();
     m_audEngine->Resume();
 }
 
@@ -317,15 +811,25 @@ void Game::OnWindowMoved()
 
 void Game::OnDisplayChange()
 {
+    // Outputs may have been added, moved, or switched in or out of HDR.
+    m_deviceResources->InvalidateOutputTopology();
     m_deviceResources->UpdateColorSpace();
 }
 
 void Game::OnWindowSizeChanged(int width, int height)
 {
-    if (!m_deviceResources->WindowSizeChanged(width, height))
-        return;
+    m_deviceResources->RequestWindowSize(width, height);
+}
 
-    CreateWindowSizeDependentResources();
+void Game::OnEnterSizeMove()
+{
+    // Keep rendering at the old size while the user drags; the present is stretched to the window.
+    m_deviceResources->SetLiveResize(true);
+}
+
+void Game::OnExitSizeMove()
+{
+    m_deviceResources->SetLiveResize(false);
 }
 
 void Game::NewAudioDevice()
@@ -350,104 +854,783 @@ void Game::GetDefaultSize(int& width, int& height) const noexcept
 // These are the resources that depend on the device.
 void Game::CreateDeviceDependentResources()
 {
-    auto device = m_deviceResources->GetD3DDevice();
+    DX::TaskGraph graph;
+    AddDeviceDependentTasks(graph, {});
+    graph.Run(*m_threadPool);
+}
+
+// Adds tasks creating the device dependent resources, returning the one which finishes them.
+// Each group of assets loads and records its uploads on a worker, and goes to the copy queue in
+// its own batch, so it can be drawn as soon as its own copy completes.
+DX::TaskGraph::TaskId Game::AddDeviceDependentTasks(DX::TaskGraph& graph, std::initializer_list<DX::TaskGraph::TaskId> dependencies)
+{
+    const auto core = graph.AddTask("Device objects",
+        [this]()
+        {
+            auto device = m_deviceResources->GetD3DDevice();
 
-    m_graphicsMemory = std::make_unique<GraphicsMemory>(device);
+            m_graphicsMemory = std::make_unique<GraphicsMemory>(device);
 
-    m_states = std::make_unique<CommonStates>(device);
+            m_frameGraphExecutor = std::make_unique<DX::FrameGraphExecutor>(device, m_deviceResources->GetFramesInFlight());
 
-    m_resourceDescriptors = std::make_unique<DescriptorHeap>(device,
-        Descriptors::Count);
+            m_states = std::make_unique<CommonStates>(device);
 
-    m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(device);
+            m_resourceDescriptors = std::make_unique<DX::DescriptorAllocator>(device,
+                c_PersistentDescriptors, c_TransientDescriptors);
 
-    m_shape = GeometricPrimitive::CreateTeapot(4.f, 8);
+            m_residency = std::make_unique<DX::ResidencyManager>(device, m_deviceResources->GetDXGIFactory(), c_TextureBudget);
+
+            m_placeholderDescriptor = m_resourceDescriptors->AllocatePersistent();
+            m_flatNormalDescriptor = m_resourceDescriptors->AllocatePersistent();
+            m_windowsLogo.descriptor = m_resourceDescriptors->AllocatePersistent();
+            m_seaFloor.descriptor = m_resourceDescriptors->AllocatePersistent();
+            m_segoeFontDescriptor = m_resourceDescriptors->AllocatePersistent();
+
+            m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(device);
+        }, dependencies);
+
+    // Effect pipelines don't depend on any assets, so they start compiling as soon as the device exists.
+    const auto effects = graph.AddTask("Queue effect pipelines",
+        [this]()
+        {
+            auto device = m_deviceResources->GetD3DDevice();
+            const auto rtState = GetRenderTargetState();
+
+            m_lineEffectPipeline = m_pipelineQueue->Enqueue([device, rtState]()
+                {
+                    EffectPipelineStateDescription pd(
+                        &VertexPositionColor::InputLayout,
+                        CommonStates::Opaque,
+                        CommonStates::DepthNone,
+                        CommonStates::CullNone,
+                        rtState,
+                        D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE);
+
+                    return std::make_unique<BasicEffect>(device, EffectFlags::VertexColor, pd);
+                });
+
+            m_shapeEffectPipeline = m_pipelineQueue->Enqueue([device, rtState]()
+                {
+                    EffectPipelineStateDescription pd(
+                        &GeometricPrimitive::VertexType::InputLayout,
+                        CommonStates::Opaque,
+                        CommonStates::DepthDefault,
+                        CommonStates::CullNone,
+                        rtState);
+
+                    return std::make_unique<BasicEffect>(device, EffectFlags::PerPixelLighting | EffectFlags::Texture, pd);
+                });
+
+            m_shapeInstancedEffectPipeline = m_pipelineQueue->Enqueue([device, rtState]()
+                {
+                    std::vector<D3D12_INPUT_ELEMENT_DESC> elements(
+                        GeometricPrimitive::VertexType::InputElements,
+                        GeometricPrimitive::VertexType::InputElements + GeometricPrimitive::VertexType::InputElementCount);
+                    elements.insert(elements.end(), std::begin(s_instanceElements), std::end(s_instanceElements));
+
+                    const D3D12_INPUT_LAYOUT_DESC inputLayout = { elements.data(), static_cast<UINT>(elements.size()) };
+                    EffectPipelineStateDescription pd(
+                        &inputLayout,
+                        CommonStates::Opaque,
+                        CommonStates::DepthDefault,
+                        CommonStates::CullNone,
+                        rtState);
+
+                    return std::make_unique<NormalMapEffect>(device, EffectFlags::Instancing, pd);
+                });
+        }, dependencies);
 
     // SDKMESH has to use clockwise winding with right-handed coordinates, so textures are flipped in U
-    m_model = Model::CreateFromSDKMESH(device, L"tiny.sdkmesh");
+    //
+    // The file is validated and parsed where it lies in a read-only mapping (unless the pack stores
+    // it compressed), so the loader's copy of the vertex and index data into upload memory is the
+    // only one made. That upload memory comes from GraphicsMemory, hence the dependency.
+    const auto modelFile = graph.AddTask("Model file",
+        [this]()
+        {
+            const auto file = LoadAsset(L"tiny_optimized.sdkmesh");
+            const DX::SDKMeshView mesh(file.GetData(), file.GetSize());
+
+        #ifdef _DEBUG
+            char buff[128] = {};
+            sprintf_s(buff, "INFO: tiny_optimized.sdkmesh %s %zu KB: %u meshes, %llu KB vertices, %llu KB indices\n",
+                file.IsMapped() ? "maps" : "decompressed", mesh.GetDataSize() / 1024, mesh.GetMeshCount(),
+                mesh.GetTotalVertexBytes() / 1024, mesh.GetTotalIndexBytes() / 1024);
+            OutputDebugStringA(buff);
+        #endif
+
+            m_model = Model::CreateFromSDKMESH(m_deviceResources->GetD3DDevice(), mesh.GetData(), mesh.GetDataSize());
+            m_model->name = L"tiny_optimized.sdkmesh";
+
+            // Only the bounds are kept; the meshlets' vertices and triangles are for a mesh shader.
+            const auto meshletFile = LoadAsset(L"tiny.meshlets");
+            const DX::MeshletFileView meshlets(meshletFile.GetData(), meshletFile.GetSize());
+            m_modelMeshlets.assign(meshlets.GetBounds(), meshlets.GetBounds() + meshlets.GetMeshletCount());
+        }, { core });
+
+    // Textures stream in behind the first frames rather than holding up startup; until each one
+    // arrives, whatever uses it draws with this placeholder.
+    const auto placeholder = AddUploadTask(graph, "Placeholder", m_placeholderUploadFence,
+        [this](ID3D12Device* device, ResourceUploadBatch& resourceUpload)
+        {
+            static const uint32_t s_checker[] = { 0xFF808080, 0xFF404040, 0xFF404040, 0xFF808080 };
+            const D3D12_SUBRESOURCE_DATA initData = { s_checker, 2 * sizeof(uint32_t), sizeof(s_checker) };
+            DX::ThrowIfFailed(
+                CreateTextureFromMemory(device, resourceUpload, 2, 2, DXGI_FORMAT_R8G8B8A8_UNORM, initData,
+                    m_placeholderTexture.ReleaseAndGetAddressOf())
+            );
+
+            CreateShaderResourceView(device, m_placeholderTexture.Get(), m_resourceDescriptors->GetCpuHandle(m_placeholderDescriptor));
+
+            // A normal map which leaves the vertex normals as they are, for the instanced effects.
+            static const uint32_t s_flatNormal = 0xFFFF8080;
+            const D3D12_SUBRESOURCE_DATA normalData = { &s_flatNormal, sizeof(uint32_t), sizeof(uint32_t) };
+            DX::ThrowIfFailed(
+                CreateTextureFromMemory(device, resourceUpload, 1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, normalData,
+                    m_flatNormalTexture.ReleaseAndGetAddressOf())
+            );
+
+            CreateShaderResourceView(device, m_flatNormalTexture.Get(), m_resourceDescriptors->GetCpuHandle(m_flatNormalDescriptor));
+        }, { core });
+
+    // The logo is on screen from the first frame, so it goes ahead of the teapot's texture.
+    const auto textures = graph.AddTask("Request textures",
+        [this]()
+        {
+            RequestTexture(m_windowsLogo, L"windowslogo.dds", 1);
+            RequestTexture(m_seaFloor, L"seafloor.dds", 0);
+        }, { core }, true);
+
+    const auto sprites = AddUploadTask(graph, "Sprites", m_spriteUploadFence,
+        [this](ID3D12Device* device, ResourceUploadBatch& resourceUpload)
+        {
+            const auto font = LoadAsset(L"SegoeUI_18.spritefont");
+            m_font = std::make_unique<SpriteFont>(device, resourceUpload,
+                font.GetData(), font.GetSize(),
+                m_resourceDescriptors->GetCpuHandle(m_segoeFontDescriptor),
+                m_resourceDescriptors->GetGpuHandle(m_segoeFontDescriptor));
+        }, { core });
+
+    // SpriteBatch creates its pipeline while recording into an upload batch, so rather than going
+    // through the compile queue it gets a batch of its own, and compiles alongside the sprite loads.
+    const auto spriteBatch = AddUploadTask(graph, "Sprite batch", m_spriteBatchUploadFence,
+        [this](ID3D12Device* device, ResourceUploadBatch& resourceUpload)
+        {
+            SpriteBatchPipelineStateDescription pd(GetRenderTargetState());
+
+            m_sprites = std::make_unique<SpriteBatch>(device, resourceUpload, pd);
+        }, dependencies);
+
+    const auto shape = graph.AddTask("Teapot",
+        [this]()
+        {
+            m_shape = GeometricPrimitive::CreateTeapot(4.f, 8);
+        }, { core });
+
+    const auto model = AddUploadTask(graph, "Model", m_modelUploadFence,
+        [this](ID3D12Device* device, ResourceUploadBatch& resourceUpload)
+        {
+            m_model->LoadStaticBuffers(device, resourceUpload);
+
+            // Rather than Model::LoadTextures, which opens each texture file itself, the textures are
+            // loaded from memory into a heap laid out the way CreateEffects expects: one SRV per
+            // entry in textureNames, in order. The SDKMESH textures are all DDS. The flat normal map
+            // the instanced effects use goes after them.
+            const size_t textureCount = m_model->textureNames.size();
+            m_modelResources = std::make_unique<DescriptorHeap>(device, textureCount + 1);
+            CreateShaderResourceView(device, m_flatNormalTexture.Get(), m_modelResources->GetCpuHandle(textureCount));
+            m_modelTextures.resize(textureCount);
+
+            for (size_t j = 0; j < textureCount; ++j)
+            {
+                const auto texture = LoadAsset(m_model->textureNames[j].c_str());
+                DX::ThrowIfFailed(
+                    CreateDDSTextureFromMemory(device, resourceUpload, texture.GetData(), texture.GetSize(),
+                        m_modelTextures[j].ReleaseAndGetAddressOf())
+                );
+
+                CreateShaderResourceView(device, m_modelTextures[j].Get(), m_modelResources->GetCpuHandle(j));
+            }
+
+            // The model's effects compile while its uploads are submitted.
+            const auto rtState = GetRenderTargetState();
+            m_modelEffectsPipeline = m_pipelineQueue->Enqueue([this, rtState]()
+                {
+                    const EffectPipelineStateDescription psd(
+                        nullptr,
+                        CommonStates::Opaque,
+                        CommonStates::DepthDefault,
+                        CommonStates::CullNone,
+                        rtState);
+
+                    return m_model->CreateEffects(psd, psd, m_modelResources->Heap(), m_states->Heap());
+                });
+
+            // The instanced path has an effect for each material (and vertex layout) in the model,
+            // with the per-instance transforms appended to the part's layout as a second stream.
+            m_modelInstancedParts.clear();
+            m_modelInstancedEffectPipelines.clear();
+
+            std::vector<std::pair<uint32_t, const void*>> materials;
+            for (const auto& mesh : m_model->meshes)
+            {
+                for (const auto parts : { &mesh->opaqueMeshParts, &mesh->alphaMeshParts })
+                {
+                    for (const auto& part : *parts)
+                    {
+                        const auto key = std::make_pair(part->materialIndex, static_cast<const void*>(part->vbDecl.get()));
+                        const size_t effect = static_cast<size_t>(std::find(materials.cbegin(), materials.cend(), key) - materials.cbegin());
+                        m_modelInstancedParts.push_back({ part.get(), effect });
+
+                        if (effect < materials.size())
+                            continue;
+
+                        materials.push_back(key);
+
+                        std::vector<D3D12_INPUT_ELEMENT_DESC> elements(part->vbDecl->cbegin(), part->vbDecl->cend());
+                        elements.insert(elements.end(), std::begin(s_instanceElements), std::end(s_instanceElements));
+
+                        // Untextured materials fall back on the flat normal map, which is at least valid.
+                        const auto& material = m_model->materials[part->materialIndex];
+                        const size_t diffuse = (material.diffuseTextureIndex >= 0) ? size_t(material.diffuseTextureIndex) : textureCount;
+                        const auto diffuseHandle = m_modelResources->GetGpuHandle(diffuse);
+                        const auto normalHandle = m_modelResources->GetGpuHandle(textureCount);
+                        const auto sampler = m_states->LinearWrap();
+
+                        m_modelInstancedEffectPipelines.emplace_back(m_pipelineQueue->Enqueue(
+                            [device, rtState, elements, diffuseHandle, normalHandle, sampler]()
+                            {
+                                const D3D12_INPUT_LAYOUT_DESC inputLayout = { elements.data(), static_cast<UINT>(elements.size()) };
+                                EffectPipelineStateDescription pd(
+                                    &inputLayout,
+                                    CommonStates::Opaque,
+                                    CommonStates::DepthDefault,
+                                    CommonStates::CullNone,
+                                    rtState);
+
+                                auto effect = std::make_unique<NormalMapEffect>(device, EffectFlags::Instancing, pd);
+                                effect->EnableDefaultLighting();
+                                effect->SetTexture(diffuseHandle, sampler);
+                                effect->SetNormalTexture(normalHandle);
+                                return effect;
+                            }));
+                    }
+                }
+            }
+
+            std::stable_sort(m_modelInstancedParts.begin(), m_modelInstancedParts.end(),
+                [](const InstancedPart& a, const InstancedPart& b) { return a.effect < b.effect; });
+        }, { core, modelFile, placeholder });
+
+    // Pipelines resolve here, before their first use. This waits on the compile queue, so it stays
+    // on the calling thread rather than holding up a worker the queue may need.
+    return graph.AddTask("Resolve pipelines",
+        [this]()
+        {
+            m_lineEffect = m_lineEffectPipeline.get();
+
+            m_shapeEffect = m_shapeEffectPipeline.get();
+            m_shapeEffect->EnableDefaultLighting();
+
+            m_modelEffects = m_modelEffectsPipeline.get();
+
+            m_shapeInstancedEffect = m_shapeInstancedEffectPipeline.get();
+            m_shapeInstancedEffect->EnableDefaultLighting();
+            m_shapeInstancedEffect->SetNormalTexture(m_resourceDescriptors->GetGpuHandle(m_flatNormalDescriptor));
+
+            m_modelInstancedEffects.clear();
+            for (auto& pipeline : m_modelInstancedEffectPipelines)
+            {
+                m_modelInstancedEffects.emplace_back(pipeline.get());
+            }
+            m_modelInstancedEffectPipelines.clear();
+
+        #ifdef _DEBUG
+            const auto stats = m_pipelineQueue->GetStatistics();
+            char buff[128] = {};
+            sprintf_s(buff, "Pipeline compile queue: %u requests, %.2f ms total, %.2f ms longest\n",
+                stats.requests, stats.totalCompileMs, stats.longestCompileMs);
+            OutputDebugStringA(buff);
+        #endif
+            m_pipelineQueue->ResetStatistics();
+
+            // Publish the views to the shader-visible heap.
+            m_resourceDescriptors->Commit();
+        }, { effects, placeholder, textures, sprites, spriteBatch, shape, model }, true);
+}
+
+// Records an upload batch on a worker, then submits it to the copy queue from the calling thread,
+// which owns the queue fences. The returned task completes once fenceValue has been assigned.
+DX::TaskGraph::TaskId Game::AddUploadTask(DX::TaskGraph& graph, const char* name, uint64_t& fenceValue,
+    std::function<void(ID3D12Device*, ResourceUploadBatch&)> record,
+    std::initializer_list<DX::TaskGraph::TaskId> dependencies)
+{
+    auto upload = std::make_shared<std::future<void>>();
+
+    const auto recorded = graph.AddTask(name,
+        [this, upload, record]()
+        {
+            auto device = m_deviceResources->GetD3DDevice();
+
+            ResourceUploadBatch resourceUpload(device);
+
+            resourceUpload.Begin(D3D12_COMMAND_LIST_TYPE_COPY);
+
+            record(device, resourceUpload);
+
+            // The future keeps the batch's upload memory alive until the copy has finished.
+            *upload = resourceUpload.End(m_deviceResources->GetCopyQueue());
+        }, dependencies);
+
+    const std::string submitName = std::string("Submit ") + name;
+
+    return graph.AddTask(submitName.c_str(),
+        [this, upload, &fenceValue]()
+        {
+            fenceValue = SignalUpload(std::move(*upload));
+        }, { recorded }, true);
+}
+
+RenderTargetState Game::GetRenderTargetState() const
+{
+    return RenderTargetState(m_deviceResources->GetBackBufferFormat(), m_deviceResources->GetDepthBufferFormat());
+}
+
+// Returns an asset's bytes from the pack, or from a mapping of the loose file if the pack doesn't
+// have it (or wasn't built).
+DX::AssetData Game::LoadAsset(const wchar_t* name) const
+{
+    return m_assetPack ? m_assetPack->LoadOrOpen(name) : DX::AssetData::FromFile(name);
+}
+
+// Signals the copy queue after submitting an upload batch, and makes the graphics queue wait for
+// that value on the GPU so nothing it runs from now on can read the resources before the copy
+// lands. The batch's future, which owns its upload memory, is released by the copy fence timeline
+// once the value completes; the batch's own fence precedes it, so by then the future is ready.
+uint64_t Game::SignalUpload(std::future<void> upload)
+{
+    const uint64_t fenceValue = m_deviceResources->SignalQueue(DX::CommandQueue_Copy);
+    m_deviceResources->QueueWait(DX::CommandQueue_Graphics, DX::CommandQueue_Copy, fenceValue);
+
+    const auto batch = std::make_shared<std::future<void>>(std::move(upload));
+    m_deviceResources->GetFenceTimeline(DX::CommandQueue_Copy)->OnCompletion(fenceValue,
+        [batch]()
+        {
+            batch->wait();
+        });
+
+    return fenceValue;
+}
+
+// Returns true once an upload has completed. This is only the CPU gate for drawing with the
+// resources; the GPU ordering was already set up by SignalUpload.
+bool Game::IsUploaded(uint64_t fenceValue)
+{
+    return m_deviceResources->IsFenceComplete(DX::CommandQueue_Copy, fenceValue);
+}
 
+// Queues a texture with the streamer. The read stage fetches its bytes; the decode stage creates
+// the texture and records the copy of its mip tail into a batch of its own, which the render loop
+// then submits. StreamMipLevels copies the rest.
+void Game::RequestTexture(StreamedTexture& texture, const wchar_t* name, int priority)
+{
+    // A handle is only ever from the current residency manager; OnDeviceLost drops both together.
+    if (texture.residency != DX::ResidencyManager::c_InvalidHandle)
     {
-        ResourceUploadBatch resourceUpload(device);
+        m_residency->Remove(texture.residency);
+        texture.residency = DX::ResidencyManager::c_InvalidHandle;
+    }
 
-        resourceUpload.Begin();
+    // Frames in flight may still be drawing with the old texture.
+    if (texture.texture)
+    {
+        m_deviceResources->GetFenceTimeline(DX::CommandQueue_Graphics)->DeferRelease(
+            m_deviceResources->GetCurrentFenceValue(), texture.texture->GetResource());
+        texture.texture.reset();
+    }
+    texture.uploadFence = 0;
+    texture.copying = false;
+    texture.resident = false;
 
-        m_model->LoadStaticBuffers(device, resourceUpload);
+    const std::wstring fileName(name);
 
-        DX::ThrowIfFailed(
-            CreateDDSTextureFromFile(device, resourceUpload, L"seafloor.dds", m_texture1.ReleaseAndGetAddressOf())
-        );
+    texture.request = m_assetStreamer->Request(priority,
+        [this, fileName]()
+        {
+            return LoadAsset(fileName.c_str());
+        },
+        [this](DX::AssetData data)
+        {
+            auto device = m_deviceResources->GetD3DDevice();
+
+            StreamedTexture::Upload upload;
+            upload.texture = std::make_unique<DX::ProgressiveTexture>(device, std::move(data));
 
-        CreateShaderResourceView(device, m_texture1.Get(), m_resourceDescriptors->GetCpuHandle(Descriptors::SeaFloor));
+            ResourceUploadBatch resourceUpload(device);
+            resourceUpload.Begin(D3D12_COMMAND_LIST_TYPE_COPY);
 
-        DX::ThrowIfFailed(
-            CreateDDSTextureFromFile(device, resourceUpload, L"windowslogo.dds", m_texture2.ReleaseAndGetAddressOf())
-        );
+            upload.texture->RecordTail(resourceUpload);
 
-        CreateShaderResourceView(device, m_texture2.Get(), m_resourceDescriptors->GetCpuHandle(Descriptors::WindowsLogo));
+            upload.copy = resourceUpload.End(m_deviceResources->GetCopyQueue());
+            return upload;
+        });
+}
 
-        const RenderTargetState rtState(m_deviceResources->GetBackBufferFormat(),
-            m_deviceResources->GetDepthBufferFormat());
+// Advances a streamed texture, returning true once it can be drawn. A decoded texture is handed to
+// the copy queue fence here, on the thread which owns it. Each time a copy completes the view is
+// rewritten to cover the new levels, into a fresh descriptor since frames in flight may still be
+// reading the old one. A failed request keeps the placeholder.
+bool Game::UpdateStreamedTexture(StreamedTexture& texture)
+{
+    if (!texture.texture)
+    {
+        if (!texture.request.IsValid() || texture.request.IsPending())
+            return false;
 
+        try
         {
-            SpriteBatchPipelineStateDescription pd(rtState);
+            auto& upload = texture.request.Get();
+            texture.texture = std::move(upload.texture);
+            texture.uploadFence = SignalUpload(std::move(upload.copy));
+            texture.copying = true;
+        }
+        catch (const std::exception& e)
+        {
+        #ifdef _DEBUG
+            char buff[256] = {};
+            sprintf_s(buff, "WARNING: Streamed texture failed to load: %s\n", e.what());
+            OutputDebugStringA(buff);
+        #else
+            UNREFERENCED_PARAMETER(e);
+        #endif
+        }
 
-            m_sprites = std::make_unique<SpriteBatch>(device, resourceUpload, pd);
+        texture.request.Reset();
+
+        if (!texture.texture)
+            return false;
+    }
+
+    if (!texture.copying || !IsUploaded(texture.uploadFence))
+        return texture.resident;
+
+    texture.copying = false;
+    texture.texture->MakeRecordedResident();
+
+    if (texture.residency == DX::ResidencyManager::c_InvalidHandle)
+    {
+        texture.residency = m_residency->Add(texture.texture->GetResource(), m_deviceResources->GetCurrentFenceValue());
+    }
+    else
+    {
+        m_residency->SetPinned(texture.residency, false);
+    }
+
+    uint32_t descriptor = texture.descriptor;
+    if (texture.resident)
+    {
+        descriptor = m_resourceDescriptors->AllocatePersistent();
+        m_resourceDescriptors->FreePersistent(texture.descriptor);
+    }
+
+    texture.texture->CreateShaderResourceView(m_deviceResources->GetD3DDevice(), m_resourceDescriptors->GetCpuHandle(descriptor));
+    m_resourceDescriptors->MarkDirty(descriptor);
+    texture.descriptor = descriptor;
+
+#ifdef _DEBUG
+    if (!texture.resident && !m_assetStreamer->GetPendingCount())
+    {
+        const auto stats = m_assetStreamer->GetStatistics();
+        char buff[128] = {};
+        sprintf_s(buff, "Asset streamer: %u requests, %u failed, %.2f ms average, %.2f ms longest\n",
+            stats.requests, stats.failed, stats.completed ? stats.totalLatencyMs / stats.completed : 0.0,
+            stats.longestLatencyMs);
+        OutputDebugStringA(buff);
+    }
+#endif
+
+    texture.resident = true;
+    return true;
+}
+
+// Records the next finer mip levels of the streamed textures, smallest first across all of them,
+// into one copy batch of at most c_MipUploadBudget bytes. A new batch starts only once the last
+// has been copied, which bounds the copy bandwidth streaming takes from the frame; a single level
+// larger than the budget still goes, on its own. Textures are pinned resident while copied to.
+void Game::StreamMipLevels()
+{
+    StreamedTexture* textures[] = { &m_windowsLogo, &m_seaFloor };
+
+    for (const auto texture : textures)
+    {
+        if (texture->copying)
+            return;
+    }
+
+    auto next = [this, &textures]()
+    {
+        StreamedTexture* smallest = nullptr;
+        size_t smallestSize = 0;
+        for (const auto texture : textures)
+        {
+            const size_t size = (texture->resident && m_residency->IsResident(texture->residency))
+                ? texture->texture->GetNextLevelSize() : 0;
+            if (size && (!smallest || size < smallestSize))
+            {
+                smallest = texture;
+                smallestSize = size;
+            }
         }
+        return std::make_pair(smallest, smallestSize);
+    };
+
+    auto level = next();
+    if (!level.first)
+        return;
+
+    ResourceUploadBatch resourceUpload(m_deviceResources->GetD3DDevice());
+    resourceUpload.Begin(D3D12_COMMAND_LIST_TYPE_COPY);
+
+    size_t bytes = 0;
+    do
+    {
+        level.first->texture->RecordNextLevel(resourceUpload);
+        level.first->copying = true;
+        m_residency->SetPinned(level.first->residency, true);
+        bytes += level.second;
 
+        level = next();
+    }
+    while (level.first && bytes + level.second <= c_MipUploadBudget);
+
+    const uint64_t fenceValue = SignalUpload(resourceUpload.End(m_deviceResources->GetCopyQueue()));
+    for (const auto texture : textures)
+    {
+        if (texture->copying)
         {
-            EffectPipelineStateDescription pd(
-                &VertexPositionColor::InputLayout,
-                CommonStates::Opaque,
-                CommonStates::DepthNone,
-                CommonStates::CullNone,
-                rtState,
-                D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE);
+            texture->uploadFence = fenceValue;
+        }
+    }
+}
+
+// Fills this frame's instance transforms, each spinning in place on the grid in front of the
+// camera. Only the instances whose bounding spheres are in view are written: the visible teapots,
+// then the visible models. Both the culling and the transforms run in parallel.
+void Game::UpdateInstanceTransforms()
+{
+    constexpr uint32_t perRow = c_StressGridSize / 2;
+    constexpr float spacing = 0.75f;
+
+    // Instance index is the teapot's or the model's index within its own half of the grid.
+    auto position = [](uint32_t index, bool isModel)
+        {
+            const uint32_t z = index / perRow;
+            const uint32_t j = index % perRow;
+
+            // Alternate rows start with a model, so the two make a checkerboard.
+            const uint32_t column = isModel ? 2 * j + 1 - (z & 1) : 2 * j + (z & 1);
+            return XMFLOAT3((float(column) - float(c_StressGridSize) / 2.f) * spacing, -2.f, -2.f - float(z) * spacing);
+        };
 
-            m_lineEffect = std::make_unique<BasicEffect>(device, EffectFlags::VertexColor, pd);
+    // The instances only spin about their origins, so the spheres are set up once, with radii
+    // covering every orientation.
+    if (!m_instanceCuller.GetSphereCount())
+    {
+        // The teapot is 4 units across before it is scaled.
+        const float teapotRadius = 4.f * 0.1f;
+
+        float modelRadius = 0.f;
+        for (const auto& mesh : m_model->meshes)
+        {
+            const auto& sphere = mesh->boundingSphere;
+            modelRadius = std::max(modelRadius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&sphere.Center))) + sphere.Radius);
         }
+        modelRadius *= 0.0025f;
 
+        for (uint32_t index = 0; index < c_StressInstances; ++index)
         {
-            EffectPipelineStateDescription pd(
-                &GeometricPrimitive::VertexType::InputLayout,
-                CommonStates::Opaque,
-                CommonStates::DepthDefault,
-                CommonStates::CullNone,
-                rtState);
+            const auto center = position(index, false);
+            m_instanceCuller.AddSphere(center.x, center.y, center.z, teapotRadius);
+        }
 
-            m_shapeEffect = std::make_unique<BasicEffect>(device, EffectFlags::PerPixelLighting | EffectFlags::Texture, pd);
-            m_shapeEffect->EnableDefaultLighting();
-            m_shapeEffect->SetTexture(m_resourceDescriptors->GetGpuHandle(Descriptors::SeaFloor), m_states->LinearWrap());
+        for (uint32_t index = 0; index < c_StressInstances; ++index)
+        {
+            const auto center = position(index, true);
+            m_instanceCuller.AddSphere(center.x, center.y, center.z, modelRadius);
         }
+    }
+
+    XMFLOAT4X4 viewProjection;
+    XMStoreFloat4x4(&viewProjection, m_view * m_projection);
+    m_instanceCuller.CullSpheres(DX::Frustum::FromViewProjection(viewProjection.m), m_visibleInstances, *m_threadPool);
+
+    // The list is in ascending order, so the teapots (the first c_StressInstances) lead.
+    const auto models = std::lower_bound(m_visibleInstances.cbegin(), m_visibleInstances.cend(), c_StressInstances);
+    m_visibleTeapots = static_cast<uint32_t>(models - m_visibleInstances.cbegin());
+    m_visibleModels = static_cast<uint32_t>(m_visibleInstances.cend() - models);
 
-        m_modelResources = m_model->LoadTextures(device, resourceUpload);
+    const size_t visible = m_visibleInstances.size();
+    m_instanceTransforms = m_graphicsMemory->Allocate(sizeof(XMFLOAT3X4) * std::max<size_t>(visible, 1));
+    const auto transforms = static_cast<XMFLOAT3X4*>(m_instanceTransforms.Memory());
 
+    const float angle = float(m_timer.GetTotalSeconds() * XM_PIDIV4);
+    const XMMATRIX teapot = XMMatrixScaling(0.1f, 0.1f, 0.1f);
+    const XMMATRIX model = XMMatrixScaling(0.0025f, 0.0025f, 0.0025f)
+        * XMMatrixRotationQuaternion(Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f));
+
+    constexpr size_t chunkSize = 64;
+
+    m_threadPool->ParallelFor(0, (visible + chunkSize - 1) / chunkSize, [&](size_t chunk)
         {
-            const EffectPipelineStateDescription psd(
-                nullptr,
-                CommonStates::Opaque,
-                CommonStates::DepthDefault,
-                CommonStates::CullNone,
-                rtState);
+            const size_t end = std::min(visible, (chunk + 1) * chunkSize);
+            for (size_t k = chunk * chunkSize; k < end; ++k)
+            {
+                const bool isModel = m_visibleInstances[k] >= c_StressInstances;
+                const uint32_t index = m_visibleInstances[k] - (isModel ? c_StressInstances : 0);
 
-            m_modelEffects = m_model->CreateEffects(psd, psd, m_modelResources->Heap(), m_states->Heap());
+                const XMMATRIX spin = XMMatrixRotationY(angle + float(index) * 0.1f);
+                const auto place = position(index, isModel);
+
+                XMStoreFloat3x4(&transforms[k], (isModel ? model : teapot) * spin * XMMatrixTranslation(place.x, place.y, place.z));
+            }
+        });
+}
+
+// Places the teapot and the model in the world, turning with m_world.
+XMMATRIX Game::GetWorld(SceneObject object) const
+{
+    if (object == SceneObject_Teapot)
+    {
+        return m_world * Matrix::CreateTranslation(-2.f, -2.f, -4.f);
+    }
+
+    const XMVECTORF32 scale = { 0.01f, 0.01f, 0.01f };
+    const XMVECTORF32 translate = { 3.f, -2.f, -4.f };
+    const XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(XM_PI / 2.f, 0.f, -XM_PI / 2.f);
+    return m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
+}
+
+BoundingBox Game::GetLocalBounds(SceneObject object) const
+{
+    // The teapot is 4 units across.
+    if (object == SceneObject_Teapot)
+    {
+        return BoundingBox(XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(2.f, 2.f, 2.f));
+    }
+
+    return m_modelBounds;
+}
+
+// Keeps the scene index's boxes around the teapot and the model as they turn, adding each once it
+// can be drawn. Only the boxes above them are refit.
+void Game::UpdateScene(bool shapeReady, bool modelReady)
+{
+    auto update = [this](DX::DynamicBVH::Handle& node, SceneObject object)
+        {
+            BoundingBox bounds;
+            GetLocalBounds(object).Transform(bounds, GetWorld(object));
+
+            DX::DynamicBVH::Box box;
+            box.lower[0] = bounds.Center.x - bounds.Extents.x;
+            box.lower[1] = bounds.Center.y - bounds.Extents.y;
+            box.lower[2] = bounds.Center.z - bounds.Extents.z;
+            box.upper[0] = bounds.Center.x + bounds.Extents.x;
+            box.upper[1] = bounds.Center.y + bounds.Extents.y;
+            box.upper[2] = bounds.Center.z + bounds.Extents.z;
+
+            if (node == DX::DynamicBVH::c_InvalidHandle)
+            {
+                node = m_scene.Insert(box, object);
+            }
+            else
+            {
+                m_scene.Move(node, box);
+            }
+        };
+
+    if (shapeReady)
+    {
+        update(m_teapotNode, SceneObject_Teapot);
+    }
+
+    if (modelReady)
+    {
+        if (m_modelNode == DX::DynamicBVH::c_InvalidHandle)
+        {
+            m_modelBounds = m_model->meshes.front()->boundingBox;
+            for (const auto& mesh : m_model->meshes)
+            {
+                BoundingBox::CreateMerged(m_modelBounds, m_modelBounds, mesh->boundingBox);
+            }
         }
 
-        m_font = std::make_unique<SpriteFont>(device, resourceUpload,
-            L"SegoeUI_18.spritefont",
-            m_resourceDescriptors->GetCpuHandle(Descriptors::SegoeFont),
-            m_resourceDescriptors->GetGpuHandle(Descriptors::SegoeFont));
+        update(m_modelNode, SceneObject_Model);
+    }
+}
 
-        // Upload the resources to the GPU.
-        auto uploadResourcesFinished = resourceUpload.End(m_deviceResources->GetCommandQueue());
+// Casts a ray through the cursor. The scene index finds the nearest boxes it passes through, and
+// each object's own bounds, turned with it, decide whether it was hit.
+void Game::Pick(int x, int y)
+{
+    const auto viewport = m_deviceResources->GetScreenViewport();
+    auto unproject = [&](float z)
+        {
+            return XMVector3Unproject(XMVectorSet(float(x), float(y), z, 0.f),
+                viewport.TopLeftX, viewport.TopLeftY, viewport.Width, viewport.Height, viewport.MinDepth, viewport.MaxDepth,
+                m_projection, m_view, XMMatrixIdentity());
+        };
+
+    const XMVECTOR nearPoint = unproject(0.f);
+    const XMVECTOR farPoint = unproject(1.f);
+    const XMVECTOR direction = XMVector3Normalize(farPoint - nearPoint);
+
+    XMFLOAT3 from, toward;
+    XMStoreFloat3(&from, nearPoint);
+    XMStoreFloat3(&toward, direction);
+    const float origin[3] = { from.x, from.y, from.z };
+    const float dir[3] = { toward.x, toward.y, toward.z };
+
+    float distance = 0.f;
+    const auto leaf = m_scene.Raycast(origin, dir, XMVectorGetX(XMVector3Length(farPoint - nearPoint)), distance,
+        [&](DX::DynamicBVH::Handle candidate, float)
+        {
+            const auto object = static_cast<SceneObject>(m_scene.GetValue(candidate));
 
-        // Wait for the command list to finish executing
-        m_deviceResources->WaitForGpu();
+            BoundingOrientedBox bounds;
+            BoundingOrientedBox::CreateFromBoundingBox(bounds, GetLocalBounds(object));
+            bounds.Transform(bounds, GetWorld(object));
+
+            float hit = 0.f;
+            return bounds.Intersects(nearPoint, direction, hit) ? hit : -1.f;
+        });
+
+    static const wchar_t* const s_names[] = { L"teapot", L"model" };
+    m_picked = (leaf != DX::DynamicBVH::c_InvalidHandle) ? s_names[m_scene.GetValue(leaf)] : nullptr;
+}
 
-        // Wait for the upload thread to terminate
-        uploadResourcesFinished.wait();
+// Records that this frame draws a streamed texture, once it has been registered for residency.
+void Game::UseTexture(const StreamedTexture& texture)
+{
+    if (texture.residency != DX::ResidencyManager::c_InvalidHandle)
+    {
+        m_residency->Use(texture.residency, m_deviceResources->GetCurrentFenceValue());
     }
 }
 
+// Records that this frame draws the model, and so every one of its textures.
+void Game::UseModelTextures()
+{
+    for (const auto handle : m_modelTextureResidency)
+    {
+        m_residency->Use(handle, m_deviceResources->GetCurrentFenceValue());
+    }
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE Game::GetTextureHandle(const StreamedTexture& texture) const
+{
+    return m_resourceDescriptors->GetGpuHandle(texture.resident ? texture.descriptor : m_placeholderDescriptor);
+}
+
 // Allocate all memory resources that change on a window SizeChanged event.
 void Game::CreateWindowSizeDependentResources()
 {
@@ -479,20 +1662,41 @@ void Game::CreateWindowSizeDependentResources()
 
 void Game::OnDeviceLost()
 {
-    m_texture1.Reset();
-    m_texture2.Reset();
+    // Decodes in flight are recording against the lost device; let them finish before releasing it.
+    m_assetStreamer->WaitIdle();
+
+    // Along with the textures, this forgets their residency handles, which belong to the manager
+    // released below; the restored device's manager starts from scratch.
+    m_windowsLogo = StreamedTexture();
+    m_seaFloor = StreamedTexture();
+    m_placeholderTexture.Reset();
 
     m_font.reset();
     m_batch.reset();
     m_shape.reset();
     m_model.reset();
+    m_modelMeshlets.clear();
     m_lineEffect.reset();
     m_shapeEffect.reset();
     m_modelEffects.clear();
     m_modelResources.reset();
+    m_modelTextures.clear();
+    m_modelTextureResidency.clear();
+    m_shapeInstancedEffect.reset();
+    m_modelInstancedEffects.clear();
+    m_modelInstancedParts.clear();
+    m_flatNormalTexture.Reset();
+    m_instanceTransforms.Reset();
+    m_instanceCuller.Clear();
+    m_scene.Clear();
+    m_teapotNode = DX::DynamicBVH::c_InvalidHandle;
+    m_modelNode = DX::DynamicBVH::c_InvalidHandle;
+    m_picked = nullptr;
     m_sprites.reset();
     m_resourceDescriptors.reset();
+    m_residency.reset();
     m_states.reset();
+    m_frameGraphExecutor.reset();
     m_graphicsMemory.reset();
 }
 
@@ -4,8 +4,25 @@
 
 #pragma once
 
+#include "AssetPack.h"
+#include "AssetStreamer.h"
+#include "DescriptorAllocator.h"
 #include "DeviceResources.h"
+#include "DynamicBVH.h"
+#include "FrameGraphExecutor.h"
+#include "FrustumCuller.h"
+#include "Meshlets.h"
+#include "PipelineCompileQueue.h"
+#include "ProgressiveTexture.h"
+#include "ResidencyManager.h"
 #include "StepTimer.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <vector>
 
 
 // A basic game implementation that creates a D3D12 device and
@@ -41,6 +58,8 @@ public:
     void OnWindowMoved();
     void OnDisplayChange();
     void OnWindowSizeChanged(int width, int height);
+    void OnEnterSizeMove();
+    void OnExitSizeMove();
     void NewAudioDevice();
 
     // Properties
@@ -51,19 +70,91 @@ private:
     void Update(DX::StepTimer const& timer);
     void Render();
 
-    void Clear();
+    void Clear(ID3D12GraphicsCommandList* commandList);
+    void SetRenderTargets(ID3D12GraphicsCommandList* commandList);
 
     void CreateDeviceDependentResources();
+    DX::TaskGraph::TaskId AddDeviceDependentTasks(DX::TaskGraph& graph, std::initializer_list<DX::TaskGraph::TaskId> dependencies);
+    DX::TaskGraph::TaskId AddUploadTask(DX::TaskGraph& graph, const char* name, uint64_t& fenceValue,
+        std::function<void(ID3D12Device*, DirectX::ResourceUploadBatch&)> record,
+        std::initializer_list<DX::TaskGraph::TaskId> dependencies);
+    DirectX::RenderTargetState GetRenderTargetState() const;
+    DX::AssetData LoadAsset(_In_z_ const wchar_t* name) const;
+    uint64_t SignalUpload(std::future<void> upload);
+    bool IsUploaded(uint64_t fenceValue);
     void CreateWindowSizeDependentResources();
+    void UpdateLatencyStatistics();
+
+    // A texture loaded by m_assetStreamer. Draws use the placeholder until its mip tail has been
+    // copied, and the finer levels follow a few at a time.
+    struct StreamedTexture
+    {
+        // What the streamer's decode stage produces: the texture, and the recorded copy of its tail.
+        struct Upload
+        {
+            std::unique_ptr<DX::ProgressiveTexture> texture;
+            std::future<void>                       copy;
+        };
+
+        DX::AssetHandle<Upload>                     request;
+        std::unique_ptr<DX::ProgressiveTexture>     texture;
+        uint64_t                                    uploadFence = 0;    // Of the copy in flight
+        uint32_t                                    descriptor = DX::DescriptorAllocator::c_InvalidIndex;
+        DX::ResidencyManager::Handle                residency = DX::ResidencyManager::c_InvalidHandle;
+        bool                                        copying = false;
+        bool                                        resident = false;
+    };
+
+    void RequestTexture(StreamedTexture& texture, _In_z_ const wchar_t* name, int priority);
+    bool UpdateStreamedTexture(StreamedTexture& texture);
+    void StreamMipLevels();
+    void UseTexture(const StreamedTexture& texture);
+    void UseModelTextures();
+
+    // A model mesh part drawn instanced, with the index of the effect for its material.
+    struct InstancedPart
+    {
+        const DirectX::ModelMeshPart*   part;
+        size_t                          effect;
+    };
 
-    void XM_CALLCONV DrawGrid(DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
+    void UpdateInstanceTransforms();
+
+    // Objects in the scene index, stored as its leaf values.
+    enum SceneObject : uint32_t
+    {
+        SceneObject_Teapot,
+        SceneObject_Model,
+    };
+
+    DirectX::XMMATRIX GetWorld(SceneObject object) const;
+    DirectX::BoundingBox GetLocalBounds(SceneObject object) const;
+    void UpdateScene(bool shapeReady, bool modelReady);
+    void Pick(int x, int y);
+    D3D12_GPU_DESCRIPTOR_HANDLE GetTextureHandle(const StreamedTexture& texture) const;
+
+    void XM_CALLCONV DrawGrid(ID3D12GraphicsCommandList* commandList, DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
 
+    // Single mapped file holding the assets, if one was built.
+    std::unique_ptr<DX::AssetPack>          m_assetPack;
+
     // Rendering loop timer.
     DX::StepTimer                           m_timer;
 
+    // Per-frame pass scheduling.
+    DX::FrameGraph                          m_frameGraph;
+    std::unique_ptr<DX::FrameGraphExecutor> m_frameGraphExecutor;
+
+    // Worker threads for parallel command list recording.
+    std::unique_ptr<DX::ThreadPool>             m_threadPool;
+    std::unique_ptr<DX::PipelineCompileQueue>   m_pipelineQueue;
+
+    // Background texture loading: reads on its own threads, decodes on m_threadPool.
+    std::unique_ptr<DX::AssetStreamer>          m_assetStreamer;
+
     // Input devices.
     std::unique_ptr<DirectX::GamePad>           m_gamePad;
     std::unique_ptr<DirectX::Keyboard>          m_keyboard;
@@ -71,17 +162,50 @@ private:
 
     DirectX::GamePad::ButtonStateTracker        m_gamePadButtons;
     DirectX::Keyboard::KeyboardStateTracker     m_keyboardButtons;
+    DirectX::Mouse::ButtonStateTracker          m_mouseButtons;
 
     // DirectXTK objects.
     std::unique_ptr<DirectX::GraphicsMemory>                                m_graphicsMemory;
     std::unique_ptr<DirectX::CommonStates>                                  m_states;
-    std::unique_ptr<DirectX::DescriptorHeap>                                m_resourceDescriptors;
+    std::unique_ptr<DX::DescriptorAllocator>                                m_resourceDescriptors;
+    std::unique_ptr<DX::ResidencyManager>                                   m_residency;
     std::unique_ptr<DirectX::BasicEffect>                                   m_lineEffect;
     std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionColor>>  m_batch;
     std::unique_ptr<DirectX::BasicEffect>                                   m_shapeEffect;
     std::unique_ptr<DirectX::Model>                                         m_model;
     DirectX::Model::EffectCollection                                        m_modelEffects;
-    std::unique_ptr<DirectX::EffectTextureFactory>                          m_modelResources;
+    std::unique_ptr<DirectX::DescriptorHeap>                                m_modelResources;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>                     m_modelTextures;
+    std::vector<DX::ResidencyManager::Handle>                               m_modelTextureResidency;
+
+    // Stress mode draws the teapot and the model c_StressInstances times each, instanced: one draw
+    // per mesh part, with the transforms in a second vertex stream. Instancing needs NormalMapEffect,
+    // so these have a flat normal map.
+    std::unique_ptr<DirectX::NormalMapEffect>                               m_shapeInstancedEffect;
+    std::vector<std::unique_ptr<DirectX::NormalMapEffect>>                  m_modelInstancedEffects;
+    std::vector<InstancedPart>                                              m_modelInstancedParts;
+    Microsoft::WRL::ComPtr<ID3D12Resource>                                  m_flatNormalTexture;
+    DirectX::GraphicsResource                                               m_instanceTransforms;
+
+    // Bounding spheres of the instances, teapots then models, culled against the view each frame;
+    // only the visible ones' transforms are written.
+    DX::FrustumCuller                                                       m_instanceCuller;
+    std::vector<uint32_t>                                                   m_visibleInstances;
+    uint32_t                                                                m_visibleTeapots;
+    uint32_t                                                                m_visibleModels;
+    bool                                                                    m_stressMode;
+
+    // World bounds of the teapot and the model, refit as they turn, for culling and mouse picking.
+    DX::DynamicBVH                                                          m_scene;
+    DX::DynamicBVH::Handle                                                  m_teapotNode;
+    DX::DynamicBVH::Handle                                                  m_modelNode;
+    DirectX::BoundingBox                                                    m_modelBounds;
+    const wchar_t*                                                          m_picked;
+
+    // Culling bounds of the model's meshlets, in its own space, from the sidecar the mesh optimizer
+    // wrote with it. The clusters are culled on the CPU each frame, ahead of submission.
+    std::vector<DX::Meshlets::MeshletBounds>                                m_modelMeshlets;
+    DX::Meshlets::CullStatistics                                            m_modelMeshletStatistics;
     std::unique_ptr<DirectX::GeometricPrimitive>                            m_shape;
     std::unique_ptr<DirectX::SpriteBatch>                                   m_sprites;
     std::unique_ptr<DirectX::SpriteFont>                                    m_font;
@@ -92,8 +216,22 @@ private:
     std::unique_ptr<DirectX::SoundEffectInstance>                           m_effect1;
     std::unique_ptr<DirectX::SoundEffectInstance>                           m_effect2;
 
-    Microsoft::WRL::ComPtr<ID3D12Resource>                                  m_texture1;
-    Microsoft::WRL::ComPtr<ID3D12Resource>                                  m_texture2;
+    StreamedTexture                                                         m_windowsLogo;
+    StreamedTexture                                                         m_seaFloor;
+    Microsoft::WRL::ComPtr<ID3D12Resource>                                  m_placeholderTexture;
+
+    // Copy queue fence values for each group of uploaded assets.
+    uint64_t                                                                m_spriteUploadFence;
+    uint64_t                                                                m_modelUploadFence;
+    uint64_t                                                                m_spriteBatchUploadFence;
+    uint64_t                                                                m_placeholderUploadFence;
+
+    // Pipelines being compiled by m_pipelineQueue, resolved into the members above before first use.
+    std::future<std::unique_ptr<DirectX::BasicEffect>>                      m_lineEffectPipeline;
+    std::future<std::unique_ptr<DirectX::BasicEffect>>                      m_shapeEffectPipeline;
+    std::future<DirectX::Model::EffectCollection>                           m_modelEffectsPipeline;
+    std::future<std::unique_ptr<DirectX::NormalMapEffect>>                  m_shapeInstancedEffectPipeline;
+    std::vector<std::future<std::unique_ptr<DirectX::NormalMapEffect>>>     m_modelInstancedEffectPipelines;
 
     uint32_t                                                                m_audioEvent;
     float                                                                   m_audioTimerAcc;
@@ -104,12 +242,39 @@ private:
     DirectX::SimpleMath::Matrix                                             m_view;
     DirectX::SimpleMath::Matrix                                             m_projection;
 
-    // Descriptors
-    enum Descriptors
-    {
-        WindowsLogo,
-        SeaFloor,
-        SegoeFont,
-        Count = 256
-    };
+    // Persistent descriptor indices
+    uint32_t                                                                m_placeholderDescriptor;
+    uint32_t                                                                m_flatNormalDescriptor;
+    uint32_t                                                                m_segoeFontDescriptor;
+
+    // Input-to-present latency: from reading input after the frame latency wait, to Present returning.
+    LARGE_INTEGER                                                           m_qpcFrequency;
+    LARGE_INTEGER                                                           m_inputTime;
+    double                                                                  m_latencyTotalMs;
+    double                                                                  m_latencyMaxMs;
+    uint32_t                                                                m_latencySamples;
+    float                                                                   m_inputLatencyMs;
+    float                                                                   m_inputLatencyMaxMs;
+
+    static constexpr uint32_t c_LatencyReportFrames = 60;
+
+    // Time from the start of Initialize to the first Present.
+    LARGE_INTEGER                                                           m_startupTime;
+    double                                                                  m_timeToFirstFrameMs;
+
+    static constexpr uint32_t c_PersistentDescriptors = 1024;
+    static constexpr uint32_t c_TransientDescriptors = 8192;
+
+    // Size the placeholder is drawn at in place of a sprite which is still streaming in.
+    static constexpr long c_PlaceholderSpriteSize = 64;
+
+    // Most bytes of finer mip levels copied per batch; only one batch is in flight at a time.
+    static constexpr size_t c_MipUploadBudget = 1024 * 1024;
+
+    // Stress mode lays the instances out on a square grid, alternating teapots and models.
+    static constexpr uint32_t c_StressGridSize = 64;
+    static constexpr uint32_t c_StressInstances = c_StressGridSize * c_StressGridSize / 2;
+
+    // Textures beyond this (or beyond the OS budget) are evicted, least recently drawn first.
+    static constexpr uint64_t c_TextureBudget = 256 * 1024 * 1024;
 };
@@ -0,0 +1,287 @@
+//
+// HeapAllocator.cpp - Placed-resource sub-allocation from ID3D12Heap objects
+//
+
+#include "pch.h"
+#include "HeapAllocator.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    constexpr uint64_t c_MinBlockSize = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+
+    inline bool IsRenderTargetOrDepth(const D3D12_RESOURCE_DESC& desc) noexcept
+    {
+        return (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+    }
+}
+
+ResourceHeapAllocator::ResourceHeapAllocator(
+    ID3D12Device* device,
+    D3D12_HEAP_TYPE heapType,
+    uint64_t maxHeapSize) noexcept(false) :
+    m_device(device),
+    m_heapType(heapType),
+    m_heapTier(D3D12_RESOURCE_HEAP_TIER_1),
+    m_maxHeapSize(maxHeapSize)
+{
+    if (!device)
+    {
+        throw std::invalid_argument("ResourceHeapAllocator requires a device");
+    }
+
+    if (!BuddyAllocator::IsPow2(maxHeapSize) || maxHeapSize < D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT)
+    {
+        throw std::invalid_argument("ResourceHeapAllocator heap size must be a power of two of at least 4 MB");
+    }
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+    {
+        m_heapTier = options.ResourceHeapTier;
+    }
+
+    static const D3D12_HEAP_FLAGS s_categoryFlags[Category_Count] =
+    {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES,
+    };
+
+    for (uint32_t category = 0; category < Category_Count; ++category)
+    {
+        m_pools[category * 2].flags = s_categoryFlags[category];
+        m_pools[category * 2].alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        m_pools[category * 2].nextHeapSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        m_pools[category * 2 + 1].flags = s_categoryFlags[category];
+        m_pools[category * 2 + 1].alignment = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+        m_pools[category * 2 + 1].nextHeapSize = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+    }
+}
+
+void ResourceHeapAllocator::CreatePlacedResource(
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* optimizedClearValue,
+    ID3D12Resource** resource,
+    PlacedAllocation& allocation)
+{
+    if (!resource)
+    {
+        throw std::invalid_argument("ResourceHeapAllocator::CreatePlacedResource");
+    }
+
+    *resource = nullptr;
+
+    D3D12_RESOURCE_DESC placedDesc = desc;
+    CD3DX12_RESOURCE_ALLOCATION_INFO info;
+
+    // Small textures can be placed on 4 KB boundaries if the driver agrees; otherwise fall back to 64 KB.
+    if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER
+        && !IsRenderTargetOrDepth(desc)
+        && desc.SampleDesc.Count <= 1
+        && desc.Alignment == 0)
+    {
+        placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        info = CD3DX12_RESOURCE_ALLOCATION_INFO(m_device->GetResourceAllocationInfo(0, 1, &placedDesc));
+        if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+        {
+            placedDesc.Alignment = 0;
+            info = CD3DX12_RESOURCE_ALLOCATION_INFO(m_device->GetResourceAllocationInfo(0, 1, &placedDesc));
+        }
+    }
+    else
+    {
+        info = CD3DX12_RESOURCE_ALLOCATION_INFO(m_device->GetResourceAllocationInfo(0, 1, &placedDesc));
+    }
+
+    if (info.SizeInBytes == UINT64_MAX)
+    {
+        throw std::invalid_argument("Invalid resource description for placed resource");
+    }
+
+    const uint32_t poolIndex = PoolIndex(desc);
+    Pool& pool = m_pools[poolIndex];
+
+    uint32_t heapIndex = UINT32_MAX;
+    uint64_t offset = BuddyAllocator::c_InvalidOffset;
+
+    for (uint32_t j = 0; j < pool.heaps.size(); ++j)
+    {
+        auto& heap = pool.heaps[j];
+        if (!heap.allocator || heap.dedicated)
+            continue;
+
+        offset = heap.allocator->Allocate(info.SizeInBytes, info.Alignment);
+        if (offset != BuddyAllocator::c_InvalidOffset)
+        {
+            heapIndex = j;
+            break;
+        }
+    }
+
+    if (heapIndex == UINT32_MAX)
+    {
+        // Empty heaps which couldn't hold this request (say, the depth buffer's before the window
+        // grew) would only sit beside the new one, so they go first.
+        for (auto& heap : pool.heaps)
+        {
+            if (heap.allocator && !heap.dedicated && heap.allocator->IsEmpty())
+            {
+                heap.heap.Reset();
+                heap.allocator.reset();
+            }
+        }
+
+        // Anything larger than the largest heap gets a heap of its own; otherwise heaps grow by
+        // doubling, starting from the size of the first request.
+        const uint64_t requestSize = BuddyAllocator::NextPow2(std::max<uint64_t>(info.SizeInBytes, pool.alignment));
+        const bool dedicated = requestSize > m_maxHeapSize;
+        const uint64_t heapSize = dedicated ? requestSize : std::max(requestSize, pool.nextHeapSize);
+        if (!dedicated)
+        {
+            pool.nextHeapSize = std::min(heapSize * 2, m_maxHeapSize);
+        }
+
+        heapIndex = CreateHeap(pool, heapSize, dedicated);
+        offset = pool.heaps[heapIndex].allocator->Allocate(info.SizeInBytes, info.Alignment);
+        if (offset == BuddyAllocator::c_InvalidOffset)
+        {
+            throw std::bad_alloc();
+        }
+    }
+
+    auto& heap = pool.heaps[heapIndex];
+
+    HRESULT hr = m_device->CreatePlacedResource(
+        heap.heap.Get(),
+        offset,
+        &placedDesc,
+        initialState,
+        optimizedClearValue,
+        IID_PPV_ARGS(resource));
+    if (FAILED(hr))
+    {
+        heap.allocator->Free(offset);
+        ThrowIfFailed(hr);
+    }
+
+    allocation.pool = poolIndex;
+    allocation.heap = heapIndex;
+    allocation.offset = offset;
+    allocation.size = heap.allocator->GetAllocationSize(offset);
+}
+
+void ResourceHeapAllocator::Free(PlacedAllocation& allocation) noexcept
+{
+    if (!allocation.IsValid())
+        return;
+
+    auto& heap = m_pools[allocation.pool].heaps[allocation.heap];
+    if (heap.allocator)
+    {
+        try
+        {
+            heap.allocator->Free(allocation.offset);
+        }
+        catch (const std::exception&)
+        {
+        #ifdef _DEBUG
+            OutputDebugStringA("ERROR: ResourceHeapAllocator::Free called with an invalid allocation\n");
+        #endif
+        }
+
+        // Shared heaps are kept around for reuse (e.g. on resize), but dedicated heaps are not.
+        if (heap.dedicated && heap.allocator->IsEmpty())
+        {
+            heap.heap.Reset();
+            heap.allocator.reset();
+        }
+    }
+
+    allocation = PlacedAllocation();
+}
+
+ResourceHeapAllocator::Statistics ResourceHeapAllocator::GetStatistics() const noexcept
+{
+    Statistics stats = {};
+
+    uint64_t freeBytes = 0;
+    for (const auto& pool : m_pools)
+    {
+        for (const auto& heap : pool.heaps)
+        {
+            if (!heap.allocator)
+                continue;
+
+            const auto heapStats = heap.allocator->GetStatistics();
+            ++stats.heapCount;
+            stats.allocationCount += heapStats.allocationCount;
+            stats.reservedBytes += heapStats.totalSize;
+            stats.usedBytes += heapStats.usedBytes;
+            stats.requestedBytes += heapStats.requestedBytes;
+            stats.largestFreeBlock = std::max(stats.largestFreeBlock, heapStats.largestFreeBlock);
+            freeBytes += heapStats.FreeBytes();
+        }
+    }
+
+    stats.fragmentation = (freeBytes > 0)
+        ? 1.f - float(double(stats.largestFreeBlock) / double(freeBytes))
+        : 0.f;
+    stats.internalWaste = (stats.usedBytes > 0)
+        ? 1.f - float(double(stats.requestedBytes) / double(stats.usedBytes))
+        : 0.f;
+
+    return stats;
+}
+
+uint32_t ResourceHeapAllocator::PoolIndex(const D3D12_RESOURCE_DESC& desc) const noexcept
+{
+    uint32_t category = Category_All;
+    if (m_heapTier == D3D12_RESOURCE_HEAP_TIER_1)
+    {
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            category = Category_Buffers;
+        }
+        else if (IsRenderTargetOrDepth(desc))
+        {
+            category = Category_RTDSTextures;
+        }
+        else
+        {
+            category = Category_OtherTextures;
+        }
+    }
+
+    return category * 2 + ((desc.SampleDesc.Count > 1) ? 1u : 0u);
+}
+
+uint32_t ResourceHeapAllocator::CreateHeap(Pool& pool, uint64_t size, bool dedicated)
+{
+    const CD3DX12_HEAP_DESC heapDesc(size, m_heapType, pool.alignment, pool.flags);
+
+    Heap heap;
+    ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(heap.heap.GetAddressOf())));
+
+    heap.heap->SetName(L"ResourceHeapAllocator");
+    heap.allocator = std::make_unique<BuddyAllocator>(size, c_MinBlockSize);
+    heap.dedicated = dedicated;
+
+    // Reuse a slot vacated by a released heap so that outstanding indices stay stable.
+    for (uint32_t j = 0; j < pool.heaps.size(); ++j)
+    {
+        if (!pool.heaps[j].allocator)
+        {
+            pool.heaps[j] = std::move(heap);
+            return j;
+        }
+    }
+
+    pool.heaps.emplace_back(std::move(heap));
+    return static_cast<uint32_t>(pool.heaps.size() - 1);
+}
@@ -0,0 +1,113 @@
+//
+// HeapAllocator.h - Placed-resource sub-allocation from ID3D12Heap objects
+//
+
+#pragma once
+
+#include "BuddyAllocator.h"
+
+#include <vector>
+
+
+namespace DX
+{
+    // Identifies a placed resource's memory so it can be returned to the allocator.
+    struct PlacedAllocation
+    {
+        uint32_t    pool;
+        uint32_t    heap;
+        uint64_t    offset;
+        uint64_t    size;
+
+        PlacedAllocation() noexcept : pool(UINT32_MAX), heap(UINT32_MAX), offset(0), size(0) {}
+
+        bool IsValid() const noexcept { return pool != UINT32_MAX; }
+    };
+
+    // Sub-allocates placed resources from a small number of large heaps rather than
+    // creating a committed resource (and an implicit heap) for each one. Honors the
+    // resource heap tier rules: tier 1 hardware needs separate heaps for buffers,
+    // render target/depth stencil textures, and all other textures.
+    //
+    // Heaps are created on demand: a pool's first heap is just big enough for the request
+    // which needed it, and each one after that is twice the size of the last, up to
+    // maxHeapSize. Anything larger than that gets a dedicated heap of its own.
+    class ResourceHeapAllocator
+    {
+    public:
+        static constexpr uint64_t c_DefaultMaxHeapSize = 64u * 1024u * 1024u;
+
+        struct Statistics
+        {
+            uint32_t    heapCount;
+            uint32_t    allocationCount;
+            uint64_t    reservedBytes;
+            uint64_t    usedBytes;
+            uint64_t    requestedBytes;
+            uint64_t    largestFreeBlock;
+            float       fragmentation;
+            float       internalWaste;
+        };
+
+        ResourceHeapAllocator(ID3D12Device* device,
+            D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT,
+            uint64_t maxHeapSize = c_DefaultMaxHeapSize) noexcept(false);
+
+        ResourceHeapAllocator(ResourceHeapAllocator&&) = default;
+        ResourceHeapAllocator& operator= (ResourceHeapAllocator&&) = default;
+
+        ResourceHeapAllocator(ResourceHeapAllocator const&) = delete;
+        ResourceHeapAllocator& operator= (ResourceHeapAllocator const&) = delete;
+
+        // Creates a placed resource. Throws on failure.
+        void CreatePlacedResource(
+            const D3D12_RESOURCE_DESC& desc,
+            D3D12_RESOURCE_STATES initialState,
+            _In_opt_ const D3D12_CLEAR_VALUE* optimizedClearValue,
+            _Outptr_ ID3D12Resource** resource,
+            PlacedAllocation& allocation);
+
+        // Returns memory to the allocator. The caller must ensure the GPU is no longer
+        // using the resource, and should release the resource itself first.
+        void Free(PlacedAllocation& allocation) noexcept;
+
+        Statistics GetStatistics() const noexcept;
+        D3D12_RESOURCE_HEAP_TIER GetResourceHeapTier() const noexcept { return m_heapTier; }
+
+    private:
+        enum HeapCategory : uint32_t
+        {
+            Category_Buffers = 0,
+            Category_RTDSTextures,
+            Category_OtherTextures,
+            Category_All,
+            Category_Count
+        };
+
+        struct Heap
+        {
+            Microsoft::WRL::ComPtr<ID3D12Heap>  heap;
+            std::unique_ptr<BuddyAllocator>     allocator;
+            bool                                dedicated;
+        };
+
+        struct Pool
+        {
+            D3D12_HEAP_FLAGS                    flags;
+            uint64_t                            alignment;
+            uint64_t                            nextHeapSize;
+            std::vector<Heap>                   heaps;
+        };
+
+        uint32_t PoolIndex(const D3D12_RESOURCE_DESC& desc) const noexcept;
+        uint32_t CreateHeap(Pool& pool, uint64_t size, bool dedicated);
+
+        Microsoft::WRL::ComPtr<ID3D12Device>    m_device;
+        D3D12_HEAP_TYPE                         m_heapType;
+        D3D12_RESOURCE_HEAP_TIER                m_heapTier;
+        uint64_t                                m_maxHeapSize;
+
+        // Pools are indexed by heap category, then by MSAA placement alignment.
+        Pool                                    m_pools[Category_Count * 2];
+    };
+}
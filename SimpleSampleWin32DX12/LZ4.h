@@ -0,0 +1,289 @@
+//
+// LZ4.h - LZ4 block format compression and bounds-checked decompression
+//
+
+#pragma once
+
+#include "SalFallbacks.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace DX
+{
+    // The LZ4 block format (no frame header or checksums). Decompression is cheap enough to run as
+    // assets are loaded, and compression is a simple greedy match finder meant for offline tools.
+    //
+    // Each sequence is a token (literal count in the high nibble, match length - 4 in the low one,
+    // with 15 meaning more length bytes follow), the literals, a 16-bit little-endian match offset,
+    // and the extra match length bytes. The last sequence has literals only.
+    namespace LZ4
+    {
+        constexpr size_t c_MinMatch = 4;
+        constexpr size_t c_LastLiterals = 5;        // The block always ends with at least this many literals
+        constexpr size_t c_MatchSearchLimit = 12;   // No match may start within this many bytes of the end
+        constexpr size_t c_MaxOffset = 65535;
+
+        inline size_t CompressBound(size_t size) noexcept
+        {
+            return size + size / 255 + 16;
+        }
+
+        namespace Internal
+        {
+            inline uint32_t Read32(const uint8_t* p) noexcept
+            {
+                uint32_t value;
+                memcpy(&value, p, sizeof(value));
+                return value;
+            }
+
+            inline uint32_t Hash(uint32_t sequence, unsigned int bits) noexcept
+            {
+                return (sequence * 2654435761u) >> (32 - bits);
+            }
+
+            // Writes a length continuation (after a nibble of 15), returning false if out of space.
+            inline bool WriteLength(size_t length, uint8_t*& op, const uint8_t* oend) noexcept
+            {
+                for (; length >= 255; length -= 255)
+                {
+                    if (op >= oend)
+                        return false;
+                    *op++ = 255;
+                }
+
+                if (op >= oend)
+                    return false;
+                *op++ = static_cast<uint8_t>(length);
+                return true;
+            }
+
+            inline size_t ReadLength(const uint8_t*& ip, const uint8_t* iend)
+            {
+                size_t length = 0;
+                uint8_t b;
+                do
+                {
+                    if (ip >= iend)
+                    {
+                        throw std::runtime_error("LZ4: truncated length");
+                    }
+                    b = *ip++;
+                    length += b;
+                } while (b == 255);
+                return length;
+            }
+
+            // Writes one sequence; matchLength of 0 writes the final literals-only sequence.
+            inline bool WriteSequence(const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength,
+                uint8_t*& op, const uint8_t* oend) noexcept
+            {
+                if (op >= oend)
+                    return false;
+
+                uint8_t* token = op++;
+                *token = 0;
+
+                if (literalCount >= 15)
+                {
+                    *token = 15 << 4;
+                    if (!WriteLength(literalCount - 15, op, oend))
+                        return false;
+                }
+                else
+                {
+                    *token = static_cast<uint8_t>(literalCount << 4);
+                }
+
+                if (literalCount > size_t(oend - op))
+                    return false;
+                if (literalCount)
+                {
+                    memcpy(op, literals, literalCount);
+                    op += literalCount;
+                }
+
+                if (!matchLength)
+                    return true;
+
+                if (oend - op < 2)
+                    return false;
+                *op++ = static_cast<uint8_t>(offset);
+                *op++ = static_cast<uint8_t>(offset >> 8);
+
+                const size_t code = matchLength - c_MinMatch;
+                if (code >= 15)
+                {
+                    *token |= 15;
+                    return WriteLength(code - 15, op, oend);
+                }
+
+                *token |= static_cast<uint8_t>(code);
+                return true;
+            }
+        }
+
+        // Returns the compressed size, or 0 if the result doesn't fit in dstCapacity (which can't
+        // happen when it is at least CompressBound(srcSize)).
+        inline size_t Compress(
+            _In_reads_bytes_(srcSize) const uint8_t* src, size_t srcSize,
+            _Out_writes_bytes_(dstCapacity) uint8_t* dst, size_t dstCapacity)
+        {
+            constexpr unsigned int c_HashBits = 16;
+
+            uint8_t* op = dst;
+            const uint8_t* oend = dst + dstCapacity;
+
+            const uint8_t* ip = src;
+            const uint8_t* anchor = src;
+            const uint8_t* iend = src + srcSize;
+
+            if (srcSize > c_MatchSearchLimit)
+            {
+                // Positions of recently seen 4-byte sequences, relative to src.
+                std::vector<uint32_t> table(size_t(1) << c_HashBits, 0);
+
+                const uint8_t* matchLimit = iend - c_MatchSearchLimit;
+                const uint8_t* extendLimit = iend - c_LastLiterals;
+
+                while (ip < matchLimit)
+                {
+                    const uint32_t sequence = Internal::Read32(ip);
+                    uint32_t& slot = table[Internal::Hash(sequence, c_HashBits)];
+                    const uint8_t* ref = src + slot;
+                    slot = static_cast<uint32_t>(ip - src);
+
+                    if (ref >= ip || size_t(ip - ref) > c_MaxOffset || Internal::Read32(ref) != sequence)
+                    {
+                        ++ip;
+                        continue;
+                    }
+
+                    const size_t offset = size_t(ip - ref);
+
+                    const uint8_t* matchEnd = ip + c_MinMatch;
+                    ref += c_MinMatch;
+                    while (matchEnd < extendLimit && *matchEnd == *ref)
+                    {
+                        ++matchEnd;
+                        ++ref;
+                    }
+
+                    if (!Internal::WriteSequence(anchor, size_t(ip - anchor), offset, size_t(matchEnd - ip), op, oend))
+                    {
+                        return 0;
+                    }
+
+                    ip = matchEnd;
+                    anchor = ip;
+                }
+            }
+
+            if (!Internal::WriteSequence(anchor, size_t(iend - anchor), 0, 0, op, oend))
+                return 0;
+
+            return size_t(op - dst);
+        }
+
+        inline std::vector<uint8_t> Compress(_In_reads_bytes_(srcSize) const uint8_t* src, size_t srcSize)
+        {
+            std::vector<uint8_t> result(CompressBound(srcSize));
+            result.resize(Compress(src, srcSize, result.data(), result.size()));
+            return result;
+        }
+
+        // Decompresses a block whose decompressed size is known. Malformed input, or input which
+        // doesn't decompress to exactly dstSize bytes, throws std::runtime_error without writing
+        // outside dst.
+        inline void Decompress(
+            _In_reads_bytes_(srcSize) const uint8_t* src, size_t srcSize,
+            _Out_writes_bytes_(dstSize) uint8_t* dst, size_t dstSize)
+        {
+            const uint8_t* ip = src;
+            const uint8_t* iend = src + srcSize;
+            uint8_t* op = dst;
+            uint8_t* oend = dst + dstSize;
+
+            for (;;)
+            {
+                if (ip >= iend)
+                {
+                    throw std::runtime_error("LZ4: truncated block");
+                }
+
+                const uint8_t token = *ip++;
+
+                size_t literalCount = token >> 4;
+                if (literalCount == 15)
+                {
+                    literalCount += Internal::ReadLength(ip, iend);
+                }
+
+                if (literalCount > size_t(iend - ip) || literalCount > size_t(oend - op))
+                {
+                    throw std::runtime_error("LZ4: literals out of range");
+                }
+
+                if (literalCount)
+                {
+                    memcpy(op, ip, literalCount);
+                    ip += literalCount;
+                    op += literalCount;
+                }
+
+                if (ip == iend)
+                    break;
+
+                if (iend - ip < 2)
+                {
+                    throw std::runtime_error("LZ4: truncated offset");
+                }
+
+                const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+                ip += 2;
+
+                if (!offset || offset > size_t(op - dst))
+                {
+                    throw std::runtime_error("LZ4: bad match offset");
+                }
+
+                size_t matchLength = token & 15;
+                if (matchLength == 15)
+                {
+                    matchLength += Internal::ReadLength(ip, iend);
+                }
+                matchLength += c_MinMatch;
+
+                if (matchLength > size_t(oend - op))
+                {
+                    throw std::runtime_error("LZ4: match out of range");
+                }
+
+                const uint8_t* match = op - offset;
+                if (offset >= matchLength)
+                {
+                    memcpy(op, match, matchLength);
+                    op += matchLength;
+                }
+                else
+                {
+                    // Overlapping copies repeat the last offset bytes, so go a byte at a time.
+                    for (size_t j = 0; j < matchLength; ++j)
+                    {
+                        *op++ = *match++;
+                    }
+                }
+            }
+
+            if (op != oend)
+            {
+                throw std::runtime_error("LZ4: size mismatch");
+            }
+        }
+    }
+}
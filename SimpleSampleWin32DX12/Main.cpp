@@ -232,20 +232,27 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                 game->OnResuming();
             s_in_suspend = false;
         }
-        else if (!s_in_sizemove && game)
+        else if (game)
         {
+            // Sizes are coalesced by the game and applied at the next frame boundary.
             game->OnWindowSizeChanged(LOWORD(lParam), HIWORD(lParam));
         }
         break;
 
     case WM_ENTERSIZEMOVE:
         s_in_sizemove = true;
+        if (game)
+        {
+            game->OnEnterSizeMove();
+        }
         break;
 
     case WM_EXITSIZEMOVE:
         s_in_sizemove = false;
         if (game)
         {
+            game->OnExitSizeMove();
+
             RECT rc;
             GetClientRect(hWnd, &rc);
 
@@ -0,0 +1,67 @@
+//
+// MappedFile.cpp - Read-only memory mapping of a whole file
+//
+
+#include "pch.h"
+#include "MappedFile.h"
+
+using namespace DX;
+
+using Microsoft::WRL::Wrappers::FileHandle;
+using Microsoft::WRL::Wrappers::HandleT;
+using Microsoft::WRL::Wrappers::HandleTraits::HANDLENullTraits;
+
+namespace
+{
+    [[noreturn]] void ThrowLastError(const char* what)
+    {
+        throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), what);
+    }
+}
+
+MappedFile::MappedFile(const wchar_t* fileName) noexcept(false) :
+    m_size(0)
+{
+    if (!fileName)
+    {
+        throw std::invalid_argument("MappedFile");
+    }
+
+    CREATEFILE2_EXTENDED_PARAMETERS params = {};
+    params.dwSize = sizeof(params);
+    params.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+    params.dwFileFlags = FILE_FLAG_SEQUENTIAL_SCAN;
+
+    FileHandle file(CreateFile2(fileName, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, &params));
+    if (!file.IsValid())
+    {
+        ThrowLastError("CreateFile2");
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(file.Get(), &fileSize))
+    {
+        ThrowLastError("GetFileSizeEx");
+    }
+
+    // A zero-length file can't be mapped.
+    if (fileSize.QuadPart <= 0 || uint64_t(fileSize.QuadPart) > SIZE_MAX)
+    {
+        throw std::runtime_error("MappedFile: empty or oversized file");
+    }
+
+    HandleT<HANDLENullTraits> mapping(CreateFileMappingW(file.Get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if (!mapping.IsValid())
+    {
+        ThrowLastError("CreateFileMappingW");
+    }
+
+    // The view keeps the mapping and the file open, so both handles can be closed now.
+    m_view.reset(MapViewOfFile(mapping.Get(), FILE_MAP_READ, 0, 0, 0));
+    if (!m_view)
+    {
+        ThrowLastError("MapViewOfFile");
+    }
+
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+}
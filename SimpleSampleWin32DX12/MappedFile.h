@@ -0,0 +1,47 @@
+//
+// MappedFile.h - Read-only memory mapping of a whole file
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace DX
+{
+    // Maps a file read-only so its contents can be parsed and copied where they lie, without first
+    // reading them into a heap allocation. Pages are brought in on first touch and are backed by the
+    // file, so they can be dropped under memory pressure instead of being written to the page file.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(_In_z_ const wchar_t* fileName) noexcept(false);
+
+        MappedFile(MappedFile&&) = default;
+        MappedFile& operator= (MappedFile&&) = default;
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator= (MappedFile const&) = delete;
+
+        ~MappedFile() = default;
+
+        const uint8_t* GetData() const noexcept { return static_cast<const uint8_t*>(m_view.get()); }
+        size_t GetSize() const noexcept { return m_size; }
+
+    private:
+        struct ViewDeleter
+        {
+            void operator()(const void* view) const noexcept
+            {
+                if (view)
+                {
+                    UnmapViewOfFile(view);
+                }
+            }
+        };
+
+        std::unique_ptr<const void, ViewDeleter>    m_view;
+        size_t                                      m_size;
+    };
+}
@@ -0,0 +1,469 @@
+//
+// MeshOptimizer.h - Reorders triangle lists and vertices for the GPU's caches
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace DX
+{
+    // Offline mesh optimizations, free of Direct3D so the asset tools can use them. Each works on a
+    // triangle list given as 32-bit indices into a vertex array, and leaves the triangles (and
+    // their winding) as they were, changing only the order they and their vertices come in:
+    //
+    //  - OptimizeVertexCache orders triangles so vertices are reused while still in the
+    //    post-transform cache (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+    //  - OptimizeOverdraw then reorders clusters of that order so outward-facing parts are drawn
+    //    first, giving up no more than a set fraction of the cache gains (after Sander et al.,
+    //    "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+    //  - OptimizeVertexFetch numbers vertices in the order they are first used, so vertex fetches
+    //    walk memory forward, and drops the vertices nothing uses.
+    //
+    // AnalyzeVertexCache measures the result against a FIFO cache, as most hardware has.
+    namespace MeshOptimizer
+    {
+        constexpr uint32_t c_Unused = UINT32_MAX;
+
+        // Cache sizes: the one OptimizeVertexCache models, and the FIFO measured by default.
+        constexpr uint32_t c_OptimizeCacheSize = 32;
+        constexpr uint32_t c_AnalyzeCacheSize = 16;
+
+        struct VertexCacheStatistics
+        {
+            uint32_t    misses;         // Vertices transformed
+            float       acmr;           // Average cache miss ratio: misses per triangle, at best 0.5
+            float       atvr;           // Average transformed vertex ratio: misses per vertex used, at best 1
+        };
+
+        namespace Internal
+        {
+            // A FIFO cache: a vertex is in it if fewer than size misses have happened since its own.
+            class FifoCache
+            {
+            public:
+                FifoCache(size_t vertexCount, uint32_t size) :
+                    m_stamps(vertexCount, 0),
+                    m_time(size + 1),
+                    m_size(size)
+                {
+                }
+
+                // Returns whether v missed, and if so, brings it in.
+                bool Access(uint32_t v)
+                {
+                    if (m_time - m_stamps[v] <= m_size)
+                        return false;
+
+                    m_stamps[v] = m_time++;
+                    return true;
+                }
+
+                void Reset() noexcept
+                {
+                    m_time += m_size + 1;
+                }
+
+            private:
+                std::vector<uint32_t>   m_stamps;
+                uint32_t                m_time;
+                uint32_t                m_size;
+            };
+
+            inline void CheckIndices(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+            {
+                if ((indexCount % 3) || (indexCount && !indices))
+                {
+                    throw std::invalid_argument("MeshOptimizer: not a triangle list");
+                }
+
+                for (size_t j = 0; j < indexCount; ++j)
+                {
+                    if (indices[j] >= vertexCount)
+                    {
+                        throw std::out_of_range("MeshOptimizer: index out of range");
+                    }
+                }
+            }
+
+            inline float CacheScore(int position) noexcept
+            {
+                // The last triangle's three vertices score the same, and less than the next few in
+                // the cache, which keeps the order from fanning tightly around one vertex.
+                if (position < 0)
+                    return 0.f;
+
+                if (position < 3)
+                    return 0.75f;
+
+                const float scale = 1.f - float(position - 3) / float(c_OptimizeCacheSize - 3);
+                return std::pow(scale, 1.5f);
+            }
+
+            inline float ValenceScore(uint32_t remaining) noexcept
+            {
+                // Favors finishing off vertices with few triangles left, so none are stranded.
+                return remaining ? 2.f / std::sqrt(float(remaining)) : 0.f;
+            }
+        }
+
+        inline VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+            uint32_t cacheSize = c_AnalyzeCacheSize)
+        {
+            Internal::CheckIndices(indices, indexCount, vertexCount);
+
+            Internal::FifoCache cache(vertexCount, cacheSize);
+            std::vector<bool> used(vertexCount, false);
+
+            VertexCacheStatistics stats = {};
+            size_t usedCount = 0;
+            for (size_t j = 0; j < indexCount; ++j)
+            {
+                if (cache.Access(indices[j]))
+                {
+                    ++stats.misses;
+                }
+
+                if (!used[indices[j]])
+                {
+                    used[indices[j]] = true;
+                    ++usedCount;
+                }
+            }
+
+            stats.acmr = indexCount ? float(stats.misses) / float(indexCount / 3) : 0.f;
+            stats.atvr = usedCount ? float(stats.misses) / float(usedCount) : 0.f;
+            return stats;
+        }
+
+        // Reorders the triangles of indices in place.
+        inline void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+        {
+            using namespace Internal;
+
+            CheckIndices(indices, indexCount, vertexCount);
+
+            const size_t triangleCount = indexCount / 3;
+            if (triangleCount < 2)
+                return;
+
+            const std::vector<uint32_t> input(indices, indices + indexCount);
+
+            // Each vertex's triangles not yet drawn, in one array: adjacency[start[v], start[v] + remaining[v]).
+            std::vector<uint32_t> remaining(vertexCount, 0);
+            for (const uint32_t v : input)
+            {
+                ++remaining[v];
+            }
+
+            std::vector<uint32_t> start(vertexCount, 0);
+            for (size_t v = 1; v < vertexCount; ++v)
+            {
+                start[v] = start[v - 1] + remaining[v - 1];
+            }
+
+            std::vector<uint32_t> adjacency(indexCount);
+            {
+                std::vector<uint32_t> fill(start);
+                for (size_t j = 0; j < indexCount; ++j)
+                {
+                    adjacency[fill[input[j]]++] = static_cast<uint32_t>(j / 3);
+                }
+            }
+
+            std::vector<int> position(vertexCount, -1);
+            std::vector<float> vertexScore(vertexCount);
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                vertexScore[v] = ValenceScore(remaining[v]);
+            }
+
+            std::vector<bool> emitted(triangleCount, false);
+
+            // Most recently used first; the extra three hold what the last triangle pushed out.
+            std::vector<uint32_t> cache;
+            std::vector<uint32_t> next;
+            cache.reserve(c_OptimizeCacheSize + 3);
+            next.reserve(c_OptimizeCacheSize + 3);
+
+            size_t best = 0;
+            size_t cursor = 0;
+            for (size_t output = 0; output < triangleCount; ++output)
+            {
+                // With nothing in the cache to build on, carry on from the first triangle not yet drawn.
+                if (best == SIZE_MAX)
+                {
+                    while (emitted[cursor])
+                    {
+                        ++cursor;
+                    }
+                    best = cursor;
+                }
+
+                const uint32_t* triangle = &input[3 * best];
+                std::memcpy(indices + 3 * output, triangle, 3 * sizeof(uint32_t));
+                emitted[best] = true;
+
+                next.assign(triangle, triangle + 3);
+                for (const uint32_t v : cache)
+                {
+                    if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    {
+                        next.push_back(v);
+                    }
+                }
+
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    const uint32_t v = triangle[k];
+                    uint32_t* list = &adjacency[start[v]];
+                    uint32_t* end = list + remaining[v];
+                    uint32_t* it = std::find(list, end, static_cast<uint32_t>(best));
+                    if (it != end)
+                    {
+                        *it = *(end - 1);
+                        --remaining[v];
+                    }
+                }
+
+                for (size_t k = 0; k < next.size(); ++k)
+                {
+                    const uint32_t v = next[k];
+                    position[v] = (k < c_OptimizeCacheSize) ? int(k) : -1;
+                    vertexScore[v] = remaining[v] ? CacheScore(position[v]) + ValenceScore(remaining[v]) : -1.f;
+                }
+
+                // Only the triangles around what is in the cache changed score.
+                best = SIZE_MAX;
+                float bestScore = -1.f;
+                for (const uint32_t v : next)
+                {
+                    for (uint32_t k = 0; k < remaining[v]; ++k)
+                    {
+                        const uint32_t t = adjacency[start[v] + k];
+                        const float score = vertexScore[input[3 * t]] + vertexScore[input[3 * t + 1]] + vertexScore[input[3 * t + 2]];
+                        if (score > bestScore)
+                        {
+                            bestScore = score;
+                            best = t;
+                        }
+                    }
+                }
+
+                if (next.size() > c_OptimizeCacheSize)
+                {
+                    next.resize(c_OptimizeCacheSize);
+                }
+                std::swap(cache, next);
+            }
+        }
+
+        // Reorders clusters of triangles in place, most outward-facing first, where the vertex cache
+        // order from OptimizeVertexCache allows: a cluster is split off wherever the cache miss
+        // ratio up to that point is within threshold (1.05 for 5%) of the whole run's. Positions are
+        // three floats at the start of each vertex, stride bytes apart.
+        inline void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const void* positions, size_t stride, size_t vertexCount,
+            float threshold = 1.05f)
+        {
+            using namespace Internal;
+
+            CheckIndices(indices, indexCount, vertexCount);
+
+            if (!positions || stride < 3 * sizeof(float))
+            {
+                throw std::invalid_argument("MeshOptimizer: bad positions");
+            }
+
+            const size_t triangleCount = indexCount / 3;
+            if (triangleCount < 2)
+                return;
+
+            // Runs start where the cache is cold: a triangle whose vertices all miss.
+            FifoCache cache(vertexCount, c_AnalyzeCacheSize);
+            std::vector<size_t> runs;
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                uint32_t misses = 0;
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    misses += cache.Access(indices[3 * t + k]) ? 1 : 0;
+                }
+
+                if (misses == 3 || !t)
+                {
+                    runs.push_back(t);
+                }
+            }
+            runs.push_back(triangleCount);
+
+            // Split each run into clusters, each starting cold, for as long as the ratio stays near
+            // the run's.
+            std::vector<size_t> clusters;
+            for (size_t r = 0; r + 1 < runs.size(); ++r)
+            {
+                const size_t begin = runs[r];
+                const size_t end = runs[r + 1];
+
+                cache.Reset();
+                uint32_t runMisses = 0;
+                for (size_t j = 3 * begin; j < 3 * end; ++j)
+                {
+                    runMisses += cache.Access(indices[j]) ? 1 : 0;
+                }
+                const float limit = float(runMisses) / float(end - begin) * threshold;
+
+                cache.Reset();
+                clusters.push_back(begin);
+                uint32_t misses = 0;
+                size_t first = begin;
+                for (size_t t = begin; t < end; ++t)
+                {
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        misses += cache.Access(indices[3 * t + k]) ? 1 : 0;
+                    }
+
+                    if (t + 1 < end && float(misses) / float(t + 1 - first) <= limit)
+                    {
+                        clusters.push_back(t + 1);
+                        cache.Reset();
+                        misses = 0;
+                        first = t + 1;
+                    }
+                }
+            }
+            clusters.push_back(triangleCount);
+
+            auto position = [&](uint32_t v)
+                {
+                    return reinterpret_cast<const float*>(static_cast<const uint8_t*>(positions) + size_t(v) * stride);
+                };
+
+            // Area-weighted centroid and normal of each cluster, and of the whole mesh.
+            struct Cluster
+            {
+                size_t  begin;
+                size_t  end;
+                float   centroid[3];
+                float   normal[3];
+                float   area;
+                float   key;
+            };
+
+            std::vector<Cluster> sorted(clusters.size() - 1);
+            float meshCentroid[3] = {};
+            float meshArea = 0.f;
+            for (size_t c = 0; c < sorted.size(); ++c)
+            {
+                auto& cluster = sorted[c];
+                cluster = Cluster();
+                cluster.begin = clusters[c];
+                cluster.end = clusters[c + 1];
+
+                for (size_t t = cluster.begin; t < cluster.end; ++t)
+                {
+                    const float* p0 = position(indices[3 * t]);
+                    const float* p1 = position(indices[3 * t + 1]);
+                    const float* p2 = position(indices[3 * t + 2]);
+
+                    const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                    const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                    const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                    const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        cluster.centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.f * area;
+                        cluster.normal[k] += n[k];
+                    }
+                    cluster.area += area;
+                }
+
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    meshCentroid[k] += cluster.centroid[k];
+                }
+                meshArea += cluster.area;
+
+                if (cluster.area > 0.f)
+                {
+                    for (auto& value : cluster.centroid)
+                    {
+                        value /= cluster.area;
+                    }
+                }
+            }
+
+            if (meshArea > 0.f)
+            {
+                for (auto& value : meshCentroid)
+                {
+                    value /= meshArea;
+                }
+            }
+
+            for (auto& cluster : sorted)
+            {
+                const float length = std::sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+                cluster.key = 0.f;
+                if (length > 0.f)
+                {
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        cluster.key += (cluster.centroid[k] - meshCentroid[k]) * cluster.normal[k] / length;
+                    }
+                }
+            }
+
+            std::stable_sort(sorted.begin(), sorted.end(),
+                [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+            const std::vector<uint32_t> input(indices, indices + indexCount);
+            size_t output = 0;
+            for (const auto& cluster : sorted)
+            {
+                const size_t count = 3 * (cluster.end - cluster.begin);
+                std::memcpy(indices + output, &input[3 * cluster.begin], count * sizeof(uint32_t));
+                output += count;
+            }
+        }
+
+        // Fills remap (vertexCount entries) with each vertex's new index, in order of first use, or
+        // c_Unused. Returns the number of vertices used.
+        inline size_t OptimizeVertexFetch(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+        {
+            Internal::CheckIndices(indices, indexCount, vertexCount);
+
+            std::fill(remap, remap + vertexCount, c_Unused);
+
+            uint32_t used = 0;
+            for (size_t j = 0; j < indexCount; ++j)
+            {
+                if (remap[indices[j]] == c_Unused)
+                {
+                    remap[indices[j]] = used++;
+                }
+            }
+            return used;
+        }
+
+        // Copies vertices (stride bytes each) to their places under remap, leaving out unused ones.
+        inline void RemapVertices(void* destination, const void* vertices, size_t stride, const uint32_t* remap, size_t vertexCount)
+        {
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                if (remap[v] != c_Unused)
+                {
+                    std::memcpy(static_cast<uint8_t*>(destination) + size_t(remap[v]) * stride,
+                        static_cast<const uint8_t*>(vertices) + v * stride, stride);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,778 @@
+//
+// Meshlets.h - Splits triangle lists into small clusters with culling bounds, and culls them on the CPU
+//
+
+#pragma once
+
+#include "FrustumCuller.h"
+#include "SalFallbacks.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace DX
+{
+    // A meshlet is a cluster of up to c_MaxVertices vertices and c_MaxTriangles triangles of a
+    // triangle list, sized to a mesh shader threadgroup's output. Each has a bounding sphere, so
+    // clusters off screen can be rejected, and a cone bounding its triangles' normals, so clusters
+    // facing wholly away from the eye can be too (after Kapoulkine's meshoptimizer, and Wihlidal,
+    // "Optimizing the Graphics Pipeline with Compute").
+    //
+    // Like MeshOptimizer, this is free of Direct3D so the asset tools can use it.
+    namespace Meshlets
+    {
+        constexpr uint32_t c_MaxVertices = 64;
+        constexpr uint32_t c_MaxTriangles = 124;
+
+        // Triangles index a meshlet's vertices with bytes.
+        constexpr uint32_t c_MaxVerticesLimit = 256;
+
+        // How many added vertices a triangle at right angles to the way a meshlet faces counts as,
+        // when growing it.
+        // Higher makes more, smaller meshlets with narrower cones.
+        constexpr float c_ConeWeight = 2.f;
+
+        struct Meshlet
+        {
+            uint32_t    vertexOffset;       // Into the vertex indices
+            uint32_t    triangleOffset;     // Into the triangle bytes, a multiple of 4
+            uint32_t    vertexCount;
+            uint32_t    triangleCount;
+        };
+
+        // Bounds in the mesh's own space. The cone's axis and cutoff are snorm bytes: the meshlet is
+        // back-facing when the direction from the eye to the apex is within acos(cutoff) of the
+        // axis. A cutoff of c_NoCone means its triangles face too many ways for that to happen.
+        struct MeshletBounds
+        {
+            float       center[3];
+            float       radius;
+            float       coneApex[3];
+            int8_t      coneAxis[3];
+            int8_t      coneCutoff;
+        };
+
+        constexpr int8_t c_NoCone = 127;
+
+        static_assert(sizeof(Meshlet) == 16, "Meshlet size mismatch");
+        static_assert(sizeof(MeshletBounds) == 32, "Meshlet bounds size mismatch");
+
+        // The meshlets of a triangle list. Vertices are indices into the list's vertex array, as
+        // its own indices were; triangles are three bytes each, indexing their meshlet's vertices.
+        struct MeshletSet
+        {
+            std::vector<Meshlet>        meshlets;
+            std::vector<MeshletBounds>  bounds;
+            std::vector<uint32_t>       vertices;
+            std::vector<uint8_t>        triangles;
+        };
+
+        struct CullStatistics
+        {
+            uint32_t    visible;
+            uint32_t    outsideFrustum;
+            uint32_t    backFacing;
+        };
+
+        namespace Internal
+        {
+            struct Float3
+            {
+                float x, y, z;
+            };
+
+            inline Float3 operator+(Float3 a, Float3 b) noexcept { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+            inline Float3 operator-(Float3 a, Float3 b) noexcept { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+            inline Float3 operator*(Float3 a, float s) noexcept { return { a.x * s, a.y * s, a.z * s }; }
+
+            inline float Dot(Float3 a, Float3 b) noexcept { return a.x * b.x + a.y * b.y + a.z * b.z; }
+            inline float Length(Float3 a) noexcept { return std::sqrt(Dot(a, a)); }
+
+            inline Float3 Cross(Float3 a, Float3 b) noexcept
+            {
+                return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+            }
+
+            inline int8_t QuantizeSnorm(float value) noexcept
+            {
+                return static_cast<int8_t>(std::lround(std::max(-1.f, std::min(1.f, value)) * 127.f));
+            }
+
+            // Ritter's sphere: around the most separated pair of axis extremes, grown until it
+            // holds every point. Within a few percent of the smallest, in two passes.
+            inline void BoundingSphere(const std::vector<Float3>& points, Float3& center, float& radius) noexcept
+            {
+                size_t lowest[3] = {}, highest[3] = {};
+                for (size_t j = 1; j < points.size(); ++j)
+                {
+                    const float* p = &points[j].x;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        if (p[axis] < (&points[lowest[axis]].x)[axis])
+                            lowest[axis] = j;
+                        if (p[axis] > (&points[highest[axis]].x)[axis])
+                            highest[axis] = j;
+                    }
+                }
+
+                int widest = 0;
+                float widestSpan = -1.f;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    const Float3 span = points[highest[axis]] - points[lowest[axis]];
+                    if (Dot(span, span) > widestSpan)
+                    {
+                        widestSpan = Dot(span, span);
+                        widest = axis;
+                    }
+                }
+
+                center = (points[lowest[widest]] + points[highest[widest]]) * 0.5f;
+                radius = std::sqrt(widestSpan) * 0.5f;
+
+                for (const auto& p : points)
+                {
+                    const float distance = Length(p - center);
+                    if (distance > radius)
+                    {
+                        const float grown = (radius + distance) * 0.5f;
+                        center = center + (p - center) * ((grown - radius) / distance);
+                        radius = grown;
+                    }
+                }
+
+                // Growing rounds both ways, so settle on the true distance to the farthest point, and
+                // allow for rounding in that too.
+                radius = 0.f;
+                for (const auto& p : points)
+                {
+                    radius = std::max(radius, Length(p - center));
+                }
+                radius += (Length(center) + radius) * 4.f * FLT_EPSILON;
+            }
+
+            // A k-d tree of points which can be taken one at a time, finding the nearest not yet taken.
+            class NearestPoints
+            {
+            public:
+                explicit NearestPoints(const std::vector<Float3>& points) :
+                    m_points(points),
+                    m_items(points.size()),
+                    m_leaves(points.size())
+                {
+                    for (size_t j = 0; j < m_items.size(); ++j)
+                    {
+                        m_items[j] = static_cast<uint32_t>(j);
+                    }
+
+                    if (!m_items.empty())
+                    {
+                        Build(UINT32_MAX, 0, static_cast<uint32_t>(m_items.size()));
+                    }
+                }
+
+                void Take(size_t item) noexcept
+                {
+                    for (uint32_t node = m_leaves[item]; node != UINT32_MAX; node = m_nodes[node].parent)
+                    {
+                        --m_nodes[node].remaining;
+                    }
+                }
+
+                // Returns SIZE_MAX once everything is taken.
+                size_t Nearest(Float3 point, const std::vector<uint8_t>& taken) const noexcept
+                {
+                    size_t best = SIZE_MAX;
+                    float bestDistance = FLT_MAX;
+                    if (!m_nodes.empty())
+                    {
+                        Search(0, point, taken, best, bestDistance);
+                    }
+                    return best;
+                }
+
+            private:
+                static constexpr uint32_t c_LeafSize = 8;
+
+                struct Node
+                {
+                    uint32_t    parent;
+                    uint32_t    remaining;      // Points under the node not yet taken
+                    uint32_t    first;          // Leaves: the range of m_items
+                    uint32_t    count;
+                    uint32_t    axis;           // Inner nodes: the split, with children at this + 1 and right
+                    uint32_t    right;
+                    float       split;
+                };
+
+                uint32_t Build(uint32_t parent, uint32_t first, uint32_t count)
+                {
+                    const auto index = static_cast<uint32_t>(m_nodes.size());
+                    m_nodes.push_back(Node{ parent, count, first, count, 0, 0, 0.f });
+
+                    if (count <= c_LeafSize)
+                    {
+                        for (uint32_t j = first; j < first + count; ++j)
+                        {
+                            m_leaves[m_items[j]] = index;
+                        }
+                        return index;
+                    }
+
+                    Float3 lower = m_points[m_items[first]], upper = lower;
+                    for (uint32_t j = first + 1; j < first + count; ++j)
+                    {
+                        const Float3& p = m_points[m_items[j]];
+                        lower = { std::min(lower.x, p.x), std::min(lower.y, p.y), std::min(lower.z, p.z) };
+                        upper = { std::max(upper.x, p.x), std::max(upper.y, p.y), std::max(upper.z, p.z) };
+                    }
+
+                    const Float3 extent = upper - lower;
+                    const uint32_t axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0u : (extent.y >= extent.z ? 1u : 2u);
+
+                    const uint32_t half = count / 2;
+                    std::nth_element(m_items.begin() + first, m_items.begin() + first + half, m_items.begin() + first + count,
+                        [this, axis](uint32_t a, uint32_t b) { return (&m_points[a].x)[axis] < (&m_points[b].x)[axis]; });
+
+                    m_nodes[index].axis = axis;
+                    m_nodes[index].split = (&m_points[m_items[first + half]].x)[axis];
+                    m_nodes[index].count = 0;
+
+                    Build(index, first, half);
+                    const uint32_t right = Build(index, first + half, count - half);
+                    m_nodes[index].right = right;
+                    return index;
+                }
+
+                void Search(uint32_t index, Float3 point, const std::vector<uint8_t>& taken, size_t& best, float& bestDistance) const noexcept
+                {
+                    const Node& node = m_nodes[index];
+                    if (!node.remaining)
+                        return;
+
+                    if (node.count)
+                    {
+                        for (uint32_t j = node.first; j < node.first + node.count; ++j)
+                        {
+                            const uint32_t item = m_items[j];
+                            const Float3 offset = m_points[item] - point;
+                            if (!taken[item] && Dot(offset, offset) < bestDistance)
+                            {
+                                best = item;
+                                bestDistance = Dot(offset, offset);
+                            }
+                        }
+                        return;
+                    }
+
+                    const float delta = (&point.x)[node.axis] - node.split;
+                    const uint32_t nearChild = delta < 0.f ? index + 1 : node.right;
+                    const uint32_t farChild = delta < 0.f ? node.right : index + 1;
+
+                    Search(nearChild, point, taken, best, bestDistance);
+                    if (delta * delta < bestDistance)
+                    {
+                        Search(farChild, point, taken, best, bestDistance);
+                    }
+                }
+
+                const std::vector<Float3>&  m_points;
+                std::vector<uint32_t>       m_items;
+                std::vector<uint32_t>       m_leaves;
+                std::vector<Node>           m_nodes;
+            };
+
+            // The unit axis a quantized cone stands for, as the builder and the culler both use it.
+            inline Float3 DecodeConeAxis(const MeshletBounds& bounds) noexcept
+            {
+                const Float3 axis = { float(bounds.coneAxis[0]), float(bounds.coneAxis[1]), float(bounds.coneAxis[2]) };
+                const float length = Length(axis);
+                return length > 0.f ? axis * (1.f / length) : axis;
+            }
+
+            // corners and normals hold, for each triangle, one corner's position and the unit normal
+            // of its front face, or zero if it's degenerate (and so never drawn).
+            inline MeshletBounds ComputeBounds(const std::vector<Float3>& points, const std::vector<Float3>& corners,
+                const std::vector<Float3>& normals) noexcept
+            {
+                MeshletBounds bounds = {};
+
+                Float3 center;
+                float radius;
+                BoundingSphere(points, center, radius);
+
+                bounds.center[0] = center.x;
+                bounds.center[1] = center.y;
+                bounds.center[2] = center.z;
+                bounds.radius = radius;
+                bounds.coneApex[0] = center.x;
+                bounds.coneApex[1] = center.y;
+                bounds.coneApex[2] = center.z;
+                bounds.coneCutoff = c_NoCone;
+
+                Float3 sum = {};
+                for (const auto& n : normals)
+                {
+                    sum = sum + n;
+                }
+
+                const float length = Length(sum);
+                if (!(length > 0.f))
+                    return bounds;
+
+                // Quantize the axis first and fit the cutoff and apex to the axis the culler will
+                // decode, rounding the cutoff up, so the test stays conservative.
+                const int8_t quantized[3] = { QuantizeSnorm(sum.x / length), QuantizeSnorm(sum.y / length), QuantizeSnorm(sum.z / length) };
+                std::memcpy(bounds.coneAxis, quantized, sizeof(quantized));
+                const Float3 axis = DecodeConeAxis(bounds);
+
+                float minDot = 1.f;
+                for (const auto& n : normals)
+                {
+                    if (Dot(n, n) > 0.f)
+                    {
+                        minDot = std::min(minDot, Dot(axis, n));
+                    }
+                }
+
+                const float cutoff = std::ceil(std::sqrt(std::max(0.f, 1.f - minDot * minDot)) * 127.f);
+                if (minDot <= 0.f || cutoff >= 127.f)
+                {
+                    std::memset(bounds.coneAxis, 0, sizeof(bounds.coneAxis));
+                    return bounds;
+                }
+
+                // The apex goes back along the axis until it's behind every triangle's plane.
+                float distance = 0.f;
+                for (size_t j = 0; j < normals.size(); ++j)
+                {
+                    if (Dot(normals[j], normals[j]) > 0.f)
+                    {
+                        distance = std::max(distance, Dot(center - corners[j], normals[j]) / Dot(axis, normals[j]));
+                    }
+                }
+
+                const Float3 apex = center - axis * distance;
+                bounds.coneApex[0] = apex.x;
+                bounds.coneApex[1] = apex.y;
+                bounds.coneApex[2] = apex.z;
+                bounds.coneCutoff = static_cast<int8_t>(cutoff);
+                return bounds;
+            }
+        }
+
+        // Splits a triangle list into meshlets. Each starts beside the last and grows across the
+        // surface by whichever neighboring triangle adds the fewest vertices, weighed against how far
+        // it turns from the way the meshlet faces, to keep the normal cone narrow. Where the surface
+        // runs out, a meshlet with room left takes the nearest triangle not yet taken.
+        //
+        // positions are float3s stride bytes apart. clockwise says which way front faces wind, in
+        // a right-handed space; SDKMESH files, for one, wind clockwise.
+        inline MeshletSet BuildMeshlets(const uint32_t* indices, size_t indexCount, const void* positions, size_t stride,
+            size_t vertexCount, bool clockwise, size_t maxVertices = c_MaxVertices, size_t maxTriangles = c_MaxTriangles)
+        {
+            using namespace Internal;
+
+            if ((indexCount && !indices) || (indexCount % 3))
+                throw std::invalid_argument("Meshlets: indices must be a triangle list");
+
+            if ((vertexCount && !positions) || stride < 3 * sizeof(float))
+                throw std::invalid_argument("Meshlets: bad positions");
+
+            if (maxVertices < 3 || maxVertices > c_MaxVerticesLimit || !maxTriangles)
+                throw std::invalid_argument("Meshlets: bad limits");
+
+            for (size_t j = 0; j < indexCount; ++j)
+            {
+                if (indices[j] >= vertexCount)
+                    throw std::out_of_range("Meshlets: index out of range");
+            }
+
+            auto position = [&](uint32_t v)
+                {
+                    Float3 p;
+                    std::memcpy(&p, static_cast<const uint8_t*>(positions) + size_t(v) * stride, sizeof(p));
+                    return p;
+                };
+
+            const size_t triangleCount = indexCount / 3;
+
+            std::vector<Float3> normals(triangleCount), centroids(triangleCount);
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                const Float3 a = position(indices[3 * t]);
+                const Float3 b = position(indices[3 * t + 1]);
+                const Float3 c = position(indices[3 * t + 2]);
+                centroids[t] = (a + b + c) * (1.f / 3.f);
+
+                Float3 n = Cross(b - a, c - a);
+                if (clockwise)
+                {
+                    n = n * -1.f;
+                }
+
+                const float length = Length(n);
+                normals[t] = length > 0.f ? n * (1.f / length) : Float3{};
+            }
+
+            // The triangles using each vertex.
+            std::vector<uint32_t> firstAdjacent(vertexCount + 1, 0);
+            for (size_t j = 0; j < indexCount; ++j)
+            {
+                ++firstAdjacent[indices[j] + 1];
+            }
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                firstAdjacent[v + 1] += firstAdjacent[v];
+            }
+
+            std::vector<uint32_t> adjacent(indexCount);
+            {
+                std::vector<uint32_t> filled(firstAdjacent.begin(), firstAdjacent.end() - 1);
+                for (size_t j = 0; j < indexCount; ++j)
+                {
+                    adjacent[filled[indices[j]]++] = static_cast<uint32_t>(j / 3);
+                }
+            }
+
+            NearestPoints nearest(centroids);
+
+            MeshletSet result;
+            std::vector<uint8_t> taken(triangleCount, 0);
+            std::vector<uint32_t> local(vertexCount, UINT32_MAX);
+
+            Meshlet meshlet = {};
+            Float3 normalSum = {};
+            Float3 centroidSum = {};
+            Float3 lastCenter = centroids.empty() ? Float3{} : centroids[0];
+            std::vector<uint32_t> current;
+            std::vector<Float3> points, corners, currentNormals;
+
+            // Vertices triangle t would add to the meshlet.
+            auto newVertices = [&](size_t t)
+                {
+                    const uint32_t* v = indices + 3 * t;
+                    return uint32_t(local[v[0]] == UINT32_MAX)
+                        + uint32_t(local[v[1]] == UINT32_MAX && v[1] != v[0])
+                        + uint32_t(local[v[2]] == UINT32_MAX && v[2] != v[0] && v[2] != v[1]);
+                };
+
+            auto add = [&](size_t t)
+                {
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        const uint32_t v = indices[3 * t + k];
+                        if (local[v] == UINT32_MAX)
+                        {
+                            local[v] = meshlet.vertexCount++;
+                            result.vertices.push_back(v);
+                        }
+                        result.triangles.push_back(static_cast<uint8_t>(local[v]));
+                    }
+
+                    taken[t] = 1;
+                    nearest.Take(t);
+                    ++meshlet.triangleCount;
+                    normalSum = normalSum + normals[t];
+                    centroidSum = centroidSum + centroids[t];
+                    current.push_back(static_cast<uint32_t>(t));
+                };
+
+            auto finish = [&]()
+                {
+                    points.clear();
+                    for (uint32_t j = 0; j < meshlet.vertexCount; ++j)
+                    {
+                        const uint32_t v = result.vertices[meshlet.vertexOffset + j];
+                        points.push_back(position(v));
+                        local[v] = UINT32_MAX;
+                    }
+
+                    corners.clear();
+                    currentNormals.clear();
+                    for (const uint32_t t : current)
+                    {
+                        corners.push_back(position(indices[3 * t]));
+                        currentNormals.push_back(normals[t]);
+                    }
+
+                    result.meshlets.push_back(meshlet);
+                    result.bounds.push_back(ComputeBounds(points, corners, currentNormals));
+
+                    while (result.triangles.size() % 4)
+                    {
+                        result.triangles.push_back(0);
+                    }
+
+                    lastCenter = centroidSum * (1.f / float(meshlet.triangleCount));
+
+                    meshlet = {};
+                    meshlet.vertexOffset = static_cast<uint32_t>(result.vertices.size());
+                    meshlet.triangleOffset = static_cast<uint32_t>(result.triangles.size());
+                    normalSum = {};
+                    centroidSum = {};
+                    current.clear();
+                };
+
+            for (;;)
+            {
+                size_t next = SIZE_MAX;
+                if (meshlet.triangleCount && meshlet.triangleCount < maxTriangles)
+                {
+                    const float normalLength = Length(normalSum);
+                    const Float3 facing = normalLength > 0.f ? normalSum * (1.f / normalLength) : normalSum;
+                    float bestScore = FLT_MAX;
+                    for (uint32_t j = 0; j < meshlet.vertexCount; ++j)
+                    {
+                        const uint32_t v = result.vertices[meshlet.vertexOffset + j];
+                        for (uint32_t a = firstAdjacent[v]; a < firstAdjacent[v + 1]; ++a)
+                        {
+                            const uint32_t t = adjacent[a];
+                            if (taken[t])
+                                continue;
+
+                            const uint32_t added = newVertices(t);
+                            if (meshlet.vertexCount + added > maxVertices)
+                                continue;
+
+                            const float score = float(added) + c_ConeWeight * (1.f - Dot(normals[t], facing));
+                            if (score < bestScore)
+                            {
+                                next = t;
+                                bestScore = score;
+                            }
+                        }
+                    }
+                }
+
+                // Cut off from the rest of the surface, the meshlet takes the nearest triangle left if it's
+                // no farther than the meshlet is across.
+                if (next == SIZE_MAX && meshlet.triangleCount && meshlet.triangleCount < maxTriangles
+                    && meshlet.vertexCount + 3 <= maxVertices)
+                {
+                    const Float3 center = centroidSum * (1.f / float(meshlet.triangleCount));
+                    float extent = 0.f;
+                    for (const uint32_t t : current)
+                    {
+                        extent = std::max(extent, Length(centroids[t] - center));
+                    }
+
+                    const size_t candidate = nearest.Nearest(center, taken);
+                    if (candidate != SIZE_MAX && Length(centroids[candidate] - center) <= 2.f * extent)
+                    {
+                        next = candidate;
+                    }
+                }
+
+                // Otherwise the next meshlet starts beside this one.
+                if (next == SIZE_MAX)
+                {
+                    if (meshlet.triangleCount)
+                    {
+                        finish();
+                    }
+
+                    next = nearest.Nearest(lastCenter, taken);
+                    if (next == SIZE_MAX)
+                        break;
+                }
+
+                add(next);
+            }
+
+            return result;
+        }
+
+        inline bool IsOutsideFrustum(const MeshletBounds& bounds, const Frustum& frustum) noexcept
+        {
+            for (const auto& plane : frustum.planes)
+            {
+                if (plane[0] * bounds.center[0] + plane[1] * bounds.center[1] + plane[2] * bounds.center[2] + plane[3] < -bounds.radius)
+                    return true;
+            }
+            return false;
+        }
+
+        // True if every triangle faces away from the eye (or is edge on to it).
+        inline bool IsBackFacing(const MeshletBounds& bounds, const float (&eye)[3]) noexcept
+        {
+            if (bounds.coneCutoff == c_NoCone)
+                return false;
+
+            const Internal::Float3 toApex = {
+                bounds.coneApex[0] - eye[0], bounds.coneApex[1] - eye[1], bounds.coneApex[2] - eye[2] };
+
+            return Internal::Dot(toApex, Internal::DecodeConeAxis(bounds))
+                >= float(bounds.coneCutoff) / 127.f * Internal::Length(toApex);
+        }
+
+        // The reference culler, for checking a GPU one against and for CPU-side submission. The
+        // frustum and eye must be in the meshes' own space: take the frustum from world * view *
+        // projection, and the eye through the inverse world. Cones stay valid under rotation,
+        // translation and uniform scale, but not under non-uniform scale.
+        //
+        // Appends the indices of the meshlets which survive to visible, if given.
+        inline CullStatistics CullMeshlets(const MeshletBounds* bounds, size_t count, const Frustum& frustum, const float (&eye)[3],
+            std::vector<uint32_t>* visible = nullptr)
+        {
+            CullStatistics statistics = {};
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (IsOutsideFrustum(bounds[j], frustum))
+                {
+                    ++statistics.outsideFrustum;
+                }
+                else if (IsBackFacing(bounds[j], eye))
+                {
+                    ++statistics.backFacing;
+                }
+                else
+                {
+                    ++statistics.visible;
+                    if (visible)
+                    {
+                        visible->push_back(static_cast<uint32_t>(j));
+                    }
+                }
+            }
+            return statistics;
+        }
+    }
+
+    // A meshlet file is a sidecar to a model holding the meshlets of its mesh parts:
+    //
+    //   Header          32 bytes at offset 0
+    //   Part[]          which meshlets belong to which of the model's mesh parts
+    //   Meshlet[]       for every part, one after another
+    //   MeshletBounds[] one for each meshlet
+    //   uint32_t[]      the meshlets' vertices, indices into the model's vertex buffer relative to
+    //                   their part's base vertex, as its index buffer holds them
+    //   uint8_t[]       the meshlets' triangles
+    //
+    // Everything is little-endian, and each array starts on a 4-byte boundary.
+    namespace MeshletFormat
+    {
+        constexpr uint32_t c_Magic = 0x4C48534D;          // 'MSHL'
+        constexpr uint32_t c_Version = 1;
+
+        struct Header
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            uint32_t    partCount;
+            uint32_t    meshletCount;
+            uint32_t    vertexCount;
+            uint32_t    triangleBytes;
+            uint32_t    reserved[2];
+        };
+
+        // A mesh part is the subset at position subset of mesh's subset list, as a Model makes them.
+        struct Part
+        {
+            uint32_t    mesh;
+            uint32_t    subset;
+            uint32_t    firstMeshlet;
+            uint32_t    meshletCount;
+        };
+
+        static_assert(sizeof(Header) == 32, "Meshlet file header size mismatch");
+        static_assert(sizeof(Part) == 16, "Meshlet file part size mismatch");
+    }
+
+    // Validates a meshlet file image where it lies. The image must be 4-byte aligned and outlive
+    // the view. Everything is checked up front, down to each triangle's vertices, and a malformed
+    // file throws std::runtime_error from the constructor.
+    class MeshletFileView
+    {
+    public:
+        MeshletFileView(_In_reads_bytes_(dataSize) const uint8_t* data, size_t dataSize) noexcept(false) :
+            m_header(nullptr),
+            m_parts(nullptr),
+            m_meshlets(nullptr),
+            m_bounds(nullptr),
+            m_vertices(nullptr),
+            m_triangles(nullptr)
+        {
+            using namespace MeshletFormat;
+
+            if (!data || dataSize < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % alignof(Header))
+                throw std::runtime_error("Invalid meshlet file: too small or misaligned");
+
+            m_header = reinterpret_cast<const Header*>(data);
+            if (m_header->magic != c_Magic || m_header->version != c_Version)
+                throw std::runtime_error("Invalid meshlet file: not a meshlet file, or the wrong version");
+
+            const uint64_t partsOffset = sizeof(Header);
+            const uint64_t meshletsOffset = partsOffset + uint64_t(m_header->partCount) * sizeof(Part);
+            const uint64_t boundsOffset = meshletsOffset + uint64_t(m_header->meshletCount) * sizeof(Meshlets::Meshlet);
+            const uint64_t verticesOffset = boundsOffset + uint64_t(m_header->meshletCount) * sizeof(Meshlets::MeshletBounds);
+            const uint64_t trianglesOffset = verticesOffset + uint64_t(m_header->vertexCount) * sizeof(uint32_t);
+            if (trianglesOffset + m_header->triangleBytes > dataSize)
+                throw std::runtime_error("Invalid meshlet file: truncated");
+
+            m_parts = reinterpret_cast<const Part*>(data + partsOffset);
+            m_meshlets = reinterpret_cast<const Meshlets::Meshlet*>(data + meshletsOffset);
+            m_bounds = reinterpret_cast<const Meshlets::MeshletBounds*>(data + boundsOffset);
+            m_vertices = reinterpret_cast<const uint32_t*>(data + verticesOffset);
+            m_triangles = data + trianglesOffset;
+
+            for (uint32_t j = 0; j < m_header->partCount; ++j)
+            {
+                if (uint64_t(m_parts[j].firstMeshlet) + m_parts[j].meshletCount > m_header->meshletCount)
+                    throw std::runtime_error("Invalid meshlet file: part out of range");
+            }
+
+            for (uint32_t j = 0; j < m_header->meshletCount; ++j)
+            {
+                const auto& meshlet = m_meshlets[j];
+                if (meshlet.vertexCount > Meshlets::c_MaxVerticesLimit
+                    || uint64_t(meshlet.vertexOffset) + meshlet.vertexCount > m_header->vertexCount
+                    || uint64_t(meshlet.triangleOffset) + uint64_t(meshlet.triangleCount) * 3 > m_header->triangleBytes)
+                {
+                    throw std::runtime_error("Invalid meshlet file: meshlet out of range");
+                }
+
+                const uint8_t* triangles = m_triangles + meshlet.triangleOffset;
+                for (uint32_t k = 0; k < meshlet.triangleCount * 3; ++k)
+                {
+                    if (triangles[k] >= meshlet.vertexCount)
+                        throw std::runtime_error("Invalid meshlet file: triangle vertex out of range");
+                }
+            }
+        }
+
+        MeshletFileView(MeshletFileView&&) = default;
+        MeshletFileView& operator= (MeshletFileView&&) = default;
+
+        MeshletFileView(MeshletFileView const&) = default;
+        MeshletFileView& operator= (MeshletFileView const&) = default;
+
+        uint32_t GetPartCount() const noexcept { return m_header->partCount; }
+        const MeshletFormat::Part& GetPart(uint32_t index) const noexcept { return m_parts[index]; }
+
+        uint32_t GetMeshletCount() const noexcept { return m_header->meshletCount; }
+        const Meshlets::Meshlet* GetMeshlets() const noexcept { return m_meshlets; }
+        const Meshlets::MeshletBounds* GetBounds() const noexcept { return m_bounds; }
+
+        uint32_t GetVertexCount() const noexcept { return m_header->vertexCount; }
+        const uint32_t* GetVertices() const noexcept { return m_vertices; }
+
+        uint32_t GetTriangleBytes() const noexcept { return m_header->triangleBytes; }
+        const uint8_t* GetTriangles() const noexcept { return m_triangles; }
+
+    private:
+        const MeshletFormat::Header*        m_header;
+        const MeshletFormat::Part*          m_parts;
+        const Meshlets::Meshlet*            m_meshlets;
+        const Meshlets::MeshletBounds*      m_bounds;
+        const uint32_t*                     m_vertices;
+        const uint8_t*                      m_triangles;
+    };
+}
@@ -0,0 +1,115 @@
+//
+// PipelineCompileQueue.h - Creates pipeline state objects concurrently on a ThreadPool
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdint>
+
+
+namespace DX
+{
+    // Runs pipeline state creation, or the construction of objects which create their own pipeline
+    // state (such as effects), on worker threads. ID3D12Device creation methods are free-threaded,
+    // so requests overlap with each other and with whatever the caller does next.
+    //
+    // Enqueue returns a future for the created object; call get() on it before the object's first
+    // use. Errors are rethrown from get().
+    class PipelineCompileQueue
+    {
+    public:
+        struct Statistics
+        {
+            uint32_t    requests;
+            uint32_t    completed;
+            double      totalCompileMs;     // Sum over requests, as if they had run one after another
+            double      longestCompileMs;
+        };
+
+        explicit PipelineCompileQueue(ThreadPool& threadPool) noexcept :
+            m_threadPool(&threadPool),
+            m_stats{}
+        {
+        }
+
+        PipelineCompileQueue(PipelineCompileQueue&&) = delete;
+        PipelineCompileQueue& operator= (PipelineCompileQueue&&) = delete;
+
+        PipelineCompileQueue(PipelineCompileQueue const&) = delete;
+        PipelineCompileQueue& operator= (PipelineCompileQueue const&) = delete;
+
+        // Requests still queued hold a pointer to this object, so they must finish first.
+        ~PipelineCompileQueue()
+        {
+            WaitAll();
+        }
+
+        template<typename F>
+        auto Enqueue(F&& create) -> std::future<decltype(create())>
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_stats.requests;
+            }
+
+            return m_threadPool->Submit(
+                [this, create = std::forward<F>(create)]() mutable
+                {
+                    const auto start = std::chrono::steady_clock::now();
+
+                    // Count the request as completed even if creation throws; the future carries the error.
+                    struct Completion
+                    {
+                        PipelineCompileQueue* queue;
+                        std::chrono::steady_clock::time_point start;
+                        ~Completion() { queue->OnCompleted(start); }
+                    } completion{ this, start };
+
+                    return create();
+                });
+        }
+
+        // Blocks until every request made so far has completed.
+        void WaitAll()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stats.completed == m_stats.requests; });
+        }
+
+        Statistics GetStatistics() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_stats;
+        }
+
+        void ResetStatistics()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const uint32_t outstanding = m_stats.requests - m_stats.completed;
+            m_stats = {};
+            m_stats.requests = outstanding;
+        }
+
+    private:
+        void OnCompleted(std::chrono::steady_clock::time_point start)
+        {
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.completed;
+            m_stats.totalCompileMs += ms;
+            m_stats.longestCompileMs = std::max(m_stats.longestCompileMs, ms);
+
+            // Notify while holding the lock, so a waiting destructor can't return before this thread is done.
+            m_condition.notify_all();
+        }
+
+        ThreadPool*                 m_threadPool;
+        mutable std::mutex          m_mutex;
+        std::condition_variable     m_condition;
+        Statistics                  m_stats;
+    };
+}
@@ -0,0 +1,120 @@
+//
+// ProgressiveTexture.cpp - DDS texture uploaded one mip level at a time, smallest first
+//
+
+#include "pch.h"
+#include "ProgressiveTexture.h"
+
+using namespace DirectX;
+using namespace DX;
+
+ProgressiveTexture::ProgressiveTexture(ID3D12Device* device, AssetData&& dds, uint32_t tailSize) noexcept(false) :
+    m_dds(std::move(dds)),
+    m_mipLevels(0),
+    m_tailMip(0),
+    m_recordedMip(0),
+    m_residentMip(0),
+    m_isCubeMap(false)
+{
+    if (!device)
+    {
+        throw std::invalid_argument("ProgressiveTexture");
+    }
+
+    // The subresources point into the image rather than being copied out of it.
+    ThrowIfFailed(
+        LoadDDSTextureFromMemory(device, m_dds.GetData(), m_dds.GetSize(), m_texture.ReleaseAndGetAddressOf(),
+            m_subresources, 0, nullptr, &m_isCubeMap)
+    );
+
+    const auto desc = m_texture->GetDesc();
+    m_mipLevels = desc.MipLevels;
+    m_recordedMip = m_mipLevels;
+    m_residentMip = m_mipLevels;
+
+    // With a single slice, subresource j is mip level j. Anything else has a tail of every level.
+    if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D
+        || desc.DepthOrArraySize != 1
+        || m_subresources.size() != m_mipLevels)
+    {
+        return;
+    }
+
+    m_tailMip = m_mipLevels - 1;
+    while (m_tailMip > 0
+        && (desc.Width >> (m_tailMip - 1)) <= tailSize
+        && (desc.Height >> (m_tailMip - 1)) <= tailSize)
+    {
+        --m_tailMip;
+    }
+}
+
+void ProgressiveTexture::RecordTail(ResourceUploadBatch& resourceUpload)
+{
+    if (m_recordedMip != m_mipLevels)
+    {
+        throw std::logic_error("ProgressiveTexture::RecordTail called twice");
+    }
+
+    resourceUpload.Upload(m_texture.Get(), m_tailMip, &m_subresources[m_tailMip],
+        static_cast<uint32_t>(m_subresources.size() - m_tailMip));
+
+    m_recordedMip = m_tailMip;
+}
+
+void ProgressiveTexture::RecordNextLevel(ResourceUploadBatch& resourceUpload)
+{
+    if (m_recordedMip == m_mipLevels || !m_recordedMip)
+    {
+        throw std::logic_error("ProgressiveTexture::RecordNextLevel has no level to record");
+    }
+
+    --m_recordedMip;
+    resourceUpload.Upload(m_texture.Get(), m_recordedMip, &m_subresources[m_recordedMip], 1);
+}
+
+size_t ProgressiveTexture::GetNextLevelSize() const noexcept
+{
+    if (m_recordedMip == m_mipLevels || !m_recordedMip)
+        return 0;
+
+    return static_cast<size_t>(m_subresources[m_recordedMip - 1].SlicePitch);
+}
+
+void ProgressiveTexture::MakeRecordedResident() noexcept
+{
+    m_residentMip = m_recordedMip;
+
+    // Once everything is on the GPU the image is no longer needed.
+    if (!m_residentMip)
+    {
+        m_subresources.clear();
+        m_subresources.shrink_to_fit();
+        m_dds = AssetData();
+    }
+}
+
+void ProgressiveTexture::CreateShaderResourceView(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE descriptor) const
+{
+    if (!IsResident())
+    {
+        throw std::logic_error("ProgressiveTexture::CreateShaderResourceView called before the tail was resident");
+    }
+
+    if (!m_tailMip)
+    {
+        DirectX::CreateShaderResourceView(device, m_texture.Get(), descriptor, m_isCubeMap);
+        return;
+    }
+
+    const auto desc = m_texture->GetDesc();
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = desc.Format;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Texture2D.MipLevels = desc.MipLevels;
+    srvDesc.Texture2D.ResourceMinLODClamp = static_cast<float>(m_residentMip);
+
+    device->CreateShaderResourceView(m_texture.Get(), &srvDesc, descriptor);
+}
@@ -0,0 +1,71 @@
+//
+// ProgressiveTexture.h - DDS texture uploaded one mip level at a time, smallest first
+//
+
+#pragma once
+
+#include "AssetPack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace DX
+{
+    // A DDS texture which can be drawn as soon as its mip tail has been copied, and then has its
+    // finer levels copied in one at a time. Its view clamps sampling (ResourceMinLODClamp) to the
+    // finest level resident so far, so the texture sharpens as levels arrive instead of appearing
+    // only once all of it has been loaded, and no single copy has to carry the whole mip chain.
+    //
+    // The levels are copied from the DDS image, which is kept until the last one has been recorded.
+    // Only plain 2D textures stream by level; arrays, cube maps and volumes go up whole with the tail.
+    class ProgressiveTexture
+    {
+    public:
+        // Levels no larger than this in either dimension are uploaded together as the tail.
+        static constexpr uint32_t c_DefaultTailSize = 64;
+
+        // Creates the texture, ready to be copied to, without uploading anything.
+        ProgressiveTexture(_In_ ID3D12Device* device, AssetData&& dds, uint32_t tailSize = c_DefaultTailSize) noexcept(false);
+
+        ProgressiveTexture(ProgressiveTexture&&) = default;
+        ProgressiveTexture& operator= (ProgressiveTexture&&) = default;
+
+        ProgressiveTexture(ProgressiveTexture const&) = delete;
+        ProgressiveTexture& operator= (ProgressiveTexture const&) = delete;
+
+        // Records the copy of the mip tail. This must be the first copy recorded.
+        void RecordTail(DirectX::ResourceUploadBatch& resourceUpload);
+
+        // Records the copy of the next finer level.
+        void RecordNextLevel(DirectX::ResourceUploadBatch& resourceUpload);
+
+        // Bytes RecordNextLevel would copy, or zero once every level has been recorded.
+        size_t GetNextLevelSize() const noexcept;
+
+        // Call once every copy recorded so far has completed; the view then covers those levels.
+        void MakeRecordedResident() noexcept;
+
+        // Writes a view clamped to the resident levels. Rewrite it after each MakeRecordedResident.
+        void CreateShaderResourceView(_In_ ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE descriptor) const;
+
+        bool IsResident() const noexcept { return m_residentMip < m_mipLevels; }
+        bool IsComplete() const noexcept { return m_residentMip == 0; }
+
+        uint32_t GetResidentMip() const noexcept { return m_residentMip; }
+        uint32_t GetMipLevels() const noexcept { return m_mipLevels; }
+
+        ID3D12Resource* GetResource() const noexcept { return m_texture.Get(); }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Resource>  m_texture;
+        AssetData                               m_dds;
+        std::vector<D3D12_SUBRESOURCE_DATA>     m_subresources;     // Point into m_dds
+        uint32_t                                m_mipLevels;
+        uint32_t                                m_tailMip;          // Finest level in the tail
+        uint32_t                                m_recordedMip;      // Finest level recorded; m_mipLevels before the tail
+        uint32_t                                m_residentMip;      // Finest level copied; m_mipLevels before the tail
+        bool                                    m_isCubeMap;
+    };
+}
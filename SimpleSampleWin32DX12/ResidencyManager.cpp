@@ -0,0 +1,141 @@
+//
+// ResidencyManager.cpp - Keeps textures within a video memory budget, evicting the least recently used
+//
+
+#include "pch.h"
+#include "ResidencyManager.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+ResidencyManager::ResidencyManager(ID3D12Device* device, IDXGIFactory4* factory, uint64_t budget) noexcept(false) :
+    m_device(device),
+    m_budget(budget),
+    m_effectiveBudget(UINT64_MAX),
+    m_evictions(0),
+    m_restores(0)
+{
+    if (!device)
+    {
+        throw std::invalid_argument("ResidencyManager");
+    }
+
+    // Without the adapter (or IDXGIAdapter3) only the fixed budget applies.
+    if (factory)
+    {
+        std::ignore = factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(m_adapter.ReleaseAndGetAddressOf()));
+    }
+}
+
+ResidencyManager::Handle ResidencyManager::Add(ID3D12Resource* resource, uint64_t fenceValue)
+{
+    if (!resource)
+    {
+        throw std::invalid_argument("ResidencyManager::Add");
+    }
+
+    const auto desc = resource->GetDesc();
+    const auto info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+    const Handle handle = m_policy.Add(info.SizeInBytes, fenceValue);
+    if (handle >= m_objects.size())
+    {
+        m_objects.resize(size_t(handle) + 1);
+    }
+    m_objects[handle] = resource;
+    return handle;
+}
+
+void ResidencyManager::Remove(Handle handle)
+{
+    m_policy.Remove(handle);
+    m_objects[handle].Reset();
+}
+
+void ResidencyManager::Use(Handle handle, uint64_t fenceValue)
+{
+    if (!m_policy.Use(handle, fenceValue))
+    {
+        m_restore.push_back(handle);
+    }
+}
+
+void ResidencyManager::SetPinned(Handle handle, bool pinned)
+{
+    m_policy.SetPinned(handle, pinned);
+}
+
+bool ResidencyManager::IsResident(Handle handle) const
+{
+    return m_policy.IsResident(handle);
+}
+
+void ResidencyManager::Update(uint64_t completedFenceValue)
+{
+    // MakeResident returns once the memory is back, so this frame's draws can use it.
+    m_pageables.clear();
+    for (const Handle handle : m_restore)
+    {
+        if (m_objects[handle] && !m_policy.IsResident(handle))
+        {
+            m_pageables.push_back(m_objects[handle].Get());
+            m_policy.MarkResident(handle);
+        }
+    }
+    m_restore.clear();
+
+    if (!m_pageables.empty())
+    {
+        ThrowIfFailed(m_device->MakeResident(static_cast<UINT>(m_pageables.size()), m_pageables.data()));
+        m_restores += static_cast<uint32_t>(m_pageables.size());
+    }
+
+    // When the process is over the OS budget, what is tracked here gives back the difference.
+    uint64_t budget = m_budget ? m_budget : UINT64_MAX;
+    if (m_adapter)
+    {
+        DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+        if (SUCCEEDED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info))
+            && info.CurrentUsage > info.Budget)
+        {
+            const uint64_t over = info.CurrentUsage - info.Budget;
+            const uint64_t resident = m_policy.GetResidentBytes();
+            budget = std::min(budget, resident > over ? resident - over : 0);
+        }
+    }
+    m_effectiveBudget = budget;
+
+    m_evict.clear();
+    m_policy.Trim(budget, completedFenceValue, m_evict);
+
+    if (!m_evict.empty())
+    {
+        m_pageables.clear();
+        for (const Handle handle : m_evict)
+        {
+            m_pageables.push_back(m_objects[handle].Get());
+        }
+
+        ThrowIfFailed(m_device->Evict(static_cast<UINT>(m_pageables.size()), m_pageables.data()));
+        m_evictions += static_cast<uint32_t>(m_pageables.size());
+
+    #ifdef _DEBUG
+        char buff[128] = {};
+        sprintf_s(buff, "Residency: evicted %zu resources, %llu KB of %llu KB now resident\n",
+            m_evict.size(), m_policy.GetResidentBytes() / 1024, m_policy.GetTotalBytes() / 1024);
+        OutputDebugStringA(buff);
+    #endif
+    }
+}
+
+ResidencyManager::Statistics ResidencyManager::GetStatistics() const noexcept
+{
+    Statistics stats = {};
+    stats.residentBytes = m_policy.GetResidentBytes();
+    stats.totalBytes = m_policy.GetTotalBytes();
+    stats.budget = m_effectiveBudget;
+    stats.evictions = m_evictions;
+    stats.restores = m_restores;
+    return stats;
+}
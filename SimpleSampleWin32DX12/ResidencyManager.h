@@ -0,0 +1,79 @@
+//
+// ResidencyManager.h - Keeps textures within a video memory budget, evicting the least recently used
+//
+
+#pragma once
+
+#include "ResidencyPolicy.h"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace DX
+{
+    // Tracks when each registered resource was last drawn, and evicts the least recently used ones
+    // (ID3D12Device::Evict) once they exceed the budget: a fixed one if given, further reduced by
+    // however far the process is over the budget the OS currently allows it (QueryVideoMemoryInfo).
+    // A resource drawn again after being evicted is made resident before the frame is submitted.
+    //
+    // Uses are stamped with the graphics fence value of the frame making them, so nothing a frame
+    // in flight may still read is evicted. Pin resources which other queues are writing to.
+    class ResidencyManager
+    {
+    public:
+        using Handle = ResidencyPolicy::Handle;
+
+        static constexpr Handle c_InvalidHandle = ResidencyPolicy::c_InvalidHandle;
+
+        struct Statistics
+        {
+            uint64_t    residentBytes;
+            uint64_t    totalBytes;
+            uint64_t    budget;             // In effect at the last Update; UINT64_MAX if none
+            uint32_t    evictions;
+            uint32_t    restores;           // Evicted resources made resident again
+        };
+
+        // A budget of zero leaves only the OS budget.
+        ResidencyManager(_In_ ID3D12Device* device, _In_opt_ IDXGIFactory4* factory, uint64_t budget = 0) noexcept(false);
+
+        ResidencyManager(ResidencyManager&&) = default;
+        ResidencyManager& operator= (ResidencyManager&&) = default;
+
+        ResidencyManager(ResidencyManager const&) = delete;
+        ResidencyManager& operator= (ResidencyManager const&) = delete;
+
+        // Starts tracking a resident resource, as if used by the frame which signals fenceValue.
+        Handle Add(_In_ ID3D12Resource* resource, uint64_t fenceValue);
+        void Remove(Handle handle);
+
+        // Records a use by the frame which signals fenceValue.
+        void Use(Handle handle, uint64_t fenceValue);
+
+        void SetPinned(Handle handle, bool pinned);
+        bool IsResident(Handle handle) const;
+
+        // Makes resident whatever was used since the last call after having been evicted, then
+        // evicts down to the budget. Call once a frame, before its command lists are submitted.
+        void Update(uint64_t completedFenceValue);
+
+        void SetBudget(uint64_t budget) noexcept { m_budget = budget; }
+        uint64_t GetBudget() const noexcept { return m_budget; }
+
+        Statistics GetStatistics() const noexcept;
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Device>                m_device;
+        Microsoft::WRL::ComPtr<IDXGIAdapter3>               m_adapter;
+        ResidencyPolicy                                     m_policy;
+        std::vector<Microsoft::WRL::ComPtr<ID3D12Pageable>> m_objects;          // Indexed by handle
+        std::vector<Handle>                                 m_restore;
+        std::vector<Handle>                                 m_evict;
+        std::vector<ID3D12Pageable*>                        m_pageables;
+        uint64_t                                            m_budget;
+        uint64_t                                            m_effectiveBudget;
+        uint32_t                                            m_evictions;
+        uint32_t                                            m_restores;
+    };
+}
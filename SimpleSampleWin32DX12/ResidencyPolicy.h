@@ -0,0 +1,246 @@
+//
+// ResidencyPolicy.h - Least-recently-used eviction under a memory budget
+//
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+
+namespace DX
+{
+    // The bookkeeping behind ResidencyManager, kept free of Direct3D so it can be run on the CPU
+    // alone. Each object has a size, and a stamp for its last use: any value which never decreases
+    // from one call to the next, such as the fence value of the frame using it. Resident objects
+    // are kept in a list ordered by last use, so Trim finds eviction candidates from the least
+    // recently used end without sorting.
+    //
+    // An object is only evicted once the stamp of its last use has completed, so nothing a frame in
+    // flight still reads is chosen, and never while it is pinned (for instance, while it is being
+    // copied to).
+    class ResidencyPolicy
+    {
+    public:
+        using Handle = uint32_t;
+
+        static constexpr Handle c_InvalidHandle = UINT32_MAX;
+
+        ResidencyPolicy() noexcept :
+            m_head(c_InvalidHandle),
+            m_tail(c_InvalidHandle),
+            m_residentBytes(0),
+            m_totalBytes(0),
+            m_count(0)
+        {
+        }
+
+        ResidencyPolicy(ResidencyPolicy&&) = default;
+        ResidencyPolicy& operator= (ResidencyPolicy&&) = default;
+
+        ResidencyPolicy(ResidencyPolicy const&) = default;
+        ResidencyPolicy& operator= (ResidencyPolicy const&) = default;
+
+        // Adds a resident object, last used at stamp.
+        Handle Add(uint64_t size, uint64_t stamp)
+        {
+            Handle handle;
+            if (!m_free.empty())
+            {
+                handle = m_free.back();
+                m_free.pop_back();
+            }
+            else
+            {
+                if (m_entries.size() >= c_InvalidHandle)
+                {
+                    throw std::length_error("ResidencyPolicy");
+                }
+
+                handle = static_cast<Handle>(m_entries.size());
+                m_entries.emplace_back();
+            }
+
+            auto& entry = m_entries[handle];
+            entry = Entry();
+            entry.size = size;
+            entry.lastUsed = stamp;
+            entry.live = true;
+            entry.resident = true;
+
+            Link(handle);
+            m_residentBytes += size;
+            m_totalBytes += size;
+            ++m_count;
+            return handle;
+        }
+
+        void Remove(Handle handle)
+        {
+            auto& entry = Get(handle);
+            if (entry.resident)
+            {
+                Unlink(handle);
+                m_residentBytes -= entry.size;
+            }
+
+            m_totalBytes -= entry.size;
+            --m_count;
+            entry.live = false;
+            m_free.push_back(handle);
+        }
+
+        // Records a use at stamp. Returns false if the object is evicted, in which case it must be
+        // made resident, and MarkResident called, before the use executes.
+        bool Use(Handle handle, uint64_t stamp)
+        {
+            auto& entry = Get(handle);
+            if (stamp > entry.lastUsed)
+            {
+                entry.lastUsed = stamp;
+            }
+
+            if (!entry.resident)
+                return false;
+
+            // Move to the most recently used end.
+            Unlink(handle);
+            Link(handle);
+            return true;
+        }
+
+        void MarkResident(Handle handle)
+        {
+            auto& entry = Get(handle);
+            if (entry.resident)
+                return;
+
+            entry.resident = true;
+            Link(handle);
+            m_residentBytes += entry.size;
+        }
+
+        void SetPinned(Handle handle, bool pinned)
+        {
+            Get(handle).pinned = pinned;
+        }
+
+        // Chooses objects to evict, least recently used first, until the resident objects fit in
+        // budget or no more can be evicted; only those whose last use is no later than
+        // completedStamp are candidates. Those chosen are appended to evicted and marked as evicted.
+        void Trim(uint64_t budget, uint64_t completedStamp, std::vector<Handle>& evicted)
+        {
+            Handle handle = m_head;
+            while (m_residentBytes > budget && handle != c_InvalidHandle)
+            {
+                auto& entry = m_entries[handle];
+
+                // The list is in order of use, so everything from here on is more recent.
+                if (entry.lastUsed > completedStamp)
+                    break;
+
+                const Handle next = entry.next;
+                if (!entry.pinned)
+                {
+                    Unlink(handle);
+                    entry.resident = false;
+                    m_residentBytes -= entry.size;
+                    evicted.push_back(handle);
+                }
+                handle = next;
+            }
+        }
+
+        bool IsResident(Handle handle) const { return Get(handle).resident; }
+        bool IsPinned(Handle handle) const { return Get(handle).pinned; }
+        uint64_t GetSize(Handle handle) const { return Get(handle).size; }
+        uint64_t GetLastUsed(Handle handle) const { return Get(handle).lastUsed; }
+
+        uint64_t GetResidentBytes() const noexcept { return m_residentBytes; }
+        uint64_t GetTotalBytes() const noexcept { return m_totalBytes; }
+        uint32_t GetCount() const noexcept { return m_count; }
+
+    private:
+        struct Entry
+        {
+            uint64_t    size = 0;
+            uint64_t    lastUsed = 0;
+            Handle      prev = c_InvalidHandle;     // Toward the least recently used end
+            Handle      next = c_InvalidHandle;
+            bool        live = false;
+            bool        resident = false;
+            bool        pinned = false;
+        };
+
+        Entry& Get(Handle handle)
+        {
+            if (handle >= m_entries.size() || !m_entries[handle].live)
+            {
+                throw std::out_of_range("ResidencyPolicy: invalid handle");
+            }
+            return m_entries[handle];
+        }
+
+        const Entry& Get(Handle handle) const
+        {
+            if (handle >= m_entries.size() || !m_entries[handle].live)
+            {
+                throw std::out_of_range("ResidencyPolicy: invalid handle");
+            }
+            return m_entries[handle];
+        }
+
+        // Appends to the most recently used end.
+        void Link(Handle handle) noexcept
+        {
+            auto& entry = m_entries[handle];
+            entry.prev = m_tail;
+            entry.next = c_InvalidHandle;
+
+            if (m_tail != c_InvalidHandle)
+            {
+                m_entries[m_tail].next = handle;
+            }
+            else
+            {
+                m_head = handle;
+            }
+            m_tail = handle;
+        }
+
+        void Unlink(Handle handle) noexcept
+        {
+            auto& entry = m_entries[handle];
+
+            if (entry.prev != c_InvalidHandle)
+            {
+                m_entries[entry.prev].next = entry.next;
+            }
+            else
+            {
+                m_head = entry.next;
+            }
+
+            if (entry.next != c_InvalidHandle)
+            {
+                m_entries[entry.next].prev = entry.prev;
+            }
+            else
+            {
+                m_tail = entry.prev;
+            }
+
+            entry.prev = c_InvalidHandle;
+            entry.next = c_InvalidHandle;
+        }
+
+        std::vector<Entry>      m_entries;
+        std::vector<Handle>     m_free;
+        Handle                  m_head;             // Least recently used resident object
+        Handle                  m_tail;             // Most recently used
+        uint64_t                m_residentBytes;
+        uint64_t                m_totalBytes;
+        uint32_t                m_count;
+    };
+}
@@ -0,0 +1,468 @@
+//
+// SDKMesh.h - SDKMESH file layout, and a validated read-only view of a file image
+//
+
+#pragma once
+
+#include "SalFallbacks.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+
+namespace DX
+{
+    // The on-disk layout, matching the structures DirectXTK's loader reads. Only fixed-size types are
+    // used so the layout is the same for every compiler and platform.
+    namespace SDKMesh
+    {
+        constexpr uint32_t c_FileVersion = 101;
+        constexpr uint32_t c_FileVersionV2 = 200;     // PBR materials
+
+        constexpr uint32_t c_MaxVertexElements = 32;
+        constexpr uint32_t c_MaxVertexStreams = 16;
+        constexpr uint32_t c_MaxFrameName = 100;
+        constexpr uint32_t c_MaxMeshName = 100;
+        constexpr uint32_t c_MaxSubsetName = 100;
+        constexpr uint32_t c_MaxMaterialName = 100;
+        constexpr uint32_t c_MaxPath = 260;
+
+        constexpr uint32_t c_InvalidFrame = uint32_t(-1);
+        constexpr uint32_t c_InvalidMesh = uint32_t(-1);
+
+        enum INDEX_TYPE : uint32_t
+        {
+            IndexType_16Bit = 0,
+            IndexType_32Bit,
+        };
+
+        enum PRIMITIVE_TYPE : uint32_t
+        {
+            PrimitiveType_TriangleList = 0,
+            PrimitiveType_TriangleStrip,
+            PrimitiveType_LineList,
+            PrimitiveType_LineStrip,
+            PrimitiveType_PointList,
+            PrimitiveType_TriangleListAdj,
+            PrimitiveType_TriangleStripAdj,
+            PrimitiveType_LineListAdj,
+            PrimitiveType_LineStripAdj,
+            PrimitiveType_QuadPatchList,
+            PrimitiveType_TrianglePatchList,
+        };
+
+    #pragma pack(push, 8)
+
+        struct Header
+        {
+            uint32_t    Version;
+            uint8_t     IsBigEndian;
+            uint64_t    HeaderSize;
+            uint64_t    NonBufferDataSize;
+            uint64_t    BufferDataSize;
+
+            uint32_t    NumVertexBuffers;
+            uint32_t    NumIndexBuffers;
+            uint32_t    NumMeshes;
+            uint32_t    NumTotalSubsets;
+            uint32_t    NumFrames;
+            uint32_t    NumMaterials;
+
+            // Offsets from the start of the file.
+            uint64_t    VertexStreamHeadersOffset;
+            uint64_t    IndexStreamHeadersOffset;
+            uint64_t    MeshDataOffset;
+            uint64_t    SubsetDataOffset;
+            uint64_t    FrameDataOffset;
+            uint64_t    MaterialDataOffset;
+        };
+
+        // D3DVERTEXELEMENT9; the declaration ends at the first element with Stream 0xFF.
+        struct VertexElement
+        {
+            uint16_t    Stream;
+            uint16_t    Offset;
+            uint8_t     Type;
+            uint8_t     Method;
+            uint8_t     Usage;
+            uint8_t     UsageIndex;
+        };
+
+        struct VertexBufferHeader
+        {
+            uint64_t        NumVertices;
+            uint64_t        SizeBytes;
+            uint64_t        StrideBytes;
+            VertexElement   Decl[c_MaxVertexElements];
+            uint64_t        DataOffset;
+        };
+
+        struct IndexBufferHeader
+        {
+            uint64_t    NumIndices;
+            uint64_t    SizeBytes;
+            uint32_t    IndexType;
+            uint64_t    DataOffset;
+        };
+
+        struct Mesh
+        {
+            char        Name[c_MaxMeshName];
+            uint8_t     NumVertexBuffers;
+            uint32_t    VertexBuffers[c_MaxVertexStreams];
+            uint32_t    IndexBuffer;
+            uint32_t    NumSubsets;
+            uint32_t    NumFrameInfluences;     // Bones
+
+            float       BoundingBoxCenter[3];
+            float       BoundingBoxExtents[3];
+
+            uint64_t    SubsetOffset;           // Array of NumSubsets uint32_t subset indices
+            uint64_t    FrameInfluenceOffset;   // Array of NumFrameInfluences uint32_t frame indices
+        };
+
+        struct Subset
+        {
+            char        Name[c_MaxSubsetName];
+            uint32_t    MaterialID;
+            uint32_t    PrimitiveType;
+            uint64_t    IndexStart;
+            uint64_t    IndexCount;
+            uint64_t    VertexStart;
+            uint64_t    VertexCount;
+        };
+
+        struct Frame
+        {
+            char        Name[c_MaxFrameName];
+            uint32_t    Mesh;
+            uint32_t    ParentFrame;
+            uint32_t    ChildFrame;
+            uint32_t    SiblingFrame;
+            float       Matrix[16];
+            uint32_t    AnimationDataIndex;
+        };
+
+        // Version 101 material. Version 200 files reuse the same size with PBR texture names.
+        struct Material
+        {
+            char        Name[c_MaxMaterialName];
+            char        MaterialInstancePath[c_MaxPath];
+            char        DiffuseTexture[c_MaxPath];
+            char        NormalTexture[c_MaxPath];
+            char        SpecularTexture[c_MaxPath];
+
+            float       Diffuse[4];
+            float       Ambient[4];
+            float       Specular[4];
+            float       Emissive[4];
+            float       Power;
+
+            uint64_t    Reserved[6];            // Runtime pointers in the original format
+        };
+
+    #pragma pack(pop)
+
+        static_assert(sizeof(Header) == 104, "SDKMESH header size mismatch");
+        static_assert(sizeof(VertexElement) == 8, "SDKMESH vertex element size mismatch");
+        static_assert(sizeof(VertexBufferHeader) == 288, "SDKMESH vertex buffer header size mismatch");
+        static_assert(sizeof(IndexBufferHeader) == 32, "SDKMESH index buffer header size mismatch");
+        static_assert(sizeof(Mesh) == 224, "SDKMESH mesh size mismatch");
+        static_assert(sizeof(Subset) == 144, "SDKMESH subset size mismatch");
+        static_assert(sizeof(Frame) == 184, "SDKMESH frame size mismatch");
+        static_assert(sizeof(Material) == 1256, "SDKMESH material size mismatch");
+
+        namespace Internal
+        {
+            // True if [offset, offset + count * elementSize) lies within [0, limit), without overflowing.
+            inline bool IsInRange(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t limit) noexcept
+            {
+                if (offset > limit)
+                    return false;
+
+                if (elementSize && count > (limit - offset) / elementSize)
+                    return false;
+
+                return true;
+            }
+
+            // Arrays are read in place, so they have to be naturally aligned. Files written by the
+            // DirectX tools always are.
+            template<typename T>
+            inline bool IsArrayValid(uint64_t offset, uint64_t count, uint64_t limit) noexcept
+            {
+                return !(offset % alignof(T)) && IsInRange(offset, count, sizeof(T), limit);
+            }
+
+            template<typename T>
+            inline const T* At(const uint8_t* data, uint64_t offset) noexcept
+            {
+                return reinterpret_cast<const T*>(data + offset);
+            }
+
+            [[noreturn]] inline void ThrowInvalid(const char* reason)
+            {
+                throw std::runtime_error(std::string("Invalid SDKMESH file: ") + reason);
+            }
+        }
+    }
+
+    // Validates an SDKMESH file image where it lies (typically a file mapping) without copying any of
+    // it, then gives typed access to the headers and to the vertex and index payloads. The image must
+    // outlive the view.
+    //
+    // Every offset, count, and cross-reference is range-checked up front, so the accessors don't
+    // need to be; a malformed file throws std::runtime_error from the constructor.
+    class SDKMeshView
+    {
+    public:
+        SDKMeshView(_In_reads_bytes_(dataSize) const uint8_t* data, size_t dataSize) noexcept(false);
+
+        SDKMeshView(SDKMeshView&&) = default;
+        SDKMeshView& operator= (SDKMeshView&&) = default;
+
+        SDKMeshView(SDKMeshView const&) = default;
+        SDKMeshView& operator= (SDKMeshView const&) = default;
+
+        const SDKMesh::Header& GetHeader() const noexcept { return *m_header; }
+
+        const SDKMesh::VertexBufferHeader* GetVertexBuffers() const noexcept { return m_vertexBuffers; }
+        const SDKMesh::IndexBufferHeader* GetIndexBuffers() const noexcept { return m_indexBuffers; }
+        const SDKMesh::Mesh* GetMeshes() const noexcept { return m_meshes; }
+        const SDKMesh::Subset* GetSubsets() const noexcept { return m_subsets; }
+        const SDKMesh::Frame* GetFrames() const noexcept { return m_frames; }
+        const SDKMesh::Material* GetMaterials() const noexcept { return m_materials; }
+
+        uint32_t GetVertexBufferCount() const noexcept { return m_header->NumVertexBuffers; }
+        uint32_t GetIndexBufferCount() const noexcept { return m_header->NumIndexBuffers; }
+        uint32_t GetMeshCount() const noexcept { return m_header->NumMeshes; }
+        uint32_t GetSubsetCount() const noexcept { return m_header->NumTotalSubsets; }
+        uint32_t GetFrameCount() const noexcept { return m_header->NumFrames; }
+        uint32_t GetMaterialCount() const noexcept { return m_header->NumMaterials; }
+
+        // Indices into GetSubsets() for the given mesh.
+        const uint32_t* GetMeshSubsets(uint32_t mesh) const;
+
+        const uint8_t* GetVertexData(uint32_t vb) const;
+        const uint8_t* GetIndexData(uint32_t ib) const;
+
+        // Payload totals, useful for sizing upload memory before copying.
+        uint64_t GetTotalVertexBytes() const noexcept { return m_totalVertexBytes; }
+        uint64_t GetTotalIndexBytes() const noexcept { return m_totalIndexBytes; }
+
+        const uint8_t* GetData() const noexcept { return m_data; }
+        size_t GetDataSize() const noexcept { return m_dataSize; }
+
+    private:
+        const uint8_t*                      m_data;
+        size_t                              m_dataSize;
+
+        const SDKMesh::Header*              m_header;
+        const SDKMesh::VertexBufferHeader*  m_vertexBuffers;
+        const SDKMesh::IndexBufferHeader*   m_indexBuffers;
+        const SDKMesh::Mesh*                m_meshes;
+        const SDKMesh::Subset*              m_subsets;
+        const SDKMesh::Frame*               m_frames;
+        const SDKMesh::Material*            m_materials;
+
+        uint64_t                            m_totalVertexBytes;
+        uint64_t                            m_totalIndexBytes;
+    };
+
+    inline SDKMeshView::SDKMeshView(_In_reads_bytes_(dataSize) const uint8_t* data, size_t dataSize) noexcept(false) :
+        m_data(data),
+        m_dataSize(dataSize),
+        m_header(nullptr),
+        m_vertexBuffers(nullptr),
+        m_indexBuffers(nullptr),
+        m_meshes(nullptr),
+        m_subsets(nullptr),
+        m_frames(nullptr),
+        m_materials(nullptr),
+        m_totalVertexBytes(0),
+        m_totalIndexBytes(0)
+    {
+        using namespace SDKMesh;
+        using namespace SDKMesh::Internal;
+
+        if (!data)
+        {
+            throw std::invalid_argument("SDKMeshView");
+        }
+
+        if (dataSize < sizeof(Header))
+            ThrowInvalid("too small for the header");
+
+        m_header = At<Header>(data, 0);
+        const Header& header = *m_header;
+
+        if (header.IsBigEndian)
+            ThrowInvalid("big-endian files are not supported");
+
+        if (header.Version != c_FileVersion && header.Version != c_FileVersionV2)
+            ThrowInvalid("unsupported version");
+
+        if (header.HeaderSize < sizeof(Header))
+            ThrowInvalid("bad header size");
+
+        // The headers and arrays all live in the non-buffer region; the payloads follow it.
+        if (!IsInRange(header.HeaderSize, 1, header.NonBufferDataSize, dataSize))
+            ThrowInvalid("truncated header data");
+
+        const uint64_t bufferDataOffset = header.HeaderSize + header.NonBufferDataSize;
+        if (!IsInRange(bufferDataOffset, 1, header.BufferDataSize, dataSize))
+            ThrowInvalid("truncated buffer data");
+
+        if (!header.NumMeshes || !header.NumVertexBuffers || !header.NumIndexBuffers
+            || !header.NumTotalSubsets || !header.NumMaterials)
+        {
+            ThrowInvalid("no meshes");
+        }
+
+        if (!IsArrayValid<VertexBufferHeader>(header.VertexStreamHeadersOffset, header.NumVertexBuffers, bufferDataOffset)
+            || !IsArrayValid<IndexBufferHeader>(header.IndexStreamHeadersOffset, header.NumIndexBuffers, bufferDataOffset)
+            || !IsArrayValid<Mesh>(header.MeshDataOffset, header.NumMeshes, bufferDataOffset)
+            || !IsArrayValid<Subset>(header.SubsetDataOffset, header.NumTotalSubsets, bufferDataOffset)
+            || !IsArrayValid<Frame>(header.FrameDataOffset, header.NumFrames, bufferDataOffset)
+            || !IsArrayValid<Material>(header.MaterialDataOffset, header.NumMaterials, bufferDataOffset))
+        {
+            ThrowInvalid("header array out of range");
+        }
+
+        m_vertexBuffers = At<VertexBufferHeader>(data, header.VertexStreamHeadersOffset);
+        m_indexBuffers = At<IndexBufferHeader>(data, header.IndexStreamHeadersOffset);
+        m_meshes = At<Mesh>(data, header.MeshDataOffset);
+        m_subsets = At<Subset>(data, header.SubsetDataOffset);
+        m_frames = header.NumFrames ? At<Frame>(data, header.FrameDataOffset) : nullptr;
+        m_materials = At<Material>(data, header.MaterialDataOffset);
+
+        for (uint32_t j = 0; j < header.NumVertexBuffers; ++j)
+        {
+            const auto& vb = m_vertexBuffers[j];
+
+            if (!vb.StrideBytes || vb.SizeBytes > UINT32_MAX
+                || vb.NumVertices > vb.SizeBytes / vb.StrideBytes)
+            {
+                ThrowInvalid("bad vertex buffer size");
+            }
+
+            if (vb.DataOffset < bufferDataOffset || !IsInRange(vb.DataOffset, 1, vb.SizeBytes, dataSize))
+                ThrowInvalid("vertex buffer data out of range");
+
+            m_totalVertexBytes += vb.SizeBytes;
+        }
+
+        for (uint32_t j = 0; j < header.NumIndexBuffers; ++j)
+        {
+            const auto& ib = m_indexBuffers[j];
+
+            if (ib.IndexType != IndexType_16Bit && ib.IndexType != IndexType_32Bit)
+                ThrowInvalid("bad index type");
+
+            const uint64_t indexSize = (ib.IndexType == IndexType_32Bit) ? 4 : 2;
+            if (ib.SizeBytes > UINT32_MAX || ib.NumIndices > ib.SizeBytes / indexSize)
+                ThrowInvalid("bad index buffer size");
+
+            if (ib.DataOffset < bufferDataOffset || !IsInRange(ib.DataOffset, 1, ib.SizeBytes, dataSize))
+                ThrowInvalid("index buffer data out of range");
+
+            m_totalIndexBytes += ib.SizeBytes;
+        }
+
+        for (uint32_t j = 0; j < header.NumMeshes; ++j)
+        {
+            const auto& mesh = m_meshes[j];
+
+            if (!mesh.NumSubsets || !mesh.NumVertexBuffers || mesh.NumVertexBuffers > c_MaxVertexStreams)
+                ThrowInvalid("bad mesh");
+
+            for (uint32_t k = 0; k < mesh.NumVertexBuffers; ++k)
+            {
+                if (mesh.VertexBuffers[k] >= header.NumVertexBuffers)
+                    ThrowInvalid("mesh references a missing vertex buffer");
+            }
+
+            if (mesh.IndexBuffer >= header.NumIndexBuffers)
+                ThrowInvalid("mesh references a missing index buffer");
+
+            if (!IsArrayValid<uint32_t>(mesh.SubsetOffset, mesh.NumSubsets, bufferDataOffset)
+                || !IsArrayValid<uint32_t>(mesh.FrameInfluenceOffset, mesh.NumFrameInfluences, bufferDataOffset))
+            {
+                ThrowInvalid("mesh array out of range");
+            }
+
+            const auto& vb = m_vertexBuffers[mesh.VertexBuffers[0]];
+            const auto& ib = m_indexBuffers[mesh.IndexBuffer];
+
+            const auto subsets = At<uint32_t>(data, mesh.SubsetOffset);
+            for (uint32_t k = 0; k < mesh.NumSubsets; ++k)
+            {
+                if (subsets[k] >= header.NumTotalSubsets)
+                    ThrowInvalid("mesh references a missing subset");
+
+                const auto& subset = m_subsets[subsets[k]];
+
+                if (subset.MaterialID >= header.NumMaterials)
+                    ThrowInvalid("subset references a missing material");
+
+                if (!IsInRange(subset.IndexStart, 1, subset.IndexCount, ib.NumIndices)
+                    || !IsInRange(subset.VertexStart, 1, subset.VertexCount, vb.NumVertices))
+                {
+                    ThrowInvalid("subset out of range");
+                }
+            }
+
+            const auto influences = At<uint32_t>(data, mesh.FrameInfluenceOffset);
+            for (uint32_t k = 0; k < mesh.NumFrameInfluences; ++k)
+            {
+                if (influences[k] >= header.NumFrames)
+                    ThrowInvalid("mesh references a missing frame");
+            }
+        }
+
+        for (uint32_t j = 0; j < header.NumFrames; ++j)
+        {
+            const auto& frame = m_frames[j];
+
+            if ((frame.Mesh != c_InvalidMesh && frame.Mesh >= header.NumMeshes)
+                || (frame.ParentFrame != c_InvalidFrame && frame.ParentFrame >= header.NumFrames)
+                || (frame.ChildFrame != c_InvalidFrame && frame.ChildFrame >= header.NumFrames)
+                || (frame.SiblingFrame != c_InvalidFrame && frame.SiblingFrame >= header.NumFrames))
+            {
+                ThrowInvalid("bad frame hierarchy");
+            }
+        }
+    }
+
+    inline const uint32_t* SDKMeshView::GetMeshSubsets(uint32_t mesh) const
+    {
+        if (mesh >= m_header->NumMeshes)
+        {
+            throw std::out_of_range("SDKMeshView::GetMeshSubsets");
+        }
+
+        return SDKMesh::Internal::At<uint32_t>(m_data, m_meshes[mesh].SubsetOffset);
+    }
+
+    inline const uint8_t* SDKMeshView::GetVertexData(uint32_t vb) const
+    {
+        if (vb >= m_header->NumVertexBuffers)
+        {
+            throw std::out_of_range("SDKMeshView::GetVertexData");
+        }
+
+        return m_data + m_vertexBuffers[vb].DataOffset;
+    }
+
+    inline const uint8_t* SDKMeshView::GetIndexData(uint32_t ib) const
+    {
+        if (ib >= m_header->NumIndexBuffers)
+        {
+            throw std::out_of_range("SDKMeshView::GetIndexData");
+        }
+
+        return m_data + m_indexBuffers[ib].DataOffset;
+    }
+}
@@ -0,0 +1,765 @@
+//
+// SDKMeshOptimizer.cpp - Command-line tool which reorders SDKMESH geometry for the GPU's caches
+//
+// Usage: SDKMeshOptimizer [-nooverdraw] [-threshold <ratio>] [-meshlets <output.meshlets>]
+//                         <input.sdkmesh> <output.sdkmesh>
+//
+// Each subset's triangles are ordered for the post-transform vertex cache, then by cluster for
+// less overdraw, giving up at most the threshold (1.05 by default) of the cache gains. Each mesh's
+// vertices are then renumbered in order of first use, and unused ones dropped. Meshes which share
+// vertex or index buffers with another mesh, or aren't triangle lists, are copied unchanged.
+//
+// The vertex cache statistics are printed before and after, and the output is read back and
+// checked to draw exactly the same triangles as the input.
+//
+// With -meshlets, the optimized triangles of each mesh part are then split into meshlets, which
+// are written with their culling bounds to a sidecar file for the game to load with the model.
+//
+
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "SDKMesh.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace DX;
+using namespace DX::SDKMesh;
+using namespace DX::SDKMesh::Internal;
+
+namespace
+{
+    constexpr uint8_t c_UsagePosition = 0;     // D3DDECLUSAGE_POSITION
+    constexpr uint8_t c_UsageNormal = 3;       // D3DDECLUSAGE_NORMAL
+    constexpr uint8_t c_TypeFloat3 = 2;        // D3DDECLTYPE_FLOAT3
+    constexpr uint16_t c_DeclEnd = 0xFF;
+    constexpr uint64_t c_BufferAlignment = 4096;   // Buffers start and end on pages, as the DXUT exporter wrote them.
+
+    std::vector<uint8_t> ReadFile(const char* fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            throw std::runtime_error(std::string("Can't open ") + fileName);
+        }
+
+        const std::streamoff size = file.tellg();
+        if (size < 0)
+        {
+            throw std::runtime_error(std::string("Can't read ") + fileName);
+        }
+
+        std::vector<uint8_t> data(static_cast<size_t>(size));
+        file.seekg(0);
+        if (size && !file.read(reinterpret_cast<char*>(data.data()), size))
+        {
+            throw std::runtime_error(std::string("Can't read ") + fileName);
+        }
+
+        return data;
+    }
+
+    // A writable SDKMESH image, with the parts the optimizer uses range-checked up front. The game
+    // reads files through SDKMeshView, which only gives read-only access.
+    class MeshFile
+    {
+    public:
+        explicit MeshFile(std::vector<uint8_t>&& data) :
+            m_image(std::move(data))
+        {
+            if (m_image.size() < sizeof(Header))
+                ThrowInvalid("too small for the header");
+
+            const auto& header = GetHeader();
+
+            if (header.IsBigEndian)
+                ThrowInvalid("big-endian files are not supported");
+
+            if (header.Version != c_FileVersion && header.Version != c_FileVersionV2)
+                ThrowInvalid("unsupported version");
+
+            if (header.HeaderSize < sizeof(Header)
+                || !IsInRange(header.HeaderSize, 1, header.NonBufferDataSize, m_image.size()))
+            {
+                ThrowInvalid("truncated header data");
+            }
+
+            const uint64_t bufferDataOffset = GetBufferDataOffset();
+            if (!IsInRange(bufferDataOffset, 1, header.BufferDataSize, m_image.size()))
+                ThrowInvalid("truncated buffer data");
+
+            if (!IsArrayValid<VertexBufferHeader>(header.VertexStreamHeadersOffset, header.NumVertexBuffers, bufferDataOffset)
+                || !IsArrayValid<IndexBufferHeader>(header.IndexStreamHeadersOffset, header.NumIndexBuffers, bufferDataOffset)
+                || !IsArrayValid<Mesh>(header.MeshDataOffset, header.NumMeshes, bufferDataOffset)
+                || !IsArrayValid<Subset>(header.SubsetDataOffset, header.NumTotalSubsets, bufferDataOffset))
+            {
+                ThrowInvalid("header array out of range");
+            }
+
+            for (uint32_t j = 0; j < header.NumVertexBuffers; ++j)
+            {
+                const auto& vb = GetVertexBuffer(j);
+                if (!vb.StrideBytes || vb.NumVertices > vb.SizeBytes / vb.StrideBytes
+                    || vb.DataOffset < bufferDataOffset || !IsInRange(vb.DataOffset, 1, vb.SizeBytes, m_image.size()))
+                {
+                    ThrowInvalid("bad vertex buffer");
+                }
+            }
+
+            for (uint32_t j = 0; j < header.NumIndexBuffers; ++j)
+            {
+                const auto& ib = GetIndexBuffer(j);
+                if ((ib.IndexType != IndexType_16Bit && ib.IndexType != IndexType_32Bit)
+                    || ib.NumIndices > ib.SizeBytes / GetIndexSize(j)
+                    || ib.DataOffset < bufferDataOffset || !IsInRange(ib.DataOffset, 1, ib.SizeBytes, m_image.size()))
+                {
+                    ThrowInvalid("bad index buffer");
+                }
+            }
+
+            for (uint32_t j = 0; j < header.NumMeshes; ++j)
+            {
+                const auto& mesh = GetMesh(j);
+                if (!mesh.NumVertexBuffers || mesh.NumVertexBuffers > c_MaxVertexStreams
+                    || mesh.IndexBuffer >= header.NumIndexBuffers
+                    || !IsArrayValid<uint32_t>(mesh.SubsetOffset, mesh.NumSubsets, bufferDataOffset))
+                {
+                    ThrowInvalid("bad mesh");
+                }
+
+                for (uint32_t k = 0; k < mesh.NumVertexBuffers; ++k)
+                {
+                    if (mesh.VertexBuffers[k] >= header.NumVertexBuffers)
+                        ThrowInvalid("mesh references a missing vertex buffer");
+                }
+
+                const auto& vb = GetVertexBuffer(mesh.VertexBuffers[0]);
+                const auto& ib = GetIndexBuffer(mesh.IndexBuffer);
+                const auto subsets = GetMeshSubsets(j);
+                for (uint32_t k = 0; k < mesh.NumSubsets; ++k)
+                {
+                    if (subsets[k] >= header.NumTotalSubsets)
+                        ThrowInvalid("mesh references a missing subset");
+
+                    const auto& subset = GetSubset(subsets[k]);
+                    if (!IsInRange(subset.IndexStart, 1, subset.IndexCount, ib.NumIndices)
+                        || !IsInRange(subset.VertexStart, 1, subset.VertexCount, vb.NumVertices))
+                    {
+                        ThrowInvalid("subset out of range");
+                    }
+                }
+            }
+        }
+
+        Header& GetHeader() noexcept { return At<Header>(0); }
+        const Header& GetHeader() const noexcept { return At<Header>(0); }
+
+        uint64_t GetBufferDataOffset() const noexcept { return GetHeader().HeaderSize + GetHeader().NonBufferDataSize; }
+
+        VertexBufferHeader& GetVertexBuffer(uint32_t j) noexcept { return At<VertexBufferHeader>(GetHeader().VertexStreamHeadersOffset, j); }
+        const VertexBufferHeader& GetVertexBuffer(uint32_t j) const noexcept { return At<VertexBufferHeader>(GetHeader().VertexStreamHeadersOffset, j); }
+
+        IndexBufferHeader& GetIndexBuffer(uint32_t j) noexcept { return At<IndexBufferHeader>(GetHeader().IndexStreamHeadersOffset, j); }
+        const IndexBufferHeader& GetIndexBuffer(uint32_t j) const noexcept { return At<IndexBufferHeader>(GetHeader().IndexStreamHeadersOffset, j); }
+
+        const Mesh& GetMesh(uint32_t j) const noexcept { return At<Mesh>(GetHeader().MeshDataOffset, j); }
+
+        Subset& GetSubset(uint32_t j) noexcept { return At<Subset>(GetHeader().SubsetDataOffset, j); }
+        const Subset& GetSubset(uint32_t j) const noexcept { return At<Subset>(GetHeader().SubsetDataOffset, j); }
+
+        const uint32_t* GetMeshSubsets(uint32_t mesh) const noexcept { return &At<uint32_t>(GetMesh(mesh).SubsetOffset); }
+
+        const uint8_t* GetVertexData(uint32_t vb) const noexcept { return m_image.data() + GetVertexBuffer(vb).DataOffset; }
+
+        uint32_t GetIndexSize(uint32_t ib) const noexcept { return GetIndexBuffer(ib).IndexType == IndexType_32Bit ? 4u : 2u; }
+
+        std::vector<uint32_t> ReadIndices(uint32_t ib) const
+        {
+            const auto& header = GetIndexBuffer(ib);
+            const uint8_t* data = m_image.data() + header.DataOffset;
+
+            std::vector<uint32_t> indices(static_cast<size_t>(header.NumIndices));
+            for (size_t j = 0; j < indices.size(); ++j)
+            {
+                if (header.IndexType == IndexType_32Bit)
+                {
+                    memcpy(&indices[j], data + 4 * j, 4);
+                }
+                else
+                {
+                    uint16_t index;
+                    memcpy(&index, data + 2 * j, 2);
+                    indices[j] = index;
+                }
+            }
+            return indices;
+        }
+
+        // Headers and arrays, everything before the buffer data.
+        const uint8_t* GetNonBufferData() const noexcept { return m_image.data(); }
+
+    private:
+        template<typename T>
+        T& At(uint64_t offset, uint64_t index = 0) noexcept
+        {
+            return reinterpret_cast<T*>(m_image.data() + offset)[index];
+        }
+
+        template<typename T>
+        const T& At(uint64_t offset, uint64_t index = 0) const noexcept
+        {
+            return reinterpret_cast<const T*>(m_image.data() + offset)[index];
+        }
+
+        std::vector<uint8_t>    m_image;
+    };
+
+    // Every triangle of a subset as the bytes of its vertices (all streams), each rotated to start
+    // at its least vertex so the winding is kept, then sorted: equal if the subsets draw the same.
+    std::vector<std::string> GetTriangles(const MeshFile& file, uint32_t meshIndex, uint32_t subsetIndex)
+    {
+        const auto& mesh = file.GetMesh(meshIndex);
+        const auto& subset = file.GetSubset(subsetIndex);
+        const auto indices = file.ReadIndices(mesh.IndexBuffer);
+
+        std::vector<std::string> triangles;
+        for (uint64_t j = 0; j + 2 < subset.IndexCount; j += 3)
+        {
+            std::string vertices[3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const uint64_t vertex = subset.VertexStart + indices[size_t(subset.IndexStart + j + k)];
+                for (uint32_t s = 0; s < mesh.NumVertexBuffers; ++s)
+                {
+                    const auto& vb = file.GetVertexBuffer(mesh.VertexBuffers[s]);
+                    if (vertex >= vb.NumVertices)
+                    {
+                        throw std::runtime_error("Verification failed: index out of range");
+                    }
+
+                    vertices[k].append(reinterpret_cast<const char*>(file.GetVertexData(mesh.VertexBuffers[s]) + vertex * vb.StrideBytes),
+                        size_t(vb.StrideBytes));
+                }
+            }
+
+            const size_t first = size_t(std::min_element(std::begin(vertices), std::end(vertices)) - std::begin(vertices));
+            triangles.push_back(vertices[first] + vertices[(first + 1) % 3] + vertices[(first + 2) % 3]);
+        }
+
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    // Finds a FLOAT3 element with the given usage in any of a mesh's vertex streams, returning the
+    // first vertex's element and the stride, or null if there's none.
+    const uint8_t* FindFloat3(const MeshFile& file, uint32_t meshIndex, uint8_t usage, size_t& stride)
+    {
+        const auto& mesh = file.GetMesh(meshIndex);
+        for (uint32_t s = 0; s < mesh.NumVertexBuffers; ++s)
+        {
+            const auto& vb = file.GetVertexBuffer(mesh.VertexBuffers[s]);
+            for (uint32_t e = 0; e < c_MaxVertexElements && vb.Decl[e].Stream != c_DeclEnd; ++e)
+            {
+                const auto& element = vb.Decl[e];
+                if (element.Usage == usage && !element.UsageIndex && element.Type == c_TypeFloat3
+                    && element.Offset + 3 * sizeof(float) <= vb.StrideBytes)
+                {
+                    stride = static_cast<size_t>(vb.StrideBytes);
+                    return file.GetVertexData(mesh.VertexBuffers[s]) + element.Offset;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    struct MeshReport
+    {
+        MeshOptimizer::VertexCacheStatistics    before;
+        MeshOptimizer::VertexCacheStatistics    after;
+        uint64_t                                triangles;
+        uint64_t                                verticesBefore;
+        uint64_t                                verticesAfter;
+    };
+
+    // Returns why a mesh is left as it is, or null if it can be optimized.
+    const char* CheckMesh(const MeshFile& file, uint32_t meshIndex, const std::vector<uint32_t>& vertexBufferUsers, const std::vector<uint32_t>& indexBufferUsers)
+    {
+        const auto& mesh = file.GetMesh(meshIndex);
+
+        if (indexBufferUsers[mesh.IndexBuffer] > 1)
+            return "index buffer shared with another mesh";
+
+        for (uint32_t s = 0; s < mesh.NumVertexBuffers; ++s)
+        {
+            if (vertexBufferUsers[mesh.VertexBuffers[s]] > 1)
+                return "vertex buffer shared with another mesh";
+
+            if (file.GetVertexBuffer(mesh.VertexBuffers[s]).NumVertices != file.GetVertexBuffer(mesh.VertexBuffers[0]).NumVertices)
+                return "vertex streams of different lengths";
+        }
+
+        // Subsets must be triangle lists over separate stretches of the index buffer.
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        const auto subsets = file.GetMeshSubsets(meshIndex);
+        for (uint32_t k = 0; k < mesh.NumSubsets; ++k)
+        {
+            const auto& subset = file.GetSubset(subsets[k]);
+            if (subset.PrimitiveType != PrimitiveType_TriangleList || (subset.IndexCount % 3))
+                return "not a triangle list";
+
+            ranges.emplace_back(subset.IndexStart, subset.IndexStart + subset.IndexCount);
+        }
+
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t k = 1; k < ranges.size(); ++k)
+        {
+            if (ranges[k].first < ranges[k - 1].second)
+                return "subsets overlap";
+        }
+
+        return nullptr;
+    }
+
+    MeshReport OptimizeMesh(MeshFile& file, uint32_t meshIndex, bool overdraw, float threshold,
+        std::vector<std::vector<uint8_t>>& vertexData, std::vector<std::vector<uint8_t>>& indexData)
+    {
+        using namespace DX::MeshOptimizer;
+
+        const auto& mesh = file.GetMesh(meshIndex);
+        const size_t vertexCount = static_cast<size_t>(file.GetVertexBuffer(mesh.VertexBuffers[0]).NumVertices);
+
+        // Subsets in index buffer order, with their indices made absolute and laid end to end.
+        std::vector<uint32_t> subsets(file.GetMeshSubsets(meshIndex), file.GetMeshSubsets(meshIndex) + mesh.NumSubsets);
+        std::sort(subsets.begin(), subsets.end(),
+            [&](uint32_t a, uint32_t b) { return file.GetSubset(a).IndexStart < file.GetSubset(b).IndexStart; });
+
+        const auto source = file.ReadIndices(mesh.IndexBuffer);
+        std::vector<uint32_t> indices;
+        std::vector<size_t> starts;
+        for (const uint32_t s : subsets)
+        {
+            const auto& subset = file.GetSubset(s);
+            starts.push_back(indices.size());
+            for (uint64_t j = 0; j < subset.IndexCount; ++j)
+            {
+                const uint64_t index = subset.VertexStart + source[size_t(subset.IndexStart + j)];
+                if (index >= vertexCount)
+                {
+                    throw std::runtime_error("Invalid SDKMESH file: index out of range");
+                }
+                indices.push_back(static_cast<uint32_t>(index));
+            }
+        }
+        starts.push_back(indices.size());
+
+        MeshReport report = {};
+        report.triangles = indices.size() / 3;
+        report.verticesBefore = vertexCount;
+        report.before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+        // Positions for the overdraw pass, if there are any in a form it can use.
+        size_t positionStride = 0;
+        const uint8_t* positions = FindFloat3(file, meshIndex, c_UsagePosition, positionStride);
+
+        for (size_t k = 0; k + 1 < starts.size(); ++k)
+        {
+            uint32_t* range = indices.data() + starts[k];
+            const size_t count = starts[k + 1] - starts[k];
+
+            OptimizeVertexCache(range, count, vertexCount);
+
+            if (overdraw && positions)
+            {
+                OptimizeOverdraw(range, count, positions, positionStride, vertexCount, threshold);
+            }
+        }
+
+        std::vector<uint32_t> remap(vertexCount);
+        const size_t used = OptimizeVertexFetch(remap.data(), indices.data(), indices.size(), vertexCount);
+        for (auto& index : indices)
+        {
+            index = remap[index];
+        }
+
+        for (uint32_t s = 0; s < mesh.NumVertexBuffers; ++s)
+        {
+            auto& vb = file.GetVertexBuffer(mesh.VertexBuffers[s]);
+            const size_t stride = static_cast<size_t>(vb.StrideBytes);
+
+            std::vector<uint8_t> remapped(used * stride);
+            RemapVertices(remapped.data(), file.GetVertexData(mesh.VertexBuffers[s]), stride, remap.data(), vertexCount);
+            vertexData[mesh.VertexBuffers[s]] = std::move(remapped);
+
+            vb.NumVertices = used;
+            vb.SizeBytes = used * stride;
+        }
+
+        // Each subset's indices are relative to its lowest vertex again. Anything in the index
+        // buffer no subset covers is zeroed, as the vertices it named may be gone.
+        const uint32_t indexSize = file.GetIndexSize(mesh.IndexBuffer);
+        auto& ib = indexData[mesh.IndexBuffer];
+        std::fill(ib.begin(), ib.end(), uint8_t(0));
+
+        for (size_t k = 0; k + 1 < starts.size(); ++k)
+        {
+            auto& subset = file.GetSubset(subsets[k]);
+            if (starts[k] == starts[k + 1])
+            {
+                subset.VertexStart = 0;
+                subset.VertexCount = 0;
+                continue;
+            }
+
+            const auto range = std::minmax_element(indices.begin() + ptrdiff_t(starts[k]), indices.begin() + ptrdiff_t(starts[k + 1]));
+            const uint32_t base = *range.first;
+            if (indexSize == 2 && *range.second - base > UINT16_MAX)
+            {
+                throw std::runtime_error("Subset no longer fits 16-bit indices");
+            }
+
+            subset.VertexStart = base;
+            subset.VertexCount = uint64_t(*range.second - base) + 1;
+
+            for (size_t j = starts[k]; j < starts[k + 1]; ++j)
+            {
+                const uint32_t index = indices[j] - base;
+                uint8_t* destination = ib.data() + size_t(subset.IndexStart + (j - starts[k])) * indexSize;
+                if (indexSize == 4)
+                {
+                    memcpy(destination, &index, 4);
+                }
+                else
+                {
+                    const auto index16 = static_cast<uint16_t>(index);
+                    memcpy(destination, &index16, 2);
+                }
+            }
+        }
+
+        report.verticesAfter = used;
+        report.after = AnalyzeVertexCache(indices.data(), indices.size(), used);
+        return report;
+    }
+
+    // SDKMESH files wind front faces clockwise, but if the vertices have normals, they decide.
+    bool IsClockwise(const std::vector<uint32_t>& indices, const uint8_t* positions, size_t positionStride,
+        const uint8_t* normals, size_t normalStride)
+    {
+        if (!normals)
+            return true;
+
+        auto load = [](const uint8_t* data, size_t stride, uint32_t v, float (&value)[3])
+            {
+                memcpy(value, data + size_t(v) * stride, sizeof(value));
+            };
+
+        double facing = 0.0;
+        for (size_t j = 0; j + 2 < indices.size(); j += 3)
+        {
+            float p[3][3], n[3][3];
+            for (size_t k = 0; k < 3; ++k)
+            {
+                load(positions, positionStride, indices[j + k], p[k]);
+                load(normals, normalStride, indices[j + k], n[k]);
+            }
+
+            const float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+            const float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+            const float cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            for (size_t k = 0; k < 3; ++k)
+            {
+                facing += double(cross[0] * n[k][0] + cross[1] * n[k][1] + cross[2] * n[k][2]);
+            }
+        }
+
+        return facing < 0.0;
+    }
+
+    // Splits every triangle-list part of every mesh into meshlets, and writes them to a sidecar.
+    void WriteMeshlets(const MeshFile& file, const char* fileName)
+    {
+        std::vector<MeshletFormat::Part> parts;
+        Meshlets::MeshletSet all;
+        uint64_t triangles = 0;
+
+        for (uint32_t j = 0; j < file.GetHeader().NumMeshes; ++j)
+        {
+            const auto& mesh = file.GetMesh(j);
+
+            size_t positionStride = 0, normalStride = 0;
+            const uint8_t* positions = FindFloat3(file, j, c_UsagePosition, positionStride);
+            const uint8_t* normals = FindFloat3(file, j, c_UsageNormal, normalStride);
+            if (!positions)
+            {
+                printf("mesh %u: no meshlets, no FLOAT3 positions\n", j);
+                continue;
+            }
+
+            const auto source = file.ReadIndices(mesh.IndexBuffer);
+            const auto subsets = file.GetMeshSubsets(j);
+            for (uint32_t k = 0; k < mesh.NumSubsets; ++k)
+            {
+                const auto& subset = file.GetSubset(subsets[k]);
+                if (subset.PrimitiveType != PrimitiveType_TriangleList || (subset.IndexCount % 3))
+                    continue;
+
+                // The part's indices, and its vertices, start at its base vertex.
+                const std::vector<uint32_t> indices(source.begin() + ptrdiff_t(subset.IndexStart),
+                    source.begin() + ptrdiff_t(subset.IndexStart + subset.IndexCount));
+                const uint8_t* partPositions = positions + size_t(subset.VertexStart) * positionStride;
+                const uint8_t* partNormals = normals ? normals + size_t(subset.VertexStart) * normalStride : nullptr;
+
+                const bool clockwise = IsClockwise(indices, partPositions, positionStride, partNormals, normalStride);
+                const auto set = Meshlets::BuildMeshlets(indices.data(), indices.size(), partPositions, positionStride,
+                    static_cast<size_t>(subset.VertexCount), clockwise);
+
+                const MeshletFormat::Part part = { j, k, static_cast<uint32_t>(all.meshlets.size()), static_cast<uint32_t>(set.meshlets.size()) };
+                parts.push_back(part);
+
+                for (auto meshlet : set.meshlets)
+                {
+                    meshlet.vertexOffset += static_cast<uint32_t>(all.vertices.size());
+                    meshlet.triangleOffset += static_cast<uint32_t>(all.triangles.size());
+                    all.meshlets.push_back(meshlet);
+                }
+                all.bounds.insert(all.bounds.end(), set.bounds.begin(), set.bounds.end());
+                all.vertices.insert(all.vertices.end(), set.vertices.begin(), set.vertices.end());
+                all.triangles.insert(all.triangles.end(), set.triangles.begin(), set.triangles.end());
+                triangles += subset.IndexCount / 3;
+            }
+        }
+
+        MeshletFormat::Header header = {};
+        header.magic = MeshletFormat::c_Magic;
+        header.version = MeshletFormat::c_Version;
+        header.partCount = static_cast<uint32_t>(parts.size());
+        header.meshletCount = static_cast<uint32_t>(all.meshlets.size());
+        header.vertexCount = static_cast<uint32_t>(all.vertices.size());
+        header.triangleBytes = static_cast<uint32_t>(all.triangles.size());
+
+        std::vector<uint8_t> image;
+        auto append = [&image](const void* data, size_t size)
+            {
+                image.insert(image.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+            };
+
+        append(&header, sizeof(header));
+        append(parts.data(), parts.size() * sizeof(MeshletFormat::Part));
+        append(all.meshlets.data(), all.meshlets.size() * sizeof(Meshlets::Meshlet));
+        append(all.bounds.data(), all.bounds.size() * sizeof(Meshlets::MeshletBounds));
+        append(all.vertices.data(), all.vertices.size() * sizeof(uint32_t));
+        append(all.triangles.data(), all.triangles.size());
+
+        // Checked the way the game will load it before it's written.
+        const MeshletFileView view(image.data(), image.size());
+
+        std::ofstream output(fileName, std::ios::binary | std::ios::trunc);
+        if (!output.write(reinterpret_cast<const char*>(image.data()), std::streamsize(image.size())))
+        {
+            throw std::runtime_error(std::string("Can't write ") + fileName);
+        }
+
+        uint32_t cones = 0;
+        for (const auto& bounds : all.bounds)
+        {
+            cones += (bounds.coneCutoff != Meshlets::c_NoCone) ? 1u : 0u;
+        }
+
+        const double meshlets = std::max<double>(1.0, double(view.GetMeshletCount()));
+        printf("%u meshlets for %u parts in %s (%zu bytes): %.1f vertices and %.1f triangles each, %u with normal cones\n",
+            view.GetMeshletCount(), view.GetPartCount(), fileName, image.size(),
+            double(view.GetVertexCount()) / meshlets, double(triangles) / meshlets, cones);
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr, "Usage: SDKMeshOptimizer [-nooverdraw] [-threshold <ratio>] [-meshlets <output.meshlets>]\n"
+            "                        <input.sdkmesh> <output.sdkmesh>\n");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool overdraw = true;
+    float threshold = 1.05f;
+    const char* meshletsName = nullptr;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg)
+    {
+        if (!strcmp(argv[arg], "-nooverdraw"))
+        {
+            overdraw = false;
+        }
+        else if (!strcmp(argv[arg], "-meshlets") && arg + 1 < argc)
+        {
+            meshletsName = argv[++arg];
+        }
+        else if (!strcmp(argv[arg], "-threshold") && arg + 1 < argc)
+        {
+            threshold = static_cast<float>(atof(argv[++arg]));
+            if (threshold < 1.f)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (argc - arg != 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const char* inputName = argv[arg];
+    const char* outputName = argv[arg + 1];
+
+    try
+    {
+        const MeshFile input(ReadFile(inputName));
+        MeshFile output(ReadFile(inputName));
+
+        const auto& header = input.GetHeader();
+
+        // Buffers are rewritten whole; the ones no optimized mesh uses are copied as they are.
+        std::vector<std::vector<uint8_t>> vertexData(header.NumVertexBuffers);
+        std::vector<uint32_t> vertexBufferUsers(header.NumVertexBuffers, 0);
+        for (uint32_t j = 0; j < header.NumVertexBuffers; ++j)
+        {
+            const auto data = input.GetVertexData(j);
+            vertexData[j].assign(data, data + input.GetVertexBuffer(j).SizeBytes);
+        }
+
+        std::vector<std::vector<uint8_t>> indexData(header.NumIndexBuffers);
+        std::vector<uint32_t> indexBufferUsers(header.NumIndexBuffers, 0);
+        for (uint32_t j = 0; j < header.NumIndexBuffers; ++j)
+        {
+            const auto& ib = input.GetIndexBuffer(j);
+            const uint8_t* data = input.GetNonBufferData() + ib.DataOffset;
+            indexData[j].assign(data, data + ib.SizeBytes);
+        }
+
+        for (uint32_t j = 0; j < header.NumMeshes; ++j)
+        {
+            const auto& mesh = input.GetMesh(j);
+            for (uint32_t s = 0; s < mesh.NumVertexBuffers; ++s)
+            {
+                ++vertexBufferUsers[mesh.VertexBuffers[s]];
+            }
+            ++indexBufferUsers[mesh.IndexBuffer];
+        }
+
+        for (uint32_t j = 0; j < header.NumMeshes; ++j)
+        {
+            const auto& mesh = input.GetMesh(j);
+            const std::string name(mesh.Name, strnlen(mesh.Name, c_MaxMeshName));
+
+            const char* skip = CheckMesh(input, j, vertexBufferUsers, indexBufferUsers);
+            if (skip)
+            {
+                printf("mesh %u \"%s\": unchanged, %s\n", j, name.c_str(), skip);
+                continue;
+            }
+
+            const auto report = OptimizeMesh(output, j, overdraw, threshold, vertexData, indexData);
+
+            printf("mesh %u \"%s\": %llu triangles, %llu -> %llu vertices\n", j, name.c_str(),
+                static_cast<unsigned long long>(report.triangles),
+                static_cast<unsigned long long>(report.verticesBefore),
+                static_cast<unsigned long long>(report.verticesAfter));
+            printf("    ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u-entry FIFO)\n",
+                report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, MeshOptimizer::c_AnalyzeCacheSize);
+        }
+
+        // Lay the buffers out after the headers, vertices then indices, each padded to a page.
+        for (auto& data : vertexData)
+        {
+            data.resize(size_t((data.size() + c_BufferAlignment - 1) & ~(c_BufferAlignment - 1)));
+        }
+        for (auto& data : indexData)
+        {
+            data.resize(size_t((data.size() + c_BufferAlignment - 1) & ~(c_BufferAlignment - 1)));
+        }
+
+        auto& outputHeader = output.GetHeader();
+        uint64_t offset = output.GetBufferDataOffset();
+        for (uint32_t j = 0; j < header.NumVertexBuffers; ++j)
+        {
+            output.GetVertexBuffer(j).DataOffset = offset;
+            offset += vertexData[j].size();
+        }
+        for (uint32_t j = 0; j < header.NumIndexBuffers; ++j)
+        {
+            output.GetIndexBuffer(j).DataOffset = offset;
+            offset += indexData[j].size();
+        }
+        outputHeader.BufferDataSize = offset - output.GetBufferDataOffset();
+
+        {
+            std::ofstream file(outputName, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                throw std::runtime_error(std::string("Can't create ") + outputName);
+            }
+
+            file.write(reinterpret_cast<const char*>(output.GetNonBufferData()), std::streamsize(output.GetBufferDataOffset()));
+            for (const auto& data : vertexData)
+            {
+                file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+            }
+            for (const auto& data : indexData)
+            {
+                file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+            }
+
+            if (!file.good())
+            {
+                throw std::runtime_error(std::string("Can't write ") + outputName);
+            }
+        }
+
+        // Read the result back, so a mesh which draws differently never ships.
+        const MeshFile written(ReadFile(outputName));
+        for (uint32_t j = 0; j < header.NumMeshes; ++j)
+        {
+            const auto subsets = input.GetMeshSubsets(j);
+            for (uint32_t k = 0; k < input.GetMesh(j).NumSubsets; ++k)
+            {
+                if (GetTriangles(input, j, subsets[k]) != GetTriangles(written, j, subsets[k]))
+                {
+                    throw std::runtime_error("Verification failed: mesh " + std::to_string(j) + " draws different triangles");
+                }
+            }
+        }
+
+        printf("%llu -> %llu bytes of buffer data in %s\n",
+            static_cast<unsigned long long>(header.BufferDataSize),
+            static_cast<unsigned long long>(outputHeader.BufferDataSize),
+            outputName);
+
+        if (meshletsName)
+        {
+            WriteMeshlets(written, meshletsName);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
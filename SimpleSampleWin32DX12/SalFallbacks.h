@@ -0,0 +1,20 @@
+//
+// SalFallbacks.h - Empty definitions of the SAL annotations used by the portable headers
+//
+
+#pragma once
+
+// The portable headers are also built by the asset tools and the host tests, where sal.h may not
+// be available. Annotations it would have defined are defined away instead.
+
+#ifndef _In_reads_bytes_
+#define _In_reads_bytes_(size)
+#endif
+
+#ifndef _In_z_
+#define _In_z_
+#endif
+
+#ifndef _Out_writes_bytes_
+#define _Out_writes_bytes_(size)
+#endif
@@ -0,0 +1,298 @@
+//
+// TaskGraph.h - Runs named tasks in dependency order on a ThreadPool, recording a timeline
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+
+
+namespace DX
+{
+    // A one-shot graph of tasks. Each task starts as soon as the tasks it depends on have finished,
+    // on a pool thread, or on the thread calling Run for work which must stay there (such as
+    // creating a swap chain for a window owned by that thread).
+    //
+    // Dependencies must be added before the tasks which depend on them, so the graph can't contain
+    // cycles. If a task throws, nothing further is started, and Run rethrows the first exception
+    // once the tasks already running have finished.
+    class TaskGraph
+    {
+    public:
+        using TaskId = uint32_t;
+
+        // Times are in milliseconds from the start of Run.
+        struct TimelineEntry
+        {
+            std::string name;
+            double      startMs;
+            double      endMs;
+            bool        callingThread;
+        };
+
+        TaskGraph() = default;
+
+        TaskGraph(TaskGraph&&) = default;
+        TaskGraph& operator= (TaskGraph&&) = default;
+
+        TaskGraph(TaskGraph const&) = delete;
+        TaskGraph& operator= (TaskGraph const&) = delete;
+
+        TaskId AddTask(const char* name, std::function<void()> work,
+            std::initializer_list<TaskId> dependencies = {}, bool runOnCallingThread = false)
+        {
+            if (!work)
+            {
+                throw std::invalid_argument("TaskGraph::AddTask requires work");
+            }
+
+            const auto id = static_cast<TaskId>(m_tasks.size());
+
+            Task task;
+            task.name = name ? name : "";
+            task.work = std::move(work);
+            task.callingThread = runOnCallingThread;
+            task.dependencyCount = 0;
+
+            for (const TaskId dependency : dependencies)
+            {
+                if (dependency >= id)
+                {
+                    throw std::out_of_range("TaskGraph dependencies must be added first");
+                }
+
+                m_tasks[dependency].dependents.push_back(id);
+                ++task.dependencyCount;
+            }
+
+            m_tasks.emplace_back(std::move(task));
+            return id;
+        }
+
+        // Blocks until every task has run, helping with calling-thread tasks meanwhile.
+        void Run(ThreadPool& threadPool)
+        {
+            m_timeline.clear();
+            m_elapsedMs = 0;
+
+            if (m_tasks.empty())
+                return;
+
+            auto state = std::make_shared<RunState>();
+            state->start = Clock::now();
+            state->remaining.resize(m_tasks.size());
+            state->timeline.resize(m_tasks.size());
+            state->executed.resize(m_tasks.size(), false);
+
+            std::exception_ptr error;
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+
+                for (size_t j = 0; j < m_tasks.size(); ++j)
+                {
+                    state->remaining[j] = m_tasks[j].dependencyCount;
+                    if (!m_tasks[j].dependencyCount)
+                    {
+                        Schedule(state, static_cast<TaskId>(j), threadPool);
+                    }
+                }
+
+                for (;;)
+                {
+                    state->condition.wait(lock, [&]()
+                        {
+                            return !state->callingThreadQueue.empty() || IsFinished(*state);
+                        });
+
+                    if (!state->callingThreadQueue.empty())
+                    {
+                        const TaskId id = state->callingThreadQueue.front();
+                        state->callingThreadQueue.pop_front();
+
+                        lock.unlock();
+                        Execute(state, id, threadPool);
+                        lock.lock();
+                        continue;
+                    }
+
+                    break;
+                }
+
+                error = state->error;
+            }
+
+            // Tasks which never ran (after a failure) are left out of the timeline.
+            for (size_t j = 0; j < m_tasks.size(); ++j)
+            {
+                if (state->executed[j])
+                {
+                    m_timeline.emplace_back(std::move(state->timeline[j]));
+                }
+            }
+
+            m_elapsedMs = ElapsedMs(*state);
+
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        const std::vector<TimelineEntry>& GetTimeline() const noexcept { return m_timeline; }
+        double GetElapsedMs() const noexcept { return m_elapsedMs; }
+        size_t GetTaskCount() const noexcept { return m_tasks.size(); }
+
+        // Formats the timeline as one line per task, in the order the tasks started.
+        std::string FormatTimeline() const
+        {
+            std::vector<const TimelineEntry*> entries;
+            entries.reserve(m_timeline.size());
+            for (const auto& entry : m_timeline)
+            {
+                entries.push_back(&entry);
+            }
+
+            std::stable_sort(entries.begin(), entries.end(),
+                [](const TimelineEntry* a, const TimelineEntry* b) { return a->startMs < b->startMs; });
+
+            std::string result;
+            char line[192] = {};
+            for (const auto* entry : entries)
+            {
+                std::snprintf(line, sizeof(line), "%8.2f - %8.2f ms (%7.2f ms) %s %s\n",
+                    entry->startMs, entry->endMs, entry->endMs - entry->startMs,
+                    entry->callingThread ? "[main]  " : "[worker]", entry->name.c_str());
+                result += line;
+            }
+
+            std::snprintf(line, sizeof(line), "%8.2f ms total\n", m_elapsedMs);
+            result += line;
+            return result;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Task
+        {
+            std::string             name;
+            std::function<void()>   work;
+            std::vector<TaskId>     dependents;
+            uint32_t                dependencyCount;
+            bool                    callingThread;
+        };
+
+        // Shared with pool threads, so a task finishing just as Run returns still has valid state.
+        struct RunState
+        {
+            std::mutex                  mutex;
+            std::condition_variable     condition;
+            std::vector<uint32_t>       remaining;
+            std::vector<TimelineEntry>  timeline;
+            std::vector<bool>           executed;
+            std::deque<TaskId>          callingThreadQueue;
+            std::exception_ptr          error;
+            size_t                      completed = 0;
+            size_t                      running = 0;
+            Clock::time_point           start;
+        };
+
+        bool IsFinished(const RunState& state) const noexcept
+        {
+            if (state.completed == m_tasks.size())
+                return true;
+
+            return state.error && !state.running && state.callingThreadQueue.empty();
+        }
+
+        static double ElapsedMs(const RunState& state) noexcept
+        {
+            return std::chrono::duration<double, std::milli>(Clock::now() - state.start).count();
+        }
+
+        // Called with the state's mutex held.
+        void Schedule(const std::shared_ptr<RunState>& state, TaskId id, ThreadPool& threadPool)
+        {
+            ++state->running;
+
+            if (m_tasks[id].callingThread)
+            {
+                state->callingThreadQueue.push_back(id);
+                state->condition.notify_all();
+            }
+            else
+            {
+                std::ignore = threadPool.Submit([this, state, id, &threadPool]() { Execute(state, id, threadPool); });
+            }
+        }
+
+        void Execute(const std::shared_ptr<RunState>& state, TaskId id, ThreadPool& threadPool)
+        {
+            {
+                // Tasks queued before another one failed are dropped.
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->error)
+                {
+                    --state->running;
+                    state->condition.notify_all();
+                    return;
+                }
+            }
+
+            const double startMs = ElapsedMs(*state);
+
+            std::exception_ptr error;
+            try
+            {
+                m_tasks[id].work();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            const double endMs = ElapsedMs(*state);
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            auto& entry = state->timeline[id];
+            entry.name = m_tasks[id].name;
+            entry.startMs = startMs;
+            entry.endMs = endMs;
+            entry.callingThread = m_tasks[id].callingThread;
+            state->executed[id] = true;
+
+            --state->running;
+            ++state->completed;
+
+            if (error && !state->error)
+            {
+                state->error = error;
+            }
+
+            if (!state->error)
+            {
+                for (const TaskId dependent : m_tasks[id].dependents)
+                {
+                    if (!--state->remaining[dependent])
+                    {
+                        Schedule(state, dependent, threadPool);
+                    }
+                }
+            }
+
+            // Notify while holding the lock, so Run can't return before this thread is done with it.
+            state->condition.notify_all();
+        }
+
+        std::vector<Task>           m_tasks;
+        std::vector<TimelineEntry>  m_timeline;
+        double                      m_elapsedMs = 0;
+    };
+}
@@ -0,0 +1,323 @@
+//
+// AssetPackTests.cpp - AssetPackView over packs of the shipped assets, and over damaged packs
+//
+
+#include "AssetPackFormat.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace DX;
+using namespace DX::AssetPackFormat;
+
+namespace
+{
+    const char* const c_Assets[] =
+    {
+        "tiny_optimized.sdkmesh",
+        "tiny.meshlets",
+        "Tiny_skin.dds",
+        "seafloor.dds",
+        "windowslogo.dds",
+        "SegoeUI_18.spritefont",
+    };
+
+    struct Asset
+    {
+        std::string             name;
+        std::vector<uint8_t>    data;
+    };
+
+    // Lays out a pack the same way AssetPackBuilder does: table sorted by hash, names, then page
+    // aligned payloads in the order given.
+    std::vector<uint8_t> BuildPack(const std::vector<Asset>& assets, bool compress)
+    {
+        Header header = {};
+        header.magic = c_Magic;
+        header.version = c_Version;
+        header.entryCount = static_cast<uint32_t>(assets.size());
+        header.namesOffset = c_TableOffset + uint64_t(sizeof(Entry)) * assets.size();
+
+        std::vector<Entry> table(assets.size());
+        std::vector<std::vector<uint8_t>> payloads;
+        std::string names;
+        for (size_t j = 0; j < assets.size(); ++j)
+        {
+            const std::string name = NormalizeName(assets[j].name.c_str());
+            table[j].nameHash = HashName(name);
+            table[j].nameOffset = static_cast<uint32_t>(names.size());
+            table[j].nameLength = static_cast<uint32_t>(name.size());
+            table[j].size = assets[j].data.size();
+            names += name;
+            names += '\0';
+
+            auto compressed = LZ4::Compress(assets[j].data.data(), assets[j].data.size());
+            if (compress && compressed.size() < assets[j].data.size())
+            {
+                table[j].compression = Compression_LZ4;
+                payloads.emplace_back(std::move(compressed));
+            }
+            else
+            {
+                table[j].compression = Compression_None;
+                payloads.emplace_back(assets[j].data);
+            }
+        }
+        header.namesSize = names.size();
+
+        uint64_t offset = AlignUp(header.namesOffset + header.namesSize, c_DataAlignment);
+        header.dataOffset = offset;
+        for (size_t j = 0; j < assets.size(); ++j)
+        {
+            table[j].offset = offset;
+            table[j].storedSize = payloads[j].size();
+            offset = AlignUp(offset + payloads[j].size(), c_DataAlignment);
+        }
+        header.fileSize = assets.empty() ? header.dataOffset : table.back().offset + payloads.back().size();
+
+        std::vector<uint8_t> pack(static_cast<size_t>(header.fileSize), 0);
+        memcpy(pack.data(), &header, sizeof(header));
+        for (size_t j = 0; j < assets.size(); ++j)
+        {
+            if (!payloads[j].empty())
+            {
+                memcpy(pack.data() + table[j].offset, payloads[j].data(), payloads[j].size());
+            }
+        }
+        memcpy(pack.data() + header.namesOffset, names.data(), names.size());
+
+        std::stable_sort(table.begin(), table.end(), [](const Entry& a, const Entry& b) { return a.nameHash < b.nameHash; });
+        if (!table.empty())
+        {
+            memcpy(pack.data() + c_TableOffset, table.data(), table.size() * sizeof(Entry));
+        }
+
+        return pack;
+    }
+
+    std::vector<Asset> LoadShippedAssets()
+    {
+        std::vector<Asset> assets;
+        for (const char* name : c_Assets)
+        {
+            assets.push_back(Asset{ name, Test::ReadAsset(name) });
+        }
+        return assets;
+    }
+
+    void TestRoundTrip(const std::vector<Asset>& assets, bool compress)
+    {
+        const auto pack = BuildPack(assets, compress);
+        const AssetPackView view(pack.data(), pack.size());
+
+        CHECK(view.GetEntryCount() == assets.size());
+        CHECK(view.GetData() == pack.data());
+        CHECK(view.GetDataSize() == pack.size());
+
+        uint32_t compressed = 0;
+        for (const auto& asset : assets)
+        {
+            const int index = view.Find(asset.name.c_str());
+            CHECK(index >= 0);
+            if (index < 0)
+                continue;
+
+            const auto& entry = view.GetEntry(uint32_t(index));
+            CHECK(entry.size == asset.data.size());
+            CHECK(NormalizeName(asset.name.c_str()) == view.GetName(uint32_t(index)));
+            CHECK(!(entry.offset % c_DataAlignment));
+
+            std::vector<uint8_t> extracted(asset.data.size());
+            view.Extract(uint32_t(index), extracted.data(), extracted.size());
+            CHECK(extracted == asset.data);
+
+            if (view.IsCompressed(uint32_t(index)))
+            {
+                ++compressed;
+            }
+            else
+            {
+                // Stored payloads are read in place.
+                CHECK(!memcmp(view.GetStoredData(uint32_t(index)), asset.data.data(), asset.data.size()));
+            }
+
+            CHECK_THROWS(view.Extract(uint32_t(index), extracted.data(), extracted.size() - 1), std::invalid_argument);
+        }
+
+        CHECK(compress ? compressed > 0 : compressed == 0);
+
+        // Lookups ignore case and the kind of slash.
+        CHECK(view.Find("TINY_OPTIMIZED.SDKMESH") == view.Find("tiny_optimized.sdkmesh"));
+        CHECK(view.Find("missing.dds") == -1);
+        CHECK(view.Find("") == -1);
+        CHECK_THROWS(view.GetEntry(view.GetEntryCount()), std::out_of_range);
+        CHECK_THROWS(view.GetName(view.GetEntryCount()), std::out_of_range);
+    }
+
+    void TestNames()
+    {
+        std::vector<Asset> assets;
+        assets.push_back(Asset{ "Textures\\Sea.dds", { 1, 2, 3 } });
+        assets.push_back(Asset{ "textures/sky.dds", { 4, 5 } });
+        assets.push_back(Asset{ "Empty.bin", {} });
+
+        const auto pack = BuildPack(assets, true);
+        const AssetPackView view(pack.data(), pack.size());
+
+        CHECK(view.Find("textures/sea.dds") >= 0);
+        CHECK(view.Find("TEXTURES\\SKY.DDS") >= 0);
+        CHECK(view.Find("textures/sea.dd") == -1);
+        CHECK(view.Find("textures/sea.ddsx") == -1);
+
+        const int empty = view.Find("empty.bin");
+        CHECK(empty >= 0);
+        if (empty >= 0)
+        {
+            CHECK(view.GetEntry(uint32_t(empty)).size == 0);
+            view.Extract(uint32_t(empty), nullptr, 0);
+        }
+
+        // A pack with nothing in it is still valid.
+        const auto emptyPack = BuildPack({}, true);
+        const AssetPackView emptyView(emptyPack.data(), emptyPack.size());
+        CHECK(emptyView.GetEntryCount() == 0);
+        CHECK(emptyView.Find("tiny_optimized.sdkmesh") == -1);
+    }
+
+    template<typename Corrupt>
+    void CheckRejected(const std::vector<uint8_t>& pack, const char* what, Corrupt corrupt)
+    {
+        std::vector<uint8_t> copy = pack;
+        corrupt(copy);
+
+        bool rejected = false;
+        try
+        {
+            AssetPackView view(copy.data(), copy.size());
+        }
+        catch (const std::runtime_error&)
+        {
+            rejected = true;
+        }
+
+        if (!rejected)
+        {
+            Test::Fail(__FILE__, __LINE__, what);
+        }
+    }
+
+    Header& GetHeader(std::vector<uint8_t>& pack) { return *reinterpret_cast<Header*>(pack.data()); }
+    Entry& GetEntry(std::vector<uint8_t>& pack, uint32_t index) { return reinterpret_cast<Entry*>(pack.data() + c_TableOffset)[index]; }
+
+    void TestDamaged(const std::vector<Asset>& assets)
+    {
+        const auto pack = BuildPack(assets, true);
+
+        CHECK_THROWS(AssetPackView(nullptr, pack.size()), std::invalid_argument);
+
+        // The header records the file size, so any truncation is caught up front.
+        for (size_t size = 1; size < pack.size(); size += (size < 4096) ? 1 : 4093)
+        {
+            const std::vector<uint8_t> prefix(pack.begin(), pack.begin() + ptrdiff_t(size));
+            CHECK_THROWS(AssetPackView(prefix.data(), prefix.size()), std::runtime_error);
+        }
+
+        CheckRejected(pack, "magic", [](std::vector<uint8_t>& p) { GetHeader(p).magic = 0; });
+        CheckRejected(pack, "version", [](std::vector<uint8_t>& p) { GetHeader(p).version = 2; });
+        CheckRejected(pack, "file size", [](std::vector<uint8_t>& p) { GetHeader(p).fileSize += 1; });
+        CheckRejected(pack, "entry count", [](std::vector<uint8_t>& p) { GetHeader(p).entryCount = c_MaxEntries + 1; });
+        CheckRejected(pack, "table overrun", [](std::vector<uint8_t>& p) { GetHeader(p).entryCount += 1; });
+        CheckRejected(pack, "names offset", [](std::vector<uint8_t>& p) { GetHeader(p).namesOffset = p.size() + 1; });
+        CheckRejected(pack, "names size", [](std::vector<uint8_t>& p) { GetHeader(p).namesSize = UINT64_MAX; });
+        CheckRejected(pack, "data offset", [](std::vector<uint8_t>& p) { GetHeader(p).dataOffset = GetHeader(p).namesOffset; });
+
+        CheckRejected(pack, "unsorted", [](std::vector<uint8_t>& p) { std::swap(GetEntry(p, 0), GetEntry(p, 1)); });
+        CheckRejected(pack, "name offset", [](std::vector<uint8_t>& p) { GetEntry(p, 0).nameOffset = UINT32_MAX; });
+        CheckRejected(pack, "name length", [](std::vector<uint8_t>& p) { GetEntry(p, 0).nameLength += 1; });
+        CheckRejected(pack, "name too long", [](std::vector<uint8_t>& p) { GetEntry(p, 0).nameLength = c_MaxNameLength + 1; });
+        CheckRejected(pack, "payload offset", [](std::vector<uint8_t>& p) { GetEntry(p, 0).offset = 0; });
+        CheckRejected(pack, "payload size", [](std::vector<uint8_t>& p) { GetEntry(p, 0).storedSize = p.size(); });
+        CheckRejected(pack, "payload past the end", [](std::vector<uint8_t>& p) { GetEntry(p, 0).offset = UINT64_MAX - 8; });
+        CheckRejected(pack, "compression", [](std::vector<uint8_t>& p) { GetEntry(p, 0).compression = 2; });
+        CheckRejected(BuildPack(assets, false), "stored size", [](std::vector<uint8_t>& p) { GetEntry(p, 0).size += 1; });
+
+        // Random damage to the header, table and names must be caught, or leave a view whose
+        // lookups and extraction stay within the pack (compressed payloads are only checked as
+        // they are decompressed, so extraction may still throw).
+        const auto tableBytes = static_cast<uint32_t>(reinterpret_cast<const Header*>(pack.data())->dataOffset);
+        Test::Random random(42);
+        for (int iteration = 0; iteration < 5000; ++iteration)
+        {
+            auto copy = pack;
+            const uint32_t flips = 1 + random.Next(4);
+            for (uint32_t j = 0; j < flips; ++j)
+            {
+                copy[random.Next(tableBytes)] ^= static_cast<uint8_t>(1 + random.Next(255));
+            }
+
+            try
+            {
+                const AssetPackView view(copy.data(), copy.size());
+                for (uint32_t j = 0; j < view.GetEntryCount(); ++j)
+                {
+                    const auto& entry = view.GetEntry(j);
+                    CHECK(entry.offset + entry.storedSize <= copy.size());
+
+                    // A NUL inside a name only shortens it; the terminator is still within the block.
+                    CHECK(strlen(view.GetName(j)) <= entry.nameLength);
+                }
+
+                // Decompressing is the slow part, so only one entry is extracted each time.
+                const uint32_t index = random.Next(view.GetEntryCount());
+                if (index < view.GetEntryCount() && view.GetEntry(index).size < (64u << 20))
+                {
+                    std::vector<uint8_t> extracted(static_cast<size_t>(view.GetEntry(index).size));
+                    try
+                    {
+                        view.Extract(index, extracted.data(), extracted.size());
+                    }
+                    catch (const std::runtime_error&)
+                    {
+                    }
+                }
+
+                // The table may no longer be keyed by the right hashes, but lookups stay within it.
+                for (const char* name : c_Assets)
+                {
+                    const int index = view.Find(name);
+                    CHECK(index < int(view.GetEntryCount()));
+                }
+            }
+            catch (const std::runtime_error&)
+            {
+            }
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        const auto assets = LoadShippedAssets();
+
+        TestRoundTrip(assets, false);
+        TestRoundTrip(assets, true);
+        TestNames();
+        TestDamaged(assets);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return Test::Finish("AssetPackTests");
+}
@@ -0,0 +1,274 @@
+//
+// AssetStreamerBenchmark.cpp - Loads the shipped textures, model and font concurrently
+//
+// Usage: AssetStreamerBenchmark [scale]
+//
+// Requests 200 * scale loads of the sample's DDS, SDKMESH and spritefont files through an
+// AssetStreamer, then makes the same loads one after another on a single thread, and checks that
+// both give the same results. Each decode validates its file and copies the payload into a staging
+// layout the way the game's uploads do, which is the CPU work the streamer moves off the frame.
+//
+
+#include "AssetStreamer.h"
+#include "SDKMesh.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // What the benchmark's decodes produce: the staging copy, summarized.
+    struct Decoded
+    {
+        uint64_t    stagingBytes;
+        uint64_t    checksum;
+    };
+
+    constexpr size_t c_RowAlignment = 256;      // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+
+    size_t AlignUp(size_t value, size_t alignment) noexcept
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t Checksum(const uint8_t* data, size_t size) noexcept
+    {
+        uint64_t sum = 0;
+        for (size_t j = 0; j < size; ++j)
+        {
+            sum = sum * 31 + data[j];
+        }
+        return sum;
+    }
+
+    template<typename T>
+    T ReadValue(const std::vector<uint8_t>& data, size_t offset)
+    {
+        if (offset > data.size() || sizeof(T) > data.size() - offset)
+        {
+            throw std::runtime_error("Truncated asset");
+        }
+
+        T value;
+        memcpy(&value, data.data() + offset, sizeof(T));
+        return value;
+    }
+
+    // Uncompressed DDS: each mip level's rows are copied out at the aligned pitch an upload uses.
+    Decoded DecodeTexture(std::vector<uint8_t>&& dds)
+    {
+        constexpr size_t c_HeaderSize = 4 + 124;
+
+        if (ReadValue<uint32_t>(dds, 0) != 0x20534444)     // 'DDS '
+            throw std::runtime_error("Not a DDS file");
+
+        const uint32_t height = ReadValue<uint32_t>(dds, 12);
+        const uint32_t width = ReadValue<uint32_t>(dds, 16);
+        const uint32_t mipCount = std::max(ReadValue<uint32_t>(dds, 28), 1u);
+        const uint32_t bitCount = ReadValue<uint32_t>(dds, 88);
+
+        if (!width || !height || bitCount != 32)
+            throw std::runtime_error("Unsupported DDS format");
+
+        size_t stagingSize = 0;
+        for (uint32_t level = 0; level < mipCount; ++level)
+        {
+            stagingSize += AlignUp(size_t(std::max(width >> level, 1u)) * 4, c_RowAlignment) * std::max(height >> level, 1u);
+        }
+        std::vector<uint8_t> staging(stagingSize);
+
+        size_t source = c_HeaderSize;
+        size_t dest = 0;
+        for (uint32_t level = 0; level < mipCount; ++level)
+        {
+            const size_t rowBytes = size_t(std::max(width >> level, 1u)) * 4;
+            const size_t pitch = AlignUp(rowBytes, c_RowAlignment);
+            const uint32_t rows = std::max(height >> level, 1u);
+
+            if (rowBytes * rows > dds.size() - source)
+                throw std::runtime_error("Truncated DDS file");
+
+            for (uint32_t row = 0; row < rows; ++row)
+            {
+                memcpy(staging.data() + dest + row * pitch, dds.data() + source, rowBytes);
+                source += rowBytes;
+            }
+            dest += pitch * rows;
+        }
+
+        return Decoded{ staging.size(), Checksum(staging.data(), staging.size()) };
+    }
+
+    // SDKMESH: validated in place, then its vertex and index buffers copied to staging.
+    Decoded DecodeModel(std::vector<uint8_t>&& image)
+    {
+        const SDKMeshView view(image.data(), image.size());
+
+        std::vector<uint8_t> staging(static_cast<size_t>(view.GetTotalVertexBytes() + view.GetTotalIndexBytes()));
+        size_t offset = 0;
+        for (uint32_t j = 0; j < view.GetVertexBufferCount(); ++j)
+        {
+            const auto size = static_cast<size_t>(view.GetVertexBuffers()[j].SizeBytes);
+            memcpy(staging.data() + offset, view.GetVertexData(j), size);
+            offset += size;
+        }
+        for (uint32_t j = 0; j < view.GetIndexBufferCount(); ++j)
+        {
+            const auto size = static_cast<size_t>(view.GetIndexBuffers()[j].SizeBytes);
+            memcpy(staging.data() + offset, view.GetIndexData(j), size);
+            offset += size;
+        }
+
+        return Decoded{ staging.size(), Checksum(staging.data(), staging.size()) };
+    }
+
+    // DirectXTK spritefont: the glyph table is parsed, and the glyph texture copied to staging.
+    Decoded DecodeFont(std::vector<uint8_t>&& font)
+    {
+        constexpr size_t c_GlyphSize = 4 + 16 + 3 * 4;      // Character, RECT, XOffset, YOffset, XAdvance
+
+        if (font.size() < 8 || memcmp(font.data(), "DXTKfont", 8))
+            throw std::runtime_error("Not a spritefont file");
+
+        const uint32_t glyphCount = ReadValue<uint32_t>(font, 8);
+        size_t offset = 12 + size_t(glyphCount) * c_GlyphSize;
+
+        uint32_t previous = 0;
+        for (uint32_t j = 0; j < glyphCount; ++j)
+        {
+            const uint32_t character = ReadValue<uint32_t>(font, 12 + j * c_GlyphSize);
+            if (j && character <= previous)
+                throw std::runtime_error("Spritefont glyphs are not sorted");
+            previous = character;
+        }
+
+        offset += 4 + 4;    // Line spacing, default character
+
+        const uint32_t width = ReadValue<uint32_t>(font, offset);
+        const uint32_t stride = ReadValue<uint32_t>(font, offset + 12);
+        const uint32_t rows = ReadValue<uint32_t>(font, offset + 16);
+        offset += 20;
+
+        if (!width || size_t(stride) * rows > font.size() - std::min(offset, font.size()))
+            throw std::runtime_error("Truncated spritefont texture");
+
+        const size_t pitch = AlignUp(stride, c_RowAlignment);
+        std::vector<uint8_t> staging(pitch * rows);
+        for (uint32_t row = 0; row < rows; ++row)
+        {
+            memcpy(staging.data() + row * pitch, font.data() + offset + size_t(row) * stride, stride);
+        }
+
+        return Decoded{ staging.size(), Checksum(staging.data(), staging.size()) };
+    }
+
+    struct AssetType
+    {
+        const char* name;
+        Decoded (*decode)(std::vector<uint8_t>&&);
+    };
+
+    const AssetType c_Assets[] =
+    {
+        { "tiny.sdkmesh", DecodeModel },
+        { "Tiny_skin.dds", DecodeTexture },
+        { "seafloor.dds", DecodeTexture },
+        { "windowslogo.dds", DecodeTexture },
+        { "SegoeUI_18.spritefont", DecodeFont },
+    };
+
+    constexpr size_t c_AssetCount = sizeof(c_Assets) / sizeof(c_Assets[0]);
+}
+
+int main(int argc, char** argv)
+{
+    const double scale = Test::GetScale(argc, argv);
+    const uint32_t requestCount = std::max(static_cast<uint32_t>(200 * scale), uint32_t(c_AssetCount));
+
+    try
+    {
+        // One after another on this thread, as a baseline and for the expected results.
+        std::vector<Decoded> expected(c_AssetCount);
+        Test::Timer serialTimer;
+        for (uint32_t j = 0; j < requestCount; ++j)
+        {
+            const auto& asset = c_Assets[j % c_AssetCount];
+            expected[j % c_AssetCount] = asset.decode(Test::ReadAsset(asset.name));
+        }
+        const double serialMs = serialTimer.GetMilliseconds();
+
+        ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u));
+        double streamedMs = 0;
+        AssetStreamer::Statistics stats = {};
+        uint32_t mismatches = 0;
+        {
+            AssetStreamer streamer(pool);
+
+            std::vector<AssetHandle<Decoded>> handles;
+            handles.reserve(requestCount);
+
+            Test::Timer streamedTimer;
+            for (uint32_t j = 0; j < requestCount; ++j)
+            {
+                const auto& asset = c_Assets[j % c_AssetCount];
+                handles.emplace_back(streamer.Request(int(j % 3),
+                    [&asset]() { return Test::ReadAsset(asset.name); },
+                    asset.decode));
+            }
+
+            // A missing file fails its own request without disturbing the others.
+            auto missing = streamer.Request(0,
+                []() { return Test::ReadAsset("missing.dds"); },
+                DecodeTexture);
+
+            streamer.WaitIdle();
+            streamedMs = streamedTimer.GetMilliseconds();
+            stats = streamer.GetStatistics();
+
+            for (uint32_t j = 0; j < requestCount; ++j)
+            {
+                const auto& result = handles[j].Get();
+                const auto& reference = expected[j % c_AssetCount];
+                if (result.stagingBytes != reference.stagingBytes || result.checksum != reference.checksum)
+                {
+                    ++mismatches;
+                }
+            }
+
+            if (!missing.IsFailed() || streamer.GetPendingCount())
+            {
+                std::fprintf(stderr, "The request for a missing file didn't fail\n");
+                return 1;
+            }
+        }
+
+        std::printf("%u loads of %zu assets, %zu decode threads\n", requestCount, c_AssetCount, pool.GetThreadCount());
+        std::printf("  serial:   %9.2f ms\n", serialMs);
+        std::printf("  streamed: %9.2f ms (%.2fx), %.3f ms average latency, %.3f ms longest\n",
+            streamedMs, serialMs / streamedMs,
+            stats.completed ? stats.totalLatencyMs / stats.completed : 0.0, stats.longestLatencyMs);
+
+        if (mismatches || stats.completed != requestCount || stats.failed != 1)
+        {
+            std::fprintf(stderr, "Streamed loads differ from serial loads: %u mismatches, %u completed, %u failed\n",
+                mismatches, stats.completed, stats.failed);
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,233 @@
+//
+// BuddyAllocatorTests.cpp - Splitting, coalescing, alignment, exhaustion and statistics of the buddy allocator
+//
+
+#include "BuddyAllocator.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    constexpr uint64_t c_Size = 1u << 20;
+    constexpr uint64_t c_MinBlock = 4096;
+
+    bool Near(float a, float b) noexcept
+    {
+        return std::fabs(a - b) < 1e-6f;
+    }
+
+    void TestConstruction()
+    {
+        CHECK_THROWS(BuddyAllocator(3 * c_MinBlock, c_MinBlock), std::invalid_argument);
+        CHECK_THROWS(BuddyAllocator(c_Size, 3000), std::invalid_argument);
+        CHECK_THROWS(BuddyAllocator(c_MinBlock, c_Size), std::invalid_argument);
+        CHECK_THROWS(BuddyAllocator(0, c_MinBlock), std::invalid_argument);
+
+        BuddyAllocator single(c_MinBlock, c_MinBlock);
+        CHECK(single.Allocate(1) == 0);
+        CHECK(single.Allocate(1) == BuddyAllocator::c_InvalidOffset);
+
+        const auto stats = single.GetStatistics();
+        CHECK(stats.totalSize == c_MinBlock && stats.usedBytes == c_MinBlock && stats.freeBlockCount == 0);
+        CHECK(Near(stats.Fragmentation(), 0.f));
+    }
+
+    void TestSplitAndCoalesce()
+    {
+        BuddyAllocator allocator(c_Size, c_MinBlock);
+        CHECK(allocator.IsEmpty());
+
+        auto stats = allocator.GetStatistics();
+        CHECK(stats.freeBlockCount == 1 && stats.largestFreeBlock == c_Size);
+
+        // One minimum block splits the range all the way down: one free block at every other size.
+        const uint64_t first = allocator.Allocate(1);
+        CHECK(first == 0);
+        CHECK(allocator.GetAllocationSize(first) == c_MinBlock);
+
+        stats = allocator.GetStatistics();
+        CHECK(stats.freeBlockCount == 8);
+        CHECK(stats.largestFreeBlock == c_Size / 2);
+        CHECK(stats.usedBytes == c_MinBlock && stats.requestedBytes == 1);
+
+        // Allocations pack from the start; the buddy of the first block is next.
+        CHECK(allocator.Allocate(c_MinBlock) == c_MinBlock);
+        CHECK(allocator.Allocate(2 * c_MinBlock) == 2 * c_MinBlock);
+
+        // Filling with minimum blocks uses every one of them, in order.
+        std::vector<uint64_t> offsets = { 0, c_MinBlock, 2 * c_MinBlock };
+        allocator.Free(2 * c_MinBlock);
+        offsets.pop_back();
+        for (;;)
+        {
+            const uint64_t offset = allocator.Allocate(c_MinBlock);
+            if (offset == BuddyAllocator::c_InvalidOffset)
+                break;
+            CHECK(offset == offsets.size() * c_MinBlock);
+            offsets.push_back(offset);
+        }
+        CHECK(offsets.size() == c_Size / c_MinBlock);
+        CHECK(allocator.GetStatistics().freeBlockCount == 0);
+
+        // Freeing every other block leaves the space badly scattered.
+        for (size_t j = 0; j < offsets.size(); j += 2)
+        {
+            allocator.Free(offsets[j]);
+        }
+        stats = allocator.GetStatistics();
+        CHECK(stats.FreeBytes() == c_Size / 2);
+        CHECK(stats.largestFreeBlock == c_MinBlock);
+        CHECK(stats.freeBlockCount == offsets.size() / 2);
+        CHECK(Near(stats.Fragmentation(), 1.f - float(c_MinBlock) / float(c_Size / 2)));
+        CHECK(allocator.Allocate(2 * c_MinBlock) == BuddyAllocator::c_InvalidOffset);
+
+        // Freeing the rest coalesces back into a single block covering the range.
+        for (size_t j = 1; j < offsets.size(); j += 2)
+        {
+            allocator.Free(offsets[j]);
+        }
+        stats = allocator.GetStatistics();
+        CHECK(allocator.IsEmpty());
+        CHECK(stats.freeBlockCount == 1 && stats.largestFreeBlock == c_Size);
+        CHECK(Near(stats.Fragmentation(), 0.f));
+        CHECK(allocator.Allocate(c_Size) == 0);
+
+        CHECK_THROWS(allocator.Free(c_MinBlock), std::invalid_argument);
+        allocator.Free(0);
+        CHECK_THROWS(allocator.Free(0), std::invalid_argument);
+    }
+
+    void TestAlignment()
+    {
+        BuddyAllocator allocator(c_Size, c_MinBlock);
+
+        // Take the first block so an aligned request can't just land at zero.
+        CHECK(allocator.Allocate(100) == 0);
+
+        for (const uint64_t alignment : { uint64_t(4096), uint64_t(16384), uint64_t(65536), uint64_t(262144) })
+        {
+            const uint64_t offset = allocator.Allocate(5000, alignment);
+            CHECK(offset != BuddyAllocator::c_InvalidOffset);
+            CHECK(offset % alignment == 0);
+            CHECK(allocator.GetAllocationSize(offset) >= alignment);
+        }
+
+        // Blocks are aligned to their own size.
+        BuddyAllocator sizes(c_Size, c_MinBlock);
+        Test::Random random(26);
+        for (int j = 0; j < 50; ++j)
+        {
+            const uint64_t offset = sizes.Allocate(1 + random.Next(40000));
+            if (offset == BuddyAllocator::c_InvalidOffset)
+                break;
+            CHECK(offset % sizes.GetAllocationSize(offset) == 0);
+        }
+
+        CHECK(allocator.Allocate(1, 2 * c_Size) == BuddyAllocator::c_InvalidOffset);
+    }
+
+    void TestExhaustion()
+    {
+        BuddyAllocator allocator(c_Size, c_MinBlock);
+        CHECK(allocator.Allocate(0) == BuddyAllocator::c_InvalidOffset);
+        CHECK(allocator.Allocate(c_Size + 1) == BuddyAllocator::c_InvalidOffset);
+
+        // A request just over half the range rounds up to all of it.
+        const uint64_t whole = allocator.Allocate(c_Size / 2 + 1);
+        CHECK(whole == 0);
+        CHECK(allocator.Allocate(1) == BuddyAllocator::c_InvalidOffset);
+
+        const auto stats = allocator.GetStatistics();
+        CHECK(stats.usedBytes == c_Size && stats.FreeBytes() == 0);
+        CHECK(Near(stats.InternalWaste(), 1.f - float(c_Size / 2 + 1) / float(c_Size)));
+        CHECK(Near(stats.Fragmentation(), 0.f));
+
+        allocator.Free(whole);
+        CHECK(Near(allocator.GetStatistics().InternalWaste(), 0.f));
+        CHECK(allocator.Allocate(c_Size) == 0);
+    }
+
+    // Random allocations and frees against a map of what's live: no two blocks overlap, and the
+    // statistics always add up.
+    void TestRandom()
+    {
+        Test::Random random(126);
+        BuddyAllocator allocator(c_Size, c_MinBlock);
+        std::map<uint64_t, uint64_t> live;     // Offset to requested size
+        uint64_t requested = 0;
+
+        for (int step = 0; step < 20000; ++step)
+        {
+            if (live.empty() || random.Next(5) < 3)
+            {
+                const uint64_t size = 1 + random.Next(random.Next(2) ? 8192 : 131072);
+                const uint64_t alignment = random.Next(4) ? 0 : (c_MinBlock << random.Next(5));
+                const uint64_t offset = allocator.Allocate(size, alignment);
+                if (offset == BuddyAllocator::c_InvalidOffset)
+                    continue;
+
+                CHECK(!alignment || offset % alignment == 0);
+                CHECK(offset + size <= c_Size);
+                CHECK(live.find(offset) == live.end());
+                live[offset] = size;
+                requested += size;
+            }
+            else
+            {
+                auto it = live.begin();
+                std::advance(it, random.Next(static_cast<uint32_t>(live.size())));
+                allocator.Free(it->first);
+                requested -= it->second;
+                live.erase(it);
+            }
+
+            if (step % 100)
+                continue;
+
+            uint64_t used = 0;
+            uint64_t end = 0;
+            for (const auto& allocation : live)
+            {
+                const uint64_t size = allocator.GetAllocationSize(allocation.first);
+                CHECK(allocation.first >= end);
+                CHECK(size >= allocation.second);
+                end = allocation.first + size;
+                used += size;
+            }
+
+            const auto stats = allocator.GetStatistics();
+            CHECK(stats.allocationCount == live.size());
+            CHECK(stats.usedBytes == used);
+            CHECK(stats.requestedBytes == requested);
+            CHECK(stats.largestFreeBlock <= stats.FreeBytes());
+            CHECK(stats.Fragmentation() >= 0.f && stats.Fragmentation() <= 1.f);
+            CHECK(stats.InternalWaste() >= 0.f && stats.InternalWaste() < 1.f);
+        }
+
+        for (const auto& allocation : live)
+        {
+            allocator.Free(allocation.first);
+        }
+        CHECK(allocator.IsEmpty());
+        CHECK(allocator.GetStatistics().largestFreeBlock == c_Size);
+    }
+}
+
+int main()
+{
+    TestConstruction();
+    TestSplitAndCoalesce();
+    TestAlignment();
+    TestExhaustion();
+    TestRandom();
+
+    return Test::Finish("BuddyAllocatorTests");
+}
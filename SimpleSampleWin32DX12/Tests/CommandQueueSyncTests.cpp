@@ -0,0 +1,283 @@
+//
+// CommandQueueSyncTests.cpp - Fence bookkeeping against a simulated GPU
+//
+
+#include "CommandQueueSync.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    // Queues up signals and waits the way a Direct3D queue does, and runs them when asked: a
+    // signal sets the queue's fence, and a wait blocks the queue until the source fence gets there.
+    class MockBackend : public ICommandQueueBackend
+    {
+    public:
+        explicit MockBackend(uint32_t queueCount) :
+            signals(0),
+            waits(0),
+            redundantWaits(0),
+            m_queues(queueCount),
+            m_fences(queueCount, 0)
+        {
+        }
+
+        void Signal(uint32_t queue, uint64_t value) override
+        {
+            CHECK(queue < m_queues.size());
+            m_queues[queue].push_back(Command{ false, queue, value });
+            ++signals;
+        }
+
+        void Wait(uint32_t queue, uint32_t sourceQueue, uint64_t value) override
+        {
+            CHECK(queue < m_queues.size() && sourceQueue < m_queues.size());
+
+            // CommandQueueSync should never pass on a wait the queue already satisfies.
+            uint64_t& waited = m_waited[Key(queue, sourceQueue)];
+            if (value <= waited || value <= m_fences[sourceQueue])
+            {
+                ++redundantWaits;
+            }
+            waited = std::max(waited, value);
+
+            m_queues[queue].push_back(Command{ true, sourceQueue, value });
+            ++waits;
+        }
+
+        uint64_t GetCompletedValue(uint32_t queue) const override
+        {
+            return m_fences[queue];
+        }
+
+        // Runs at most one command on the queue; returns false if it is empty or blocked.
+        bool Step(uint32_t queue)
+        {
+            auto& commands = m_queues[queue];
+            if (commands.empty())
+                return false;
+
+            const Command& command = commands.front();
+            if (command.wait)
+            {
+                if (m_fences[command.queue] < command.value)
+                    return false;
+            }
+            else
+            {
+                m_fences[queue] = command.value;
+            }
+
+            commands.pop_front();
+            return true;
+        }
+
+        // Runs every queue until all are idle. Returns false if they deadlock.
+        bool Flush()
+        {
+            for (;;)
+            {
+                bool progress = false;
+                bool pending = false;
+                for (uint32_t j = 0; j < m_queues.size(); ++j)
+                {
+                    while (Step(j))
+                    {
+                        progress = true;
+                    }
+                    pending |= !m_queues[j].empty();
+                }
+
+                if (!pending)
+                    return true;
+
+                if (!progress)
+                    return false;
+            }
+        }
+
+        uint64_t signals;
+        uint64_t waits;
+        uint64_t redundantWaits;
+
+    private:
+        struct Command
+        {
+            bool        wait;
+            uint32_t    queue;      // The source queue of a wait
+            uint64_t    value;
+        };
+
+        size_t Key(uint32_t queue, uint32_t source) const { return size_t(queue) * m_queues.size() + source; }
+
+        std::vector<std::deque<Command>>    m_queues;
+        std::vector<uint64_t>               m_fences;
+        std::map<size_t, uint64_t>          m_waited;
+    };
+
+    void TestSignals()
+    {
+        MockBackend backend(CommandQueue_Count);
+        CommandQueueSync sync(&backend, CommandQueue_Count);
+
+        CHECK(sync.GetQueueCount() == CommandQueue_Count);
+        CHECK(sync.GetLastSignaledValue(CommandQueue_Graphics) == 0);
+
+        // Each queue counts up from one on its own.
+        CHECK(sync.Signal(CommandQueue_Graphics) == 1);
+        CHECK(sync.Signal(CommandQueue_Graphics) == 2);
+        CHECK(sync.Signal(CommandQueue_Copy) == 1);
+        CHECK(backend.signals == 3);
+
+        // Recorded signals must keep increasing, and later signals continue from them.
+        sync.RecordSignal(CommandQueue_Graphics, 10);
+        CHECK(sync.GetLastSignaledValue(CommandQueue_Graphics) == 10);
+        CHECK_THROWS(sync.RecordSignal(CommandQueue_Graphics, 10), std::invalid_argument);
+        CHECK_THROWS(sync.RecordSignal(CommandQueue_Graphics, 3), std::invalid_argument);
+        CHECK(sync.Signal(CommandQueue_Graphics) == 11);
+        CHECK(sync.GetLastSignaledValue(CommandQueue_Graphics) == 11);
+
+        CHECK(sync.GetStatistics().signals == 5);
+        CHECK(backend.signals == 4);
+
+        CHECK_THROWS(sync.Signal(CommandQueue_Count), std::out_of_range);
+        CHECK_THROWS(sync.RecordSignal(CommandQueue_Count, 1), std::out_of_range);
+        CHECK_THROWS(sync.GetLastSignaledValue(CommandQueue_Count), std::out_of_range);
+        CHECK_THROWS(CommandQueueSync(nullptr, 1), std::invalid_argument);
+        CHECK_THROWS(CommandQueueSync(&backend, 0), std::invalid_argument);
+    }
+
+    void TestWaits()
+    {
+        MockBackend backend(CommandQueue_Count);
+        CommandQueueSync sync(&backend, CommandQueue_Count);
+
+        // Nothing has been signaled, so there is nothing that could satisfy these.
+        CHECK_THROWS(sync.Wait(CommandQueue_Graphics, CommandQueue_Compute, 1), std::logic_error);
+        CHECK_THROWS(sync.Wait(CommandQueue_Graphics, CommandQueue_Graphics, 0), std::invalid_argument);
+        CHECK_THROWS(sync.Wait(CommandQueue_Graphics, CommandQueue_Count, 0), std::out_of_range);
+        CHECK(backend.waits == 0);
+
+        const uint64_t first = sync.Signal(CommandQueue_Compute);
+        const uint64_t second = sync.Signal(CommandQueue_Compute);
+        CHECK_THROWS(sync.Wait(CommandQueue_Graphics, CommandQueue_Compute, second + 1), std::logic_error);
+
+        sync.Wait(CommandQueue_Graphics, CommandQueue_Compute, second);
+        CHECK(backend.waits == 1);
+
+        // Already covered by the wait on the later value.
+        sync.Wait(CommandQueue_Graphics, CommandQueue_Compute, first);
+        sync.Wait(CommandQueue_Graphics, CommandQueue_Compute, second);
+        sync.WaitForLatest(CommandQueue_Graphics, CommandQueue_Compute);
+        CHECK(backend.waits == 1);
+        CHECK(sync.GetStatistics().skippedWaits == 3);
+
+        // A different queue still needs its own wait.
+        sync.Wait(CommandQueue_Copy, CommandQueue_Compute, first);
+        CHECK(backend.waits == 2);
+
+        // Once the GPU is past a value, waiting on it is a no-op.
+        CHECK(!sync.IsComplete(CommandQueue_Compute, second));
+        CHECK(backend.Flush());
+        CHECK(sync.IsComplete(CommandQueue_Compute, second));
+        CHECK(sync.GetCompletedValue(CommandQueue_Compute) == second);
+
+        sync.Wait(CommandQueue_Copy, CommandQueue_Compute, second);
+        CHECK(backend.waits == 2);
+        CHECK(sync.GetStatistics().waits == 2);
+        CHECK(sync.GetStatistics().skippedWaits == 4);
+        CHECK(backend.redundantWaits == 0);
+    }
+
+    // Random signals, waits and GPU progress across all queues. Every wait CommandQueueSync lets
+    // through must be needed, and since only signaled values can be waited on, the simulated
+    // queues must always be able to drain.
+    void TestRandomSchedules()
+    {
+        Test::Random random(32);
+
+        for (int iteration = 0; iteration < 200; ++iteration)
+        {
+            MockBackend backend(CommandQueue_Count);
+            CommandQueueSync sync(&backend, CommandQueue_Count);
+
+            uint64_t expectedSignals = 0;
+            for (int step = 0; step < 500; ++step)
+            {
+                const uint32_t queue = random.Next(CommandQueue_Count);
+                const uint32_t source = random.Next(CommandQueue_Count);
+
+                switch (random.Next(5))
+                {
+                case 0:
+                case 1:
+                {
+                    const uint64_t last = sync.GetLastSignaledValue(queue);
+                    CHECK(sync.Signal(queue) == last + 1);
+                    ++expectedSignals;
+                    break;
+                }
+
+                case 2:
+                {
+                    const uint64_t last = sync.GetLastSignaledValue(source);
+                    const uint64_t value = last + random.Next(3);
+                    if (queue == source)
+                    {
+                        CHECK_THROWS(sync.Wait(queue, source, value), std::invalid_argument);
+                    }
+                    else if (value > last)
+                    {
+                        CHECK_THROWS(sync.Wait(queue, source, value), std::logic_error);
+                    }
+                    else
+                    {
+                        sync.Wait(queue, source, value);
+                    }
+                    break;
+                }
+
+                case 3:
+                    if (queue != source)
+                    {
+                        sync.WaitForLatest(queue, source);
+                    }
+                    break;
+
+                default:
+                    backend.Step(queue);
+                    CHECK(sync.GetCompletedValue(queue) <= sync.GetLastSignaledValue(queue));
+                    break;
+                }
+            }
+
+            const auto& stats = sync.GetStatistics();
+            CHECK(stats.signals == expectedSignals);
+            CHECK(stats.waits == backend.waits);
+            CHECK(backend.redundantWaits == 0);
+            CHECK(backend.Flush());
+
+            for (uint32_t queue = 0; queue < CommandQueue_Count; ++queue)
+            {
+                CHECK(sync.GetCompletedValue(queue) == sync.GetLastSignaledValue(queue));
+                CHECK(sync.IsComplete(queue, sync.GetLastSignaledValue(queue)));
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestSignals();
+    TestWaits();
+    TestRandomSchedules();
+
+    return Test::Finish("CommandQueueSyncTests");
+}
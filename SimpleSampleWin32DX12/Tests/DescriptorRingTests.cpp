@@ -0,0 +1,183 @@
+//
+// DescriptorRingTests.cpp - Per-frame descriptor ring allocation, wrapping and retirement
+//
+
+#include "DescriptorRing.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    void TestBasics()
+    {
+        CHECK_THROWS(DescriptorRing(0), std::invalid_argument);
+
+        DescriptorRing ring(100);
+        CHECK_THROWS(ring.Allocate(0), std::runtime_error);
+        CHECK_THROWS(ring.Allocate(101), std::runtime_error);
+
+        CHECK(ring.Allocate(10) == 0);
+        CHECK(ring.Allocate(20) == 10);
+        CHECK(ring.GetInUse() == 30);
+        ring.EndFrame(1);
+
+        CHECK(ring.Allocate(50) == 30);
+        ring.EndFrame(2);
+        CHECK(ring.GetInUse() == 80);
+
+        // Frame 1 still in flight: the end of the ring is too short and the start is still busy.
+        CHECK_THROWS(ring.Allocate(30), std::runtime_error);
+        ring.Retire(0);
+        CHECK(ring.GetInUse() == 80);
+
+        // Retiring frame 1 frees the start; a range that doesn't fit at the end wraps, and the 20
+        // skipped at the end count as in use until the frame that skipped them retires.
+        ring.Retire(1);
+        CHECK(ring.GetInUse() == 50);
+        CHECK(ring.Allocate(25) == 0);
+        CHECK(ring.GetInUse() == 95);
+        CHECK(ring.GetHighWater() == 95);
+        CHECK_THROWS(ring.Allocate(6), std::runtime_error);
+        CHECK(ring.Allocate(5) == 25);
+        ring.EndFrame(3);
+
+        ring.Retire(2);
+        CHECK(ring.GetInUse() == 20 + 30);
+
+        // Once everything has retired the ring starts again from zero.
+        ring.Retire(3);
+        CHECK(ring.GetInUse() == 0);
+        CHECK(ring.Allocate(100) == 0);
+        CHECK(ring.GetHighWater() == 100);
+    }
+
+    void TestEmptyFrames()
+    {
+        DescriptorRing ring(64);
+        CHECK(ring.Allocate(40) == 0);
+        ring.EndFrame(1);
+
+        // Frames which allocate nothing keep the last allocations alive until they retire too.
+        ring.EndFrame(2);
+        ring.EndFrame(3);
+        ring.Retire(2);
+        CHECK(ring.GetInUse() == 40);
+        ring.Retire(3);
+        CHECK(ring.GetInUse() == 0);
+    }
+
+    // Frames of random allocations, retired a few frames late, against a model which tracks each
+    // frame's ranges: no live ranges overlap, and retiring a frame frees exactly its ranges.
+    void TestRandom()
+    {
+        struct Range
+        {
+            uint32_t    offset;
+            uint32_t    count;
+        };
+
+        struct Frame
+        {
+            uint64_t            fenceValue;
+            std::vector<Range>  ranges;
+        };
+
+        Test::Random random(28);
+        constexpr uint32_t c_Count = 1000;
+        DescriptorRing ring(c_Count);
+        std::deque<Frame> inFlight;
+        uint32_t wraps = 0;
+
+        for (uint64_t fenceValue = 1; fenceValue <= 5000; ++fenceValue)
+        {
+            // The GPU is up to three frames behind.
+            const uint64_t completed = fenceValue - 1 - std::min<uint64_t>(fenceValue - 1, random.Next(4));
+            ring.Retire(completed);
+            while (!inFlight.empty() && inFlight.front().fenceValue <= completed)
+            {
+                inFlight.pop_front();
+            }
+
+            std::vector<bool> busy(c_Count, false);
+            for (const auto& frame : inFlight)
+            {
+                for (const auto& range : frame.ranges)
+                {
+                    for (uint32_t j = 0; j < range.count; ++j)
+                    {
+                        busy[range.offset + j] = true;
+                    }
+                }
+            }
+
+            Frame frame{ fenceValue, {} };
+            const uint32_t allocations = random.Next(8);
+            for (uint32_t a = 0; a < allocations; ++a)
+            {
+                const uint32_t count = 1 + random.Next(60);
+                uint32_t offset = 0;
+                try
+                {
+                    offset = ring.Allocate(count);
+                }
+                catch (const std::runtime_error&)
+                {
+                    continue;
+                }
+
+                CHECK(offset + count <= c_Count);
+                if (!frame.ranges.empty() && offset < frame.ranges.back().offset)
+                {
+                    ++wraps;
+                }
+
+                for (uint32_t j = 0; j < count; ++j)
+                {
+                    CHECK(!busy[offset + j]);
+                    busy[offset + j] = true;
+                }
+                frame.ranges.push_back(Range{ offset, count });
+            }
+
+            ring.EndFrame(fenceValue);
+            if (!frame.ranges.empty())
+            {
+                inFlight.push_back(frame);
+            }
+            else if (!inFlight.empty())
+            {
+                inFlight.back().fenceValue = fenceValue;
+            }
+
+            uint32_t live = 0;
+            for (const bool b : busy)
+            {
+                live += b ? 1 : 0;
+            }
+            CHECK(ring.GetInUse() >= live);
+            CHECK(ring.GetInUse() <= c_Count);
+            CHECK(ring.GetHighWater() >= ring.GetInUse());
+        }
+
+        CHECK(wraps > 0);
+
+        ring.Retire(UINT64_MAX);
+        CHECK(ring.GetInUse() == 0);
+    }
+}
+
+int main()
+{
+    TestBasics();
+    TestEmptyFrames();
+    TestRandom();
+
+    return Test::Finish("DescriptorRingTests");
+}
@@ -0,0 +1,495 @@
+//
+// DynamicBVHBenchmark.cpp - Times building, refitting and querying the BVH, and checks it against brute force
+//
+// Usage: DynamicBVHBenchmark [scale]
+//
+// Scatters 10k to 1M (times scale) boxes through a cube around the camera, then times inserting
+// them one by one, moving them all and refitting, rebuilding, and frustum, ray and nearest-object
+// queries, beside a frustum test of every box. Every query is checked against a brute-force search
+// of the same boxes, and a separate run of random inserts, removes and moves (not scaled) checks
+// the tree as it changes shape.
+//
+
+#include "DynamicBVH.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Handle = DynamicBVH::Handle;
+    using Box = DynamicBVH::Box;
+
+    constexpr int c_Directions = 8;
+    constexpr float c_SceneSize = 500.f;
+    constexpr float c_MaxExtent = 5.f;
+
+    // Objects touching a frustum plane may come out either way, depending on which boxes above
+    // them the tree tested.
+    constexpr float c_PlaneTolerance = 1e-3f;
+
+    Box RandomBox(Test::Random& random)
+    {
+        Box box;
+        for (int j = 0; j < 3; ++j)
+        {
+            const float center = random.NextFloat(-c_SceneSize, c_SceneSize);
+            const float extent = random.NextFloat(0.f, c_MaxExtent);
+            box.lower[j] = center - extent;
+            box.upper[j] = center + extent;
+        }
+        return box;
+    }
+
+    Box Jitter(const Box& box, Test::Random& random, float distance)
+    {
+        Box moved = box;
+        for (int j = 0; j < 3; ++j)
+        {
+            const float offset = random.NextFloat(-distance, distance);
+            moved.lower[j] += offset;
+            moved.upper[j] += offset;
+        }
+        return moved;
+    }
+
+    void RandomRay(Test::Random& random, float (&origin)[3], float (&direction)[3])
+    {
+        float length = 0.f;
+        for (int j = 0; j < 3; ++j)
+        {
+            origin[j] = random.NextFloat(-c_SceneSize, c_SceneSize) * 0.1f;
+            direction[j] = random.NextFloat(-1.f, 1.f);
+            length += direction[j] * direction[j];
+        }
+
+        length = std::sqrt(std::max(length, 1e-6f));
+        for (auto& value : direction)
+        {
+            value /= length;
+        }
+    }
+
+    void RandomPoint(Test::Random& random, float (&point)[3])
+    {
+        for (auto& value : point)
+        {
+            value = random.NextFloat(-c_SceneSize, c_SceneSize);
+        }
+    }
+
+    // The boxes the tree should hold, indexed by handle.
+    class Model
+    {
+    public:
+        void Insert(Handle handle, const Box& box)
+        {
+            if (handle >= boxes.size())
+            {
+                boxes.resize(handle + 1);
+                live.resize(handle + 1, false);
+            }
+            boxes[handle] = box;
+            live[handle] = true;
+            handles.push_back(handle);
+        }
+
+        void Remove(size_t index)
+        {
+            live[handles[index]] = false;
+            handles[index] = handles.back();
+            handles.pop_back();
+        }
+
+        std::vector<Box>    boxes;
+        std::vector<bool>   live;
+        std::vector<Handle> handles;
+    };
+
+    // The smallest signed distance of the box from any plane, computed as QueryFrustum does; the box
+    // is visible if it isn't negative.
+    float FrustumMargin(const Frustum& frustum, const Box& box) noexcept
+    {
+        float margin = std::numeric_limits<float>::infinity();
+        for (const auto& plane : frustum.planes)
+        {
+            float center = plane[3];
+            float radius = 0.f;
+            for (size_t j = 0; j < 3; ++j)
+            {
+                center += plane[j] * (box.lower[j] + box.upper[j]) * 0.5f;
+                radius += std::fabs(plane[j]) * (box.upper[j] - box.lower[j]) * 0.5f;
+            }
+            margin = std::min(margin, center + radius);
+        }
+        return margin;
+    }
+
+    // The same slab test as the tree's, so the two agree exactly on where a ray enters a box.
+    bool IntersectRay(const Box& box, const float (&origin)[3], const float (&inverse)[3], float maxDistance, float& enter) noexcept
+    {
+        float first = 0.f;
+        float last = maxDistance;
+        for (size_t j = 0; j < 3; ++j)
+        {
+            float t1 = (box.lower[j] - origin[j]) * inverse[j];
+            float t2 = (box.upper[j] - origin[j]) * inverse[j];
+            if (t1 > t2)
+            {
+                std::swap(t1, t2);
+            }
+
+            first = t1 > first ? t1 : first;
+            last = t2 < last ? t2 : last;
+            if (first > last)
+                return false;
+        }
+
+        enter = first;
+        return true;
+    }
+
+    float DistanceSquared(const Box& box, const float (&point)[3]) noexcept
+    {
+        float distance = 0.f;
+        for (size_t j = 0; j < 3; ++j)
+        {
+            const float d = std::max(std::max(box.lower[j] - point[j], point[j] - box.upper[j]), 0.f);
+            distance += d * d;
+        }
+        return distance;
+    }
+
+    void BruteForceFrustum(const Frustum& frustum, const Model& model, std::vector<Handle>& visible)
+    {
+        visible.clear();
+        for (const Handle handle : model.handles)
+        {
+            if (FrustumMargin(frustum, model.boxes[handle]) >= 0.f)
+            {
+                visible.push_back(handle);
+            }
+        }
+    }
+
+    // Compares the tree's visible set with brute force's, allowing differences only for boxes on a plane.
+    bool SameVisible(const Frustum& frustum, const Model& model, std::vector<Handle> found, std::vector<Handle> expected)
+    {
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        if (std::adjacent_find(found.begin(), found.end()) != found.end())
+            return false;
+
+        std::vector<Handle> difference;
+        std::set_symmetric_difference(found.begin(), found.end(), expected.begin(), expected.end(), std::back_inserter(difference));
+        for (const Handle handle : difference)
+        {
+            if (handle >= model.live.size() || !model.live[handle]
+                || std::fabs(FrustumMargin(frustum, model.boxes[handle])) > c_PlaneTolerance)
+                return false;
+        }
+        return true;
+    }
+
+    bool CheckRay(const DynamicBVH& bvh, const Model& model, Test::Random& random)
+    {
+        float origin[3];
+        float direction[3];
+        RandomRay(random, origin, direction);
+
+        const float maxDistance = 2.f * c_SceneSize;
+        float inverse[3];
+        for (size_t j = 0; j < 3; ++j)
+        {
+            inverse[j] = 1.f / direction[j];
+        }
+
+        float expected = maxDistance;
+        bool any = false;
+        for (const Handle handle : model.handles)
+        {
+            float enter;
+            if (IntersectRay(model.boxes[handle], origin, inverse, maxDistance, enter) && enter <= expected)
+            {
+                expected = enter;
+                any = true;
+            }
+        }
+
+        float distance;
+        const Handle hit = bvh.Raycast(origin, direction, maxDistance, distance);
+        if (!any)
+            return hit == DynamicBVH::c_InvalidHandle;
+
+        // Several boxes may be hit at the same distance, so only the distance has to match.
+        return hit != DynamicBVH::c_InvalidHandle && distance == expected;
+    }
+
+    bool CheckNearest(const DynamicBVH& bvh, const Model& model, Test::Random& random)
+    {
+        float point[3];
+        RandomPoint(random, point);
+
+        float expected = std::numeric_limits<float>::infinity();
+        for (const Handle handle : model.handles)
+        {
+            expected = std::min(expected, DistanceSquared(model.boxes[handle], point));
+        }
+
+        float distance;
+        const Handle nearest = bvh.Nearest(point, distance);
+        if (model.handles.empty())
+            return nearest == DynamicBVH::c_InvalidHandle;
+
+        return nearest != DynamicBVH::c_InvalidHandle && distance == std::sqrt(expected);
+    }
+
+    // Random inserts, removes, moves, refits and rebuilds on a small tree, checking every query
+    // against brute force as it goes. Returns the number of failed checks.
+    uint32_t CheckChurn(const Frustum (&frustums)[c_Directions])
+    {
+        Test::Random random(48);
+        DynamicBVH bvh;
+        Model model;
+        std::vector<uint32_t> values;
+        uint32_t failures = 0;
+
+        auto insert = [&]()
+            {
+                const Box box = RandomBox(random);
+                const uint32_t value = random.Next();
+                const Handle handle = bvh.Insert(box, value);
+                model.Insert(handle, box);
+                if (handle >= values.size())
+                {
+                    values.resize(handle + 1);
+                }
+                values[handle] = value;
+            };
+
+        for (int j = 0; j < 2000; ++j)
+        {
+            insert();
+        }
+
+        std::vector<Handle> found;
+        std::vector<Handle> expected;
+        for (int step = 1; step <= 20000; ++step)
+        {
+            const uint32_t operation = model.handles.empty() ? 0 : random.Next(100);
+            const size_t index = model.handles.empty() ? 0 : random.Next(static_cast<uint32_t>(model.handles.size()));
+
+            if (operation < 30)
+            {
+                insert();
+            }
+            else if (operation < 55)
+            {
+                bvh.Remove(model.handles[index]);
+                model.Remove(index);
+            }
+            else if (operation < 85)
+            {
+                // Mostly small moves, sometimes right across the scene.
+                const Handle handle = model.handles[index];
+                const Box box = random.Next(4) ? Jitter(model.boxes[handle], random, 2.f) : RandomBox(random);
+                bvh.Move(handle, box);
+                model.boxes[handle] = box;
+            }
+            else if (operation < 99)
+            {
+                for (int j = 0; j < 50; ++j)
+                {
+                    const Handle handle = model.handles[random.Next(static_cast<uint32_t>(model.handles.size()))];
+                    const Box box = Jitter(model.boxes[handle], random, 10.f);
+                    bvh.SetBox(handle, box);
+                    model.boxes[handle] = box;
+                }
+                bvh.Refit();
+            }
+            else
+            {
+                bvh.Rebuild();
+            }
+
+            if (step % 500)
+                continue;
+
+            failures += bvh.GetLeafCount() != model.handles.size();
+            for (const Handle handle : model.handles)
+            {
+                const Box& box = bvh.GetBox(handle);
+                failures += bvh.GetValue(handle) != values[handle]
+                    || !std::equal(box.lower, box.lower + 3, model.boxes[handle].lower)
+                    || !std::equal(box.upper, box.upper + 3, model.boxes[handle].upper);
+            }
+
+            // Balanced by rotations, the tree stays within a small factor of the least height.
+            const double least = std::ceil(std::log2(std::max<double>(double(model.handles.size()), 1.0)));
+            failures += bvh.GetHeight() > 2 * least + 2;
+
+            for (const auto& frustum : frustums)
+            {
+                bvh.QueryFrustum(frustum, found);
+                BruteForceFrustum(frustum, model, expected);
+                failures += !SameVisible(frustum, model, found, expected);
+            }
+
+            for (int j = 0; j < 50; ++j)
+            {
+                failures += !CheckRay(bvh, model, random);
+                failures += !CheckNearest(bvh, model, random);
+            }
+        }
+
+        return failures;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const double scale = Test::GetScale(argc, argv);
+
+    Frustum frustums[c_Directions];
+    for (int j = 0; j < c_Directions; ++j)
+    {
+        float viewProjection[4][4];
+        Test::MakeViewProjection(6.2831853f * float(j) / c_Directions, 400.f, viewProjection);
+        frustums[j] = Frustum::FromViewProjection(viewProjection);
+    }
+
+    uint32_t failures = CheckChurn(frustums);
+
+    constexpr int c_Queries = 1000;
+    constexpr int c_CheckedQueries = 20;
+
+    std::printf("times are per operation over all objects, or per query\n");
+    std::printf("%8s %7s %10s %10s %10s %7s %10s %10s %8s %9s %6s %10s\n",
+        "objects", "height", "insert ms", "refit ms", "rebuild ms", "height",
+        "frustum ms", "brute ms", "visible", "ray us", "hits", "nearest us");
+
+    for (const uint32_t baseCount : { 10000u, 100000u, 1000000u })
+    {
+        const size_t count = std::max<size_t>(1, static_cast<size_t>(baseCount * scale));
+
+        Test::Random random(baseCount);
+        Model model;
+        DynamicBVH bvh;
+
+        std::vector<Box> boxes(count);
+        for (auto& box : boxes)
+        {
+            box = RandomBox(random);
+        }
+
+        std::vector<Handle> handles(count);
+        Test::Timer insertTimer;
+        for (size_t j = 0; j < count; ++j)
+        {
+            handles[j] = bvh.Insert(boxes[j], static_cast<uint32_t>(j));
+        }
+        const double insertMs = insertTimer.GetMilliseconds();
+        const int32_t insertedHeight = bvh.GetHeight();
+
+        for (size_t j = 0; j < count; ++j)
+        {
+            failures += bvh.GetValue(handles[j]) != j;
+            model.Insert(handles[j], boxes[j]);
+        }
+
+        // Everything moves a little, as a frame of animation would.
+        for (const Handle handle : handles)
+        {
+            model.boxes[handle] = Jitter(model.boxes[handle], random, 1.f);
+        }
+
+        Test::Timer refitTimer;
+        for (const Handle handle : handles)
+        {
+            bvh.SetBox(handle, model.boxes[handle]);
+        }
+        bvh.Refit();
+        const double refitMs = refitTimer.GetMilliseconds();
+
+        std::vector<Handle> found;
+        std::vector<Handle> expected;
+        failures += CheckRay(bvh, model, random) ? 0 : 1;
+        bvh.QueryFrustum(frustums[0], found);
+        BruteForceFrustum(frustums[0], model, expected);
+        failures += !SameVisible(frustums[0], model, found, expected);
+
+        Test::Timer rebuildTimer;
+        bvh.Rebuild();
+        const double rebuildMs = rebuildTimer.GetMilliseconds();
+
+        double frustumMs = 0;
+        double bruteMs = 0;
+        size_t visible = 0;
+        for (const auto& frustum : frustums)
+        {
+            Test::Timer queryTimer;
+            bvh.QueryFrustum(frustum, found);
+            frustumMs += queryTimer.GetMilliseconds();
+
+            Test::Timer bruteTimer;
+            BruteForceFrustum(frustum, model, expected);
+            bruteMs += bruteTimer.GetMilliseconds();
+
+            visible += found.size();
+            failures += !SameVisible(frustum, model, found, expected);
+        }
+
+        Test::Random queryRandom(1);
+        int hits = 0;
+        Test::Timer rayTimer;
+        for (int j = 0; j < c_Queries; ++j)
+        {
+            float origin[3];
+            float direction[3];
+            RandomRay(queryRandom, origin, direction);
+
+            float distance;
+            hits += bvh.Raycast(origin, direction, 2.f * c_SceneSize, distance) != DynamicBVH::c_InvalidHandle;
+        }
+        const double rayMs = rayTimer.GetMilliseconds();
+
+        Test::Timer nearestTimer;
+        for (int j = 0; j < c_Queries; ++j)
+        {
+            float point[3];
+            RandomPoint(queryRandom, point);
+
+            float distance;
+            failures += bvh.Nearest(point, distance) == DynamicBVH::c_InvalidHandle;
+        }
+        const double nearestMs = nearestTimer.GetMilliseconds();
+
+        for (int j = 0; j < c_CheckedQueries; ++j)
+        {
+            failures += !CheckRay(bvh, model, random);
+            failures += !CheckNearest(bvh, model, random);
+        }
+
+        std::printf("%8zu %7d %10.2f %10.2f %10.2f %7d %10.4f %10.4f %8zu %9.2f %5d%% %10.2f\n",
+            count, insertedHeight, insertMs, refitMs, rebuildMs, bvh.GetHeight(),
+            frustumMs / c_Directions, bruteMs / c_Directions, visible / c_Directions,
+            rayMs * 1000 / c_Queries, hits * 100 / c_Queries, nearestMs * 1000 / c_Queries);
+    }
+
+    if (failures)
+    {
+        std::fprintf(stderr, "DynamicBVH differs from brute force in %u checks\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+//
+// FrameGraphBenchmark.cpp - Times declaring and compiling frame graphs of increasing size
+//
+// Usage: FrameGraphBenchmark [scale]
+//
+// Each graph is a chain of post-processing style passes, each reading a few earlier results and
+// writing a new transient, with a share of dead branches for culling. The game rebuilds its graph
+// every frame, so both the declaration and the compile are timed.
+//
+
+#include "FrameGraph.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Handle = FrameGraph::ResourceHandle;
+
+    ID3D12Resource* const c_BackBuffer = reinterpret_cast<ID3D12Resource*>(uintptr_t(0x1000));
+
+    FrameGraph::MemoryRequirements QueryMemory(const FrameGraphTextureDesc& desc)
+    {
+        const uint64_t bytes = uint64_t(desc.width) * desc.height * 4;
+        return FrameGraph::MemoryRequirements{ (bytes + 65535) & ~uint64_t(65535), 65536, 0 };
+    }
+
+    void Declare(FrameGraph& graph, uint32_t passCount, Test::Random& random)
+    {
+        graph.Reset();
+        const Handle backBuffer = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+
+        std::vector<Handle> written;
+        written.reserve(passCount);
+
+        for (uint32_t j = 0; j < passCount; ++j)
+        {
+            const bool last = (j + 1 == passCount);
+            graph.AddPass("Pass", [&](FrameGraph::PassBuilder& builder)
+                {
+                    // Mostly read recent results, so lifetimes stay short and memory can be reused.
+                    const uint32_t reads = written.empty() ? 0 : 1 + random.Next(3);
+                    for (uint32_t k = 0; k < reads; ++k)
+                    {
+                        const uint32_t back = std::min<uint32_t>(static_cast<uint32_t>(written.size()), 1 + random.Next(8));
+                        builder.Read(written[written.size() - back]);
+                    }
+
+                    FrameGraphTextureDesc desc = {};
+                    desc.width = 1920u >> random.Next(4);
+                    desc.height = 1080u >> random.Next(4);
+                    desc.usage = FrameGraphAccess_RenderTarget | FrameGraphAccess_ShaderResource;
+
+                    const Handle texture = builder.CreateTexture("Texture", desc);
+                    builder.Write(texture);
+                    written.push_back(texture);
+
+                    if (last)
+                    {
+                        builder.Write(backBuffer);
+                    }
+                }, [](ID3D12GraphicsCommandList*) {});
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const double scale = Test::GetScale(argc, argv);
+
+    std::printf("%8s %8s %8s %12s %12s %10s %10s\n",
+        "passes", "culled", "barriers", "declare ms", "compile ms", "heap MB", "unaliased");
+
+    for (const uint32_t baseCount : { 16u, 64u, 256u, 1024u, 4096u })
+    {
+        const uint32_t passCount = std::max(2u, static_cast<uint32_t>(baseCount * scale));
+        const int iterations = std::max(1, static_cast<int>(4096 / passCount));
+
+        Test::Random random(passCount);
+        FrameGraph graph;
+
+        double declareMs = 0;
+        double compileMs = 0;
+        for (int j = 0; j < iterations; ++j)
+        {
+            Test::Timer declareTimer;
+            Declare(graph, passCount, random);
+            declareMs += declareTimer.GetMilliseconds();
+
+            Test::Timer compileTimer;
+            graph.Compile(QueryMemory);
+            compileMs += compileTimer.GetMilliseconds();
+        }
+
+        size_t barriers = graph.GetFinalBarriers().size();
+        for (const uint32_t pass : graph.GetExecutionOrder())
+        {
+            barriers += graph.GetPass(pass).barriers.size() + graph.GetPass(pass).releases.size();
+        }
+
+        uint64_t heap = 0;
+        for (const uint64_t size : graph.GetHeapSizes())
+        {
+            heap += size;
+        }
+
+        std::printf("%8u %8zu %8zu %12.4f %12.4f %10.1f %10.1f\n",
+            passCount, graph.GetCulledPassCount(), barriers,
+            declareMs / iterations, compileMs / iterations,
+            double(heap) / (1024 * 1024), double(graph.GetUnaliasedMemory()) / (1024 * 1024));
+
+        if (heap > graph.GetUnaliasedMemory())
+        {
+            std::fprintf(stderr, "Aliased heaps are larger than the unaliased total\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,387 @@
+//
+// FrameGraphTests.cpp - Pass culling, derived barriers, lifetimes and transient aliasing
+//
+
+#include "FrameGraph.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Handle = FrameGraph::ResourceHandle;
+
+    constexpr uint64_t c_Alignment = 65536;
+
+    ID3D12Resource* const c_BackBuffer = reinterpret_cast<ID3D12Resource*>(uintptr_t(0x1000));
+
+    FrameGraphTextureDesc MakeDesc(uint32_t width, uint32_t height, uint32_t format = 28)
+    {
+        FrameGraphTextureDesc desc = {};
+        desc.width = width;
+        desc.height = height;
+        desc.format = format;
+        desc.usage = FrameGraphAccess_RenderTarget | FrameGraphAccess_ShaderResource;
+        return desc;
+    }
+
+    // Four bytes a texel in 64KB pages; odd formats go in a second heap group.
+    FrameGraph::MemoryRequirements QueryMemory(const FrameGraphTextureDesc& desc)
+    {
+        const uint64_t bytes = uint64_t(desc.width) * desc.height * 4;
+        return FrameGraph::MemoryRequirements{ (bytes + c_Alignment - 1) / c_Alignment * c_Alignment, c_Alignment, desc.format & 1 };
+    }
+
+    void Nothing(ID3D12GraphicsCommandList*) {}
+
+    bool HasBarrier(const std::vector<FrameGraph::Barrier>& barriers, Handle resource, FRAMEGRAPH_ACCESS before, FRAMEGRAPH_ACCESS after)
+    {
+        return std::any_of(barriers.cbegin(), barriers.cend(), [&](const FrameGraph::Barrier& barrier)
+            {
+                return barrier.resource == resource && barrier.before == before && barrier.after == after;
+            });
+    }
+
+    void TestCulling()
+    {
+        FrameGraph graph;
+        const Handle backBuffer = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+
+        Handle scene = FrameGraph::c_InvalidHandle;
+        Handle unused = FrameGraph::c_InvalidHandle;
+        Handle intermediate = FrameGraph::c_InvalidHandle;
+
+        // 0: feeds the composite, so it survives.
+        graph.AddPass("Scene", [&](FrameGraph::PassBuilder& builder)
+            {
+                scene = builder.CreateTexture("Scene", MakeDesc(64, 64));
+                builder.Write(scene);
+            }, Nothing);
+
+        // 1 and 2: a chain whose end result nothing reads, so both go.
+        graph.AddPass("Orphan", [&](FrameGraph::PassBuilder& builder)
+            {
+                intermediate = builder.CreateTexture("Intermediate", MakeDesc(64, 64));
+                builder.Write(intermediate);
+            }, Nothing);
+
+        graph.AddPass("OrphanConsumer", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(intermediate);
+                unused = builder.CreateTexture("Unused", MakeDesc(64, 64));
+                builder.Write(unused);
+            }, Nothing);
+
+        // 3: writes nothing anyone reads, but is kept for its side effects.
+        graph.AddPass("Readback", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(scene, FrameGraphAccess_CopySource);
+                builder.SetSideEffects();
+            }, Nothing);
+
+        // 4: writes the imported back buffer, which is an output of the graph.
+        graph.AddPass("Composite", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(scene);
+                builder.Write(backBuffer);
+            }, Nothing);
+
+        graph.Compile(QueryMemory);
+
+        CHECK(graph.IsCompiled());
+        CHECK(graph.GetCulledPassCount() == 2);
+        CHECK(!graph.GetPass(0).culled);
+        CHECK(graph.GetPass(1).culled);
+        CHECK(graph.GetPass(2).culled);
+        CHECK(!graph.GetPass(3).culled);
+        CHECK(!graph.GetPass(4).culled);
+        CHECK((graph.GetExecutionOrder() == std::vector<uint32_t>{ 0, 3, 4 }));
+
+        // Resources only touched by culled passes get no lifetime and no memory.
+        CHECK(!graph.GetResource(intermediate).IsUsed());
+        CHECK(!graph.GetResource(unused).IsUsed());
+        CHECK(graph.GetResource(scene).IsUsed());
+        CHECK(graph.GetUnaliasedMemory() == QueryMemory(MakeDesc(64, 64)).size);
+    }
+
+    void TestBarriers()
+    {
+        FrameGraph graph;
+        const Handle backBuffer = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+
+        Handle color = FrameGraph::c_InvalidHandle;
+        Handle depth = FrameGraph::c_InvalidHandle;
+        Handle buffer = FrameGraph::c_InvalidHandle;
+
+        // 0
+        graph.AddPass("GBuffer", [&](FrameGraph::PassBuilder& builder)
+            {
+                color = builder.CreateTexture("Color", MakeDesc(128, 128));
+                depth = builder.CreateTexture("Depth", MakeDesc(128, 128));
+                builder.Write(color);
+                builder.Write(depth, FrameGraphAccess_DepthWrite);
+            }, Nothing);
+
+        // 1 and 2: back to back unordered access needs a UAV barrier, not a transition.
+        graph.AddPass("Simulate", [&](FrameGraph::PassBuilder& builder)
+            {
+                buffer = builder.CreateTexture("Buffer", MakeDesc(32, 32));
+                builder.Write(buffer, FrameGraphAccess_UnorderedAccess);
+            }, Nothing);
+
+        graph.AddPass("Resolve", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Write(buffer, FrameGraphAccess_UnorderedAccess);
+            }, Nothing);
+
+        // 3: combined read states are kept together in one transition.
+        graph.AddPass("Lighting", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(color);
+                builder.Read(depth, FrameGraphAccess_DepthRead);
+                builder.Read(depth, FrameGraphAccess_ShaderResource);
+                builder.Read(buffer);
+                builder.Write(backBuffer);
+            }, Nothing);
+
+        graph.Compile(QueryMemory);
+
+        CHECK(graph.GetCulledPassCount() == 0);
+
+        // Transients are created in the state of their first use.
+        const auto& gbuffer = graph.GetPass(0);
+        CHECK((gbuffer.activations == std::vector<Handle>{ color, depth }));
+        CHECK(gbuffer.barriers.empty());
+        CHECK(gbuffer.releases.empty());
+        CHECK(graph.GetResource(color).initialAccess == FrameGraphAccess_RenderTarget);
+        CHECK(graph.GetResource(depth).initialAccess == FrameGraphAccess_DepthWrite);
+
+        CHECK((graph.GetPass(1).activations == std::vector<Handle>{ buffer }));
+        CHECK(graph.GetPass(1).barriers.empty());
+
+        const auto& resolve = graph.GetPass(2);
+        CHECK(resolve.barriers.size() == 1);
+        CHECK(HasBarrier(resolve.barriers, buffer, FrameGraphAccess_UnorderedAccess, FrameGraphAccess_UnorderedAccess));
+
+        const auto readDepth = FrameGraphAccess_DepthRead | FrameGraphAccess_ShaderResource;
+        const auto& lighting = graph.GetPass(3);
+        CHECK(lighting.activations.empty());
+        CHECK(lighting.barriers.size() == 4);
+        CHECK(HasBarrier(lighting.barriers, color, FrameGraphAccess_RenderTarget, FrameGraphAccess_ShaderResource));
+        CHECK(HasBarrier(lighting.barriers, depth, FrameGraphAccess_DepthWrite, readDepth));
+        CHECK(HasBarrier(lighting.barriers, buffer, FrameGraphAccess_UnorderedAccess, FrameGraphAccess_ShaderResource));
+        CHECK(HasBarrier(lighting.barriers, backBuffer, FrameGraphAccess_Present, FrameGraphAccess_RenderTarget));
+
+        // Every transient ends its life in its creation state, ready for the next frame.
+        CHECK(lighting.releases.size() == 3);
+        CHECK(HasBarrier(lighting.releases, color, FrameGraphAccess_ShaderResource, FrameGraphAccess_RenderTarget));
+        CHECK(HasBarrier(lighting.releases, depth, readDepth, FrameGraphAccess_DepthWrite));
+        CHECK(HasBarrier(lighting.releases, buffer, FrameGraphAccess_ShaderResource, FrameGraphAccess_UnorderedAccess));
+
+        // Imported resources are returned to their final state after the last pass.
+        CHECK(graph.GetFinalBarriers().size() == 1);
+        CHECK(HasBarrier(graph.GetFinalBarriers(), backBuffer, FrameGraphAccess_RenderTarget, FrameGraphAccess_Present));
+    }
+
+    void TestLifetimes()
+    {
+        FrameGraph graph;
+        const Handle backBuffer = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+
+        Handle a = FrameGraph::c_InvalidHandle;
+        Handle b = FrameGraph::c_InvalidHandle;
+
+        graph.AddPass("Orphan", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Write(builder.CreateTexture("Orphan", MakeDesc(8, 8)));
+            }, Nothing);
+
+        graph.AddPass("WriteA", [&](FrameGraph::PassBuilder& builder)
+            {
+                a = builder.CreateTexture("A", MakeDesc(256, 256));
+                builder.Write(a);
+            }, Nothing);
+
+        graph.AddPass("AToB", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(a);
+                b = builder.CreateTexture("B", MakeDesc(256, 256));
+                builder.Write(b);
+            }, Nothing);
+
+        graph.AddPass("BToBackBuffer", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(b);
+                builder.Write(backBuffer);
+            }, Nothing);
+
+        graph.Compile(QueryMemory);
+
+        // Lifetimes count steps of the execution order, so the culled pass doesn't shift them.
+        CHECK(graph.GetResource(a).firstPass == 0);
+        CHECK(graph.GetResource(a).lastPass == 1);
+        CHECK(graph.GetResource(b).firstPass == 1);
+        CHECK(graph.GetResource(b).lastPass == 2);
+        CHECK(graph.GetResource(backBuffer).firstPass == 2);
+
+        // A and B are both alive in step 1, so they can't share memory.
+        const auto& resA = graph.GetResource(a);
+        const auto& resB = graph.GetResource(b);
+        CHECK(resA.heapOffset + resA.memory.size <= resB.heapOffset || resB.heapOffset + resB.memory.size <= resA.heapOffset);
+
+        // Declaring a read of a transient nothing has written is an error in the graph.
+        graph.Reset();
+        CHECK(graph.GetPassCount() == 0);
+        CHECK(graph.GetResourceCount() == 0);
+
+        const Handle target = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+        graph.AddPass("ReadFirst", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(builder.CreateTexture("Uninitialized", MakeDesc(8, 8)));
+                builder.Write(target);
+            }, Nothing);
+
+        CHECK_THROWS(graph.Compile(QueryMemory), std::logic_error);
+
+        // As is declaring a write through Read, or the other way around.
+        graph.Reset();
+        const Handle texture = graph.CreateTexture("Texture", MakeDesc(8, 8));
+        graph.AddPass("BadAccess", [&](FrameGraph::PassBuilder& builder)
+            {
+                CHECK_THROWS(builder.Read(texture, FrameGraphAccess_RenderTarget), std::invalid_argument);
+                CHECK_THROWS(builder.Write(texture, FrameGraphAccess_ShaderResource), std::invalid_argument);
+                CHECK_THROWS(builder.Read(texture + 1), std::out_of_range);
+            }, Nothing);
+    }
+
+    void TestSequentialAliasing()
+    {
+        FrameGraph graph;
+        const Handle backBuffer = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+
+        // A ping-pong chain: each texture is only alive for two steps, so they can reuse two slots.
+        Handle previous = FrameGraph::c_InvalidHandle;
+        for (int j = 0; j < 6; ++j)
+        {
+            graph.AddPass("Blur", [&](FrameGraph::PassBuilder& builder)
+                {
+                    if (previous != FrameGraph::c_InvalidHandle)
+                    {
+                        builder.Read(previous);
+                    }
+                    previous = builder.CreateTexture("Blur", MakeDesc(512, 512));
+                    builder.Write(previous);
+                }, Nothing);
+        }
+
+        graph.AddPass("Present", [&](FrameGraph::PassBuilder& builder)
+            {
+                builder.Read(previous);
+                builder.Write(backBuffer);
+            }, Nothing);
+
+        graph.Compile(QueryMemory);
+
+        const uint64_t size = QueryMemory(MakeDesc(512, 512)).size;
+        CHECK(graph.GetUnaliasedMemory() == 6 * size);
+        CHECK(graph.GetHeapSizes().size() == 1);
+        CHECK(graph.GetHeapSizes()[0] == 2 * size);
+    }
+
+    // Builds random graphs and checks that no two transients in the same heap group which are
+    // alive in the same step overlap in memory.
+    void TestRandomAliasing()
+    {
+        Test::Random random(27);
+
+        for (int iteration = 0; iteration < 200; ++iteration)
+        {
+            FrameGraph graph;
+            const Handle backBuffer = graph.ImportResource("BackBuffer", c_BackBuffer, FrameGraphAccess_Present, FrameGraphAccess_Present);
+
+            std::vector<Handle> written;
+            const uint32_t passCount = 2 + random.Next(30);
+            for (uint32_t j = 0; j < passCount; ++j)
+            {
+                const bool last = (j + 1 == passCount);
+                graph.AddPass("Pass", [&](FrameGraph::PassBuilder& builder)
+                    {
+                        const uint32_t reads = written.empty() ? 0 : random.Next(4);
+                        for (uint32_t k = 0; k < reads; ++k)
+                        {
+                            builder.Read(written[random.Next(static_cast<uint32_t>(written.size()))]);
+                        }
+
+                        const uint32_t creates = 1 + random.Next(2);
+                        for (uint32_t k = 0; k < creates; ++k)
+                        {
+                            const auto desc = MakeDesc(16 << random.Next(6), 16 << random.Next(6), random.Next(4));
+                            const Handle texture = builder.CreateTexture("Texture", desc);
+                            builder.Write(texture, random.Next(4) ? FrameGraphAccess_RenderTarget : FrameGraphAccess_UnorderedAccess);
+                            written.push_back(texture);
+                        }
+
+                        if (last)
+                        {
+                            builder.Write(backBuffer);
+                        }
+                        else if (!random.Next(8))
+                        {
+                            builder.SetSideEffects();
+                        }
+                    }, Nothing);
+            }
+
+            graph.Compile(QueryMemory);
+
+            CHECK(!graph.GetPass(passCount - 1).culled);
+
+            const auto& heapSizes = graph.GetHeapSizes();
+            uint64_t totalHeap = 0;
+            for (const uint64_t size : heapSizes)
+            {
+                totalHeap += size;
+            }
+            CHECK(totalHeap <= graph.GetUnaliasedMemory());
+
+            for (Handle a = 0; a < graph.GetResourceCount(); ++a)
+            {
+                const auto& resA = graph.GetResource(a);
+                if (resA.imported || !resA.IsUsed())
+                    continue;
+
+                CHECK(resA.firstPass <= resA.lastPass);
+                CHECK(!(resA.heapOffset % resA.memory.alignment));
+                CHECK(resA.memory.heapGroup < heapSizes.size());
+                CHECK(resA.heapOffset + resA.memory.size <= heapSizes[resA.memory.heapGroup]);
+
+                for (Handle b = a + 1; b < graph.GetResourceCount(); ++b)
+                {
+                    const auto& resB = graph.GetResource(b);
+                    if (resB.imported || !resB.IsUsed() || resB.memory.heapGroup != resA.memory.heapGroup)
+                        continue;
+
+                    const bool overlapInTime = resA.firstPass <= resB.lastPass && resB.firstPass <= resA.lastPass;
+                    const bool overlapInMemory = resA.heapOffset < resB.heapOffset + resB.memory.size
+                        && resB.heapOffset < resA.heapOffset + resA.memory.size;
+                    CHECK(!(overlapInTime && overlapInMemory));
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestCulling();
+    TestBarriers();
+    TestLifetimes();
+    TestSequentialAliasing();
+    TestRandomAliasing();
+
+    return Test::Finish("FrameGraphTests");
+}
@@ -0,0 +1,209 @@
+//
+// FrustumCullerBenchmark.cpp - Times culling large object sets, and checks them against brute force
+//
+// Usage: FrustumCullerBenchmark [scale]
+//
+// Scatters 100k to 1M (times scale) spheres and boxes through a cube around the camera, and culls
+// them against a perspective frustum turned through several directions: first one object at a time
+// from an array of structures, as a scalar baseline, then with FrustumCuller on one thread and
+// across a ThreadPool. All three must find exactly the same visible objects.
+//
+
+#include "FrustumCuller.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    struct Sphere
+    {
+        float center[3];
+        float radius;
+    };
+
+    struct Box
+    {
+        float center[3];
+        float extents[3];
+    };
+
+    constexpr int c_Directions = 8;
+    constexpr float c_SceneSize = 500.f;
+
+    // The same tests as FrustumCuller, one object at a time, with the arithmetic in the same order
+    // so that objects touching a plane come out the same way.
+    float Distance(const float* plane, const float* point) noexcept
+    {
+        return plane[0] * point[0] + (plane[1] * point[1] + (plane[2] * point[2] + plane[3]));
+    }
+
+    void CullSpheres(const Frustum& frustum, const std::vector<Sphere>& spheres, std::vector<uint32_t>& visible)
+    {
+        visible.clear();
+        for (size_t j = 0; j < spheres.size(); ++j)
+        {
+            bool inside = true;
+            for (const auto& plane : frustum.planes)
+            {
+                if (Distance(plane, spheres[j].center) + spheres[j].radius < 0.f)
+                {
+                    inside = false;
+                    break;
+                }
+            }
+
+            if (inside)
+            {
+                visible.push_back(static_cast<uint32_t>(j));
+            }
+        }
+    }
+
+    void CullBoxes(const Frustum& frustum, const std::vector<Box>& boxes, std::vector<uint32_t>& visible)
+    {
+        visible.clear();
+        for (size_t j = 0; j < boxes.size(); ++j)
+        {
+            const auto& box = boxes[j];
+
+            bool inside = true;
+            for (const auto& plane : frustum.planes)
+            {
+                const float distance = Distance(plane, box.center);
+                const float radius = std::fabs(plane[0]) * box.extents[0]
+                    + (std::fabs(plane[1]) * box.extents[1] + (std::fabs(plane[2]) * box.extents[2] + distance));
+                if (radius < 0.f)
+                {
+                    inside = false;
+                    break;
+                }
+            }
+
+            if (inside)
+            {
+                visible.push_back(static_cast<uint32_t>(j));
+            }
+        }
+    }
+
+    struct Timings
+    {
+        double      scalarMs = 0;
+        double      simdMs = 0;
+        double      threadedMs = 0;
+        size_t      visible = 0;
+    };
+
+    void PrintRow(const char* kind, size_t count, const Timings& timings)
+    {
+        std::printf("%-7s %9zu %9zu %11.3f %11.3f %11.3f %8.2fx %8.2fx\n",
+            kind, count, timings.visible / c_Directions,
+            timings.scalarMs / c_Directions, timings.simdMs / c_Directions, timings.threadedMs / c_Directions,
+            timings.scalarMs / timings.simdMs, timings.scalarMs / timings.threadedMs);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const double scale = Test::GetScale(argc, argv);
+
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u));
+
+    Frustum frustums[c_Directions];
+    for (int j = 0; j < c_Directions; ++j)
+    {
+        float viewProjection[4][4];
+        Test::MakeViewProjection(6.2831853f * float(j) / c_Directions, 400.f, viewProjection);
+        frustums[j] = Frustum::FromViewProjection(viewProjection);
+    }
+
+    std::printf("%zu culling threads; times are per frustum\n", pool.GetThreadCount());
+    std::printf("%-7s %9s %9s %11s %11s %11s %9s %9s\n",
+        "bounds", "objects", "visible", "scalar ms", "SIMD ms", "threads ms", "SIMD", "threads");
+
+    uint32_t mismatches = 0;
+    for (const uint32_t baseCount : { 100000u, 300000u, 1000000u })
+    {
+        const size_t count = std::max<size_t>(1, static_cast<size_t>(baseCount * scale));
+
+        Test::Random random(baseCount);
+        std::vector<Sphere> spheres(count);
+        std::vector<Box> boxes(count);
+        FrustumCuller culler;
+        for (size_t j = 0; j < count; ++j)
+        {
+            auto& sphere = spheres[j];
+            for (auto& value : sphere.center)
+            {
+                value = random.NextFloat(-c_SceneSize, c_SceneSize);
+            }
+            sphere.radius = random.NextFloat(0.f, 5.f);
+            culler.AddSphere(sphere.center[0], sphere.center[1], sphere.center[2], sphere.radius);
+
+            auto& box = boxes[j];
+            for (int k = 0; k < 3; ++k)
+            {
+                box.center[k] = random.NextFloat(-c_SceneSize, c_SceneSize);
+                box.extents[k] = random.NextFloat(0.f, 5.f);
+            }
+            culler.AddBox(box.center[0], box.center[1], box.center[2], box.extents[0], box.extents[1], box.extents[2]);
+        }
+
+        Timings sphereTimings;
+        Timings boxTimings;
+        std::vector<uint32_t> expected;
+        std::vector<uint32_t> visible;
+        std::vector<uint32_t> threaded;
+        for (const auto& frustum : frustums)
+        {
+            Test::Timer scalarTimer;
+            CullSpheres(frustum, spheres, expected);
+            sphereTimings.scalarMs += scalarTimer.GetMilliseconds();
+
+            Test::Timer simdTimer;
+            culler.CullSpheres(frustum, visible);
+            sphereTimings.simdMs += simdTimer.GetMilliseconds();
+
+            Test::Timer threadedTimer;
+            culler.CullSpheres(frustum, threaded, pool);
+            sphereTimings.threadedMs += threadedTimer.GetMilliseconds();
+
+            sphereTimings.visible += expected.size();
+            mismatches += (visible != expected) + (threaded != expected);
+
+            scalarTimer = Test::Timer();
+            CullBoxes(frustum, boxes, expected);
+            boxTimings.scalarMs += scalarTimer.GetMilliseconds();
+
+            simdTimer = Test::Timer();
+            culler.CullBoxes(frustum, visible);
+            boxTimings.simdMs += simdTimer.GetMilliseconds();
+
+            threadedTimer = Test::Timer();
+            culler.CullBoxes(frustum, threaded, pool);
+            boxTimings.threadedMs += threadedTimer.GetMilliseconds();
+
+            boxTimings.visible += expected.size();
+            mismatches += (visible != expected) + (threaded != expected);
+        }
+
+        PrintRow("spheres", count, sphereTimings);
+        PrintRow("boxes", count, boxTimings);
+    }
+
+    if (mismatches)
+    {
+        std::fprintf(stderr, "FrustumCuller differs from brute force in %u culls\n", mismatches);
+        return 1;
+    }
+
+    return 0;
+}
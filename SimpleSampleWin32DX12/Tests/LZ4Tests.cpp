@@ -0,0 +1,227 @@
+//
+// LZ4Tests.cpp - LZ4 block round trips, and decompression of truncated and corrupted blocks
+//
+
+#include "LZ4.h"
+#include "TestHelpers.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    bool RoundTrips(const std::vector<uint8_t>& data)
+    {
+        const auto compressed = LZ4::Compress(data.data(), data.size());
+        if (compressed.empty() || compressed.size() > LZ4::CompressBound(data.size()))
+            return false;
+
+        std::vector<uint8_t> decompressed(data.size());
+        LZ4::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+        return decompressed == data;
+    }
+
+    std::vector<uint8_t> RandomBytes(Test::Random& random, size_t size, uint32_t alphabet)
+    {
+        std::vector<uint8_t> data(size);
+        for (auto& b : data)
+        {
+            b = static_cast<uint8_t>(random.Next(alphabet));
+        }
+        return data;
+    }
+
+    void TestRoundTrips()
+    {
+        Test::Random random(42);
+
+        // Every size around the token, length continuation and end-of-block limits.
+        for (size_t size = 0; size < 600; ++size)
+        {
+            CHECK(RoundTrips(RandomBytes(random, size, 256)));
+            CHECK(RoundTrips(RandomBytes(random, size, 2)));
+            CHECK(RoundTrips(std::vector<uint8_t>(size, 0x5A)));
+        }
+
+        // Long runs are overlapping matches at offset 1, and need many length bytes.
+        CHECK(RoundTrips(std::vector<uint8_t>(1 << 20, 0)));
+
+        // A repeat further back than the largest offset can't be matched, and must still round trip.
+        auto block = RandomBytes(random, 70000, 256);
+        block.insert(block.end(), block.begin(), block.begin() + 1000);
+        CHECK(RoundTrips(block));
+
+        // Repeats just within the largest offset.
+        auto withinReach = RandomBytes(random, LZ4::c_MaxOffset, 256);
+        withinReach.insert(withinReach.end(), withinReach.begin(), withinReach.begin() + 5000);
+        CHECK(RoundTrips(withinReach));
+
+        const auto repeated = LZ4::Compress(withinReach.data(), withinReach.size());
+        CHECK(repeated.size() < withinReach.size());
+
+        // Structured data with matches of every length.
+        std::vector<uint8_t> text;
+        while (text.size() < 200000)
+        {
+            const uint32_t length = 1 + random.Next(300);
+            if (text.size() > 1000 && random.Next(2))
+            {
+                const size_t from = text.size() - 1 - random.Next(1000);
+                for (uint32_t j = 0; j < length; ++j)
+                {
+                    text.push_back(text[from + j]);
+                }
+            }
+            else
+            {
+                const auto literals = RandomBytes(random, length, 16);
+                text.insert(text.end(), literals.begin(), literals.end());
+            }
+        }
+        CHECK(RoundTrips(text));
+
+        // Incompressible input costs at most the bound.
+        const auto noise = RandomBytes(random, 100000, 256);
+        CHECK(RoundTrips(noise));
+    }
+
+    void TestShippedAssets()
+    {
+        for (const char* name : { "tiny.sdkmesh", "seafloor.dds", "windowslogo.dds", "Tiny_skin.dds", "SegoeUI_18.spritefont", "tiny.meshlets" })
+        {
+            const auto data = Test::ReadAsset(name);
+            const auto compressed = LZ4::Compress(data.data(), data.size());
+            std::printf("%-24s %9zu -> %9zu\n", name, data.size(), compressed.size());
+            CHECK(RoundTrips(data));
+        }
+    }
+
+    void TestCapacity()
+    {
+        Test::Random random(7);
+        const auto data = RandomBytes(random, 4096, 4);
+        const auto compressed = LZ4::Compress(data.data(), data.size());
+
+        // Too little room fails cleanly instead of writing past the end.
+        for (size_t capacity = 0; capacity < compressed.size(); ++capacity)
+        {
+            std::vector<uint8_t> dst(capacity + 16, 0xCD);
+            CHECK(LZ4::Compress(data.data(), data.size(), dst.data(), capacity) == 0);
+            for (size_t j = capacity; j < dst.size(); ++j)
+            {
+                CHECK(dst[j] == 0xCD);
+            }
+        }
+
+        std::vector<uint8_t> exact(compressed.size());
+        CHECK(LZ4::Compress(data.data(), data.size(), exact.data(), exact.size()) == compressed.size());
+        CHECK(exact == compressed);
+    }
+
+    // Decompresses into a buffer with guard bytes either side; returns false if it threw.
+    bool TryDecompress(const std::vector<uint8_t>& src, size_t dstSize, bool& guardsIntact)
+    {
+        constexpr size_t c_Guard = 64;
+        std::vector<uint8_t> dst(dstSize + 2 * c_Guard, 0xCD);
+
+        bool succeeded = true;
+        try
+        {
+            LZ4::Decompress(src.data(), src.size(), dst.data() + c_Guard, dstSize);
+        }
+        catch (const std::runtime_error&)
+        {
+            succeeded = false;
+        }
+
+        guardsIntact = true;
+        for (size_t j = 0; j < c_Guard; ++j)
+        {
+            guardsIntact &= dst[j] == 0xCD && dst[dst.size() - 1 - j] == 0xCD;
+        }
+        return succeeded;
+    }
+
+    void TestMalformed()
+    {
+        Test::Random random(99);
+
+        std::vector<uint8_t> text;
+        while (text.size() < 20000)
+        {
+            const auto word = RandomBytes(random, 3 + random.Next(12), 8);
+            for (int j = 0; j < 3; ++j)
+            {
+                text.insert(text.end(), word.begin(), word.end());
+            }
+        }
+        const auto compressed = LZ4::Compress(text.data(), text.size());
+
+        bool guardsIntact = false;
+        CHECK(TryDecompress(compressed, text.size(), guardsIntact) && guardsIntact);
+
+        // The wrong size is an error either way.
+        CHECK(!TryDecompress(compressed, text.size() - 1, guardsIntact) && guardsIntact);
+        CHECK(!TryDecompress(compressed, text.size() + 1, guardsIntact) && guardsIntact);
+
+        // Every truncation loses something.
+        for (size_t size = 0; size < compressed.size(); ++size)
+        {
+            const std::vector<uint8_t> prefix(compressed.begin(), compressed.begin() + ptrdiff_t(size));
+            CHECK(!TryDecompress(prefix, text.size(), guardsIntact) && guardsIntact);
+        }
+
+        // Damage may go unnoticed (a changed literal is still a valid block), but must never write
+        // outside the destination.
+        for (int iteration = 0; iteration < 20000; ++iteration)
+        {
+            auto damaged = compressed;
+            const uint32_t flips = 1 + random.Next(8);
+            for (uint32_t j = 0; j < flips; ++j)
+            {
+                damaged[random.Next(static_cast<uint32_t>(damaged.size()))] ^= static_cast<uint8_t>(1 + random.Next(255));
+            }
+
+            TryDecompress(damaged, text.size(), guardsIntact);
+            CHECK(guardsIntact);
+        }
+
+        // Hand-made blocks: a match before the start of the output, a zero offset, and a length
+        // continuation which runs off the end.
+        const std::vector<uint8_t> backReference = { 0x10, 'a', 0x02, 0x00 };
+        CHECK(!TryDecompress(backReference, 5, guardsIntact) && guardsIntact);
+
+        const std::vector<uint8_t> zeroOffset = { 0x10, 'a', 0x00, 0x00 };
+        CHECK(!TryDecompress(zeroOffset, 5, guardsIntact) && guardsIntact);
+
+        const std::vector<uint8_t> endlessLength = { 0xF0, 0xFF, 0xFF };
+        CHECK(!TryDecompress(endlessLength, 1000, guardsIntact) && guardsIntact);
+
+        const std::vector<uint8_t> overlapping = { 0x1F, 'a', 0x01, 0x00, 0x00, 0x00 };
+        std::vector<uint8_t> run(20);
+        LZ4::Decompress(overlapping.data(), overlapping.size(), run.data(), run.size());
+        CHECK(run == std::vector<uint8_t>(20, 'a'));
+    }
+}
+
+int main()
+{
+    try
+    {
+        TestRoundTrips();
+        TestShippedAssets();
+        TestCapacity();
+        TestMalformed();
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return Test::Finish("LZ4Tests");
+}
@@ -0,0 +1,325 @@
+//
+// MeshOptimizerTests.cpp - Triangle and vertex reordering keeps the mesh intact, and the cache analyzer is exact
+//
+
+#include "MeshOptimizer.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+using namespace DX::MeshOptimizer;
+
+namespace
+{
+    struct Mesh
+    {
+        std::vector<uint32_t>   indices;
+        std::vector<float>      positions;      // float3s
+    };
+
+    using Triangle = std::array<uint32_t, 3>;
+
+    // Each triangle rotated to start at its lowest index, which keeps its winding, then sorted: two
+    // index buffers draw the same triangles the same way round exactly when these match.
+    std::vector<Triangle> Triangles(const std::vector<uint32_t>& indices)
+    {
+        std::vector<Triangle> triangles;
+        for (size_t j = 0; j + 2 < indices.size(); j += 3)
+        {
+            Triangle t = { indices[j], indices[j + 1], indices[j + 2] };
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    // A closed sphere of shared vertices, its triangles wound the same way round, and shuffled so
+    // there is something for the optimizer to do.
+    Mesh MakeSphere(uint32_t stacks, uint32_t slices, Test::Random& random)
+    {
+        Mesh mesh;
+        for (uint32_t i = 0; i <= stacks; ++i)
+        {
+            const float phi = 3.14159265f * float(i) / float(stacks);
+            for (uint32_t j = 0; j < slices; ++j)
+            {
+                const float theta = 6.2831853f * float(j) / float(slices);
+                mesh.positions.push_back(std::sin(phi) * std::cos(theta));
+                mesh.positions.push_back(std::cos(phi));
+                mesh.positions.push_back(std::sin(phi) * std::sin(theta));
+            }
+        }
+
+        for (uint32_t i = 0; i < stacks; ++i)
+        {
+            for (uint32_t j = 0; j < slices; ++j)
+            {
+                const uint32_t a = i * slices + j;
+                const uint32_t b = i * slices + (j + 1) % slices;
+                const uint32_t c = a + slices;
+                const uint32_t d = b + slices;
+                if (i > 0)
+                {
+                    mesh.indices.insert(mesh.indices.end(), { a, b, c });
+                }
+                if (i + 1 < stacks)
+                {
+                    mesh.indices.insert(mesh.indices.end(), { b, d, c });
+                }
+            }
+        }
+
+        const size_t triangleCount = mesh.indices.size() / 3;
+        for (size_t t = triangleCount; t > 1; --t)
+        {
+            const size_t other = random.Next(static_cast<uint32_t>(t));
+            std::swap_ranges(&mesh.indices[3 * (t - 1)], &mesh.indices[3 * t], &mesh.indices[3 * other]);
+        }
+
+        return mesh;
+    }
+
+    // The FIFO cache kept the obvious way, as a queue searched on every access.
+    uint32_t CountMisses(const std::vector<uint32_t>& indices, uint32_t cacheSize)
+    {
+        std::deque<uint32_t> cache;
+        uint32_t misses = 0;
+        for (const uint32_t v : indices)
+        {
+            if (std::find(cache.begin(), cache.end(), v) != cache.end())
+                continue;
+
+            ++misses;
+            cache.push_back(v);
+            if (cache.size() > cacheSize)
+            {
+                cache.pop_front();
+            }
+        }
+        return misses;
+    }
+
+    bool Near(float a, float b) noexcept
+    {
+        return std::fabs(a - b) < 1e-5f;
+    }
+
+    void TestAnalyze()
+    {
+        // One triangle: every vertex misses once.
+        const std::vector<uint32_t> one = { 0, 1, 2 };
+        auto stats = AnalyzeVertexCache(one.data(), one.size(), 3);
+        CHECK(stats.misses == 3 && Near(stats.acmr, 3.f) && Near(stats.atvr, 1.f));
+
+        // The same triangle again is free.
+        const std::vector<uint32_t> repeated = { 0, 1, 2, 2, 0, 1, 1, 2, 0, 0, 1, 2 };
+        stats = AnalyzeVertexCache(repeated.data(), repeated.size(), 3);
+        CHECK(stats.misses == 3 && Near(stats.acmr, 0.75f) && Near(stats.atvr, 1.f));
+
+        // A cache of three is flushed by the second triangle, so the third misses again; six is not.
+        const std::vector<uint32_t> flush = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+        stats = AnalyzeVertexCache(flush.data(), flush.size(), 6, 3);
+        CHECK(stats.misses == 9 && Near(stats.acmr, 3.f) && Near(stats.atvr, 1.5f));
+        stats = AnalyzeVertexCache(flush.data(), flush.size(), 6, 6);
+        CHECK(stats.misses == 6 && Near(stats.acmr, 2.f) && Near(stats.atvr, 1.f));
+
+        // A hit doesn't move a vertex to the back of a FIFO: 0 is still evicted first.
+        const std::vector<uint32_t> fifo = { 0, 1, 2, 0, 1, 2, 3, 4, 5, 0, 0, 0 };
+        stats = AnalyzeVertexCache(fifo.data(), fifo.size(), 6, 5);
+        CHECK(stats.misses == 7);
+
+        // ATVR counts only the vertices used.
+        stats = AnalyzeVertexCache(flush.data(), flush.size(), 100, 3);
+        CHECK(Near(stats.atvr, 1.5f));
+
+        stats = AnalyzeVertexCache(nullptr, 0, 0);
+        CHECK(stats.misses == 0 && stats.acmr == 0.f && stats.atvr == 0.f);
+
+        CHECK_THROWS(AnalyzeVertexCache(one.data(), 2, 3), std::invalid_argument);
+        CHECK_THROWS(AnalyzeVertexCache(one.data(), one.size(), 2), std::out_of_range);
+
+        // Random index buffers against the queue.
+        Test::Random random(49);
+        for (int iteration = 0; iteration < 200; ++iteration)
+        {
+            const uint32_t vertexCount = 3 + random.Next(200);
+            std::vector<uint32_t> indices(3 * (1 + random.Next(300)));
+            for (auto& index : indices)
+            {
+                index = random.Next(vertexCount);
+            }
+
+            const uint32_t cacheSize = 1 + random.Next(40);
+            stats = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize);
+
+            std::vector<uint32_t> used(indices);
+            std::sort(used.begin(), used.end());
+            used.erase(std::unique(used.begin(), used.end()), used.end());
+
+            const uint32_t misses = CountMisses(indices, cacheSize);
+            CHECK(stats.misses == misses);
+            CHECK(Near(stats.acmr, float(misses) / float(indices.size() / 3)));
+            CHECK(Near(stats.atvr, float(misses) / float(used.size())));
+        }
+    }
+
+    void TestVertexCache()
+    {
+        Test::Random random(149);
+        Mesh mesh = MakeSphere(40, 64, random);
+        const size_t vertexCount = mesh.positions.size() / 3;
+        const auto expected = Triangles(mesh.indices);
+
+        const auto before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+        OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+        const auto after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+
+        CHECK(Triangles(mesh.indices) == expected);
+        // Shuffled, nearly every vertex misses; ordered, each is transformed not much more than once.
+        CHECK(before.acmr > 2.f);
+        CHECK(after.acmr < 0.8f);
+        CHECK(after.atvr < 1.5f);
+
+        // Already optimal, or too small to reorder.
+        std::vector<uint32_t> one = { 2, 0, 1 };
+        OptimizeVertexCache(one.data(), one.size(), 3);
+        CHECK((one == std::vector<uint32_t>{ 2, 0, 1 }));
+        OptimizeVertexCache(nullptr, 0, 0);
+
+        CHECK_THROWS(OptimizeVertexCache(one.data(), one.size(), 2), std::out_of_range);
+
+        // Random soups, with repeated and degenerate triangles, keep every one of them.
+        for (int iteration = 0; iteration < 50; ++iteration)
+        {
+            const uint32_t count = 3 + random.Next(100);
+            std::vector<uint32_t> indices(3 * (1 + random.Next(400)));
+            for (auto& index : indices)
+            {
+                index = random.Next(count);
+            }
+
+            const auto soup = Triangles(indices);
+            OptimizeVertexCache(indices.data(), indices.size(), count);
+            CHECK(Triangles(indices) == soup);
+        }
+    }
+
+    void TestOverdraw()
+    {
+        Test::Random random(249);
+        Mesh mesh = MakeSphere(40, 64, random);
+        const size_t vertexCount = mesh.positions.size() / 3;
+        const auto expected = Triangles(mesh.indices);
+
+        OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+        const auto cacheOnly = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+
+        for (const float threshold : { 1.f, 1.05f, 1.5f })
+        {
+            std::vector<uint32_t> indices = mesh.indices;
+            OptimizeOverdraw(indices.data(), indices.size(), mesh.positions.data(), 3 * sizeof(float), vertexCount, threshold);
+            CHECK(Triangles(indices) == expected);
+
+            // Clusters break only where the cache is cold, so the cost stays near the threshold.
+            const auto stats = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+            CHECK(stats.acmr <= cacheOnly.acmr * threshold * 1.1f);
+        }
+
+        // Positions may be interleaved with other attributes.
+        std::vector<float> interleaved;
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            interleaved.insert(interleaved.end(), &mesh.positions[3 * v], &mesh.positions[3 * v + 3]);
+            interleaved.insert(interleaved.end(), { 0.f, 1.f, 0.f, 0.5f, 0.5f });
+        }
+        std::vector<uint32_t> indices = mesh.indices;
+        OptimizeOverdraw(indices.data(), indices.size(), interleaved.data(), 8 * sizeof(float), vertexCount);
+        CHECK(Triangles(indices) == expected);
+
+        CHECK_THROWS(OptimizeOverdraw(indices.data(), indices.size(), nullptr, 12, vertexCount), std::invalid_argument);
+        CHECK_THROWS(OptimizeOverdraw(indices.data(), indices.size(), mesh.positions.data(), 8, vertexCount), std::invalid_argument);
+    }
+
+    void TestVertexFetch()
+    {
+        Test::Random random(349);
+        Mesh mesh = MakeSphere(20, 32, random);
+        OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.positions.size() / 3);
+
+        // Some vertices nothing uses, which the remap drops.
+        const size_t used = mesh.positions.size() / 3;
+        for (int j = 0; j < 10; ++j)
+        {
+            mesh.positions.insert(mesh.positions.end(), { 9.f, 9.f, float(j) });
+        }
+        const size_t vertexCount = mesh.positions.size() / 3;
+
+        std::vector<uint32_t> remap(vertexCount);
+        CHECK(OptimizeVertexFetch(remap.data(), mesh.indices.data(), mesh.indices.size(), vertexCount) == used);
+
+        for (size_t v = used; v < vertexCount; ++v)
+        {
+            CHECK(remap[v] == c_Unused);
+        }
+
+        // New indices are handed out in order of first use.
+        std::vector<uint32_t> indices(mesh.indices.size());
+        uint32_t next = 0;
+        for (size_t j = 0; j < indices.size(); ++j)
+        {
+            indices[j] = remap[mesh.indices[j]];
+            CHECK(indices[j] <= next);
+            if (indices[j] == next)
+            {
+                ++next;
+            }
+        }
+        CHECK(next == used);
+
+        // The renumbering is a permutation of the used vertices, so the order of triangles and their
+        // winding carry over unchanged.
+        std::vector<uint32_t> inverse(used, c_Unused);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            if (remap[v] != c_Unused)
+            {
+                CHECK(inverse[remap[v]] == c_Unused);
+                inverse[remap[v]] = static_cast<uint32_t>(v);
+            }
+        }
+        for (size_t j = 0; j < indices.size(); ++j)
+        {
+            CHECK(inverse[indices[j]] == mesh.indices[j]);
+        }
+
+        std::vector<float> positions(3 * used);
+        RemapVertices(positions.data(), mesh.positions.data(), 3 * sizeof(float), remap.data(), vertexCount);
+        for (size_t j = 0; j < indices.size(); ++j)
+        {
+            CHECK(std::equal(&positions[3 * indices[j]], &positions[3 * indices[j] + 3], &mesh.positions[3 * mesh.indices[j]]));
+        }
+
+        // Renumbering doesn't change which accesses hit the post-transform cache.
+        const auto before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+        const auto after = AnalyzeVertexCache(indices.data(), indices.size(), used);
+        CHECK(after.misses == before.misses);
+    }
+}
+
+int main()
+{
+    TestAnalyze();
+    TestVertexCache();
+    TestOverdraw();
+    TestVertexFetch();
+
+    return Test::Finish("MeshOptimizerTests");
+}
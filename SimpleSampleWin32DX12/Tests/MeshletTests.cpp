@@ -0,0 +1,522 @@
+//
+// MeshletTests.cpp - Meshlets built from the shipped model, and MeshletFileView on good and bad sidecars
+//
+
+#include "Meshlets.h"
+#include "SDKMesh.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+using namespace DX::Meshlets;
+
+namespace
+{
+    struct Triangle
+    {
+        uint32_t v[3];
+
+        bool operator<(const Triangle& other) const noexcept { return std::lexicographical_compare(v, v + 3, other.v, other.v + 3); }
+        bool operator==(const Triangle& other) const noexcept { return std::equal(v, v + 3, other.v); }
+    };
+
+    // The same triangle whichever corner it starts at, keeping its winding.
+    Triangle Canonical(uint32_t a, uint32_t b, uint32_t c) noexcept
+    {
+        if (b < a && b < c)
+            return Triangle{ { b, c, a } };
+        if (c < a && c <= b)
+            return Triangle{ { c, a, b } };
+        return Triangle{ { a, b, c } };
+    }
+
+    // One mesh part of the shipped model: a triangle list and the vertices it indexes.
+    struct ModelPart
+    {
+        std::vector<uint32_t>   indices;
+        std::vector<float>      positions;      // float3s
+        bool                    clockwise;
+    };
+
+    // tiny_optimized.sdkmesh's vertices start with a FLOAT3 position, followed by a FLOAT3 normal.
+    std::vector<ModelPart> LoadParts(const std::vector<uint8_t>& image)
+    {
+        const SDKMeshView view(image.data(), image.size());
+
+        std::vector<ModelPart> parts;
+        for (uint32_t j = 0; j < view.GetMeshCount(); ++j)
+        {
+            const auto& mesh = view.GetMeshes()[j];
+            const auto& vb = view.GetVertexBuffers()[mesh.VertexBuffers[0]];
+            const auto& ib = view.GetIndexBuffers()[mesh.IndexBuffer];
+            CHECK(vb.StrideBytes >= 6 * sizeof(float));
+
+            const uint8_t* vertices = view.GetVertexData(mesh.VertexBuffers[0]);
+            const uint8_t* indices = view.GetIndexData(mesh.IndexBuffer);
+
+            const uint32_t* subsets = view.GetMeshSubsets(j);
+            for (uint32_t k = 0; k < mesh.NumSubsets; ++k)
+            {
+                const auto& subset = view.GetSubsets()[subsets[k]];
+                if (subset.PrimitiveType != SDKMesh::PrimitiveType_TriangleList)
+                    continue;
+
+                ModelPart part;
+                for (uint64_t i = 0; i < subset.IndexCount; ++i)
+                {
+                    const uint64_t index = subset.IndexStart + i;
+                    uint32_t value;
+                    if (ib.IndexType == SDKMesh::IndexType_32Bit)
+                    {
+                        std::memcpy(&value, indices + index * 4, 4);
+                    }
+                    else
+                    {
+                        uint16_t narrow;
+                        std::memcpy(&narrow, indices + index * 2, 2);
+                        value = narrow;
+                    }
+                    part.indices.push_back(value);
+                }
+
+                // Front faces wind whichever way most triangles agree with their vertex normals.
+                std::vector<float> normals;
+                for (uint64_t v = 0; v < subset.VertexCount; ++v)
+                {
+                    float vertex[6];
+                    std::memcpy(vertex, vertices + (subset.VertexStart + v) * vb.StrideBytes, sizeof(vertex));
+                    part.positions.insert(part.positions.end(), vertex, vertex + 3);
+                    normals.insert(normals.end(), vertex + 3, vertex + 6);
+                }
+
+                double facing = 0;
+                for (size_t t = 0; t + 2 < part.indices.size(); t += 3)
+                {
+                    const float* a = &part.positions[3 * part.indices[t]];
+                    const float* b = &part.positions[3 * part.indices[t + 1]];
+                    const float* c = &part.positions[3 * part.indices[t + 2]];
+                    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                    const float cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                    for (size_t corner = 0; corner < 3; ++corner)
+                    {
+                        const float* n = &normals[3 * part.indices[t + corner]];
+                        facing += double(cross[0] * n[0] + cross[1] * n[1] + cross[2] * n[2]);
+                    }
+                }
+                part.clockwise = facing < 0.0;
+
+                parts.push_back(std::move(part));
+            }
+        }
+        return parts;
+    }
+
+    // The meshlets' triangles, as the part's own vertex indices.
+    std::vector<Triangle> GetTriangles(const Meshlet* meshlets, size_t meshletCount, const uint32_t* vertices, const uint8_t* triangles)
+    {
+        std::vector<Triangle> result;
+        for (size_t m = 0; m < meshletCount; ++m)
+        {
+            const auto& meshlet = meshlets[m];
+            const uint32_t* v = vertices + meshlet.vertexOffset;
+            const uint8_t* t = triangles + meshlet.triangleOffset;
+            for (uint32_t j = 0; j < meshlet.triangleCount; ++j)
+            {
+                result.push_back(Canonical(v[t[3 * j]], v[t[3 * j + 1]], v[t[3 * j + 2]]));
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    std::vector<Triangle> GetTriangles(const std::vector<uint32_t>& indices)
+    {
+        std::vector<Triangle> result;
+        for (size_t j = 0; j + 2 < indices.size(); j += 3)
+        {
+            result.push_back(Canonical(indices[j], indices[j + 1], indices[j + 2]));
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    float Extent(const ModelPart& part)
+    {
+        float lower[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float upper[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (size_t j = 0; j < part.positions.size(); ++j)
+        {
+            lower[j % 3] = std::min(lower[j % 3], part.positions[j]);
+            upper[j % 3] = std::max(upper[j % 3], part.positions[j]);
+        }
+        return std::max(std::max(upper[0] - lower[0], upper[1] - lower[1]), upper[2] - lower[2]);
+    }
+
+    // Every triangle lands in exactly one meshlet, within the limits, and every bounding sphere
+    // holds its meshlet's vertices.
+    void CheckSet(const ModelPart& part, const MeshletSet& set, size_t maxVertices, size_t maxTriangles)
+    {
+        CHECK(set.bounds.size() == set.meshlets.size());
+        CHECK(GetTriangles(set.meshlets.data(), set.meshlets.size(), set.vertices.data(), set.triangles.data()) == GetTriangles(part.indices));
+
+        const float tolerance = 1e-5f * Extent(part);
+        for (size_t m = 0; m < set.meshlets.size(); ++m)
+        {
+            const auto& meshlet = set.meshlets[m];
+            const auto& bounds = set.bounds[m];
+            CHECK(meshlet.vertexCount <= maxVertices && meshlet.triangleCount <= maxTriangles && meshlet.triangleCount);
+            CHECK(meshlet.triangleOffset % 4 == 0);
+            CHECK(meshlet.vertexOffset + meshlet.vertexCount <= set.vertices.size());
+            CHECK(meshlet.triangleOffset + meshlet.triangleCount * 3 <= set.triangles.size());
+
+            for (uint32_t j = 0; j < meshlet.vertexCount; ++j)
+            {
+                const float* p = &part.positions[3 * set.vertices[meshlet.vertexOffset + j]];
+                const float dx = p[0] - bounds.center[0];
+                const float dy = p[1] - bounds.center[1];
+                const float dz = p[2] - bounds.center[2];
+                CHECK(std::sqrt(dx * dx + dy * dy + dz * dz) <= bounds.radius + tolerance);
+            }
+        }
+    }
+
+    // From any eye, a meshlet culled as back-facing has no triangle whose front faces the eye.
+    void CheckCones(const ModelPart& part, const MeshletSet& set, bool clockwise, Test::Random& random)
+    {
+        const float extent = Extent(part);
+        const float tolerance = 1e-4f * extent;
+
+        float center[3] = {};
+        for (size_t j = 0; j < part.positions.size(); ++j)
+        {
+            center[j % 3] += part.positions[j] * 3.f / float(part.positions.size());
+        }
+
+        size_t culled = 0;
+        for (int iteration = 0; iteration < 300; ++iteration)
+        {
+            // Eyes inside the model as well as around it.
+            float direction[3];
+            float length = 0.f;
+            for (auto& value : direction)
+            {
+                value = random.NextFloat(-1.f, 1.f);
+                length += value * value;
+            }
+            length = std::sqrt(std::max(length, 1e-6f));
+
+            const float distance = extent * random.NextFloat(0.1f, 4.f);
+            const float eye[3] = {
+                center[0] + direction[0] / length * distance,
+                center[1] + direction[1] / length * distance,
+                center[2] + direction[2] / length * distance };
+
+            for (size_t m = 0; m < set.meshlets.size(); ++m)
+            {
+                if (!IsBackFacing(set.bounds[m], eye))
+                    continue;
+
+                ++culled;
+                const auto& meshlet = set.meshlets[m];
+                const uint32_t* v = &set.vertices[meshlet.vertexOffset];
+                const uint8_t* t = &set.triangles[meshlet.triangleOffset];
+                for (uint32_t j = 0; j < meshlet.triangleCount; ++j)
+                {
+                    const float* a = &part.positions[3 * v[t[3 * j]]];
+                    const float* b = &part.positions[3 * v[t[3 * j + 1]]];
+                    const float* c = &part.positions[3 * v[t[3 * j + 2]]];
+                    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                    float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                    const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    if (area == 0.f)
+                        continue;
+
+                    const float sign = clockwise ? -1.f : 1.f;
+                    const float facing = sign * ((eye[0] - a[0]) * n[0] + (eye[1] - a[1]) * n[1] + (eye[2] - a[2]) * n[2]) / area;
+                    CHECK(facing <= tolerance);
+                }
+            }
+        }
+
+        // Not a vacuous pass: from some of those eyes, something was culled.
+        CHECK(culled > 0);
+    }
+
+    void TestBuild(const std::vector<ModelPart>& parts)
+    {
+        Test::Random random(50);
+        CHECK(!parts.empty());
+
+        for (const auto& part : parts)
+        {
+            const size_t vertexCount = part.positions.size() / 3;
+            const auto set = BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                vertexCount, part.clockwise);
+
+            std::printf("%zu triangles: %zu meshlets, winding %s\n", part.indices.size() / 3, set.meshlets.size(),
+                part.clockwise ? "clockwise" : "counterclockwise");
+
+            CheckSet(part, set, c_MaxVertices, c_MaxTriangles);
+            CheckCones(part, set, part.clockwise, random);
+
+            // Built with the other winding, the cones must be just as safe for back faces of that kind.
+            const auto reversed = BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                vertexCount, !part.clockwise);
+            CheckSet(part, reversed, c_MaxVertices, c_MaxTriangles);
+            CheckCones(part, reversed, !part.clockwise, random);
+
+            // Limits from the smallest possible up to a byte's worth of vertices.
+            for (const size_t maxVertices : { size_t(3), size_t(4), size_t(17), size_t(128), size_t(c_MaxVerticesLimit) })
+            {
+                for (const size_t maxTriangles : { size_t(1), size_t(7), size_t(c_MaxTriangles), size_t(512) })
+                {
+                    const auto limited = BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                        vertexCount, part.clockwise, maxVertices, maxTriangles);
+                    CheckSet(part, limited, maxVertices, maxTriangles);
+                }
+            }
+
+            CHECK_THROWS(BuildMeshlets(part.indices.data(), part.indices.size() - 1, part.positions.data(), 3 * sizeof(float),
+                vertexCount, false), std::invalid_argument);
+            CHECK_THROWS(BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                vertexCount - 1, false), std::out_of_range);
+            CHECK_THROWS(BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 2 * sizeof(float),
+                vertexCount, false), std::invalid_argument);
+            CHECK_THROWS(BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                vertexCount, false, 2), std::invalid_argument);
+            CHECK_THROWS(BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                vertexCount, false, c_MaxVerticesLimit + 1), std::invalid_argument);
+            CHECK_THROWS(BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+                vertexCount, false, c_MaxVertices, 0), std::invalid_argument);
+        }
+
+        // No triangles make no meshlets.
+        const auto empty = BuildMeshlets(nullptr, 0, nullptr, 3 * sizeof(float), 0, false);
+        CHECK(empty.meshlets.empty() && empty.bounds.empty());
+    }
+
+    // A copy of a meshlet file image in 4-byte aligned storage, as the game reads it.
+    class Image
+    {
+    public:
+        Image(const uint8_t* data, size_t size) :
+            m_storage((size + 3) / 4 + 1),
+            m_size(size)
+        {
+            if (size)
+            {
+                std::memcpy(m_storage.data(), data, size);
+            }
+        }
+
+        uint8_t* GetData() noexcept { return reinterpret_cast<uint8_t*>(m_storage.data()); }
+        size_t GetSize() const noexcept { return m_size; }
+
+        template<typename T>
+        T& At(size_t offset) noexcept { return *reinterpret_cast<T*>(GetData() + offset); }
+
+    private:
+        std::vector<uint32_t>   m_storage;
+        size_t                  m_size;
+    };
+
+    // For any file the view accepts, everything it hands out has to lie within the image and
+    // every triangle has to index its own meshlet's vertices.
+    void CheckView(const MeshletFileView& view, Image& image)
+    {
+        const auto begin = reinterpret_cast<uintptr_t>(image.GetData());
+        auto isWithin = [&](const void* pointer, uint64_t size)
+            {
+                const auto p = reinterpret_cast<uintptr_t>(pointer);
+                return p >= begin && p - begin <= image.GetSize() && size <= image.GetSize() - (p - begin);
+            };
+
+        CHECK(isWithin(view.GetMeshlets(), uint64_t(view.GetMeshletCount()) * sizeof(Meshlet)));
+        CHECK(isWithin(view.GetBounds(), uint64_t(view.GetMeshletCount()) * sizeof(MeshletBounds)));
+        CHECK(isWithin(view.GetVertices(), uint64_t(view.GetVertexCount()) * sizeof(uint32_t)));
+        CHECK(isWithin(view.GetTriangles(), view.GetTriangleBytes()));
+
+        for (uint32_t j = 0; j < view.GetPartCount(); ++j)
+        {
+            const auto& part = view.GetPart(j);
+            CHECK(uint64_t(part.firstMeshlet) + part.meshletCount <= view.GetMeshletCount());
+        }
+
+        for (uint32_t j = 0; j < view.GetMeshletCount(); ++j)
+        {
+            const auto& meshlet = view.GetMeshlets()[j];
+            CHECK(uint64_t(meshlet.vertexOffset) + meshlet.vertexCount <= view.GetVertexCount());
+            CHECK(uint64_t(meshlet.triangleOffset) + uint64_t(meshlet.triangleCount) * 3 <= view.GetTriangleBytes());
+
+            const uint8_t* triangles = view.GetTriangles() + meshlet.triangleOffset;
+            for (uint32_t k = 0; k < meshlet.triangleCount * 3; ++k)
+            {
+                CHECK(triangles[k] < meshlet.vertexCount);
+            }
+        }
+    }
+
+    // Returns whether the view accepted the image; anything but std::runtime_error is a failure.
+    bool TryView(Image& image, size_t size)
+    {
+        try
+        {
+            const MeshletFileView view(image.GetData(), size);
+            CheckView(view, image);
+            return true;
+        }
+        catch (const std::runtime_error&)
+        {
+            return false;
+        }
+    }
+
+    void TestShippedFile(const std::vector<ModelPart>& parts)
+    {
+        const auto data = Test::ReadAsset("tiny.meshlets");
+        Image image(data.data(), data.size());
+
+        const MeshletFileView view(image.GetData(), image.GetSize());
+        CheckView(view, image);
+        CHECK(view.GetPartCount() == parts.size());
+
+        // The sidecar covers the shipped model's triangles, part by part.
+        for (uint32_t j = 0; j < view.GetPartCount() && j < parts.size(); ++j)
+        {
+            const auto& part = view.GetPart(j);
+            CHECK(GetTriangles(view.GetMeshlets() + part.firstMeshlet, part.meshletCount, view.GetVertices(), view.GetTriangles())
+                == GetTriangles(parts[j].indices));
+        }
+    }
+
+    void TestBadFiles()
+    {
+        using namespace MeshletFormat;
+
+        const auto data = Test::ReadAsset("tiny.meshlets");
+        const Header& header = *reinterpret_cast<const Header*>(data.data());
+        const size_t partsOffset = sizeof(Header);
+        const size_t meshletsOffset = partsOffset + header.partCount * sizeof(Part);
+        const size_t trianglesOffset = meshletsOffset + header.meshletCount * (sizeof(Meshlet) + sizeof(MeshletBounds))
+            + header.vertexCount * sizeof(uint32_t);
+
+        Image good(data.data(), data.size());
+        CHECK(TryView(good, good.GetSize()));
+
+        // Null, misaligned, and every truncation.
+        CHECK_THROWS(MeshletFileView(nullptr, data.size()), std::runtime_error);
+        {
+            std::vector<uint32_t> storage(data.size() / 4 + 2);
+            auto* misaligned = reinterpret_cast<uint8_t*>(storage.data()) + 1;
+            std::memcpy(misaligned, data.data(), data.size());
+            CHECK_THROWS(MeshletFileView(misaligned, data.size()), std::runtime_error);
+        }
+        for (size_t size = 0; size < data.size(); ++size)
+        {
+            CHECK(!TryView(good, size));
+        }
+
+        // Targeted damage, each of which the view must catch.
+        auto damaged = [&](void (*damage)(Image&, size_t meshlets, size_t triangles))
+            {
+                Image image(data.data(), data.size());
+                damage(image, meshletsOffset, trianglesOffset);
+                return !TryView(image, image.GetSize());
+            };
+
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Header>(0).magic ^= 1; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Header>(0).version = c_Version + 1; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Header>(0).partCount = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Header>(0).meshletCount = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Header>(0).vertexCount = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Header>(0).triangleBytes = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Part>(sizeof(Header)).firstMeshlet = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t, size_t) { image.At<Part>(sizeof(Header)).meshletCount += 1; }));
+        CHECK(damaged([](Image& image, size_t meshlets, size_t) { image.At<Meshlet>(meshlets).vertexOffset = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t meshlets, size_t) { image.At<Meshlet>(meshlets).vertexCount = c_MaxVerticesLimit + 1; }));
+        CHECK(damaged([](Image& image, size_t meshlets, size_t) { image.At<Meshlet>(meshlets).triangleOffset = UINT32_MAX; }));
+        CHECK(damaged([](Image& image, size_t meshlets, size_t) { image.At<Meshlet>(meshlets).triangleCount = UINT32_MAX / 2; }));
+        CHECK(damaged([](Image& image, size_t meshlets, size_t triangles)
+            {
+                image.At<uint8_t>(triangles + image.At<Meshlet>(meshlets).triangleOffset) = static_cast<uint8_t>(image.At<Meshlet>(meshlets).vertexCount);
+            }));
+
+        // Random damage: either the view rejects it, or what it accepts is safe to walk.
+        Test::Random random(51);
+        uint32_t accepted = 0;
+        for (int iteration = 0; iteration < 20000; ++iteration)
+        {
+            Image image(data.data(), data.size());
+            const uint32_t flips = 1 + random.Next(6);
+            for (uint32_t j = 0; j < flips; ++j)
+            {
+                // A third of the time, the header and parts, where most of the checks are.
+                const size_t range = (iteration % 3) ? data.size() : std::min<size_t>(meshletsOffset + 64, data.size());
+                image.GetData()[random.Next(static_cast<uint32_t>(range))] = static_cast<uint8_t>(random.Next());
+            }
+
+            const size_t size = (iteration % 7) ? data.size() : random.Next(static_cast<uint32_t>(data.size()));
+            accepted += TryView(image, size);
+        }
+        std::printf("%u of 20000 damaged sidecars accepted\n", accepted);
+    }
+
+    void TestCulling(const std::vector<ModelPart>& parts)
+    {
+        const auto& part = parts[0];
+        const auto set = BuildMeshlets(part.indices.data(), part.indices.size(), part.positions.data(), 3 * sizeof(float),
+            part.positions.size() / 3, part.clockwise);
+
+        // A frustum which holds everything leaves only back faces to cull.
+        Frustum everything = {};
+        for (auto& plane : everything.planes)
+        {
+            plane[3] = FLT_MAX;
+        }
+
+        const float eye[3] = { 0.f, 0.f, -10.f * Extent(part) };
+        std::vector<uint32_t> visible;
+        const auto statistics = CullMeshlets(set.bounds.data(), set.bounds.size(), everything, eye, &visible);
+        CHECK(statistics.outsideFrustum == 0);
+        CHECK(statistics.visible + statistics.backFacing == set.meshlets.size());
+        CHECK(visible.size() == statistics.visible);
+        for (size_t j = 0; j < visible.size(); ++j)
+        {
+            CHECK(!IsBackFacing(set.bounds[visible[j]], eye));
+        }
+
+        // One which holds nothing culls everything against the frustum first.
+        Frustum nothing = {};
+        nothing.planes[0][3] = -FLT_MAX;
+        const auto none = CullMeshlets(set.bounds.data(), set.bounds.size(), nothing, eye);
+        CHECK(none.outsideFrustum == set.meshlets.size() && !none.visible && !none.backFacing);
+    }
+}
+
+int main()
+{
+    try
+    {
+        const auto parts = LoadParts(Test::ReadAsset("tiny_optimized.sdkmesh"));
+        TestBuild(parts);
+        TestShippedFile(parts);
+        TestBadFiles();
+        TestCulling(parts);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return Test::Finish("MeshletTests");
+}
@@ -0,0 +1,307 @@
+//
+// ResidencyPolicyTests.cpp - The LRU residency policy against a brute-force model
+//
+
+#include "ResidencyPolicy.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    using Handle = ResidencyPolicy::Handle;
+
+    // The same policy kept the slow way: a plain vector of resident handles in order of use, which
+    // is searched and erased from linearly.
+    class Model
+    {
+    public:
+        struct Object
+        {
+            uint64_t    size = 0;
+            uint64_t    lastUsed = 0;
+            bool        live = false;
+            bool        resident = false;
+            bool        pinned = false;
+        };
+
+        Handle Add(uint64_t size, uint64_t stamp)
+        {
+            Handle handle;
+            if (!free.empty())
+            {
+                handle = free.back();
+                free.pop_back();
+            }
+            else
+            {
+                handle = static_cast<Handle>(objects.size());
+                objects.emplace_back();
+            }
+
+            objects[handle] = Object{ size, stamp, true, true, false };
+            order.push_back(handle);
+            return handle;
+        }
+
+        void Remove(Handle handle)
+        {
+            const auto it = std::find(order.begin(), order.end(), handle);
+            if (it != order.end())
+            {
+                order.erase(it);
+            }
+
+            objects[handle] = Object();
+            free.push_back(handle);
+        }
+
+        bool Use(Handle handle, uint64_t stamp)
+        {
+            auto& object = objects[handle];
+            object.lastUsed = std::max(object.lastUsed, stamp);
+            if (!object.resident)
+                return false;
+
+            order.erase(std::find(order.begin(), order.end(), handle));
+            order.push_back(handle);
+            return true;
+        }
+
+        void MarkResident(Handle handle)
+        {
+            auto& object = objects[handle];
+            if (object.resident)
+                return;
+
+            object.resident = true;
+            order.push_back(handle);
+        }
+
+        std::vector<Handle> Trim(uint64_t budget, uint64_t completedStamp)
+        {
+            std::vector<Handle> evicted;
+            for (size_t j = 0; j < order.size() && GetResidentBytes() > budget; )
+            {
+                auto& object = objects[order[j]];
+                if (object.lastUsed > completedStamp)
+                    break;
+
+                if (object.pinned)
+                {
+                    ++j;
+                    continue;
+                }
+
+                object.resident = false;
+                evicted.push_back(order[j]);
+                order.erase(order.begin() + ptrdiff_t(j));
+            }
+            return evicted;
+        }
+
+        uint64_t GetResidentBytes() const
+        {
+            uint64_t total = 0;
+            for (const Handle handle : order)
+            {
+                total += objects[handle].size;
+            }
+            return total;
+        }
+
+        uint64_t GetTotalBytes() const
+        {
+            uint64_t total = 0;
+            for (const auto& object : objects)
+            {
+                total += object.live ? object.size : 0;
+            }
+            return total;
+        }
+
+        uint32_t GetCount() const
+        {
+            return static_cast<uint32_t>(std::count_if(objects.begin(), objects.end(), [](const Object& object) { return object.live; }));
+        }
+
+        std::vector<Object> objects;
+        std::vector<Handle> order;      // Resident objects, least recently used first
+        std::vector<Handle> free;
+    };
+
+    void CheckSame(const ResidencyPolicy& policy, const Model& model)
+    {
+        CHECK(policy.GetCount() == model.GetCount());
+        CHECK(policy.GetResidentBytes() == model.GetResidentBytes());
+        CHECK(policy.GetTotalBytes() == model.GetTotalBytes());
+
+        for (Handle handle = 0; handle < model.objects.size(); ++handle)
+        {
+            const auto& object = model.objects[handle];
+            if (!object.live)
+            {
+                CHECK_THROWS(policy.IsResident(handle), std::out_of_range);
+                continue;
+            }
+
+            CHECK(policy.IsResident(handle) == object.resident);
+            CHECK(policy.IsPinned(handle) == object.pinned);
+            CHECK(policy.GetSize(handle) == object.size);
+            CHECK(policy.GetLastUsed(handle) == object.lastUsed);
+        }
+    }
+
+    void TestBasics()
+    {
+        ResidencyPolicy policy;
+        const Handle a = policy.Add(100, 1);
+        const Handle b = policy.Add(200, 2);
+        const Handle c = policy.Add(300, 3);
+
+        CHECK(policy.GetResidentBytes() == 600);
+        CHECK(policy.GetCount() == 3);
+
+        // Using a makes b the least recently used.
+        CHECK(policy.Use(a, 4));
+
+        std::vector<Handle> evicted;
+        policy.Trim(450, 10, evicted);
+        CHECK((evicted == std::vector<Handle>{ b }));
+        CHECK(policy.GetResidentBytes() == 400);
+        CHECK(!policy.IsResident(b));
+
+        // An evicted object reports its use, and comes back at the most recently used end.
+        CHECK(!policy.Use(b, 5));
+        policy.MarkResident(b);
+        CHECK(policy.IsResident(b));
+        CHECK(policy.GetLastUsed(b) == 5);
+
+        // Nothing used after the completed stamp is evicted, however far over budget.
+        evicted.clear();
+        policy.Trim(0, 3, evicted);
+        CHECK((evicted == std::vector<Handle>{ c }));
+
+        // Pinned objects are skipped.
+        policy.MarkResident(c);
+        policy.SetPinned(a, true);
+        evicted.clear();
+        policy.Trim(0, 100, evicted);
+        CHECK((evicted == std::vector<Handle>{ b, c }));
+        CHECK(policy.IsResident(a));
+        CHECK(policy.GetResidentBytes() == 100);
+
+        // Removed handles are invalid until reused.
+        policy.Remove(b);
+        CHECK_THROWS(policy.Use(b, 6), std::out_of_range);
+        CHECK_THROWS(policy.Remove(b), std::out_of_range);
+        CHECK_THROWS(policy.SetPinned(ResidencyPolicy::c_InvalidHandle, true), std::out_of_range);
+        CHECK(policy.Add(50, 7) == b);
+        CHECK(policy.GetTotalBytes() == 100 + 300 + 50);
+    }
+
+    void TestRandom()
+    {
+        Test::Random random(45);
+
+        for (int iteration = 0; iteration < 100; ++iteration)
+        {
+            ResidencyPolicy policy;
+            Model model;
+            std::vector<Handle> live;
+            uint64_t stamp = 1;
+
+            for (int step = 0; step < 2000; ++step)
+            {
+                // Stamps never go backwards, and usually advance a frame at a time.
+                if (!random.Next(4))
+                {
+                    ++stamp;
+                }
+
+                const uint32_t operation = live.empty() ? 0 : random.Next(12);
+                const Handle handle = live.empty() ? 0 : live[random.Next(static_cast<uint32_t>(live.size()))];
+
+                switch (operation)
+                {
+                case 0:
+                case 1:
+                {
+                    const uint64_t size = 1 + random.Next(1000);
+                    const Handle added = policy.Add(size, stamp);
+                    CHECK(added == model.Add(size, stamp));
+                    live.push_back(added);
+                    break;
+                }
+
+                case 2:
+                    policy.Remove(handle);
+                    model.Remove(handle);
+                    live.erase(std::find(live.begin(), live.end(), handle));
+                    break;
+
+                case 3:
+                case 4:
+                case 5:
+                {
+                    // A use may record a stamp older than the last one, which mustn't move it back.
+                    const uint64_t useStamp = stamp - std::min<uint64_t>(stamp, random.Next(2));
+                    CHECK(policy.Use(handle, useStamp) == model.Use(handle, useStamp));
+                    break;
+                }
+
+                case 6:
+                    policy.MarkResident(handle);
+                    model.MarkResident(handle);
+                    break;
+
+                case 7:
+                {
+                    const bool pinned = random.Next(3) == 0;
+                    policy.SetPinned(handle, pinned);
+                    model.objects[handle].pinned = pinned;
+                    break;
+                }
+
+                default:
+                {
+                    const uint64_t budget = random.Next(20000);
+                    const uint64_t completed = stamp - std::min<uint64_t>(stamp, random.Next(4));
+
+                    std::vector<Handle> evicted;
+                    policy.Trim(budget, completed, evicted);
+                    const auto expected = model.Trim(budget, completed);
+                    CHECK(evicted == expected);
+
+                    // Whatever the order, nothing evicted may be pinned or still in use.
+                    for (const Handle e : evicted)
+                    {
+                        CHECK(!model.objects[e].pinned);
+                        CHECK(model.objects[e].lastUsed <= completed);
+                    }
+                    break;
+                }
+                }
+
+                if (!(step % 50))
+                {
+                    CheckSame(policy, model);
+                }
+            }
+
+            CheckSame(policy, model);
+        }
+    }
+}
+
+int main()
+{
+    TestBasics();
+    TestRandom();
+
+    return Test::Finish("ResidencyPolicyTests");
+}
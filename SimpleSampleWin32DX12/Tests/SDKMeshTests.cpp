@@ -0,0 +1,255 @@
+//
+// SDKMeshTests.cpp - SDKMeshView on the shipped model, and on truncated and corrupted copies of it
+//
+
+#include "SDKMesh.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+using namespace DX;
+using namespace DX::SDKMesh;
+
+namespace
+{
+    template<typename T>
+    T& At(std::vector<uint8_t>& image, uint64_t offset)
+    {
+        return *reinterpret_cast<T*>(image.data() + offset);
+    }
+
+    Header& GetHeader(std::vector<uint8_t>& image) { return At<Header>(image, 0); }
+
+    // True if [pointer, pointer + size) lies within the image.
+    bool IsWithin(const std::vector<uint8_t>& image, const void* pointer, uint64_t size)
+    {
+        const auto begin = reinterpret_cast<uintptr_t>(image.data());
+        const auto p = reinterpret_cast<uintptr_t>(pointer);
+        return p >= begin && p - begin <= image.size() && size <= image.size() - (p - begin);
+    }
+
+    // Everything the accessors hand out has to lie within the image, and every cross-reference
+    // has to resolve, for any image the constructor accepts.
+    void CheckView(const SDKMeshView& view, const std::vector<uint8_t>& image)
+    {
+        const auto& header = view.GetHeader();
+
+        CHECK(IsWithin(image, view.GetVertexBuffers(), uint64_t(header.NumVertexBuffers) * sizeof(VertexBufferHeader)));
+        CHECK(IsWithin(image, view.GetIndexBuffers(), uint64_t(header.NumIndexBuffers) * sizeof(IndexBufferHeader)));
+        CHECK(IsWithin(image, view.GetMeshes(), uint64_t(header.NumMeshes) * sizeof(Mesh)));
+        CHECK(IsWithin(image, view.GetSubsets(), uint64_t(header.NumTotalSubsets) * sizeof(Subset)));
+        CHECK(IsWithin(image, view.GetMaterials(), uint64_t(header.NumMaterials) * sizeof(Material)));
+        CHECK(!header.NumFrames || IsWithin(image, view.GetFrames(), uint64_t(header.NumFrames) * sizeof(Frame)));
+
+        for (uint32_t j = 0; j < view.GetVertexBufferCount(); ++j)
+        {
+            const auto& vb = view.GetVertexBuffers()[j];
+            CHECK(IsWithin(image, view.GetVertexData(j), vb.SizeBytes));
+            CHECK(vb.NumVertices * vb.StrideBytes <= vb.SizeBytes);
+        }
+
+        for (uint32_t j = 0; j < view.GetIndexBufferCount(); ++j)
+        {
+            const auto& ib = view.GetIndexBuffers()[j];
+            CHECK(IsWithin(image, view.GetIndexData(j), ib.SizeBytes));
+            CHECK(ib.NumIndices * ((ib.IndexType == IndexType_32Bit) ? 4 : 2) <= ib.SizeBytes);
+        }
+
+        for (uint32_t j = 0; j < view.GetMeshCount(); ++j)
+        {
+            const auto& mesh = view.GetMeshes()[j];
+            CHECK(mesh.IndexBuffer < view.GetIndexBufferCount());
+            CHECK(IsWithin(image, view.GetMeshSubsets(j), uint64_t(mesh.NumSubsets) * sizeof(uint32_t)));
+
+            const auto& vb = view.GetVertexBuffers()[mesh.VertexBuffers[0]];
+            const auto& ib = view.GetIndexBuffers()[mesh.IndexBuffer];
+            for (uint32_t k = 0; k < mesh.NumSubsets; ++k)
+            {
+                const uint32_t index = view.GetMeshSubsets(j)[k];
+                CHECK(index < view.GetSubsetCount());
+                if (index >= view.GetSubsetCount())
+                    continue;
+
+                const auto& subset = view.GetSubsets()[index];
+                CHECK(subset.MaterialID < view.GetMaterialCount());
+                CHECK(subset.IndexStart + subset.IndexCount <= ib.NumIndices);
+                CHECK(subset.VertexStart + subset.VertexCount <= vb.NumVertices);
+            }
+        }
+    }
+
+    void TestShippedModel(const std::vector<uint8_t>& image)
+    {
+        SDKMeshView view(image.data(), image.size());
+        CheckView(view, image);
+
+        CHECK(view.GetData() == image.data());
+        CHECK(view.GetDataSize() == image.size());
+        CHECK(view.GetHeader().Version == c_FileVersion);
+        CHECK(view.GetMeshCount() == 1);
+        CHECK(view.GetSubsetCount() == 1);
+        CHECK(view.GetMaterialCount() == 1);
+        CHECK(view.GetFrameCount() == 1);
+
+        const auto& vb = view.GetVertexBuffers()[0];
+        CHECK(vb.NumVertices == 4432);
+        CHECK(vb.StrideBytes == 32);
+
+        const auto& ib = view.GetIndexBuffers()[0];
+        CHECK(ib.IndexType == IndexType_32Bit);
+        CHECK(ib.NumIndices == 20523);
+
+        CHECK(view.GetTotalVertexBytes() == vb.SizeBytes);
+        CHECK(view.GetTotalIndexBytes() == ib.SizeBytes);
+
+        const auto& subset = view.GetSubsets()[view.GetMeshSubsets(0)[0]];
+        CHECK(subset.PrimitiveType == PrimitiveType_TriangleList);
+        CHECK(subset.IndexStart + subset.IndexCount == ib.NumIndices);
+
+        // Every index of the model refers to a vertex in its buffer.
+        const auto indices = reinterpret_cast<const uint32_t*>(view.GetIndexData(0));
+        uint32_t largest = 0;
+        for (uint64_t j = 0; j < ib.NumIndices; ++j)
+        {
+            largest = std::max(largest, indices[j]);
+        }
+        CHECK(largest < vb.NumVertices);
+
+        CHECK_THROWS(view.GetMeshSubsets(1), std::out_of_range);
+        CHECK_THROWS(view.GetVertexData(1), std::out_of_range);
+        CHECK_THROWS(view.GetIndexData(1), std::out_of_range);
+
+        CHECK_THROWS(SDKMeshView(nullptr, image.size()), std::invalid_argument);
+    }
+
+    // The payloads run to the end of the file, so every shorter prefix is missing something. (An
+    // empty vector may have no data pointer at all, which is an invalid argument instead.)
+    void TestTruncated(const std::vector<uint8_t>& image)
+    {
+        for (size_t size = 1; size < image.size(); ++size)
+        {
+            // Each prefix is copied so reading past its end is a real overrun for sanitizers.
+            const std::vector<uint8_t> prefix(image.cbegin(), image.cbegin() + ptrdiff_t(size));
+            CHECK_THROWS(SDKMeshView(prefix.data(), prefix.size()), std::runtime_error);
+
+            // Past the header arrays nothing changes until the end, so sample sparsely.
+            if (size > 4096)
+            {
+                size += 997;
+            }
+        }
+    }
+
+    template<typename Corrupt>
+    void CheckRejected(const std::vector<uint8_t>& image, const char* what, Corrupt corrupt)
+    {
+        std::vector<uint8_t> copy = image;
+        corrupt(copy);
+
+        bool rejected = false;
+        try
+        {
+            SDKMeshView view(copy.data(), copy.size());
+        }
+        catch (const std::runtime_error&)
+        {
+            rejected = true;
+        }
+
+        if (!rejected)
+        {
+            Test::Fail(__FILE__, __LINE__, what);
+        }
+    }
+
+    void TestCorrupted(const std::vector<uint8_t>& image)
+    {
+        std::vector<uint8_t> copy = image;
+        auto& header = GetHeader(copy);
+        const uint64_t vbOffset = header.VertexStreamHeadersOffset;
+        const uint64_t ibOffset = header.IndexStreamHeadersOffset;
+        const uint64_t meshOffset = header.MeshDataOffset;
+        const uint64_t subsetOffset = header.SubsetDataOffset;
+        const uint64_t frameOffset = header.FrameDataOffset;
+
+        CheckRejected(image, "big-endian", [](std::vector<uint8_t>& i) { GetHeader(i).IsBigEndian = 1; });
+        CheckRejected(image, "version", [](std::vector<uint8_t>& i) { GetHeader(i).Version = 102; });
+        CheckRejected(image, "header size", [](std::vector<uint8_t>& i) { GetHeader(i).HeaderSize = 8; });
+        CheckRejected(image, "buffer size", [](std::vector<uint8_t>& i) { GetHeader(i).BufferDataSize += 1; });
+        CheckRejected(image, "huge sizes", [](std::vector<uint8_t>& i) { GetHeader(i).NonBufferDataSize = UINT64_MAX - 8; });
+        CheckRejected(image, "no meshes", [](std::vector<uint8_t>& i) { GetHeader(i).NumMeshes = 0; });
+        CheckRejected(image, "mesh count", [](std::vector<uint8_t>& i) { GetHeader(i).NumMeshes = 1000; });
+        CheckRejected(image, "misaligned meshes", [](std::vector<uint8_t>& i) { GetHeader(i).MeshDataOffset += 1; });
+        CheckRejected(image, "materials out of range", [](std::vector<uint8_t>& i) { GetHeader(i).MaterialDataOffset = i.size(); });
+
+        CheckRejected(image, "vertex stride", [=](std::vector<uint8_t>& i) { At<VertexBufferHeader>(i, vbOffset).StrideBytes = 0; });
+        CheckRejected(image, "vertex count", [=](std::vector<uint8_t>& i) { At<VertexBufferHeader>(i, vbOffset).NumVertices += 1; });
+        CheckRejected(image, "vertex data", [=](std::vector<uint8_t>& i) { At<VertexBufferHeader>(i, vbOffset).DataOffset = i.size() - 16; });
+        CheckRejected(image, "vertex data in headers", [=](std::vector<uint8_t>& i) { At<VertexBufferHeader>(i, vbOffset).DataOffset = 0; });
+
+        CheckRejected(image, "index type", [=](std::vector<uint8_t>& i) { At<IndexBufferHeader>(i, ibOffset).IndexType = 2; });
+        CheckRejected(image, "index count", [=](std::vector<uint8_t>& i) { At<IndexBufferHeader>(i, ibOffset).NumIndices += 1; });
+        CheckRejected(image, "index data", [=](std::vector<uint8_t>& i) { At<IndexBufferHeader>(i, ibOffset).DataOffset = UINT64_MAX; });
+
+        CheckRejected(image, "mesh vertex streams", [=](std::vector<uint8_t>& i) { At<Mesh>(i, meshOffset).NumVertexBuffers = c_MaxVertexStreams + 1; });
+        CheckRejected(image, "mesh vertex buffer", [=](std::vector<uint8_t>& i) { At<Mesh>(i, meshOffset).VertexBuffers[0] = 1; });
+        CheckRejected(image, "mesh index buffer", [=](std::vector<uint8_t>& i) { At<Mesh>(i, meshOffset).IndexBuffer = 1; });
+        CheckRejected(image, "mesh subsets", [=](std::vector<uint8_t>& i) { At<Mesh>(i, meshOffset).SubsetOffset = i.size(); });
+        CheckRejected(image, "mesh subset index", [=](std::vector<uint8_t>& i) { At<uint32_t>(i, At<Mesh>(i, meshOffset).SubsetOffset) = 1; });
+
+        CheckRejected(image, "subset material", [=](std::vector<uint8_t>& i) { At<Subset>(i, subsetOffset).MaterialID = 1; });
+        CheckRejected(image, "subset indices", [=](std::vector<uint8_t>& i) { At<Subset>(i, subsetOffset).IndexCount += 1; });
+        CheckRejected(image, "subset vertices", [=](std::vector<uint8_t>& i) { At<Subset>(i, subsetOffset).VertexStart = UINT64_MAX; });
+
+        CheckRejected(image, "frame mesh", [=](std::vector<uint8_t>& i) { At<Frame>(i, frameOffset).Mesh = 1; });
+        CheckRejected(image, "frame parent", [=](std::vector<uint8_t>& i) { At<Frame>(i, frameOffset).ParentFrame = 1; });
+
+        // Random damage to the headers must either be caught, or leave a view whose accessors all
+        // stay within the image.
+        const uint64_t headerBytes = header.HeaderSize + header.NonBufferDataSize;
+        Test::Random random(41);
+        for (int iteration = 0; iteration < 20000; ++iteration)
+        {
+            copy = image;
+
+            const uint32_t flips = 1 + random.Next(4);
+            for (uint32_t j = 0; j < flips; ++j)
+            {
+                copy[random.Next(static_cast<uint32_t>(headerBytes))] ^= static_cast<uint8_t>(1 + random.Next(255));
+            }
+
+            try
+            {
+                SDKMeshView view(copy.data(), copy.size());
+                CheckView(view, copy);
+            }
+            catch (const std::runtime_error&)
+            {
+            }
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        const auto image = Test::ReadAsset("tiny.sdkmesh");
+
+        TestShippedModel(image);
+        TestTruncated(image);
+        TestCorrupted(image);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return Test::Finish("SDKMeshTests");
+}
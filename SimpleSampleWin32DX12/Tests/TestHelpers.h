@@ -0,0 +1,174 @@
+//
+// TestHelpers.h - Minimal checks and timing shared by the portable module tests and benchmarks
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace Test
+{
+    inline int& FailureCount() noexcept
+    {
+        static int s_failures = 0;
+        return s_failures;
+    }
+
+    inline void Fail(const char* file, int line, const char* what)
+    {
+        std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, what);
+        ++FailureCount();
+    }
+
+    // Prints a summary and returns the process exit code.
+    inline int Finish(const char* name)
+    {
+        const int failures = FailureCount();
+        if (failures)
+        {
+            std::fprintf(stderr, "%s: %d check(s) failed\n", name, failures);
+            return EXIT_FAILURE;
+        }
+
+        std::printf("%s: passed\n", name);
+        return EXIT_SUCCESS;
+    }
+
+    // Reads a file shipped with the sample, relative to the sample directory.
+    inline std::vector<uint8_t> ReadAsset(const char* name)
+    {
+        const std::string path = std::string(TEST_ASSET_DIR) + "/" + name;
+
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if (!input)
+        {
+            throw std::runtime_error("Can't open " + path);
+        }
+
+        const std::streamoff size = input.tellg();
+        std::vector<uint8_t> data(static_cast<size_t>(std::max<std::streamoff>(size, 0)));
+        input.seekg(0);
+        if (!data.empty() && !input.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size())))
+        {
+            throw std::runtime_error("Can't read " + path);
+        }
+
+        return data;
+    }
+
+    // Benchmarks take an optional scale argument; ctest runs them small so the gate stays quick.
+    inline double GetScale(int argc, char** argv)
+    {
+        return (argc > 1) ? std::atof(argv[1]) : 1.0;
+    }
+
+    // A view-projection matrix in the DirectXMath convention (row vectors, left-handed, clip space
+    // z from 0 to w), for a camera at the origin turned yaw radians about y.
+    inline void MakeViewProjection(float yaw, float farZ, float (&m)[4][4]) noexcept
+    {
+        const float fovY = 1.0f;
+        const float aspect = 16.f / 9.f;
+        const float nearZ = 0.1f;
+
+        const float ys = 1.f / std::tan(fovY * 0.5f);
+        const float xs = ys / aspect;
+        const float range = farZ / (farZ - nearZ);
+
+        // The view matrix undoes the turn.
+        const float c = std::cos(yaw);
+        const float s = std::sin(yaw);
+        const float view[4][4] =
+        {
+            { c, 0, s, 0 },
+            { 0, 1, 0, 0 },
+            { -s, 0, c, 0 },
+            { 0, 0, 0, 1 },
+        };
+        const float projection[4][4] =
+        {
+            { xs, 0, 0, 0 },
+            { 0, ys, 0, 0 },
+            { 0, 0, range, 1 },
+            { 0, 0, -range * nearZ, 0 },
+        };
+
+        for (int row = 0; row < 4; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                m[row][column] = 0.f;
+                for (int k = 0; k < 4; ++k)
+                {
+                    m[row][column] += view[row][k] * projection[k][column];
+                }
+            }
+        }
+    }
+
+    class Timer
+    {
+    public:
+        Timer() noexcept : m_start(std::chrono::steady_clock::now()) {}
+
+        double GetMilliseconds() const noexcept
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // A small deterministic generator, so failures reproduce on every platform.
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) noexcept : m_state(seed ? seed : 1) {}
+
+        uint32_t Next() noexcept
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 7;
+            m_state ^= m_state << 17;
+            return static_cast<uint32_t>(m_state >> 32);
+        }
+
+        // In [0, bound).
+        uint32_t Next(uint32_t bound) noexcept
+        {
+            return static_cast<uint32_t>((uint64_t(Next()) * bound) >> 32);
+        }
+
+        // In [lower, upper).
+        float NextFloat(float lower, float upper) noexcept
+        {
+            return lower + (upper - lower) * float(Next() >> 8) * (1.f / 16777216.f);
+        }
+
+    private:
+        uint64_t m_state;
+    };
+}
+
+#define CHECK(expr) \
+    do { if (!(expr)) Test::Fail(__FILE__, __LINE__, #expr); } while (false)
+
+#define CHECK_THROWS(expr, exception) \
+    do \
+    { \
+        bool thrown = false; \
+        try { (void)(expr); } \
+        catch (const exception&) { thrown = true; } \
+        catch (...) {} \
+        if (!thrown) Test::Fail(__FILE__, __LINE__, #expr " throws " #exception); \
+    } while (false)
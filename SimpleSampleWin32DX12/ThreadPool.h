@@ -0,0 +1,177 @@
+//
+// ThreadPool.h - A simple fixed-size worker thread pool
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace DX
+{
+    // Runs tasks on a fixed set of worker threads. Submit returns a future for the task's result;
+    // ParallelFor splits an index range across the workers and the calling thread.
+    class ThreadPool
+    {
+    public:
+        // A thread count of zero uses one thread per hardware thread, less one for the caller.
+        explicit ThreadPool(unsigned int threadCount = 0) noexcept(false) :
+            m_stop(false)
+        {
+            if (!threadCount)
+            {
+                const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+                threadCount = (hardwareThreads > 1) ? (hardwareThreads - 1) : 1;
+            }
+
+            m_threads.reserve(threadCount);
+            for (unsigned int j = 0; j < threadCount; ++j)
+            {
+                m_threads.emplace_back([this]() { WorkerLoop(); });
+            }
+        }
+
+        ThreadPool(ThreadPool&&) = delete;
+        ThreadPool& operator= (ThreadPool&&) = delete;
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator= (ThreadPool const&) = delete;
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_condition.notify_all();
+
+            for (auto& thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        template<typename F>
+        auto Submit(F&& task) -> std::future<decltype(task())>
+        {
+            using Result = decltype(task());
+
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+            auto result = packaged->get_future();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.emplace_back([packaged]() { (*packaged)(); });
+            }
+            m_condition.notify_one();
+
+            return result;
+        }
+
+        // Calls body(index) for every index in [begin, end), returning once all calls have finished.
+        // The first exception thrown by any call is rethrown on the calling thread.
+        template<typename F>
+        void ParallelFor(size_t begin, size_t end, F&& body)
+        {
+            if (begin >= end)
+                return;
+
+            std::atomic<size_t> next(begin);
+            auto run = [&]()
+                {
+                    try
+                    {
+                        for (size_t index = next++; index < end; index = next++)
+                        {
+                            body(index);
+                        }
+                    }
+                    catch (...)
+                    {
+                        // Stop handing out further indices.
+                        next = end;
+                        throw;
+                    }
+                };
+
+            const size_t helpers = std::min<size_t>(m_threads.size(), end - begin - 1);
+
+            std::vector<std::future<void>> pending;
+            pending.reserve(helpers);
+            for (size_t j = 0; j < helpers; ++j)
+            {
+                pending.emplace_back(Submit(run));
+            }
+
+            std::exception_ptr error;
+            try
+            {
+                run();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            // Helpers reference this stack frame, so they must all finish before returning.
+            for (auto& it : pending)
+            {
+                try
+                {
+                    it.get();
+                }
+                catch (...)
+                {
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                }
+            }
+
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        size_t GetThreadCount() const noexcept { return m_threads.size(); }
+
+    private:
+        void WorkerLoop()
+        {
+            for (;;)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+                    if (m_tasks.empty())
+                        return;
+
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+
+        std::vector<std::thread>            m_threads;
+        std::deque<std::function<void()>>   m_tasks;
+        std::mutex                          m_mutex;
+        std::condition_variable             m_condition;
+        bool                                m_stop;
+    };
+}
@@ -77,6 +77,7 @@
 #endif
 
 #include "directxtk12/Audio.h"
+#include "directxtk12/BufferHelpers.h"
 #include "directxtk12/CommonStates.h"
 #include "directxtk12/DirectXHelpers.h"
 #include "directxtk12/DDSTextureLoader.h"